@@ -0,0 +1,59 @@
+/*
+ * libpino bench - bench.h
+ * 
+ */
+
+#ifndef PINO_BENCH_H
+#define PINO_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+static inline double bench_now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+static inline void bench_fill(uint8_t *out, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint8_t)(i * 31 + 7);
+    }
+}
+
+static inline void bench_report(const char *name, size_t param, double seconds, size_t bytes)
+{
+    printf("%-32s %8zu %10.3f ms %10.1f MiB/s\n",
+        name, param, seconds * 1e3,
+        seconds > 0 ? (double)bytes / seconds / (1024.0 * 1024.0) : 0.0
+    );
+}
+
+#endif  /* PINO_BENCH_H */
@@ -0,0 +1,87 @@
+/*
+ * libpino bench - bench_cache.c
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../tests/handler_spl1.h"
+#include "bench.h"
+
+#define BENCH_ROUNDS        1000
+
+static bool bench_case(const uint8_t *data, size_t size, bool cached)
+{
+    pino_t *pino;
+    uint8_t *buffer;
+    const void *view;
+    double begin, serialize, shared;
+    size_t record_size, view_size, round;
+
+    pino = pino_pack("spl1", data, size);
+    record_size = pino ? pino_serialize_size(pino) : 0;
+    buffer = record_size ? (uint8_t *)malloc(record_size) : NULL;
+    if (!buffer || !pino_serialize_cache(pino, cached)) {
+        free(buffer);
+        pino_destroy(pino);
+        return false;
+    }
+
+    /* a fan-out to many subscribers of the same unchanged pino; spl1 serializes with a plain copy,
+       so the cached path only saves the handler calls while the view saves the copy as well */
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        if (pino_serialize_size(pino) != record_size || !pino_serialize(pino, buffer)) {
+            break;
+        }
+    }
+    serialize = bench_now() - begin;
+
+    view_size = 0;
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS && cached; round++) {
+        view = pino_serialize_view(pino, 0, &view_size);
+        if (!view) {
+            break;
+        }
+    }
+    shared = bench_now() - begin;
+
+    free(buffer);
+    pino_destroy(pino);
+
+    bench_report(cached ? "serialize (cached)" : "serialize", size, serialize, record_size * BENCH_ROUNDS);
+    if (cached) {
+        bench_report("serialize_view", size, shared, view_size * BENCH_ROUNDS);
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    uint8_t *data;
+    size_t sizes[] = {64, 4096, 64 * 1024, 1024 * 1024}, i;
+
+    data = (uint8_t *)malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    if (!data || !pino_init() || !PH_REG(spl1)) {
+        return 1;
+    }
+
+    bench_fill(data, sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (!bench_case(data, sizes[i], false) || !bench_case(data, sizes[i], true)) {
+            return 1;
+        }
+    }
+
+    PH_UNREG(spl1);
+    pino_free();
+    free(data);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * libpino bench - bench_checksum.c
+ * 
+ */
+
+#include <stdio.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+#include "../tests/handler_spl1.h"
+#include "bench.h"
+
+#define BENCH_BYTES         (256 * 1024 * 1024)
+#define BENCH_ROUNDS        1000
+
+static bool bench_unserialize(const char *name, const pino_t *pino, uint32_t flags, size_t record_size)
+{
+    pino_t *out;
+    uint8_t *buffer;
+    double begin, seconds;
+    size_t size, rounds, round;
+
+    size = pino_serialize_size_ex(pino, flags);
+    buffer = (uint8_t *)malloc(size);
+    if (!buffer || !pino_serialize_ex(pino, buffer, flags)) {
+        free(buffer);
+        return false;
+    }
+
+    rounds = BENCH_ROUNDS;
+    begin = bench_now();
+    for (round = 0; round < rounds; round++) {
+        out = pino_unserialize(buffer, size);
+        if (!out) {
+            free(buffer);
+            return false;
+        }
+        pino_destroy(out);
+    }
+    seconds = bench_now() - begin;
+
+    bench_report(name, record_size, seconds, rounds * record_size);
+    free(buffer);
+
+    return true;
+}
+
+static void bench_crc(const char *name, const uint8_t *src, uint8_t *dest, size_t size, bool hardware)
+{
+    double begin;
+    volatile uint32_t crc;
+
+    pino_crc32c_hardware(hardware);
+
+    begin = bench_now();
+    crc = pino_crc32c_update(0, src, size);
+    bench_report(hardware ? "crc32c (hardware)" : "crc32c (slicing-by-8)", size, bench_now() - begin, size);
+
+    begin = bench_now();
+    crc = pino_crc32c_copy(crc, dest, src, size);
+    bench_report(name, size, bench_now() - begin, size);
+
+    (void)crc;
+}
+
+int main(void)
+{
+    pino_t *pino;
+    uint8_t *src, *dest;
+    size_t sizes[] = {256, 4096, 64 * 1024, 1024 * 1024}, i;
+    double begin;
+
+    src = (uint8_t *)malloc(BENCH_BYTES);
+    dest = (uint8_t *)malloc(BENCH_BYTES);
+    if (!src || !dest || !pino_init() || !PH_REG(spl1)) {
+        return 1;
+    }
+
+    bench_fill(src, BENCH_BYTES);
+    bench_fill(dest, BENCH_BYTES);
+
+    begin = bench_now();
+    memcpy(dest, src, BENCH_BYTES);
+    bench_report("memcpy", BENCH_BYTES, bench_now() - begin, BENCH_BYTES);
+    bench_crc("crc32c_copy (slicing-by-8)", src, dest, BENCH_BYTES, false);
+    printf("hardware crc32c: %s\n", pino_crc32c_hardware(true) ? "yes" : "no");
+    bench_crc("crc32c_copy (hardware)", src, dest, BENCH_BYTES, true);
+
+    /* the checked decode should stay close to the plain one */
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        pino = pino_pack("spl1", src, sizes[i]);
+        if (!pino ||
+            !bench_unserialize("unserialize (plain)", pino, 0, sizes[i]) ||
+            !bench_unserialize("unserialize (crc32c)", pino, PINO_SERIALIZE_CRC32C, sizes[i])
+        ) {
+            return 1;
+        }
+        pino_destroy(pino);
+    }
+
+    PH_UNREG(spl1);
+    pino_free();
+    free(src);
+    free(dest);
+
+    return 0;
+}
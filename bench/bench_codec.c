@@ -0,0 +1,239 @@
+/*
+ * libpino bench - bench_codec.c
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../tests/handler_fld1.h"
+#include "bench.h"
+
+#define BENCH_ROUNDS        200000
+
+/* fld1 written by hand the usual way: one conversion per member and per array element */
+PH_BEGIN(hnd1);
+
+PH_DEF_STATIC_FIELDS_STRUCT(hnd1) {
+    uint32_t size;
+} PH_DEF_STATIC_FIELDS_STRUCT_END;
+
+PH_DEF_STRUCT(hnd1) {
+    uint64_t id;
+    uint32_t seq;
+    uint32_t flags;
+    uint16_t kind;
+    uint16_t ports[3];
+    uint8_t level;
+    uint8_t *body;
+    uint32_t body_count;
+    uint32_t *values;
+    uint32_t values_count;
+} PH_DEF_STRUCT_END;
+
+#define HND1_PUT(param, size) do { \
+    PH_MEMCPY_SERIALIZE(dest, param, size); \
+    dest += size; \
+} while (0)
+
+#define HND1_GET(param, size) do { \
+    if (size > remain) { \
+        return false; \
+    } \
+    PH_MEMCPY_UNSERIALIZE(param, src, size); \
+    src += size; \
+    remain -= size; \
+} while (0)
+
+PH_DEFUN_SERIALIZE_SIZE(hnd1) {
+    return 8 + 4 + 4 + 2 + 2 * 3 + 1 + 4 + (size_t)PH_THIS(hnd1)->body_count + 4 + 4 * (size_t)PH_THIS(hnd1)->values_count;
+}
+
+PH_DEFUN_SERIALIZE(hnd1) {
+    uint8_t *dest = (uint8_t *)PH_ARG_DST;
+    uint32_t i;
+
+    HND1_PUT(&PH_THIS(hnd1)->id, 8);
+    HND1_PUT(&PH_THIS(hnd1)->seq, 4);
+    HND1_PUT(&PH_THIS(hnd1)->flags, 4);
+    HND1_PUT(&PH_THIS(hnd1)->kind, 2);
+    for (i = 0; i < 3; i++) {
+        HND1_PUT(&PH_THIS(hnd1)->ports[i], 2);
+    }
+    HND1_PUT(&PH_THIS(hnd1)->level, 1);
+    HND1_PUT(&PH_THIS(hnd1)->body_count, 4);
+    memcpy(dest, PH_THIS(hnd1)->body, PH_THIS(hnd1)->body_count);
+    dest += PH_THIS(hnd1)->body_count;
+    HND1_PUT(&PH_THIS(hnd1)->values_count, 4);
+    for (i = 0; i < PH_THIS(hnd1)->values_count; i++) {
+        HND1_PUT(&PH_THIS(hnd1)->values[i], 4);
+    }
+
+    return true;
+}
+
+PH_DEFUN_UNSERIALIZE(hnd1) {
+    const uint8_t *src = (const uint8_t *)PH_ARG_SRC;
+    size_t remain = PH_ARG_SRC_SIZE;
+    uint32_t i;
+
+    HND1_GET(&PH_THIS(hnd1)->id, 8);
+    HND1_GET(&PH_THIS(hnd1)->seq, 4);
+    HND1_GET(&PH_THIS(hnd1)->flags, 4);
+    HND1_GET(&PH_THIS(hnd1)->kind, 2);
+    for (i = 0; i < 3; i++) {
+        HND1_GET(&PH_THIS(hnd1)->ports[i], 2);
+    }
+    HND1_GET(&PH_THIS(hnd1)->level, 1);
+    HND1_GET(&PH_THIS(hnd1)->body_count, 4);
+    if (PH_THIS(hnd1)->body_count > remain) {
+        return false;
+    }
+    PH_THIS(hnd1)->body = (uint8_t *)malloc(PH_THIS(hnd1)->body_count + 1);
+    if (!PH_THIS(hnd1)->body) {
+        return false;
+    }
+    HND1_GET(PH_THIS(hnd1)->body, (size_t)PH_THIS(hnd1)->body_count);
+    HND1_GET(&PH_THIS(hnd1)->values_count, 4);
+    if (PH_THIS(hnd1)->values_count > remain / 4) {
+        return false;
+    }
+    PH_THIS(hnd1)->values = (uint32_t *)malloc(4 * (size_t)PH_THIS(hnd1)->values_count + 1);
+    if (!PH_THIS(hnd1)->values) {
+        return false;
+    }
+    for (i = 0; i < PH_THIS(hnd1)->values_count; i++) {
+        HND1_GET(&PH_THIS(hnd1)->values[i], 4);
+    }
+
+    return remain == 0;
+}
+
+/* the benchmark only moves records, the native form goes through the same code */
+PH_DEFUN_PACK(hnd1) {
+    return PH_NAME_FUNC_UNSERIALIZE(hnd1)(PH_ARG_THIS, PH_ARG_STATIC_FIELDS, PH_ARG_SRC, PH_ARG_SIZE);
+}
+
+PH_DEFUN_UNPACK_SIZE(hnd1) {
+    return PH_NAME_FUNC_SERIALIZE_SIZE(hnd1)(PH_ARG_THIS, PH_ARG_STATIC_FIELDS);
+}
+
+PH_DEFUN_UNPACK(hnd1) {
+    return PH_NAME_FUNC_SERIALIZE(hnd1)(PH_ARG_THIS, PH_ARG_STATIC_FIELDS, PH_ARG_DST);
+}
+
+PH_DEFUN_CREATE(hnd1) {
+    uint32_t size = (uint32_t)PH_ARG_SIZE;
+
+    PH_CREATE_THIS(hnd1);
+    PH_THIS_STATIC_SET(hnd1, size, &size);
+
+    return PH_THIS(hnd1);
+}
+
+PH_DEFUN_DESTROY(hnd1) {
+    free(PH_THIS(hnd1)->body);
+    free(PH_THIS(hnd1)->values);
+    PH_DESTROY_THIS(hnd1);
+}
+
+PH_END(hnd1);
+
+static size_t bench_build(uint8_t *dest, size_t body_count, size_t values_count)
+{
+    uint8_t *p = dest;
+    uint32_t count;
+    size_t i;
+
+    /* id, seq, flags, kind, ports, level */
+    bench_fill(p, 8 + 4 + 4 + 2 + 2 * 3 + 1);
+    p += 8 + 4 + 4 + 2 + 2 * 3 + 1;
+    count = (uint32_t)body_count;
+    memcpy(p, &count, sizeof(count));
+    p += sizeof(count);
+    bench_fill(p, body_count);
+    p += body_count;
+    count = (uint32_t)values_count;
+    memcpy(p, &count, sizeof(count));
+    p += sizeof(count);
+    for (i = 0; i < values_count; i++) {
+        count = (uint32_t)(i * 2654435761U);
+        memcpy(p, &count, sizeof(count));
+        p += sizeof(count);
+    }
+
+    return (size_t)(p - dest);
+}
+
+static bool bench_case(pino_magic_safe_t magic, const char *label, const uint8_t *src, size_t size, size_t values_count)
+{
+    pino_t *pino, *out;
+    uint8_t *buffer;
+    double begin, serialize, unserialize;
+    size_t record_size, round;
+    char name[64];
+
+    pino = pino_pack(magic, src, size);
+    record_size = pino ? pino_serialize_size(pino) : 0;
+    buffer = record_size ? (uint8_t *)malloc(record_size) : NULL;
+    if (!buffer) {
+        pino_destroy(pino);
+        return false;
+    }
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        if (pino_serialize_size(pino) != record_size || !pino_serialize(pino, buffer)) {
+            break;
+        }
+    }
+    serialize = bench_now() - begin;
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        out = pino_unserialize(buffer, record_size);
+        if (!out) {
+            break;
+        }
+        pino_destroy(out);
+    }
+    unserialize = bench_now() - begin;
+
+    snprintf(name, sizeof(name), "serialize (%s)", label);
+    bench_report(name, values_count, serialize, record_size * BENCH_ROUNDS);
+    snprintf(name, sizeof(name), "unserialize (%s)", label);
+    bench_report(name, values_count, unserialize, record_size * BENCH_ROUNDS);
+
+    free(buffer);
+    pino_destroy(pino);
+
+    return true;
+}
+
+int main(void)
+{
+    uint8_t src[8192];
+    size_t values[] = {0, 16, 256}, size, i;
+
+    if (!pino_init() || !PH_REG(fld1) || !PH_REG(hnd1)) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        size = bench_build(src, 64, values[i]);
+        if (!bench_case("hnd1", "hand-written", src, size, values[i]) ||
+            !bench_case("fld1", "field list", src, size, values[i])
+        ) {
+            return 1;
+        }
+    }
+
+    PH_UNREG(hnd1);
+    PH_UNREG(fld1);
+    pino_free();
+
+    return 0;
+}
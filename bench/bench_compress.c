@@ -0,0 +1,130 @@
+/*
+ * libpino bench - bench_compress.c
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../tests/handler_spl1.h"
+#include "bench.h"
+
+#define BENCH_ROUNDS        200
+
+typedef enum {
+    BENCH_DATA_TEXT = 0,
+    BENCH_DATA_TABLE,
+    BENCH_DATA_RANDOM
+} bench_data_t;
+
+static const char *g_data_names[] = {"text", "table", "random"};
+
+static void bench_generate(uint8_t *out, size_t size, bench_data_t kind)
+{
+    static const char words[] = "pino serialize unserialize handler static fields payload record ";
+    uint32_t state = 2463534242U, value;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        switch (kind) {
+            case BENCH_DATA_TEXT:
+                out[i] = (uint8_t)words[(state % 8 == 0 ? state : i) % (sizeof(words) - 1)];
+                break;
+            case BENCH_DATA_TABLE:
+                /* rows of little endian u32 counters with a few noisy columns */
+                value = (uint32_t)(i / 16) + ((i % 16) >= 12 ? (state & 0xFF) : 0);
+                out[i] = (uint8_t)(value >> (8 * (i % 4)));
+                break;
+            case BENCH_DATA_RANDOM:
+            default:
+                out[i] = (uint8_t)state;
+                break;
+        }
+    }
+}
+
+static bool bench_case(const uint8_t *data, size_t size, bench_data_t kind, uint32_t flags)
+{
+    char name[64];
+    pino_t *pino, *out;
+    uint8_t *buffer;
+    double begin, serialize, unserialize;
+    size_t capacity, record_size, round;
+
+    pino = pino_pack("spl1", data, size);
+    capacity = pino ? pino_serialize_record(pino, NULL, 0, flags) : 0;
+    buffer = capacity ? (uint8_t *)malloc(capacity) : NULL;
+    if (!buffer) {
+        pino_destroy(pino);
+        return false;
+    }
+
+    record_size = 0;
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        record_size = pino_serialize_record(pino, buffer, capacity, flags);
+    }
+    serialize = bench_now() - begin;
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS && record_size > 0; round++) {
+        out = pino_unserialize(buffer, record_size);
+        if (!out) {
+            record_size = 0;
+            break;
+        }
+        pino_destroy(out);
+    }
+    unserialize = bench_now() - begin;
+
+    free(buffer);
+    pino_destroy(pino);
+    if (record_size == 0) {
+        return false;
+    }
+
+    /* throughput is counted in raw payload bytes for both paths */
+    snprintf(name, sizeof(name), "serialize (%s, %s)", g_data_names[kind], flags ? "lz" : "raw");
+    bench_report(name, size, serialize, size * BENCH_ROUNDS);
+    snprintf(name, sizeof(name), "unserialize (%s, %s)", g_data_names[kind], flags ? "lz" : "raw");
+    bench_report(name, size, unserialize, size * BENCH_ROUNDS);
+    printf("%-32s %8zu %10.3f x\n", "ratio", size, (double)capacity / (double)record_size);
+
+    return true;
+}
+
+int main(void)
+{
+    uint8_t *data;
+    size_t sizes[] = {4096, 64 * 1024, 1024 * 1024}, i;
+    int kind;
+
+    data = (uint8_t *)malloc(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    if (!data || !pino_init() || !PH_REG(spl1)) {
+        return 1;
+    }
+
+    for (kind = BENCH_DATA_TEXT; kind <= BENCH_DATA_RANDOM; kind++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            bench_generate(data, sizes[i], (bench_data_t)kind);
+            if (!bench_case(data, sizes[i], (bench_data_t)kind, 0) ||
+                !bench_case(data, sizes[i], (bench_data_t)kind, PINO_SERIALIZE_COMPRESS)
+            ) {
+                return 1;
+            }
+        }
+    }
+
+    PH_UNREG(spl1);
+    pino_free();
+    free(data);
+
+    return 0;
+}
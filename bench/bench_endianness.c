@@ -0,0 +1,87 @@
+/*
+ * libpino bench - bench_endianness.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/endianness.h>
+#include <pino/pool.h>
+
+#include "bench.h"
+
+#define BENCH_SIZE          (256 * 1024 * 1024)
+#define BENCH_ROUNDS        5
+
+static void bench_workers(pino_pool_t *pool, uint8_t *dest, const uint8_t *src, bool streaming)
+{
+    double begin, swap, copy;
+    size_t round;
+
+    pino_endianness_parallel(pool, 0);
+    pino_endianness_streaming(streaming, 0);
+
+    swap = 0.0;
+    copy = 0.0;
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        /* one of these always swaps, whatever the host is */
+        begin = bench_now();
+        pino_endianness_memcpy_array_native2be(dest, src, BENCH_SIZE / sizeof(uint32_t), sizeof(uint32_t));
+        pino_endianness_memcpy_array_native2le(dest, src, BENCH_SIZE / sizeof(uint32_t), sizeof(uint32_t));
+        swap += bench_now() - begin;
+
+        begin = bench_now();
+        pino_endianness_memcpy_native2le(dest, src, BENCH_SIZE);
+        copy += bench_now() - begin;
+    }
+
+    bench_report(streaming ? "memcpy_array (u32, streaming)" : "memcpy_array (u32, cached)", pino_pool_workers(pool), swap / BENCH_ROUNDS, (size_t)BENCH_SIZE * 2);
+    bench_report(streaming ? "memcpy (bytes, streaming)" : "memcpy (bytes, cached)", pino_pool_workers(pool), copy / BENCH_ROUNDS, BENCH_SIZE);
+
+    pino_endianness_parallel(NULL, 0);
+    pino_endianness_streaming(true, 0);
+}
+
+int main(void)
+{
+    pino_pool_t *pool;
+    uint8_t *src, *dest;
+    size_t cpus, workers;
+
+    src = (uint8_t *)malloc(BENCH_SIZE);
+    dest = (uint8_t *)malloc(BENCH_SIZE);
+    if (!src || !dest) {
+        return 1;
+    }
+
+    bench_fill(src, BENCH_SIZE);
+    bench_fill(dest, BENCH_SIZE);
+
+    pool = pino_pool_create(0);
+    cpus = pino_pool_workers(pool);
+    pino_pool_destroy(pool);
+
+    printf("size: %d, cpus: %zu\n", BENCH_SIZE, cpus);
+
+    /* 1, 2, 4, ... and finally every CPU */
+    for (workers = 1; ; workers *= 2) {
+        workers = workers < cpus ? workers : cpus;
+
+        pool = pino_pool_create(workers);
+        if (!pool) {
+            return 1;
+        }
+
+        bench_workers(pool, dest, src, false);
+        bench_workers(pool, dest, src, true);
+        pino_pool_destroy(pool);
+
+        if (workers == cpus) {
+            break;
+        }
+    }
+
+    free(dest);
+    free(src);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * libpino bench - bench_fields.c
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../tests/handler_aln1.h"
+#include "bench.h"
+
+#define BENCH_COUNT         4096
+#define BENCH_ROUNDS        2000
+#define BENCH_RECORDS       100000
+
+/* the same members as aln1, packed like every PH_DEF_STATIC_FIELDS_STRUCT() */
+PH_DEF_STATIC_FIELDS_STRUCT(pkd1) {
+    uint8_t kind;
+    uint64_t id;
+    uint32_t size;
+    uint16_t tags[3];
+} PH_DEF_STATIC_FIELDS_STRUCT_END;
+
+static volatile uint64_t g_sink;
+
+static uint64_t sum_packed(const struct PH_NAME_STATIC_FIELDS_STRUCT(pkd1) *fields, size_t count)
+{
+    uint64_t sum = 0, id;
+    uint32_t size;
+    uint16_t tags[3];
+    uint8_t kind;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        PH_THIS_STATIC_GET_P(pkd1, &fields[i], kind, &kind);
+        PH_THIS_STATIC_GET_P(pkd1, &fields[i], id, &id);
+        PH_THIS_STATIC_GET_P(pkd1, &fields[i], size, &size);
+        PH_THIS_STATIC_GET_P(pkd1, &fields[i], tags, tags);
+        sum += kind + id + size + tags[0] + tags[1] + tags[2];
+    }
+
+    return sum;
+}
+
+static uint64_t sum_aligned(const struct PH_NAME_STATIC_FIELDS_STRUCT(aln1) *fields, size_t count)
+{
+    uint64_t sum = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        sum += fields[i].kind + fields[i].id + fields[i].size + fields[i].tags[0] + fields[i].tags[1] + fields[i].tags[2];
+    }
+
+    return sum;
+}
+
+static bool bench_access(void)
+{
+    struct PH_NAME_STATIC_FIELDS_STRUCT(pkd1) *packed;
+    struct PH_NAME_STATIC_FIELDS_STRUCT(aln1) *aligned;
+    double begin, packed_time, aligned_time;
+    size_t i, round;
+    uint16_t tags[3] = {1, 2, 3};
+
+    packed = (struct PH_NAME_STATIC_FIELDS_STRUCT(pkd1) *)malloc(sizeof(*packed) * BENCH_COUNT);
+    aligned = (struct PH_NAME_STATIC_FIELDS_STRUCT(aln1) *)malloc(sizeof(*aligned) * BENCH_COUNT);
+    if (!packed || !aligned) {
+        free(packed);
+        free(aligned);
+        return false;
+    }
+
+    for (i = 0; i < BENCH_COUNT; i++) {
+        memset(&aligned[i], 0, sizeof(aligned[i]));
+        aligned[i].kind = (uint8_t)i;
+        aligned[i].id = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        aligned[i].size = (uint32_t)i;
+        memcpy(aligned[i].tags, tags, sizeof(tags));
+
+        PH_THIS_STATIC_SET_P(pkd1, &packed[i], kind, &aligned[i].kind);
+        PH_THIS_STATIC_SET_P(pkd1, &packed[i], id, &aligned[i].id);
+        PH_THIS_STATIC_SET_P(pkd1, &packed[i], size, &aligned[i].size);
+        PH_THIS_STATIC_SET_P(pkd1, &packed[i], tags, tags);
+    }
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        g_sink += sum_packed(packed, BENCH_COUNT);
+    }
+    packed_time = bench_now() - begin;
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        g_sink += sum_aligned(aligned, BENCH_COUNT);
+    }
+    aligned_time = bench_now() - begin;
+
+    bench_report("field access (packed)", BENCH_COUNT, packed_time, sizeof(*packed) * BENCH_COUNT * BENCH_ROUNDS);
+    bench_report("field access (aligned)", BENCH_COUNT, aligned_time, sizeof(*aligned) * BENCH_COUNT * BENCH_ROUNDS);
+
+    free(packed);
+    free(aligned);
+
+    return true;
+}
+
+/* what the aligned layout costs at the boundary: the packed copy of the fields on every record */
+static bool bench_record(const uint8_t *data, size_t size)
+{
+    pino_t *pino, *out;
+    uint8_t *buffer;
+    double begin, serialize, unserialize;
+    size_t record_size, round;
+
+    pino = pino_pack("aln1", data, size);
+    record_size = pino ? pino_serialize_size(pino) : 0;
+    buffer = record_size ? (uint8_t *)malloc(record_size) : NULL;
+    if (!buffer) {
+        pino_destroy(pino);
+        return false;
+    }
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_RECORDS; round++) {
+        if (!pino_serialize(pino, buffer)) {
+            break;
+        }
+    }
+    serialize = bench_now() - begin;
+
+    begin = bench_now();
+    for (round = 0; round < BENCH_RECORDS; round++) {
+        out = pino_unserialize(buffer, record_size);
+        if (!out) {
+            break;
+        }
+        pino_destroy(out);
+    }
+    unserialize = bench_now() - begin;
+
+    bench_report("serialize (aligned fields)", size, serialize, record_size * BENCH_RECORDS);
+    bench_report("unserialize (aligned fields)", size, unserialize, record_size * BENCH_RECORDS);
+
+    free(buffer);
+    pino_destroy(pino);
+
+    return true;
+}
+
+int main(void)
+{
+    uint8_t data[256];
+
+    if (!pino_init() || !PH_REG(aln1)) {
+        return 1;
+    }
+
+    bench_fill(data, sizeof(data));
+    if (!bench_access() || !bench_record(data, 16) || !bench_record(data, sizeof(data))) {
+        return 1;
+    }
+
+    PH_UNREG(aln1);
+    pino_free();
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * libpino bench - bench_log.c
+ * 
+ */
+
+#include <stdio.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/log.h>
+#include <pino/pool.h>
+
+#include "../tests/handler_spl1.h"
+#include "bench.h"
+
+#define BENCH_RECORDS       2000
+#define BENCH_RECORD_SIZE   512
+#define BENCH_LOG_PATH      "bench_log.pinl"
+
+typedef struct {
+    pino_log_t *log;
+    pino_t *pino;
+    bool failed;
+} bench_ctx_t;
+
+static void append_fn(void *arg, size_t begin, size_t end)
+{
+    bench_ctx_t *ctx = (bench_ctx_t *)arg;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        if (!pino_log_append(ctx->log, ctx->pino, true)) {
+            ctx->failed = true;
+        }
+    }
+}
+
+static bool bench_log(pino_t *pino, pino_async_backend_t backend, size_t workers, uint32_t delay_us)
+{
+    pino_log_options_t options;
+    pino_pool_t *pool;
+    bench_ctx_t ctx;
+    double begin, elapsed;
+    char name[64];
+
+    remove(BENCH_LOG_PATH);
+
+    options.group_bytes = 0;
+    options.group_delay_us = delay_us;
+    options.backend = backend;
+
+    ctx.log = pino_log_open(BENCH_LOG_PATH, &options);
+    if (!ctx.log) {
+        /* io_uring is optional */
+        return backend == PINO_ASYNC_IO_URING;
+    }
+
+    ctx.pino = pino;
+    ctx.failed = false;
+    pool = pino_pool_create(workers);
+    if (!pool) {
+        pino_log_close(ctx.log);
+        return false;
+    }
+
+    /* every append is durable, concurrent ones share fsyncs */
+    begin = bench_now();
+    pino_pool_parallel_for(pool, BENCH_RECORDS, 1, append_fn, &ctx);
+    elapsed = bench_now() - begin;
+
+    snprintf(name, sizeof(name), "%s append (delay %uus)", backend == PINO_ASYNC_IO_URING ? "io_uring" : "threads", (unsigned int)delay_us);
+    printf("%-32s %8zu %10.3f ms %10.0f records/s\n", name, workers, elapsed * 1e3, BENCH_RECORDS / elapsed);
+
+    pino_pool_destroy(pool);
+    pino_log_close(ctx.log);
+    remove(BENCH_LOG_PATH);
+
+    return !ctx.failed;
+}
+
+int main(void)
+{
+    static const uint32_t delays[] = {0, 100, 1000};
+    uint8_t data[BENCH_RECORD_SIZE];
+    pino_t *pino;
+    size_t workers, i;
+    int backend;
+    bool result;
+
+    if (!pino_init() || !PH_REG(spl1)) {
+        return 1;
+    }
+
+    bench_fill(data, sizeof(data));
+    pino = pino_pack("spl1", data, sizeof(data));
+    if (!pino) {
+        return 1;
+    }
+
+    printf("records: %d, record size: %d\n", BENCH_RECORDS, BENCH_RECORD_SIZE);
+
+    result = true;
+    for (backend = PINO_ASYNC_IO_URING; result && backend <= PINO_ASYNC_THREADS; backend++) {
+        for (workers = 1; result && workers <= 16; workers *= 4) {
+            for (i = 0; result && i < sizeof(delays) / sizeof(delays[0]); i++) {
+                result = bench_log(pino, (pino_async_backend_t)backend, workers, delays[i]);
+            }
+        }
+    }
+
+    pino_destroy(pino);
+    PH_UNREG(spl1);
+    pino_free();
+
+    return result ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/*
+ * libpino bench - bench_pool.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/pool.h>
+
+#include "../tests/handler_spl1.h"
+#include "bench.h"
+
+#define BENCH_RECORDS       10000
+#define BENCH_RECORD_SIZE   4096
+#define BENCH_ROUNDS        5
+
+/* every record uses spl1, so all workers allocate through the same handler memory manager */
+static bool bench_workers(const pino_t **pinos, size_t workers, size_t total, void *dest, pino_t **out, double *unserialize_out)
+{
+    pino_pool_t *pool;
+    double begin, serialize, unserialize;
+    size_t round, i;
+
+    pool = pino_pool_create(workers);
+    if (!pool) {
+        return false;
+    }
+
+    serialize = 0.0;
+    unserialize = 0.0;
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        begin = bench_now();
+        if (pino_serialize_batch_parallel(pool, pinos, BENCH_RECORDS, dest, total, NULL) != total) {
+            pino_pool_destroy(pool);
+            return false;
+        }
+        serialize += bench_now() - begin;
+
+        begin = bench_now();
+        if (pino_unserialize_batch_parallel(pool, dest, total, out, BENCH_RECORDS) != BENCH_RECORDS) {
+            pino_pool_destroy(pool);
+            return false;
+        }
+        unserialize += bench_now() - begin;
+
+        for (i = 0; i < BENCH_RECORDS; i++) {
+            pino_destroy(out[i]);
+        }
+    }
+
+    bench_report("serialize_batch_parallel", pino_pool_workers(pool), serialize / BENCH_ROUNDS, total);
+    bench_report("unserialize_batch_parallel", pino_pool_workers(pool), unserialize / BENCH_ROUNDS, total);
+    *unserialize_out = unserialize / BENCH_ROUNDS;
+
+    pino_pool_destroy(pool);
+
+    return true;
+}
+
+int main(void)
+{
+    pino_t **pinos, **out;
+    pino_pool_t *probe;
+    uint8_t *data, *dest;
+    size_t total, cpus, workers, i;
+    double unserialize, single;
+    bool result;
+
+    if (!pino_init() || !PH_REG(spl1)) {
+        return 1;
+    }
+
+    data = (uint8_t *)malloc(BENCH_RECORD_SIZE);
+    pinos = (pino_t **)calloc(BENCH_RECORDS, sizeof(pino_t *));
+    out = (pino_t **)calloc(BENCH_RECORDS, sizeof(pino_t *));
+    if (!data || !pinos || !out) {
+        return 1;
+    }
+
+    bench_fill(data, BENCH_RECORD_SIZE);
+    for (i = 0; i < BENCH_RECORDS; i++) {
+        pinos[i] = pino_pack("spl1", data, BENCH_RECORD_SIZE);
+        if (!pinos[i]) {
+            return 1;
+        }
+    }
+
+    total = pino_serialize_batch((const pino_t **)pinos, BENCH_RECORDS, NULL, 0, NULL);
+    dest = (uint8_t *)malloc(total);
+    if (!dest) {
+        return 1;
+    }
+
+    probe = pino_pool_create(0);
+    cpus = pino_pool_workers(probe);
+    pino_pool_destroy(probe);
+
+    printf("records: %d, record size: %d, cpus: %zu\n", BENCH_RECORDS, BENCH_RECORD_SIZE, cpus);
+
+    /* 1, 2, 4, ... and finally every CPU */
+    result = true;
+    single = 0.0;
+    for (workers = 1; result; workers *= 2) {
+        workers = workers < cpus ? workers : cpus;
+        result = bench_workers((const pino_t **)pinos, workers, total, dest, out, &unserialize);
+        if (workers == 1) {
+            single = unserialize;
+        }
+        printf("%-32s %8zu %10.2fx\n", "unserialize speedup", workers, unserialize > 0 ? single / unserialize : 0.0);
+        if (workers == cpus) {
+            break;
+        }
+    }
+
+    for (i = 0; i < BENCH_RECORDS; i++) {
+        pino_destroy(pinos[i]);
+    }
+
+    free(dest);
+    free(out);
+    free(pinos);
+    free(data);
+
+    PH_UNREG(spl1);
+    pino_free();
+
+    return result ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+# libpino bench
+
+
+file(MAKE_DIRECTORY ${CMAKE_BINARY_DIR}/bench)
+
+file(GLOB BENCH_SOURCES "bench/bench_*.c")
+
+foreach(BENCH_SOURCE ${BENCH_SOURCES})
+  get_filename_component(BENCH_NAME ${BENCH_SOURCE} NAME_WE)
+  set(BENCH_NAME "pino_${BENCH_NAME}")
+
+  add_executable(${BENCH_NAME} ${BENCH_SOURCE})
+
+  target_link_libraries(${BENCH_NAME} PRIVATE pino)
+
+  target_include_directories(${BENCH_NAME} PRIVATE ${CMAKE_SOURCE_DIR}/include)
+
+  set_target_properties(${BENCH_NAME} PROPERTIES
+    RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR}/bench
+  )
+endforeach()
@@ -23,25 +23,119 @@ typedef char pino_magic_safe_t[sizeof(pino_magic_t) + 1];  /* + '\0' */
 
 typedef uint64_t pino_static_fields_size_t;
 
+typedef void (*pino_adopt_free_t)(void *ptr);
+
+/* pino_serialize_ex() flags, carried in the top byte of the wire static_fields_size */
+#define PINO_SERIALIZE_CRC32C   (1 << 0)    /* CRC32C trailer after the payload, checked on every unserialize */
+#define PINO_SERIALIZE_COMPRESS (1 << 1)    /* LZ compressed payload, only set on the wire when it paid off */
+#define PINO_SERIALIZE_NATIVE   (1 << 2)    /* payload in the writer's byte order, only set on the wire by big endian writers */
+#define PINO_SERIALIZE_COMPACT  (1 << 3)    /* LEB128 sized header naming the handler by its alias if any, a layout rather than a wire flag */
+/* static fields and payload start at multiples of 8, 16 or 64 from the record start, classic headers only */
+#define PINO_SERIALIZE_ALIGN8   (1 << 4)
+#define PINO_SERIALIZE_ALIGN16  (2 << 4)
+#define PINO_SERIALIZE_ALIGN64  (3 << 4)
+
+typedef int32_t pino_refcount_t;
+typedef struct _pino_share_t pino_share_t;
+typedef struct _pino_cache_t pino_cache_t;
+
 typedef struct {
     pino_magic_safe_t magic;
     pino_static_fields_size_t static_fields_size;
     pino_handler_t *handler;
     void *static_fields;
     void *this;
+    const void *lazy_src;   /* borrowed payload, decoded on first access */
+    size_t lazy_size;
+    pino_refcount_t lazy_state; /* the decode runs once even when several threads access the pino */
+    void *adopted;          /* owned buffer referenced by the handler */
+    pino_adopt_free_t adopted_free;
+    pino_refcount_t refcount;
+    pino_share_t *share;    /* copy-on-write payload shared with clones */
+    pino_cache_t *cache;    /* last serialized record, dropped by pino_touch() or replaced once the pino changed */
+    bool cache_enabled;
 } pino_t;
 
+typedef struct {
+    pino_magic_safe_t magic;
+    pino_static_fields_size_t static_fields_size;
+    const void *static_fields;  /* LE, points into the peeked buffer */
+    const void *payload;        /* the compressed block when flags has PINO_SERIALIZE_COMPRESS */
+    size_t payload_size;        /* without the checksum trailer */
+    uint32_t flags;             /* PINO_SERIALIZE_* the record was written with */
+    size_t header_size;         /* bytes in front of static_fields, differs for PINO_SERIALIZE_COMPACT records */
+} pino_header_t;
+
+typedef enum {
+    PINO_VALIDATE_OK = 0,
+    PINO_VALIDATE_INVALID_ARGUMENT,
+    PINO_VALIDATE_TRUNCATED,
+    PINO_VALIDATE_HANDLER_MISSING,
+    PINO_VALIDATE_STATIC_FIELDS_SIZE,
+    PINO_VALIDATE_PAYLOAD,
+    PINO_VALIDATE_CHECKSUM
+} pino_validate_result_t;
+
 bool pino_init(void);
 void pino_free(void);
 
 size_t pino_serialize_size(const pino_t *pino);
 bool pino_serialize(const pino_t *pino, void *dest);
+/* 0 on unknown flags, an upper bound with PINO_SERIALIZE_COMPRESS */
+size_t pino_serialize_size_ex(const pino_t *pino, uint32_t flags);
+/* PINO_SERIALIZE_COMPRESS records vary in size, write them with pino_serialize_record() */
+bool pino_serialize_ex(const pino_t *pino, void *dest, uint32_t flags);
+/* dest == NULL returns the required size, otherwise the size of the written record or 0 on failure */
+size_t pino_serialize_record(const pino_t *pino, void *dest, size_t capacity, uint32_t flags);
 pino_t *pino_unserialize(const void *src, size_t size);
+/* allocation free; PINO_SERIALIZE_COMPRESS records are only checked up to their packed block,
+   their handler validate callback runs when they are unserialized */
+pino_validate_result_t pino_validate(const void *src, size_t size);
+/* src must have passed pino_validate(); the handler validate callback is skipped unless the record is compressed */
+pino_t *pino_unserialize_validated(const void *src, size_t size);
+/* src must outlive the payload decode, which happens once on first serialize/unpack from any thread; a failed decode keeps failing */
+pino_t *pino_unserialize_lazy(const void *src, size_t size);
+bool pino_is_loaded(const pino_t *pino);
+/* on success the pino owns src/buf and releases it with free_fn; on failure the caller keeps it */
+pino_t *pino_unserialize_adopt(void *src, size_t size, pino_adopt_free_t free_fn);
 pino_t *pino_pack(pino_magic_safe_t magic, const void *src, size_t size);
+pino_t *pino_pack_adopt(pino_magic_safe_t magic, void *buf, size_t size, pino_adopt_free_t free_fn);
 size_t pino_unpack_size(const pino_t *pino);
 bool pino_unpack(const pino_t *pino, void *dest);
+/* borrowed, valid until the pino is modified or destroyed; false means fall back to pino_unpack() */
+bool pino_unpack_view(const pino_t *pino, const void **ptr, size_t *len);
 void pino_destroy(pino_t *pino);
 
+pino_t *pino_retain(pino_t *pino);
+void pino_release(pino_t *pino);    /* same as pino_destroy() */
+pino_t *pino_clone(pino_t *pino);
+bool pino_touch(pino_t *pino);      /* call before mutating pino->this */
+
+/* opt-in: keep the last serialized record so unchanged pinos serialize with a single memcpy */
+bool pino_serialize_cache(pino_t *pino, bool enabled);
+/* borrowed, valid until the pino is touched or destroyed; NULL without the cache or when it holds other flags,
+   payload changes made without pino_touch() are only noticed through the handler's generation.
+   replaced records are only kept while a view was taken of them, plain pino_serialize() does not pile them up */
+const void *pino_serialize_view(const pino_t *pino, uint32_t flags, size_t *size);
+
+/* changed static fields and payload bytes (or a handler delta) of current against base; dest == NULL returns the required size */
+size_t pino_serialize_delta(const pino_t *base, const pino_t *current, void *dest, size_t capacity);
+/* a new pino, base is only read; NULL when the delta was made against another base */
+pino_t *pino_apply_delta(pino_t *base, const void *delta, size_t size);
+
+/* dest == NULL returns the required size; records must use handlers with payload_size to be read back */
+size_t pino_serialize_batch(const pino_t **pinos, size_t n, void *dest, size_t capacity, size_t *offsets_out);
+size_t pino_unserialize_batch(const void *src, size_t size, pino_t **out, size_t n);
+/* consumed gets the bytes of the returned records, result why it stopped: PINO_VALIDATE_OK when src ended or out was full,
+   otherwise the fault of the record at src + *consumed; both may be NULL */
+size_t pino_unserialize_batch_ex(const void *src, size_t size, pino_t **out, size_t n, size_t *consumed, pino_validate_result_t *result);
+
+bool pino_peek(const void *src, size_t size, pino_header_t *header);
+bool pino_peek_static(const pino_header_t *header, size_t offset, void *dest, size_t size);
+/* borrowed payload of an uncompressed PINO_SERIALIZE_ALIGN* record in the host byte order, aligned to alignment (a power of two)
+   when src is aligned to it; checked first for PINO_SERIALIZE_CRC32C, NULL means fall back to pino_unserialize() */
+const void *pino_peek_payload(const void *src, size_t size, size_t alignment, pino_header_t *header);
+
 uint32_t pino_version_id(void);
 pino_buildtime_t pino_buildtime(void);
 
@@ -0,0 +1,108 @@
+/*
+ * libpino header - pino/container.h
+ * 
+ */
+
+#ifndef PINO_CONTAINER_H
+#define PINO_CONTAINER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pino.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * file layout, every integer is LE:
+ *
+ *   header   magic "PINC"[4] | version (uint32) | reserved (uint64)
+ *   records  size (uint64) | pino_serialize() output, repeated
+ *   index    pino magic[4] | record offset (uint64), one per record
+ *   footer   index offset (uint64) | record count (uint64) | magic "PINX"[4] | reserved (uint32)
+ */
+#define PINO_CONTAINER_MAGIC            "PINC"
+#define PINO_CONTAINER_INDEX_MAGIC      "PINX"
+#define PINO_CONTAINER_VERSION          1
+#define PINO_CONTAINER_HEADER_SIZE      16
+#define PINO_CONTAINER_RECORD_SIZE      8
+#define PINO_CONTAINER_INDEX_ENTRY_SIZE 12
+#define PINO_CONTAINER_FOOTER_SIZE      24
+
+typedef struct _pino_container_writer_t pino_container_writer_t;
+typedef struct _pino_container_reader_t pino_container_reader_t;
+typedef struct _pino_mmap_writer_t pino_mmap_writer_t;
+typedef struct _pino_async_writer_t pino_async_writer_t;
+typedef struct _pino_async_reader_t pino_async_reader_t;
+
+typedef enum {
+    PINO_ASYNC_AUTO = 0,
+    PINO_ASYNC_IO_URING,
+    PINO_ASYNC_THREADS,     /* positional I/O on worker threads, works everywhere */
+} pino_async_backend_t;
+
+/* pino is NULL when the read or the decode failed, otherwise owned by the callback */
+typedef void (*pino_async_read_fn_t)(void *arg, size_t index, pino_t *pino);
+
+pino_container_writer_t *pino_container_writer_open(const char *path);
+bool pino_container_writer_append(pino_container_writer_t *writer, const pino_t *pino);
+size_t pino_container_writer_count(const pino_container_writer_t *writer);
+/* writes the index and the footer, false means the file is not usable */
+bool pino_container_writer_close(pino_container_writer_t *writer);
+
+/* same file layout as pino_container_writer_*(), records are serialized straight into a growing mapping */
+pino_mmap_writer_t *pino_mmap_writer_open(const char *path, size_t initial_size);
+bool pino_mmap_writer_append(pino_mmap_writer_t *writer, const pino_t *pino);
+size_t pino_mmap_writer_count(const pino_mmap_writer_t *writer);
+/* syncs and truncates the file to its final size */
+bool pino_mmap_writer_close(pino_mmap_writer_t *writer);
+
+/*
+ * same file layout again, records are batched into depth buffers (0 for the default) that
+ * are written in the background while the next one fills, registered with io_uring when possible
+ */
+pino_async_writer_t *pino_async_writer_open(const char *path, pino_async_backend_t backend, size_t depth);
+pino_async_backend_t pino_async_writer_backend(const pino_async_writer_t *writer);
+bool pino_async_writer_append(pino_async_writer_t *writer, const pino_t *pino);
+/* reaps finished writes without blocking, false once any write failed */
+bool pino_async_writer_poll(pino_async_writer_t *writer);
+size_t pino_async_writer_count(const pino_async_writer_t *writer);
+/* waits for every write, then writes the index and the footer */
+bool pino_async_writer_close(pino_async_writer_t *writer);
+
+/* up to depth (0 for the default) record reads in flight, decoded as they complete */
+pino_async_reader_t *pino_async_reader_open(const char *path, pino_async_backend_t backend, size_t depth);
+pino_async_backend_t pino_async_reader_backend(const pino_async_reader_t *reader);
+size_t pino_async_reader_count(const pino_async_reader_t *reader);
+/* false when the index is out of range or depth reads are in flight, poll to make room */
+bool pino_async_reader_submit(pino_async_reader_t *reader, size_t index);
+/* calls fn for every completed read and returns their number, blocks for one if wait */
+size_t pino_async_reader_poll(pino_async_reader_t *reader, bool wait, pino_async_read_fn_t fn, void *arg);
+size_t pino_async_reader_inflight(const pino_async_reader_t *reader);
+/* pending reads are waited for and their results dropped */
+void pino_async_reader_close(pino_async_reader_t *reader);
+
+pino_container_reader_t *pino_container_reader_open(const char *path);
+/* NULL where memory mapping is not available */
+pino_container_reader_t *pino_container_reader_open_mmap(const char *path);
+size_t pino_container_reader_count(const pino_container_reader_t *reader);
+bool pino_container_reader_magic(const pino_container_reader_t *reader, size_t index, pino_magic_safe_t magic);
+size_t pino_container_reader_size(const pino_container_reader_t *reader, size_t index);
+/* raw pino_serialize() bytes of record index, dest must hold pino_container_reader_size() bytes */
+bool pino_container_reader_read(pino_container_reader_t *reader, size_t index, void *dest);
+pino_t *pino_container_reader_get(pino_container_reader_t *reader, size_t index);
+/* mapped readers only, borrowed until pino_container_reader_close() */
+const void *pino_container_reader_view(const pino_container_reader_t *reader, size_t index, size_t *size);
+/* sequential walk over the views with read-ahead, NULL at the end */
+const void *pino_container_reader_next(pino_container_reader_t *reader, size_t *size);
+void pino_container_reader_rewind(pino_container_reader_t *reader);
+void pino_container_reader_close(pino_container_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PINO_CONTAINER_H */
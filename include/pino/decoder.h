@@ -0,0 +1,38 @@
+/*
+ * libpino header - pino/decoder.h
+ * 
+ */
+
+#ifndef PINO_DECODER_H
+#define PINO_DECODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pino.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _pino_decoder_t pino_decoder_t;
+
+typedef enum {
+    PINO_DECODER_ERROR = -1,
+    PINO_DECODER_NEED_MORE = 0,
+    PINO_DECODER_DONE = 1
+} pino_decoder_status_t;
+
+pino_decoder_t *pino_decoder_create(void);
+pino_decoder_status_t pino_decoder_feed(pino_decoder_t *decoder, const void *src, size_t size, size_t *consumed);
+pino_decoder_status_t pino_decoder_finish(pino_decoder_t *decoder);
+const pino_handler_t *pino_decoder_handler(const pino_decoder_t *decoder);
+pino_t *pino_decoder_take(pino_decoder_t *decoder);
+void pino_decoder_reset(pino_decoder_t *decoder);
+void pino_decoder_destroy(pino_decoder_t *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PINO_DECODER_H */
@@ -6,12 +6,15 @@
 #ifndef PINO_ENDIANNESS_H
 #define PINO_ENDIANNESS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct _pino_pool_t;
+
 void *pino_endianness_memcpy_le2native(void *dest, const void *src, size_t size);
 void *pino_endianness_memcpy_be2native(void *dest, const void *src, size_t size);
 void *pino_endianness_memcpy_native2le(void *dest, const void *src, size_t size);
@@ -27,6 +30,19 @@ int pino_endianness_memcmp_be2native(const void *s1, const void *s2, size_t size
 int pino_endianness_memcmp_native2le(const void *s1, const void *s2, size_t size);
 int pino_endianness_memcmp_native2be(const void *s1, const void *s2, size_t size);
 
+void *pino_endianness_memcpy_array_le2native(void *dest, const void *src, size_t count, size_t elem_size);
+void *pino_endianness_memcpy_array_be2native(void *dest, const void *src, size_t count, size_t elem_size);
+void *pino_endianness_memcpy_array_native2le(void *dest, const void *src, size_t count, size_t elem_size);
+void *pino_endianness_memcpy_array_native2be(void *dest, const void *src, size_t count, size_t elem_size);
+
+bool pino_endianness_le2native_noop(size_t size);
+bool pino_endianness_be2native_noop(size_t size);
+
+/* copies of threshold bytes or more are split across the pool, NULL disables, 0 threshold means the default */
+void pino_endianness_parallel(struct _pino_pool_t *pool, size_t threshold);
+/* copies of threshold bytes or more bypass the cache with non-temporal stores, false if unsupported */
+bool pino_endianness_streaming(bool enabled, size_t threshold);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,162 @@
+/*
+ * libpino header - pino/fields.h
+ * 
+ */
+
+#ifndef PINO_FIELDS_H
+#define PINO_FIELDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * handlers generated from a field list, members are laid out in a naturally aligned PH_DEF_STRUCT_ALIGNED():
+ *
+ *   #define MSG1_FIELDS(SCALAR, ARRAY, VECTOR) \
+ *       SCALAR(uint64_t, id) \
+ *       ARRAY(uint16_t, ports, 4) \
+ *       VECTOR(uint8_t, body)
+ *
+ *   PH_FIELDS_HANDLER(msg1, MSG1_FIELDS);
+ *
+ * the payload is every member in list order, packed LE; VECTOR(type, param) is a uint32_t element count followed
+ * by the elements, held as param (PH_FIELDS_RESIZE() only) and param_count. pack / unpack take the payload in
+ * native order. the static fields are the uint32_t payload size.
+ */
+
+typedef struct {
+    size_t offset;          /* of the member in the object struct */
+    size_t size;            /* of one element: 1, 2, 4 or 8 */
+    size_t count;           /* elements, 0 for VECTOR() */
+    size_t count_offset;    /* of the VECTOR() element count */
+} pino_field_t;
+
+typedef const pino_field_t *(*pino_fields_describe_t)(size_t *count);
+
+typedef struct _pino_fields_t {
+    pino_fields_describe_t describe;
+    pino_field_t *ops;      /* the fields with adjacent same-width members merged, built on registration */
+    size_t op_count;
+} pino_fields_t;
+
+bool pino_fields_serialize(const pino_fields_t *fields, const void *object, void *dest);
+bool pino_fields_unserialize(const pino_fields_t *fields, void *object, const void *src, size_t size);
+bool pino_fields_pack(const pino_fields_t *fields, void *object, const void *src, size_t size);
+bool pino_fields_unpack(const pino_fields_t *fields, const void *object, void *dest);
+void pino_fields_destroy(const pino_fields_t *fields, void *object);
+/* touches the pino, new elements are zero */
+bool pino_fields_resize(pino_t *pino, size_t offset, size_t count);
+
+#define PH_NAME_FIELDS(name)                            _ph_handler_##name##_fields
+#define PH_NAME_FIELDS_OPS(name)                        _ph_handler_##name##_fields_ops
+#define PH_NAME_FIELDS_DESCRIBE(name)                   _ph_handler_##name##_fields_describe
+
+#define PH_FIELDS_ARG_THIS                              __fields_this
+#define PH_FIELDS_THIS_T                                __fields_this_t
+
+#define PH_FIELDS_MEMBER_SCALAR(type, param)            type param;
+#define PH_FIELDS_MEMBER_ARRAY(type, param, count)      type param[count];
+#define PH_FIELDS_MEMBER_VECTOR(type, param)            type *param; uint32_t param##_count;
+
+#define PH_FIELDS_DESC_SCALAR(type, param)              { offsetof(PH_FIELDS_THIS_T, param), sizeof(type), 1, 0 },
+#define PH_FIELDS_DESC_ARRAY(type, param, count)        { offsetof(PH_FIELDS_THIS_T, param), sizeof(type), count, 0 },
+#define PH_FIELDS_DESC_VECTOR(type, param)              { \
+    offsetof(PH_FIELDS_THIS_T, param), sizeof(type), 0, offsetof(PH_FIELDS_THIS_T, param##_count) \
+},
+
+#define PH_FIELDS_COUNT_SCALAR(type, param)             + 1
+#define PH_FIELDS_COUNT_ARRAY(type, param, count)       + 1
+#define PH_FIELDS_COUNT_VECTOR(type, param)             + 1
+
+#define PH_FIELDS_SIZE_SCALAR(type, param)              + sizeof(type)
+#define PH_FIELDS_SIZE_ARRAY(type, param, count)        + sizeof(type) * (count)
+#define PH_FIELDS_SIZE_VECTOR(type, param)              + sizeof(uint32_t)
+#define PH_FIELDS_SIZE_NONE(type, param)
+#define PH_FIELDS_SIZE_NONE_ARRAY(type, param, count)
+#define PH_FIELDS_SIZE_ELEMENTS(type, param)            + sizeof(type) * (size_t)PH_FIELDS_ARG_THIS->param##_count
+
+#define PH_FIELDS_COUNT(list)                           (0 list(PH_FIELDS_COUNT_SCALAR, PH_FIELDS_COUNT_ARRAY, PH_FIELDS_COUNT_VECTOR))
+/* every byte but the VECTOR() elements, a compile time constant */
+#define PH_FIELDS_FIXED_SIZE(list)                      ((size_t)(0 list(PH_FIELDS_SIZE_SCALAR, PH_FIELDS_SIZE_ARRAY, PH_FIELDS_SIZE_VECTOR)))
+
+#define PH_FIELDS_RESIZE(name, pino, param, count)      pino_fields_resize( \
+    (pino_t *)pino, offsetof(struct PH_NAME_STRUCT(name), param), count \
+)
+
+#define PH_EXT_FIELDS(name)                             .fields = &PH_NAME_FIELDS(name)
+
+#define PH_FIELDS_HANDLER(name, list) \
+    PH_BEGIN(name); \
+    PH_DEF_STATIC_FIELDS_STRUCT(name) { \
+        uint32_t size; \
+    } PH_DEF_STATIC_FIELDS_STRUCT_END \
+    PH_DEF_STRUCT_ALIGNED(name) { \
+        list(PH_FIELDS_MEMBER_SCALAR, PH_FIELDS_MEMBER_ARRAY, PH_FIELDS_MEMBER_VECTOR) \
+    } PH_DEF_STRUCT_ALIGNED_END \
+    static const pino_field_t *PH_NAME_FIELDS_DESCRIBE(name)(size_t *count) { \
+        typedef struct PH_NAME_STRUCT(name) PH_FIELDS_THIS_T; \
+        static const pino_field_t fields[] = { \
+            list(PH_FIELDS_DESC_SCALAR, PH_FIELDS_DESC_ARRAY, PH_FIELDS_DESC_VECTOR) \
+        }; \
+        *count = sizeof(fields) / sizeof(fields[0]); \
+        return fields; \
+    } \
+    static pino_field_t PH_NAME_FIELDS_OPS(name)[PH_FIELDS_COUNT(list)]; \
+    static pino_fields_t PH_NAME_FIELDS(name) = { PH_NAME_FIELDS_DESCRIBE(name), PH_NAME_FIELDS_OPS(name), 0 }; \
+    PH_DEFUN_SERIALIZE_SIZE(name) { \
+        const struct PH_NAME_STRUCT(name) *PH_FIELDS_ARG_THIS = PH_THIS(name); \
+        (void)PH_FIELDS_ARG_THIS; \
+        return PH_FIELDS_FIXED_SIZE(list) list(PH_FIELDS_SIZE_NONE, PH_FIELDS_SIZE_NONE_ARRAY, PH_FIELDS_SIZE_ELEMENTS); \
+    } \
+    PH_DEFUN_SERIALIZE(name) { \
+        return pino_fields_serialize(&PH_NAME_FIELDS(name), PH_ARG_THIS, PH_ARG_DST); \
+    } \
+    PH_DEFUN_UNSERIALIZE(name) { \
+        return pino_fields_unserialize(&PH_NAME_FIELDS(name), PH_ARG_THIS, PH_ARG_SRC, PH_ARG_SRC_SIZE); \
+    } \
+    PH_DEFUN_PACK(name) { \
+        return pino_fields_pack(&PH_NAME_FIELDS(name), PH_ARG_THIS, PH_ARG_SRC, PH_ARG_SIZE); \
+    } \
+    PH_DEFUN_UNPACK_SIZE(name) { \
+        return PH_NAME_FUNC_SERIALIZE_SIZE(name)(PH_ARG_THIS, PH_ARG_STATIC_FIELDS); \
+    } \
+    PH_DEFUN_UNPACK(name) { \
+        return pino_fields_unpack(&PH_NAME_FIELDS(name), PH_ARG_THIS, PH_ARG_DST); \
+    } \
+    PH_DEFUN_CREATE(name) { \
+        uint32_t size = (uint32_t)PH_ARG_SIZE; \
+        if (PH_ARG_SIZE > UINT32_MAX) { \
+            return NULL; \
+        } \
+        PH_CREATE_THIS(name); \
+        PH_THIS_STATIC_SET(name, size, &size); \
+        return PH_THIS(name); \
+    } \
+    PH_DEFUN_DESTROY(name) { \
+        pino_fields_destroy(&PH_NAME_FIELDS(name), PH_ARG_THIS); \
+        PH_DESTROY_THIS(name); \
+    } \
+    PH_DEFUN_PAYLOAD_SIZE(name) { \
+        uint32_t size; \
+        PH_THIS_STATIC_GET(name, size, &size); \
+        return (size_t)size; \
+    } \
+    PH_END_EX(name, \
+        PH_EXT_PAYLOAD_SIZE(name), \
+        PH_EXT_FIELDS(name), \
+        PH_EXT_CHECKSUM_FUSED(name) \
+    )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PINO_FIELDS_H */
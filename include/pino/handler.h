@@ -6,6 +6,7 @@
 #ifndef PINO_HANDLER_H
 #define PINO_HANDLER_H
 
+#include <stddef.h>
 #include <string.h>
 
 #include <pino.h>
@@ -17,16 +18,27 @@ extern "C" {
 
 bool pino_handler_register(pino_magic_safe_t magic, pino_handler_t *handler);
 bool pino_handler_unregister(pino_magic_safe_t magic);
+/* PINO_SERIALIZE_COMPACT records name the handler by alias (1 - 255 take one byte, up to 65535 two), 0 removes it; readers need the same alias */
+bool pino_handler_alias(pino_magic_safe_t magic, uint16_t alias);
 
 void *pino_memory_manager_malloc(void *entry, size_t size);
 void *pino_memory_manager_calloc(void *entry, size_t count, size_t size);
 void pino_memory_manager_free(void *entry, void *ptr);
 
+/* pino_endianness_memcpy_native2le(), or a plain copy for PINO_SERIALIZE_NATIVE records */
+void *pino_handler_serialize_memcpy(void *dest, const void *src, size_t size);
+/* pino_endianness_memcpy_le2native() that also checks the record checksum while copying, swaps only when the writer's byte order differs */
+void *pino_handler_unserialize_memcpy(void *dest, const void *src, size_t size);
+/* the same for count elements of elem_size bytes each */
+void *pino_handler_serialize_memcpy_array(void *dest, const void *src, size_t count, size_t elem_size);
+void *pino_handler_unserialize_memcpy_array(void *dest, const void *src, size_t count, size_t elem_size);
+
 #define PH_NAME_HANDLER(name)                           g_ph_handler_##name##_obj
 #define PH_NAME_REG(name)                               _ph_handler_##name##_register
 #define PH_NAME_UNREG(name)                             _ph_handler_##name##_unregister
 #define PH_NAME_STRUCT(name)                            _ph_handler_##name##_struct
 #define PH_NAME_STATIC_FIELDS_STRUCT(name)              _ph_handler_##name##_static_fields_struct
+#define PH_NAME_STATIC_FIELDS_LAYOUT(name)              _ph_handler_##name##_static_fields_layout
 #define PH_NAME_FUNC_SERIALIZE_SIZE(name)               _ph_handler_##name##_serialize_size
 #define PH_NAME_FUNC_SERIALIZE(name)                    _ph_handler_##name##_serialize
 #define PH_NAME_FUNC_UNSERIALIZE(name)                  _ph_handler_##name##_unserialize
@@ -35,6 +47,14 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_NAME_FUNC_UNPACK(name)                       _ph_handler_##name##_unpack
 #define PH_NAME_FUNC_CREATE(name)                       _ph_handler_##name##_create
 #define PH_NAME_FUNC_DESTROY(name)                      _ph_handler_##name##_destroy
+#define PH_NAME_FUNC_PAYLOAD_SIZE(name)                 _ph_handler_##name##_payload_size
+#define PH_NAME_FUNC_UNSERIALIZE_CHUNK(name)            _ph_handler_##name##_unserialize_chunk
+#define PH_NAME_FUNC_VALIDATE(name)                     _ph_handler_##name##_validate
+#define PH_NAME_FUNC_ADOPT(name)                        _ph_handler_##name##_adopt
+#define PH_NAME_FUNC_UNPACK_VIEW(name)                  _ph_handler_##name##_unpack_view
+#define PH_NAME_FUNC_DELTA(name)                        _ph_handler_##name##_delta
+#define PH_NAME_FUNC_APPLY_DELTA(name)                  _ph_handler_##name##_apply_delta
+#define PH_NAME_FUNC_GENERATION(name)                   _ph_handler_##name##_generation
 
 #define PH_ARG_THIS                                     __this
 #define PH_ARG_DATA                                     __data
@@ -43,6 +63,11 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_ARG_SRC_SIZE                                 __src_size
 #define PH_ARG_DST                                      __dest
 #define PH_ARG_STATIC_FIELDS                            __static_fields
+#define PH_ARG_OFFSET                                   __offset
+#define PH_ARG_VIEW                                     __view
+#define PH_ARG_VIEW_SIZE                                __view_size
+#define PH_ARG_BASE                                     __base
+#define PH_ARG_BASE_STATIC_FIELDS                       __base_static_fields
 
 #define PH_SIGNATURE_SERIALIZE_SIZE                     (const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS)
 #define PH_SIGNATURE_SERIALIZE                          (const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS, void *PH_ARG_DST)
@@ -52,6 +77,14 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_SIGNATURE_UNPACK                             (const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS, void *PH_ARG_DST)
 #define PH_SIGNATURE_CREATE                             (size_t PH_ARG_SIZE, void *PH_ARG_STATIC_FIELDS)
 #define PH_SIGNATURE_DESTROY                            (void *PH_ARG_THIS, void *PH_ARG_STATIC_FIELDS)
+#define PH_SIGNATURE_PAYLOAD_SIZE                       (const void *PH_ARG_STATIC_FIELDS)
+#define PH_SIGNATURE_UNSERIALIZE_CHUNK                  (void *PH_ARG_THIS, void *PH_ARG_STATIC_FIELDS, const void *PH_ARG_SRC, size_t PH_ARG_SRC_SIZE, size_t PH_ARG_OFFSET)
+#define PH_SIGNATURE_VALIDATE                           (const void *PH_ARG_STATIC_FIELDS, const void *PH_ARG_SRC, size_t PH_ARG_SRC_SIZE)
+#define PH_SIGNATURE_ADOPT                              (void *PH_ARG_SRC, size_t PH_ARG_SIZE, void *PH_ARG_STATIC_FIELDS)
+#define PH_SIGNATURE_UNPACK_VIEW                        (const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS, const void **PH_ARG_VIEW, size_t *PH_ARG_VIEW_SIZE)
+#define PH_SIGNATURE_DELTA                              (const void *PH_ARG_BASE, const void *PH_ARG_BASE_STATIC_FIELDS, const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS, void *PH_ARG_DST, size_t PH_ARG_SIZE)
+#define PH_SIGNATURE_APPLY_DELTA                        (const void *PH_ARG_BASE_STATIC_FIELDS, void *PH_ARG_THIS, void *PH_ARG_STATIC_FIELDS, const void *PH_ARG_SRC, size_t PH_ARG_SRC_SIZE)
+#define PH_SIGNATURE_GENERATION                         (const void *PH_ARG_THIS, const void *PH_ARG_STATIC_FIELDS)
 
 #if defined(_MSC_VER)
 # define PH_DEF_STRUCT(name)                            __pragma(pack(push, 1)) struct PH_NAME_STRUCT(name)
@@ -71,6 +104,24 @@ void pino_memory_manager_free(void *entry, void *ptr);
 # warning "Unknown compiler, struct packing may not work correctly"
 #endif
 
+/*
+ * naturally aligned, native order structs; members are accessed directly instead of through PH_THIS_STATIC_GET()/SET()
+ * aligned static fields also need PH_DEF_STATIC_FIELDS_LAYOUT() and PH_EXT_STATIC_FIELDS_ALIGNED(), the wire keeps them packed LE
+ */
+#define PH_DEF_STRUCT_ALIGNED(name)                     struct PH_NAME_STRUCT(name)
+#define PH_DEF_STRUCT_ALIGNED_END                       ;
+#define PH_DEF_STATIC_FIELDS_STRUCT_ALIGNED(name)       struct PH_NAME_STATIC_FIELDS_STRUCT(name)
+#define PH_DEF_STATIC_FIELDS_STRUCT_ALIGNED_END         ;
+/* every member in declaration order: PH_DEF_STATIC_FIELDS_LAYOUT(name) { PH_STATIC_FIELD(name, a), PH_STATIC_FIELD_ARRAY(name, b) }; */
+#define PH_DEF_STATIC_FIELDS_LAYOUT(name)               static const pino_static_field_t PH_NAME_STATIC_FIELDS_LAYOUT(name)[] =
+#define PH_STATIC_FIELD(name, param)                    { \
+    offsetof(struct PH_NAME_STATIC_FIELDS_STRUCT(name), param), sizeof(PH_THIS_STATIC_P(name, NULL)->param), 1 \
+}
+#define PH_STATIC_FIELD_ARRAY(name, param)              { \
+    offsetof(struct PH_NAME_STATIC_FIELDS_STRUCT(name), param), sizeof(PH_THIS_STATIC_P(name, NULL)->param[0]), \
+    sizeof(PH_THIS_STATIC_P(name, NULL)->param) / sizeof(PH_THIS_STATIC_P(name, NULL)->param[0]) \
+}
+
 #define PH_DEFUN_SERIALIZE_SIZE(name)                   static size_t PH_NAME_FUNC_SERIALIZE_SIZE(name)PH_SIGNATURE_SERIALIZE_SIZE
 #define PH_DEFUN_SERIALIZE(name)                        static bool PH_NAME_FUNC_SERIALIZE(name)PH_SIGNATURE_SERIALIZE
 #define PH_DEFUN_UNSERIALIZE(name)                      static bool PH_NAME_FUNC_UNSERIALIZE(name)PH_SIGNATURE_UNSERIALIZE
@@ -79,6 +130,14 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_DEFUN_UNPACK(name)                           static bool PH_NAME_FUNC_UNPACK(name)PH_SIGNATURE_UNPACK
 #define PH_DEFUN_CREATE(name)                           static void *PH_NAME_FUNC_CREATE(name)PH_SIGNATURE_CREATE
 #define PH_DEFUN_DESTROY(name)                          static void PH_NAME_FUNC_DESTROY(name)PH_SIGNATURE_DESTROY
+#define PH_DEFUN_PAYLOAD_SIZE(name)                     static size_t PH_NAME_FUNC_PAYLOAD_SIZE(name)PH_SIGNATURE_PAYLOAD_SIZE
+#define PH_DEFUN_UNSERIALIZE_CHUNK(name)                static bool PH_NAME_FUNC_UNSERIALIZE_CHUNK(name)PH_SIGNATURE_UNSERIALIZE_CHUNK
+#define PH_DEFUN_VALIDATE(name)                         static bool PH_NAME_FUNC_VALIDATE(name)PH_SIGNATURE_VALIDATE
+#define PH_DEFUN_ADOPT(name)                            static void *PH_NAME_FUNC_ADOPT(name)PH_SIGNATURE_ADOPT
+#define PH_DEFUN_UNPACK_VIEW(name)                      static bool PH_NAME_FUNC_UNPACK_VIEW(name)PH_SIGNATURE_UNPACK_VIEW
+#define PH_DEFUN_DELTA(name)                            static size_t PH_NAME_FUNC_DELTA(name)PH_SIGNATURE_DELTA
+#define PH_DEFUN_APPLY_DELTA(name)                      static bool PH_NAME_FUNC_APPLY_DELTA(name)PH_SIGNATURE_APPLY_DELTA
+#define PH_DEFUN_GENERATION(name)                       static uint64_t PH_NAME_FUNC_GENERATION(name)PH_SIGNATURE_GENERATION
 
 #define PH_THIS_P(name, ptr)                            ((struct PH_NAME_STRUCT(name) *)ptr)
 #define PH_THIS_STATIC_P(name, ptr)                     ((struct PH_NAME_STATIC_FIELDS_STRUCT(name) *)ptr)
@@ -91,11 +150,27 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_THIS(name)                                   (PH_THIS_P(name, PH_ARG_THIS))
 #define PH_THIS_STATIC(name)                            (PH_THIS_STATIC_P(name, PH_ARG_STATIC_FIELDS))
 #define PH_THIS_STATIC_GET(name, param, dest)           PH_THIS_STATIC_GET_P(name, PH_ARG_STATIC_FIELDS, param, dest)
+#define PH_BASE(name)                                   (PH_THIS_P(name, PH_ARG_BASE))
+#define PH_BASE_STATIC_GET(name, param, dest)           PH_THIS_STATIC_GET_P(name, PH_ARG_BASE_STATIC_FIELDS, param, dest)
 #define PH_THIS_STATIC_SET(name, param, src)            PH_THIS_STATIC_SET_P(name, PH_ARG_STATIC_FIELDS, param, src)
 #define PH_PINO_P(name, pino)                           (PH_THIS_P(name, ((pino_t *)pino)->this))
 #define PH_PINO_STATIC_P(name, pino)                    ((struct PH_NAME_STATIC_FIELDS_STRUCT(name) *)pino->static_fields)
 #define PH_PINO_STATIC_GET_P(name, pino, param, dest)   PH_THIS_STATIC_GET_P(name, PH_PINO_STATIC_P(name, pino), param, dest)
-#define PH_PINO_STATIC_SET_P(name, pino, param, src)    PH_THIS_STATIC_SET_P(name, PH_PINO_STATIC_P(name, pino), param, src)
+#define PH_PINO_STATIC_SET_P(name, pino, param, src)    do { \
+    pino_touch((pino_t *)pino); \
+    PH_THIS_STATIC_SET_P(name, PH_PINO_STATIC_P(name, pino), param, src); \
+} while (0)
+/* packed static fields only, the wire offset of an aligned member is not its offsetof(): use PH_PEEK_STATIC_GET_ALIGNED() */
+#define PH_PEEK_STATIC_GET(name, header, param, dest)   pino_peek_static( \
+    header, offsetof(struct PH_NAME_STATIC_FIELDS_STRUCT(name), param), dest, sizeof(PH_THIS_STATIC_P(name, NULL)->param) \
+)
+/* handlers with PH_EXT_STATIC_FIELDS_ALIGNED, the wire offset is summed up from PH_DEF_STATIC_FIELDS_LAYOUT() */
+#define PH_PEEK_STATIC_GET_ALIGNED(name, header, param, dest)   pino_peek_static( \
+    header, pino_static_fields_wire_offset( \
+        PH_NAME_STATIC_FIELDS_LAYOUT(name), sizeof(PH_NAME_STATIC_FIELDS_LAYOUT(name)) / sizeof(pino_static_field_t), \
+        offsetof(struct PH_NAME_STATIC_FIELDS_STRUCT(name), param), sizeof(PH_THIS_STATIC_P(name, NULL)->param) \
+    ), dest, sizeof(PH_THIS_STATIC_P(name, NULL)->param) \
+)
 
 #define PH_SIZE(name)                                   (sizeof(struct PH_NAME_STRUCT(name)))
 #define PH_SIZE_STATIC(name)                            (sizeof(struct PH_NAME_STATIC_FIELDS_STRUCT(name)))
@@ -109,6 +184,8 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_MEMCPY_N2B(dst, src, size)                   pino_endianness_memcpy_native2be(dst, src, size)
 #define PH_MEMCPY_L2N(dst, src, size)                   pino_endianness_memcpy_le2native(dst, src, size)
 #define PH_MEMCPY_B2N(dst, src, size)                   pino_endianness_memcpy_be2native(dst, src, size)
+#define PH_MEMCPY_SERIALIZE(dst, src, size)             pino_handler_serialize_memcpy(dst, src, size)
+#define PH_MEMCPY_UNSERIALIZE(dst, src, size)           pino_handler_unserialize_memcpy(dst, src, size)
 
 #define PH_REG(name)                                    PH_NAME_REG(name)()
 #define PH_UNREG(name)                                  PH_NAME_UNREG(name)()
@@ -122,20 +199,48 @@ void pino_memory_manager_free(void *entry, void *ptr);
 #define PH_DESTROY_THIS(name)                           PH_FREE(name, PH_ARG_THIS)
 
 #define PH_SERIALIZE_DATA(name, src, size)      do { \
-    PH_MEMCPY_N2L(PH_ARG_DST, PH_THIS(name)->src, size); \
+    PH_MEMCPY_SERIALIZE(PH_ARG_DST, PH_THIS(name)->src, size); \
 } while (0)
 #define PH_UNSERIALIZE_DATA(name, dest, size)   do { \
     if (size > PH_ARG_SRC_SIZE) { \
         return false; \
     } \
-    PH_MEMCPY_L2N(PH_THIS(name)->dest, PH_ARG_SRC, size); \
+    PH_MEMCPY_UNSERIALIZE(PH_THIS(name)->dest, PH_ARG_SRC, size); \
 } while (0)
 #define PH_PACK_DATA(name, param, size)         do { \
     PH_MEMCPY_N2L(PH_THIS(name)->param, PH_ARG_SRC, size); \
 } while (0)
+/* the buffer stays owned by the pino_t; keep it in wire (LE) order and do not free it in destroy */
+#define PH_ADOPT_DATA(name, param)              do { \
+    PH_THIS(name)->param = PH_ARG_SRC; \
+} while (0)
+#define PH_VALIDATE_DATA(size)                  do { \
+    if (size > PH_ARG_SRC_SIZE) { \
+        return false; \
+    } \
+} while (0)
 #define PH_UNPACK_DATA(name, param, size)       do { \
     PH_MEMCPY_L2N(PH_ARG_DST, PH_THIS(name)->param, size); \
 } while (0)
+/* only possible when the stored (LE) representation already is the native one */
+#define PH_UNPACK_VIEW_DATA(name, param, size)  do { \
+    if (!pino_endianness_le2native_noop(size)) { \
+        return false; \
+    } \
+    *PH_ARG_VIEW = PH_THIS(name)->param; \
+    *PH_ARG_VIEW_SIZE = size; \
+} while (0)
+/* chunks of payloads up to 8 bytes are always delivered whole, so this matches PH_UNSERIALIZE_DATA */
+#define PH_UNSERIALIZE_CHUNK_DATA(name, dest, size) do { \
+    if (PH_ARG_OFFSET > size || PH_ARG_SRC_SIZE > size - PH_ARG_OFFSET) { \
+        return false; \
+    } \
+    if (PH_ARG_SRC_SIZE == size) { \
+        PH_MEMCPY_UNSERIALIZE(PH_THIS(name)->dest, PH_ARG_SRC, size); \
+    } else { \
+        PH_MEMCPY(((char *)PH_THIS(name)->dest) + PH_ARG_OFFSET, PH_ARG_SRC, PH_ARG_SRC_SIZE); \
+    } \
+} while (0)
 
 #define PH_BEGIN(name) \
     static pino_handler_t PH_NAME_HANDLER(name); \
@@ -148,7 +253,7 @@ void pino_memory_manager_free(void *entry, void *ptr);
     PH_DEFUN_CREATE(name); \
     PH_DEFUN_DESTROY(name);
 
-#define PH_END(name) \
+#define PH_END_COMMON(name, ...) \
     static pino_handler_t PH_NAME_HANDLER(name) = { \
         .static_fields_size = PH_SIZE_STATIC(name), \
         .serialize_size = PH_NAME_FUNC_SERIALIZE_SIZE(name), \
@@ -159,7 +264,7 @@ void pino_memory_manager_free(void *entry, void *ptr);
         .unpack = PH_NAME_FUNC_UNPACK(name), \
         .create = PH_NAME_FUNC_CREATE(name), \
         .destroy = PH_NAME_FUNC_DESTROY(name), \
-        .entry = NULL \
+        __VA_ARGS__ \
     }; \
     static inline bool PH_NAME_REG(name)(void) { \
         return pino_handler_register(#name, &PH_NAME_HANDLER(name)); \
@@ -168,6 +273,40 @@ void pino_memory_manager_free(void *entry, void *ptr);
         return pino_handler_unregister(#name); \
     }
 
+#define PH_END(name)                                    PH_END_COMMON(name, .entry = NULL)
+/* optional callbacks: PH_END_EX(name, PH_EXT_PAYLOAD_SIZE(name), ...) */
+#define PH_END_EX(name, ...)                            PH_END_COMMON(name, .entry = NULL, __VA_ARGS__)
+
+#define PH_EXT_PAYLOAD_SIZE(name)                       .payload_size = PH_NAME_FUNC_PAYLOAD_SIZE(name)
+#define PH_EXT_UNSERIALIZE_CHUNK(name)                  .unserialize_chunk = PH_NAME_FUNC_UNSERIALIZE_CHUNK(name)
+#define PH_EXT_VALIDATE(name)                           .validate = PH_NAME_FUNC_VALIDATE(name)
+/* requires PH_EXT_VALIDATE() or PH_EXT_PAYLOAD_SIZE(); unserialized records hand adopt their static fields already set,
+   payloads in the other byte order are unserialized instead */
+#define PH_EXT_ADOPT(name)                              .adopt = PH_NAME_FUNC_ADOPT(name)
+#define PH_EXT_UNPACK_VIEW(name)                        .unpack_view = PH_NAME_FUNC_UNPACK_VIEW(name)
+/* unserialize bounds every read and allocation by PH_ARG_SRC_SIZE alone, so PINO_SERIALIZE_CRC32C records are checked
+   while PH_UNSERIALIZE_DATA() copies them instead of in a pass in front of the handler */
+#define PH_EXT_CHECKSUM_FUSED(name)                     .checksum_fused = true
+/* delta writes the payload change from PH_ARG_BASE into PH_ARG_DST (NULL asks for the size, 0 falls back to byte ranges),
+   apply_delta replays it on a private copy of the base whose static fields already are the new, unverified ones */
+#define PH_EXT_DELTA(name)                              .delta = PH_NAME_FUNC_DELTA(name), .apply_delta = PH_NAME_FUNC_APPLY_DELTA(name)
+/* a value that changes with every change to PH_ARG_THIS, so cached records notice payloads modified without pino_touch() */
+#define PH_EXT_GENERATION(name)                         .generation = PH_NAME_FUNC_GENERATION(name)
+/* static_fields_size turns into the packed wire size on registration */
+#define PH_EXT_STATIC_FIELDS_ALIGNED(name)              .static_fields_layout = PH_NAME_STATIC_FIELDS_LAYOUT(name), \
+    .static_fields_layout_count = sizeof(PH_NAME_STATIC_FIELDS_LAYOUT(name)) / sizeof(pino_static_field_t), \
+    .static_fields_memory_size = PH_SIZE_STATIC(name)
+
+typedef struct {
+    size_t offset;  /* in the in-memory struct */
+    size_t size;    /* of one element: 1, 2, 4 or 8 */
+    size_t count;
+} pino_static_field_t;
+
+/* packed wire offset of the aligned static field at offset (its offsetof()) of size bytes,
+   SIZE_MAX unless the layout has such a member that reads back in one LE copy */
+size_t pino_static_fields_wire_offset(const pino_static_field_t *layout, size_t count, size_t offset, size_t size);
+
 typedef size_t (*pino_handler_serialize_size_t)PH_SIGNATURE_SERIALIZE_SIZE;
 typedef bool (*pino_handler_serialize_t)PH_SIGNATURE_SERIALIZE;
 typedef bool (*pino_handler_unserialize_t)PH_SIGNATURE_UNSERIALIZE;
@@ -176,6 +315,17 @@ typedef size_t (*pino_handler_unpack_size_t)PH_SIGNATURE_UNPACK_SIZE;
 typedef bool (*pino_handler_unpack_t)PH_SIGNATURE_UNPACK;
 typedef void *(*pino_handler_create_t)PH_SIGNATURE_CREATE;
 typedef void (*pino_handler_destroy_t)PH_SIGNATURE_DESTROY;
+typedef size_t (*pino_handler_payload_size_t)PH_SIGNATURE_PAYLOAD_SIZE;
+typedef bool (*pino_handler_unserialize_chunk_t)PH_SIGNATURE_UNSERIALIZE_CHUNK;
+typedef bool (*pino_handler_validate_t)PH_SIGNATURE_VALIDATE;
+typedef void *(*pino_handler_adopt_t)PH_SIGNATURE_ADOPT;
+typedef bool (*pino_handler_unpack_view_t)PH_SIGNATURE_UNPACK_VIEW;
+typedef size_t (*pino_handler_delta_t)PH_SIGNATURE_DELTA;
+typedef bool (*pino_handler_apply_delta_t)PH_SIGNATURE_APPLY_DELTA;
+typedef uint64_t (*pino_handler_generation_t)PH_SIGNATURE_GENERATION;
+
+/* pino/fields.h */
+struct _pino_fields_t;
 
 struct _pino_handler_t {
     pino_static_fields_size_t static_fields_size;
@@ -188,6 +338,20 @@ struct _pino_handler_t {
     pino_handler_create_t create;
     pino_handler_destroy_t destroy;
     void *entry;
+    /* optional */
+    pino_handler_payload_size_t payload_size;
+    pino_handler_unserialize_chunk_t unserialize_chunk;
+    pino_handler_validate_t validate;
+    pino_handler_adopt_t adopt;
+    pino_handler_unpack_view_t unpack_view;
+    pino_handler_delta_t delta;
+    pino_handler_apply_delta_t apply_delta;
+    pino_handler_generation_t generation;
+    const pino_static_field_t *static_fields_layout;
+    size_t static_fields_layout_count;
+    size_t static_fields_memory_size;
+    struct _pino_fields_t *fields;
+    bool checksum_fused;
 };
 
 #ifdef __cplusplus
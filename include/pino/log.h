@@ -0,0 +1,58 @@
+/*
+ * libpino header - pino/log.h
+ * 
+ */
+
+#ifndef PINO_LOG_H
+#define PINO_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pino.h>
+#include <pino/container.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * file layout, every integer is LE:
+ *
+ *   header  magic "PINL"[4] | version (uint32) | reserved (uint64)
+ *   frames  size (uint64) | crc32c of size and record (uint32) | reserved (uint32) | pino_serialize() output
+ */
+#define PINO_LOG_MAGIC          "PINL"
+#define PINO_LOG_VERSION        1
+#define PINO_LOG_HEADER_SIZE    16
+#define PINO_LOG_FRAME_SIZE     16
+
+typedef struct _pino_log_t pino_log_t;
+
+typedef struct {
+    size_t group_bytes;             /* commit as soon as this much is pending, 0 means 1 MiB */
+    uint32_t group_delay_us;        /* how long a commit waits for more appends, 0 commits at once */
+    pino_async_backend_t backend;   /* how a commit writes and syncs, io_uring links the fsync to the write */
+} pino_log_options_t;
+
+/* return false to stop the scan */
+typedef bool (*pino_log_scan_fn_t)(void *arg, const void *record, size_t size);
+
+/* an existing log is recovered first, NULL options means the defaults, NULL if the requested backend is missing */
+pino_log_t *pino_log_open(const char *path, const pino_log_options_t *options);
+pino_async_backend_t pino_log_backend(const pino_log_t *log);
+/* durable appends return once the record is on disk, concurrent ones share one fsync */
+bool pino_log_append(pino_log_t *log, const pino_t *pino, bool durable);
+bool pino_log_sync(pino_log_t *log);
+uint64_t pino_log_count(const pino_log_t *log);
+bool pino_log_close(pino_log_t *log);
+
+/* walks every intact record and cuts off everything from the first torn frame */
+bool pino_log_recover(const char *path, pino_log_scan_fn_t fn, void *arg, uint64_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PINO_LOG_H */
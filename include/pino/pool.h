@@ -0,0 +1,35 @@
+/*
+ * libpino header - pino/pool.h
+ * 
+ */
+
+#ifndef PINO_POOL_H
+#define PINO_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <pino.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _pino_pool_t pino_pool_t;
+
+typedef void (*pino_pool_fn_t)(void *arg, size_t begin, size_t end);
+
+/* workers includes the calling thread, 0 means one per CPU */
+pino_pool_t *pino_pool_create(size_t workers);
+size_t pino_pool_workers(const pino_pool_t *pool);
+bool pino_pool_parallel_for(pino_pool_t *pool, size_t n, size_t grain, pino_pool_fn_t fn, void *arg);
+void pino_pool_destroy(pino_pool_t *pool);
+
+size_t pino_serialize_batch_parallel(pino_pool_t *pool, const pino_t **pinos, size_t n, void *dest, size_t capacity, size_t *offsets_out);
+size_t pino_unserialize_batch_parallel(pino_pool_t *pool, const void *src, size_t size, pino_t **out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PINO_POOL_H */
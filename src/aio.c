@@ -0,0 +1,680 @@
+/*
+ * libpino - aio.c
+ * 
+ */
+
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+# define _FILE_OFFSET_BITS 64
+#endif
+
+#include <pino.h>
+#include <pino/container.h>
+
+#include <pino_internal.h>
+#include <pino_file.h>
+#include <pino_aio.h>
+
+#if defined(PINO_IO_URING) && defined(__linux__)
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+# include <unistd.h>
+# if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register) && defined(IOSQE_IO_LINK)
+#  define PAIO_URING_AVAILABLE 1
+/* marks the CQE of the write in front of a linked sync */
+#  define PAIO_URING_LINKED (UINT64_C(1) << 63)
+# endif
+#endif
+
+#ifndef PAIO_URING_AVAILABLE
+# define PAIO_URING_AVAILABLE 0
+#endif
+
+typedef struct {
+    void *user;
+    void *buffer;
+    size_t size;
+    uint64_t offset;
+    int buf_index;
+    bool write;
+    bool sync;
+    bool result;
+#if PAIO_URING_AVAILABLE
+    struct iovec iov;   /* must stay put until the kernel is done with it */
+#endif
+} paio_req_t;
+
+#if PAIO_URING_AVAILABLE
+typedef struct {
+    int fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned queued;    /* written to the SQ ring, not yet entered */
+    bool registered;
+} paio_uring_t;
+#endif
+
+/* fixed size index rings, both are bounded by depth */
+typedef struct {
+    size_t *slots;
+    size_t head;
+    size_t count;
+} paio_queue_t;
+
+struct _paio_t {
+    pino_async_backend_t backend;
+    pfd_t fd;
+    size_t depth;
+    paio_req_t *reqs;
+    size_t *free_slots;
+    size_t free_count;
+#if PAIO_URING_AVAILABLE
+    paio_uring_t uring;
+#endif
+    /* thread backend */
+    paio_queue_t queued;    /* waiting for paio_submit(), caller thread only */
+    paio_queue_t pending;
+    paio_queue_t completed;
+    pmutex_t lock;
+    pcond_t wake;
+    pcond_t done;
+    bool stop;
+#if PINO_THREADS_AVAILABLE
+    pthrd_t threads[AIO_WORKERS];
+    size_t thread_count;
+#endif
+};
+
+static inline void queue_push(paio_queue_t *queue, size_t depth, size_t slot)
+{
+    queue->slots[(queue->head + queue->count) % depth] = slot;
+    queue->count++;
+}
+
+static inline size_t queue_pop(paio_queue_t *queue, size_t depth)
+{
+    size_t slot;
+
+    slot = queue->slots[queue->head];
+    queue->head = (queue->head + 1) % depth;
+    queue->count--;
+
+    return slot;
+}
+
+static inline bool req_transfer(paio_t *aio, paio_req_t *req)
+{
+    return req->write ?
+        pfd_pwrite(aio->fd, req->buffer, req->size, req->offset) :
+        pfd_pread(aio->fd, req->buffer, req->size, req->offset);
+}
+
+static inline bool req_run(paio_t *aio, paio_req_t *req)
+{
+    return req_transfer(aio, req) && (!req->sync || pfd_sync(aio->fd));
+}
+
+#if PAIO_URING_AVAILABLE
+static inline void uring_unmap(paio_uring_t *uring)
+{
+    if (uring->sqes) {
+        munmap(uring->sqes, uring->sqes_size);
+    }
+
+    if (uring->cq_ring && uring->cq_ring != uring->sq_ring) {
+        munmap(uring->cq_ring, uring->cq_ring_size);
+    }
+
+    if (uring->sq_ring) {
+        munmap(uring->sq_ring, uring->sq_ring_size);
+    }
+
+    close(uring->fd);
+}
+
+static inline bool uring_setup(paio_uring_t *uring, size_t depth)
+{
+    struct io_uring_params params;
+    void *map;
+
+    memset(uring, 0, sizeof(paio_uring_t));
+    memset(&params, 0, sizeof(params));
+
+    uring->fd = (int)syscall(__NR_io_uring_setup, (unsigned)depth, &params);
+    if (uring->fd < 0) {
+        PINO_SUPRTF("io_uring_setup failed: %d", errno);
+        return false;
+    }
+
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring->cq_ring_size > uring->sq_ring_size) {
+            uring->sq_ring_size = uring->cq_ring_size;
+        }
+        uring->cq_ring_size = uring->sq_ring_size;
+    }
+#endif
+
+    map = mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED) {
+        /* LCOV_EXCL_START */
+        uring_unmap(uring);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+    uring->sq_ring = map;
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        uring->cq_ring = uring->sq_ring;
+    }
+#endif
+
+    if (!uring->cq_ring) {
+        map = mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_CQ_RING);
+        if (map == MAP_FAILED) {
+            /* LCOV_EXCL_START */
+            uring_unmap(uring);
+            return false;
+            /* LCOV_EXCL_STOP */
+        }
+        uring->cq_ring = map;
+    }
+
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    map = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+    if (map == MAP_FAILED) {
+        /* LCOV_EXCL_START */
+        uring->sqes = NULL;
+        uring_unmap(uring);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+    uring->sqes = (struct io_uring_sqe *)map;
+
+    uring->sq_tail = (unsigned *)((char *)uring->sq_ring + params.sq_off.tail);
+    uring->sq_mask = (unsigned *)((char *)uring->sq_ring + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned *)((char *)uring->sq_ring + params.sq_off.array);
+    uring->cq_head = (unsigned *)((char *)uring->cq_ring + params.cq_off.head);
+    uring->cq_tail = (unsigned *)((char *)uring->cq_ring + params.cq_off.tail);
+    uring->cq_mask = (unsigned *)((char *)uring->cq_ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ring + params.cq_off.cqes);
+
+    return true;
+}
+
+/* only this thread produces SQ entries, so the tail is read plainly and published with release */
+static inline void uring_queue(paio_t *aio, size_t slot)
+{
+    paio_uring_t *uring = &aio->uring;
+    paio_req_t *req = &aio->reqs[slot];
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    tail = *uring->sq_tail;
+    index = tail & *uring->sq_mask;
+    sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    sqe->fd = aio->fd;
+    sqe->off = req->offset;
+    sqe->user_data = req->sync ? (uint64_t)slot | PAIO_URING_LINKED : (uint64_t)slot;
+
+    if (req->buf_index >= 0 && uring->registered) {
+        sqe->opcode = req->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)req->buffer;
+        sqe->len = (uint32_t)req->size;
+        sqe->buf_index = (uint16_t)req->buf_index;
+    } else {
+        req->iov.iov_base = req->buffer;
+        req->iov.iov_len = req->size;
+        sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr = (uint64_t)(uintptr_t)&req->iov;
+        sqe->len = 1;
+    }
+
+    uring->sq_array[index] = index;
+
+    if (req->sync) {
+        /* the sync only starts once the write is complete, a failed or short write cancels it */
+        sqe->flags |= IOSQE_IO_LINK;
+        tail++;
+        index = tail & *uring->sq_mask;
+        sqe = &uring->sqes[index];
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = aio->fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = (uint64_t)slot;
+        uring->sq_array[index] = index;
+        uring->queued++;
+    }
+
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    uring->queued++;
+}
+
+static inline bool uring_enter(paio_uring_t *uring, unsigned min_complete)
+{
+    int result;
+
+    for (;;) {
+        result = (int)syscall(
+            __NR_io_uring_enter, uring->fd, uring->queued, min_complete,
+            min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0
+        );
+        if (result < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+            continue; /* LCOV_EXCL_LINE */
+        }
+        if (result < 0) {
+            PINO_SUPRTF("io_uring_enter failed: %d", errno);
+            return false;
+        }
+
+        uring->queued -= (unsigned)result < uring->queued ? (unsigned)result : uring->queued;
+        if (uring->queued == 0 || min_complete > 0) {
+            return true;
+        }
+    }
+}
+
+static inline size_t uring_collect(paio_t *aio)
+{
+    paio_uring_t *uring = &aio->uring;
+    paio_req_t *req;
+    unsigned head, tail;
+    uint64_t user_data;
+    size_t count;
+    int32_t res;
+
+    count = 0;
+    head = *uring->cq_head;
+    tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        user_data = uring->cqes[head & *uring->cq_mask].user_data;
+        req = &aio->reqs[(size_t)(user_data & ~PAIO_URING_LINKED)];
+        res = uring->cqes[head & *uring->cq_mask].res;
+        head++;
+
+        if (req->sync && !(user_data & PAIO_URING_LINKED)) {
+            /* the sync was cancelled when its write came up short, redo it once that is finished */
+            req->result = req->result && (res == 0 || (res == -ECANCELED && pfd_sync(aio->fd)));
+        } else if (res >= 0 && (size_t)res == req->size) {
+            req->result = true;
+        } else if (res >= 0 && (size_t)res < req->size) {
+            /* short transfers are finished synchronously */
+            req->buffer = ((char *)req->buffer) + res;
+            req->size -= (size_t)res;
+            req->offset += (uint64_t)res;
+            req->result = res > 0 && req_transfer(aio, req);
+        } else {
+            req->result = false;
+        }
+
+        /* a linked write completes together with its sync */
+        if (user_data & PAIO_URING_LINKED) {
+            continue;
+        }
+
+        queue_push(&aio->completed, aio->depth, (size_t)user_data);
+        count++;
+    }
+
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+    return count;
+}
+#endif
+
+#if PINO_THREADS_AVAILABLE
+static PTHRD_RETURN aio_worker_main(void *arg)
+{
+    paio_t *aio = (paio_t *)arg;
+    size_t slot;
+    bool result;
+
+    pmutex_lock(&aio->lock);
+
+    for (;;) {
+        while (aio->pending.count == 0 && !aio->stop) {
+            pcond_wait(&aio->wake, &aio->lock);
+        }
+
+        if (aio->pending.count == 0) {
+            break;
+        }
+
+        slot = queue_pop(&aio->pending, aio->depth);
+        pmutex_unlock(&aio->lock);
+
+        result = req_run(aio, &aio->reqs[slot]);
+
+        pmutex_lock(&aio->lock);
+        aio->reqs[slot].result = result;
+        queue_push(&aio->completed, aio->depth, slot);
+        pcond_broadcast(&aio->done);
+    }
+
+    pmutex_unlock(&aio->lock);
+
+    return PTHRD_RETURN_VALUE;
+}
+#endif
+
+static inline bool aio_start(paio_t *aio, pino_async_backend_t backend)
+{
+#if PAIO_URING_AVAILABLE
+    /* a synced write takes two SQ entries */
+    if (backend != PINO_ASYNC_THREADS && uring_setup(&aio->uring, aio->depth * 2)) {
+        aio->backend = PINO_ASYNC_IO_URING;
+        return true;
+    }
+#endif
+
+    if (backend == PINO_ASYNC_IO_URING) {
+        return false;
+    }
+
+    aio->backend = PINO_ASYNC_THREADS;
+
+#if PINO_THREADS_AVAILABLE
+    for (aio->thread_count = 0; aio->thread_count < AIO_WORKERS; aio->thread_count++) {
+        if (!pthrd_create(&aio->threads[aio->thread_count], aio_worker_main, aio)) {
+            /* LCOV_EXCL_START */
+            PINO_SUPRTF("pthrd_create failed: %zu", aio->thread_count);
+            break;
+            /* LCOV_EXCL_STOP */
+        }
+    }
+#endif
+
+    /* without workers requests run inside paio_submit() */
+    return true;
+}
+
+extern paio_t *paio_create(pfd_t fd, size_t depth, pino_async_backend_t backend)
+{
+    paio_t *aio;
+    size_t i;
+
+    if (fd == PFD_INVALID || depth == 0 || depth > AIO_DEPTH_MAX) {
+        return NULL;
+    }
+
+    aio = (paio_t *)pcalloc(1, sizeof(paio_t));
+    if (!aio) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    aio->fd = fd;
+    aio->depth = depth;
+    aio->reqs = (paio_req_t *)pcalloc(depth, sizeof(paio_req_t));
+    aio->free_slots = (size_t *)pmalloc(depth * sizeof(size_t));
+    aio->queued.slots = (size_t *)pmalloc(depth * sizeof(size_t));
+    aio->pending.slots = (size_t *)pmalloc(depth * sizeof(size_t));
+    aio->completed.slots = (size_t *)pmalloc(depth * sizeof(size_t));
+    if (!aio->reqs || !aio->free_slots || !aio->queued.slots || !aio->pending.slots || !aio->completed.slots) {
+        /* LCOV_EXCL_START */
+        pfree(aio->reqs);
+        pfree(aio->queued.slots);
+        pfree(aio->free_slots);
+        pfree(aio->pending.slots);
+        pfree(aio->completed.slots);
+        pfree(aio);
+        return NULL;
+        /* LCOV_EXCL_STOP */
+    }
+
+    for (i = 0; i < depth; i++) {
+        aio->free_slots[i] = depth - 1 - i;
+    }
+    aio->free_count = depth;
+
+    pmutex_init(&aio->lock);
+    pcond_init(&aio->wake);
+    pcond_init(&aio->done);
+
+    if (!aio_start(aio, backend)) {
+        PINO_SUPRTF("backend not available: %d", (int)backend);
+        pmutex_destroy(&aio->lock);
+        pcond_destroy(&aio->wake);
+        pcond_destroy(&aio->done);
+        pfree(aio->reqs);
+        pfree(aio->free_slots);
+        pfree(aio->queued.slots);
+        pfree(aio->pending.slots);
+        pfree(aio->completed.slots);
+        pfree(aio);
+        return NULL;
+    }
+
+    return aio;
+}
+
+extern pino_async_backend_t paio_backend(const paio_t *aio)
+{
+    return aio->backend;
+}
+
+extern bool paio_register(paio_t *aio, void *const *buffers, size_t count, size_t size)
+{
+#if PAIO_URING_AVAILABLE
+    struct iovec *iovecs;
+    size_t i;
+
+    if (aio->backend != PINO_ASYNC_IO_URING || count == 0) {
+        return false;
+    }
+
+    iovecs = (struct iovec *)pmalloc(count * sizeof(struct iovec));
+    if (!iovecs) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    for (i = 0; i < count; i++) {
+        iovecs[i].iov_base = buffers[i];
+        iovecs[i].iov_len = size;
+    }
+
+    /* RLIMIT_MEMLOCK may refuse the pinning, plain transfers still work then */
+    aio->uring.registered = syscall(__NR_io_uring_register, aio->uring.fd, IORING_REGISTER_BUFFERS, iovecs, (unsigned)count) == 0;
+    pfree(iovecs);
+
+    return aio->uring.registered;
+#else
+    (void)aio;
+    (void)buffers;
+    (void)count;
+    (void)size;
+
+    return false;
+#endif
+}
+
+static inline bool aio_queue(paio_t *aio, void *buffer, size_t size, uint64_t offset, int buf_index, bool write, bool sync, void *user)
+{
+    paio_req_t *req;
+    size_t slot;
+
+    if (aio->free_count == 0 || size > UINT32_MAX) {
+        return false;
+    }
+
+    slot = aio->free_slots[--aio->free_count];
+    req = &aio->reqs[slot];
+    req->user = user;
+    req->buffer = buffer;
+    req->size = size;
+    req->offset = offset;
+    req->buf_index = buf_index;
+    req->write = write;
+    req->sync = sync;
+    req->result = false;
+
+#if PAIO_URING_AVAILABLE
+    if (aio->backend == PINO_ASYNC_IO_URING) {
+        uring_queue(aio, slot);
+        return true;
+    }
+#endif
+
+    /* held back until paio_submit() so one lock round trip covers the batch */
+    queue_push(&aio->queued, aio->depth, slot);
+
+    return true;
+}
+
+extern bool paio_write(paio_t *aio, const void *src, size_t size, uint64_t offset, int buf_index, void *user)
+{
+    return aio_queue(aio, (void *)(uintptr_t)src, size, offset, buf_index, true, false, user);
+}
+
+extern bool paio_write_sync(paio_t *aio, const void *src, size_t size, uint64_t offset, void *user)
+{
+    return aio_queue(aio, (void *)(uintptr_t)src, size, offset, -1, true, true, user);
+}
+
+extern bool paio_read(paio_t *aio, void *dest, size_t size, uint64_t offset, int buf_index, void *user)
+{
+    return aio_queue(aio, dest, size, offset, buf_index, false, false, user);
+}
+
+extern bool paio_submit(paio_t *aio)
+{
+    size_t slot;
+
+#if PAIO_URING_AVAILABLE
+    if (aio->backend == PINO_ASYNC_IO_URING) {
+        return aio->uring.queued == 0 || uring_enter(&aio->uring, 0);
+    }
+#endif
+
+    if (aio->queued.count == 0) {
+        return true;
+    }
+
+    pmutex_lock(&aio->lock);
+
+    while (aio->queued.count > 0) {
+        slot = queue_pop(&aio->queued, aio->depth);
+#if PINO_THREADS_AVAILABLE
+        if (aio->thread_count > 0) {
+            queue_push(&aio->pending, aio->depth, slot);
+            continue;
+        }
+#endif
+        aio->reqs[slot].result = req_run(aio, &aio->reqs[slot]);
+        queue_push(&aio->completed, aio->depth, slot);
+    }
+
+    pcond_broadcast(&aio->wake);
+    pmutex_unlock(&aio->lock);
+
+    return true;
+}
+
+extern size_t paio_inflight(const paio_t *aio)
+{
+    return aio->depth - aio->free_count;
+}
+
+extern size_t paio_reap(paio_t *aio, bool wait, paio_done_t fn, void *arg)
+{
+    paio_req_t *req;
+    size_t count, i, slot;
+
+    if (!paio_submit(aio)) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    wait = wait && paio_inflight(aio) > 0;
+
+#if PAIO_URING_AVAILABLE
+    if (aio->backend == PINO_ASYNC_IO_URING) {
+        /* the write in front of a linked sync wakes us up without completing anything */
+        count = uring_collect(aio);
+        while (count == 0 && wait && uring_enter(&aio->uring, 1)) {
+            count = uring_collect(aio);
+        }
+    } else
+#endif
+    {
+        pmutex_lock(&aio->lock);
+        while (wait && aio->completed.count == 0) {
+            pcond_wait(&aio->done, &aio->lock);
+        }
+        count = aio->completed.count;
+        pmutex_unlock(&aio->lock);
+    }
+
+    /* completions are only appended concurrently, the first count are stable */
+    for (i = 0; i < count; i++) {
+        pmutex_lock(&aio->lock);
+        slot = queue_pop(&aio->completed, aio->depth);
+        pmutex_unlock(&aio->lock);
+
+        req = &aio->reqs[slot];
+        aio->free_slots[aio->free_count++] = slot;
+
+        if (fn) {
+            fn(arg, req->user, req->result);
+        }
+    }
+
+    return count;
+}
+
+extern void paio_destroy(paio_t *aio, paio_done_t fn, void *arg)
+{
+    if (!aio) {
+        return;
+    }
+
+    /* nothing comes back from a broken ring, closing it cancels the rest */
+    while (paio_inflight(aio) > 0 && paio_reap(aio, true, fn, arg) > 0) {
+        continue;
+    }
+
+#if PAIO_URING_AVAILABLE
+    if (aio->backend == PINO_ASYNC_IO_URING) {
+        uring_unmap(&aio->uring);
+    }
+#endif
+
+#if PINO_THREADS_AVAILABLE
+    pmutex_lock(&aio->lock);
+    aio->stop = true;
+    pcond_broadcast(&aio->wake);
+    pmutex_unlock(&aio->lock);
+
+    while (aio->thread_count > 0) {
+        pthrd_join(aio->threads[--aio->thread_count]);
+    }
+#endif
+
+    pmutex_destroy(&aio->lock);
+    pcond_destroy(&aio->wake);
+    pcond_destroy(&aio->done);
+    pfree(aio->reqs);
+    pfree(aio->free_slots);
+    pfree(aio->queued.slots);
+    pfree(aio->pending.slots);
+    pfree(aio->completed.slots);
+    pfree(aio);
+}
@@ -0,0 +1,225 @@
+/*
+ * libpino - batch.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include <pino_internal.h>
+
+static inline bool batch_group(pino_handler_t **groups, size_t *group_count, pino_handler_t *handler)
+{
+    size_t i;
+
+    for (i = 0; i < *group_count; i++) {
+        if (groups[i] == handler) {
+            return true;
+        }
+    }
+
+    if (*group_count >= BATCH_GROUP_MAX) {
+        return false;
+    }
+
+    groups[(*group_count)++] = handler;
+
+    return true;
+}
+
+static inline size_t batch_serialize(const pino_t **pinos, size_t n, void *dest, size_t capacity, size_t *offsets)
+{
+    pino_handler_t *groups[BATCH_GROUP_MAX];
+    size_t group_count, total, size, i, j;
+    bool grouped;
+
+    /* sizing sweep, also collects the distinct handlers */
+    total = 0;
+    group_count = 0;
+    grouped = true;
+    for (i = 0; i < n; i++) {
+        if (!pinos[i] || !pino_ensure_payload(pinos[i])) {
+            return 0;
+        }
+
+        size = pino_record_size(pinos[i], 0);
+        if (size > SIZE_MAX - total) {
+            return 0; /* LCOV_EXCL_LINE */
+        }
+
+        if (offsets) {
+            offsets[i] = total;
+        }
+        total += size;
+
+        grouped = grouped && batch_group(groups, &group_count, pinos[i]->handler);
+    }
+
+    if (!dest) {
+        return total;
+    }
+
+    if (total > capacity) {
+        PINO_SUPRTF("capacity: %zu, required: %zu", capacity, total);
+        return 0;
+    }
+
+    if (!grouped || group_count == 1) {
+        for (i = 0; i < n; i++) {
+            if (!pino_record_write(pinos[i], ((char *)dest) + offsets[i], 0)) {
+                return 0;
+            }
+        }
+
+        return total;
+    }
+
+    /* one handler at a time keeps its code and data hot */
+    for (j = 0; j < group_count; j++) {
+        for (i = 0; i < n; i++) {
+            if (pinos[i]->handler == groups[j] && !pino_record_write(pinos[i], ((char *)dest) + offsets[i], 0)) {
+                return 0;
+            }
+        }
+    }
+
+    return total;
+}
+
+extern size_t pino_serialize_batch(const pino_t **pinos, size_t n, void *dest, size_t capacity, size_t *offsets_out)
+{
+    size_t *offsets, total;
+
+    if (!pinos || n == 0) {
+        return 0;
+    }
+
+    offsets = offsets_out;
+    if (dest && !offsets) {
+        offsets = (size_t *)pmalloc(n * sizeof(size_t));
+        if (!offsets) {
+            return 0; /* LCOV_EXCL_LINE */
+        }
+    }
+
+    total = batch_serialize(pinos, n, dest, capacity, offsets);
+
+    if (offsets != offsets_out) {
+        pfree(offsets);
+    }
+
+    return total;
+}
+
+typedef struct {
+    pino_header_t header;
+    pino_handler_t *handler;
+    size_t size;
+} batch_record_t;
+
+/* the leading run of records that decoded, anything behind the first failure is destroyed again */
+static inline size_t batch_unserialize_window(const batch_record_t *records, size_t window, pino_t **out, pino_handler_t **groups, size_t group_count)
+{
+    size_t i, j;
+
+    if (group_count <= 1) {
+        for (i = 0; i < window; i++) {
+            out[i] = pino_record_unserialize(&records[i].header, records[i].handler);
+            if (!out[i]) {
+                break;
+            }
+        }
+
+        return i;
+    }
+
+    /* one handler at a time keeps its code and data hot */
+    for (j = 0; j < group_count; j++) {
+        for (i = 0; i < window; i++) {
+            if (records[i].handler == groups[j]) {
+                out[i] = pino_record_unserialize(&records[i].header, records[i].handler);
+            }
+        }
+    }
+
+    for (i = 0; i < window && out[i]; i++);
+
+    for (j = i; j < window; j++) {
+        pino_destroy(out[j]);
+        out[j] = NULL;
+    }
+
+    return i;
+}
+
+extern size_t pino_unserialize_batch_ex(const void *src, size_t size, pino_t **out, size_t n, size_t *consumed, pino_validate_result_t *result)
+{
+    batch_record_t records[BATCH_WINDOW];
+    pino_handler_t *groups[BATCH_GROUP_MAX];
+    handler_cache_t cache;
+    pino_validate_result_t status;
+    size_t offset, scan, window, decoded, group_count, count, i;
+    bool grouped;
+
+    if (consumed) {
+        *consumed = 0;
+    }
+
+    if (!src || !out) {
+        if (result) {
+            *result = PINO_VALIDATE_INVALID_ARGUMENT;
+        }
+        return 0;
+    }
+
+    cache.handler = NULL;
+    status = PINO_VALIDATE_OK;
+    offset = 0;
+    count = 0;
+
+    while (count < n && offset < size && status == PINO_VALIDATE_OK) {
+        /* scan a window of headers, then decode it grouped by handler */
+        scan = offset;
+        window = 0;
+        group_count = 0;
+        grouped = true;
+        while (window < BATCH_WINDOW && count + window < n && scan < size) {
+            status = pino_record_scan(((const char *)src) + scan, size - scan, &cache, &records[window].header, &records[window].size);
+            if (status != PINO_VALIDATE_OK) {
+                PINO_SUPRTF("invalid record at offset: %zu", scan);
+                break;
+            }
+
+            records[window].handler = cache.handler;
+            grouped = grouped && batch_group(groups, &group_count, cache.handler);
+            scan += records[window].size;
+            ++window;
+        }
+
+        decoded = batch_unserialize_window(records, window, out + count, groups, grouped ? group_count : 0);
+        for (i = 0; i < decoded; i++) {
+            offset += records[i].size;
+        }
+        count += decoded;
+
+        if (decoded < window) {
+            PINO_SUPRTF("record at offset: %zu failed to unserialize", offset);
+            status = pino_record_checksum(&records[decoded].header) ? PINO_VALIDATE_PAYLOAD : PINO_VALIDATE_CHECKSUM;
+        }
+    }
+
+    if (consumed) {
+        *consumed = offset;
+    }
+
+    if (result) {
+        *result = status;
+    }
+
+    return count;
+}
+
+extern size_t pino_unserialize_batch(const void *src, size_t size, pino_t **out, size_t n)
+{
+    return pino_unserialize_batch_ex(src, size, out, n, NULL, NULL);
+}
@@ -0,0 +1,1221 @@
+/*
+ * libpino - container.c
+ * 
+ */
+
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+# define _FILE_OFFSET_BITS 64
+#endif
+
+#include <pino.h>
+#include <pino/container.h>
+
+#include <pino_internal.h>
+#include <pino_file.h>
+#include <pino_aio.h>
+
+typedef struct {
+    pino_magic_t magic;
+    uint64_t offset;    /* of the size prefix */
+    uint64_t size;      /* without the size prefix */
+} container_entry_t;
+
+typedef struct {
+    container_entry_t *entries;
+    size_t count;
+    size_t capacity;
+} container_index_t;
+
+struct _pino_container_writer_t {
+    FILE *fp;
+    uint64_t offset;
+    container_index_t index;
+    uint8_t *buffer;
+    size_t buffer_size;
+    bool failed;
+};
+
+struct _pino_mmap_writer_t {
+    pmap_file_t file;
+    uint64_t offset;
+    container_index_t index;
+    bool failed;
+};
+
+typedef struct {
+    uint8_t *data;
+    bool busy;      /* handed to the backend */
+    bool owned;     /* one oversized record, freed once written */
+} async_buffer_t;
+
+struct _pino_async_writer_t {
+    pfd_t fd;
+    paio_t *aio;
+    uint64_t offset;    /* end of the last appended record */
+    container_index_t index;
+    async_buffer_t *buffers;
+    size_t depth;
+    size_t current;     /* buffer being filled */
+    size_t usage;
+    bool failed;
+};
+
+struct _pino_container_reader_t {
+    FILE *fp;
+    pmap_t map;     /* used instead of fp when mapped */
+    uint64_t file_size;
+    container_entry_t *entries;
+    size_t count;
+    size_t cursor;
+    size_t readahead;
+};
+
+struct _pino_async_reader_t {
+    pino_container_reader_t *container;     /* for the index only */
+    pfd_t fd;
+    paio_t *aio;
+    size_t inflight;
+};
+
+typedef struct {
+    pino_async_reader_t *reader;
+    size_t index;
+    void *buffer;
+    size_t size;
+} async_read_t;
+
+typedef struct {
+    pino_async_read_fn_t fn;
+    void *arg;
+} async_poll_t;
+
+static inline void put_u64(uint8_t *dest, uint64_t value)
+{
+    pmemcpy_n2l(dest, &value, sizeof(uint64_t));
+}
+
+static inline uint64_t get_u64(const uint8_t *src)
+{
+    uint64_t value;
+
+    pmemcpy_l2n(&value, src, sizeof(uint64_t));
+
+    return value;
+}
+
+static inline void encode_header(uint8_t *dest)
+{
+    uint32_t version;
+
+    version = PINO_CONTAINER_VERSION;
+    memset(dest, 0, PINO_CONTAINER_HEADER_SIZE);
+    pmemcpy(dest, PINO_CONTAINER_MAGIC, sizeof(pino_magic_t));
+    pmemcpy_n2l(dest + sizeof(pino_magic_t), &version, sizeof(uint32_t));
+}
+
+static inline void encode_entry(uint8_t *dest, const container_entry_t *entry)
+{
+    pmemcpy(dest, entry->magic, sizeof(pino_magic_t));
+    put_u64(dest + sizeof(pino_magic_t), entry->offset);
+}
+
+static inline void encode_footer(uint8_t *dest, uint64_t index_offset, size_t count)
+{
+    memset(dest, 0, PINO_CONTAINER_FOOTER_SIZE);
+    put_u64(dest, index_offset);
+    put_u64(dest + 8, (uint64_t)count);
+    pmemcpy(dest + 16, PINO_CONTAINER_INDEX_MAGIC, sizeof(pino_magic_t));
+}
+
+static inline bool index_push(container_index_t *index, const pino_magic_t magic, uint64_t offset, uint64_t size)
+{
+    container_entry_t *entries;
+
+    if (index->count >= index->capacity) {
+        entries = (container_entry_t *)prealloc(index->entries, (index->capacity + CONTAINER_STEP) * sizeof(container_entry_t));
+        if (!entries) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+
+        index->entries = entries;
+        index->capacity += CONTAINER_STEP;
+    }
+
+    pmemcpy(index->entries[index->count].magic, magic, sizeof(pino_magic_t));
+    index->entries[index->count].offset = offset;
+    index->entries[index->count].size = size;
+    ++index->count;
+
+    return true;
+}
+
+static inline void index_free(container_index_t *index)
+{
+    if (index->entries) {
+        pfree(index->entries);
+    }
+
+    index->entries = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+static inline size_t record_size(const pino_t *pino)
+{
+    size_t size;
+
+    size = pino_serialize_size(pino);
+    if (size == 0 || size > SIZE_MAX - PINO_CONTAINER_RECORD_SIZE) {
+        return 0;
+    }
+
+    return size;
+}
+
+static inline bool writer_reserve(pino_container_writer_t *writer, size_t size)
+{
+    uint8_t *buffer;
+
+    if (writer->buffer_size >= size) {
+        return true;
+    }
+
+    buffer = (uint8_t *)prealloc(writer->buffer, size);
+    if (!buffer) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    writer->buffer = buffer;
+    writer->buffer_size = size;
+
+    return true;
+}
+
+static inline bool writer_finish(pino_container_writer_t *writer)
+{
+    uint8_t entry[PINO_CONTAINER_INDEX_ENTRY_SIZE], footer[PINO_CONTAINER_FOOTER_SIZE];
+    size_t i;
+
+    for (i = 0; i < writer->index.count; i++) {
+        encode_entry(entry, &writer->index.entries[i]);
+        if (!pfwrite(writer->fp, entry, sizeof(entry))) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+    }
+
+    encode_footer(footer, writer->offset, writer->index.count);
+
+    return pfwrite(writer->fp, footer, sizeof(footer));
+}
+
+extern pino_container_writer_t *pino_container_writer_open(const char *path)
+{
+    pino_container_writer_t *writer;
+    uint8_t header[PINO_CONTAINER_HEADER_SIZE];
+
+    if (!path) {
+        return NULL;
+    }
+
+    writer = (pino_container_writer_t *)pcalloc(1, sizeof(pino_container_writer_t));
+    if (!writer) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    writer->fp = fopen(path, "wb");
+    if (!writer->fp) {
+        PINO_SUPRTF("fopen failed: %s", path);
+        pfree(writer);
+        return NULL;
+    }
+
+    encode_header(header);
+    if (!pfwrite(writer->fp, header, sizeof(header))) {
+        /* LCOV_EXCL_START */
+        fclose(writer->fp);
+        pfree(writer);
+        return NULL;
+        /* LCOV_EXCL_STOP */
+    }
+
+    writer->offset = PINO_CONTAINER_HEADER_SIZE;
+
+    return writer;
+}
+
+extern bool pino_container_writer_append(pino_container_writer_t *writer, const pino_t *pino)
+{
+    size_t size;
+
+    if (!writer || !pino || writer->failed) {
+        return false;
+    }
+
+    size = record_size(pino);
+    if (size == 0 || !writer_reserve(writer, PINO_CONTAINER_RECORD_SIZE + size)) {
+        return false;
+    }
+
+    put_u64(writer->buffer, (uint64_t)size);
+    if (!pino_serialize(pino, writer->buffer + PINO_CONTAINER_RECORD_SIZE)) {
+        return false;
+    }
+
+    /* a partial record can not be taken back, the file is lost from here */
+    if (!index_push(&writer->index, (const char *)pino->magic, writer->offset, (uint64_t)size) ||
+        !pfwrite(writer->fp, writer->buffer, PINO_CONTAINER_RECORD_SIZE + size)
+    ) {
+        /* LCOV_EXCL_START */
+        writer->failed = true;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    writer->offset += PINO_CONTAINER_RECORD_SIZE + size;
+
+    return true;
+}
+
+extern size_t pino_container_writer_count(const pino_container_writer_t *writer)
+{
+    return writer ? writer->index.count : 0;
+}
+
+extern bool pino_container_writer_close(pino_container_writer_t *writer)
+{
+    bool result;
+
+    if (!writer) {
+        return false;
+    }
+
+    result = !writer->failed && writer_finish(writer);
+    result = (fclose(writer->fp) == 0) && result;
+
+    index_free(&writer->index);
+
+    if (writer->buffer) {
+        pfree(writer->buffer);
+    }
+
+    pfree(writer);
+
+    return result;
+}
+
+/* grows the mapping geometrically so that size bytes fit */
+static inline bool mmap_writer_reserve(pino_mmap_writer_t *writer, uint64_t size)
+{
+    uint64_t capacity;
+
+    if (size <= (uint64_t)writer->file.size) {
+        return true;
+    }
+
+    if (size > SIZE_MAX) {
+        return false;
+    }
+
+    capacity = (uint64_t)writer->file.size * 2;
+    capacity = capacity > size && capacity <= SIZE_MAX ? capacity : size;
+
+    PINO_SUPRTF("remap: %zu -> %zu", writer->file.size, (size_t)capacity);
+
+    return pmap_file_resize(&writer->file, (size_t)capacity);
+}
+
+extern pino_mmap_writer_t *pino_mmap_writer_open(const char *path, size_t initial_size)
+{
+    pino_mmap_writer_t *writer;
+
+    if (!path) {
+        return NULL;
+    }
+
+    writer = (pino_mmap_writer_t *)pcalloc(1, sizeof(pino_mmap_writer_t));
+    if (!writer) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    initial_size = initial_size > PINO_CONTAINER_HEADER_SIZE ? initial_size : MMAP_INITIAL_SIZE;
+    if (!pmap_file_create(path, &writer->file) || !pmap_file_resize(&writer->file, initial_size)) {
+        PINO_SUPRTF("mmap failed: %s", path);
+        pmap_file_abort(&writer->file);
+        pfree(writer);
+        return NULL;
+    }
+
+    encode_header((uint8_t *)writer->file.addr);
+    writer->offset = PINO_CONTAINER_HEADER_SIZE;
+
+    return writer;
+}
+
+extern bool pino_mmap_writer_append(pino_mmap_writer_t *writer, const pino_t *pino)
+{
+    uint8_t *dest;
+    size_t size;
+
+    if (!writer || !pino || writer->failed) {
+        return false;
+    }
+
+    size = record_size(pino);
+    if (size == 0 || writer->offset > UINT64_MAX - PINO_CONTAINER_RECORD_SIZE - size) {
+        return false;
+    }
+
+    if (!mmap_writer_reserve(writer, writer->offset + PINO_CONTAINER_RECORD_SIZE + size)) {
+        /* LCOV_EXCL_START */
+        writer->failed = true;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    /* straight into the mapping, the record is only committed by moving offset */
+    dest = ((uint8_t *)writer->file.addr) + writer->offset;
+    put_u64(dest, (uint64_t)size);
+    if (!pino_serialize(pino, dest + PINO_CONTAINER_RECORD_SIZE)) {
+        return false;
+    }
+
+    if (!index_push(&writer->index, (const char *)pino->magic, writer->offset, (uint64_t)size)) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    writer->offset += PINO_CONTAINER_RECORD_SIZE + size;
+
+    return true;
+}
+
+extern size_t pino_mmap_writer_count(const pino_mmap_writer_t *writer)
+{
+    return writer ? writer->index.count : 0;
+}
+
+static inline bool mmap_writer_finish(pino_mmap_writer_t *writer)
+{
+    uint64_t size;
+    uint8_t *dest;
+    size_t i;
+
+    size = writer->offset + (uint64_t)writer->index.count * PINO_CONTAINER_INDEX_ENTRY_SIZE + PINO_CONTAINER_FOOTER_SIZE;
+    if (!mmap_writer_reserve(writer, size)) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    dest = ((uint8_t *)writer->file.addr) + writer->offset;
+    for (i = 0; i < writer->index.count; i++) {
+        encode_entry(dest, &writer->index.entries[i]);
+        dest += PINO_CONTAINER_INDEX_ENTRY_SIZE;
+    }
+
+    encode_footer(dest, writer->offset, writer->index.count);
+
+    return pmap_file_finish(&writer->file, (size_t)size);
+}
+
+extern bool pino_mmap_writer_close(pino_mmap_writer_t *writer)
+{
+    bool result;
+
+    if (!writer) {
+        return false;
+    }
+
+    result = !writer->failed && mmap_writer_finish(writer);
+    if (!result) {
+        pmap_file_abort(&writer->file);
+    }
+
+    index_free(&writer->index);
+    pfree(writer);
+
+    return result;
+}
+
+static void async_writer_done(void *arg, void *user, bool result)
+{
+    pino_async_writer_t *writer = (pino_async_writer_t *)arg;
+    async_buffer_t *buffer = (async_buffer_t *)user;
+
+    if (!result) {
+        writer->failed = true;
+    }
+
+    if (buffer->owned) {
+        pfree(buffer->data);
+        pfree(buffer);
+        return;
+    }
+
+    buffer->busy = false;
+}
+
+/* false when the buffer could not be queued, once queued it belongs to async_writer_done() even if submitting failed */
+static inline bool async_writer_submit(pino_async_writer_t *writer, async_buffer_t *buffer, size_t size, uint64_t offset, int buf_index)
+{
+    /* oversized records may have taken every request slot */
+    while (!paio_write(writer->aio, buffer->data, size, offset, buf_index, buffer)) {
+        if (paio_reap(writer->aio, true, async_writer_done, writer) == 0) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+    }
+
+    if (!paio_submit(writer->aio)) {
+        writer->failed = true; /* LCOV_EXCL_LINE */
+    }
+
+    return true;
+}
+
+/* hands the filling buffer to the backend and moves on to a free one */
+static inline bool async_writer_flush(pino_async_writer_t *writer)
+{
+    async_buffer_t *buffer;
+    size_t i;
+
+    if (writer->usage == 0) {
+        return true;
+    }
+
+    buffer = &writer->buffers[writer->current];
+    buffer->busy = true;
+    if (!async_writer_submit(writer, buffer, writer->usage, writer->offset - writer->usage, (int)writer->current)) {
+        /* LCOV_EXCL_START */
+        buffer->busy = false;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    writer->usage = 0;
+    if (writer->failed) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    for (;;) {
+        for (i = 1; i <= writer->depth; i++) {
+            if (!writer->buffers[(writer->current + i) % writer->depth].busy) {
+                writer->current = (writer->current + i) % writer->depth;
+                return true;
+            }
+        }
+
+        if (paio_reap(writer->aio, true, async_writer_done, writer) == 0) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+    }
+}
+
+static inline bool async_writer_append_oversized(pino_async_writer_t *writer, const pino_t *pino, size_t size)
+{
+    async_buffer_t *buffer;
+
+    buffer = (async_buffer_t *)pcalloc(1, sizeof(async_buffer_t));
+    if (!buffer) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    buffer->owned = true;
+    buffer->data = (uint8_t *)pmalloc(PINO_CONTAINER_RECORD_SIZE + size);
+    if (!buffer->data) {
+        /* LCOV_EXCL_START */
+        pfree(buffer);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    put_u64(buffer->data, (uint64_t)size);
+    if (!pino_serialize(pino, buffer->data + PINO_CONTAINER_RECORD_SIZE)) {
+        pfree(buffer->data);
+        pfree(buffer);
+        return false;
+    }
+
+    if (!index_push(&writer->index, (const char *)pino->magic, writer->offset, (uint64_t)size) ||
+        !async_writer_submit(writer, buffer, PINO_CONTAINER_RECORD_SIZE + size, writer->offset, -1)
+    ) {
+        /* LCOV_EXCL_START */
+        pfree(buffer->data);
+        pfree(buffer);
+        writer->failed = true;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    writer->offset += PINO_CONTAINER_RECORD_SIZE + size;
+    if (writer->failed) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    return true;
+}
+
+static inline void async_writer_free(pino_async_writer_t *writer)
+{
+    size_t i;
+
+    paio_destroy(writer->aio, async_writer_done, writer);
+
+    if (writer->buffers) {
+        for (i = 0; i < writer->depth; i++) {
+            if (writer->buffers[i].data) {
+                pfree(writer->buffers[i].data);
+            }
+        }
+        pfree(writer->buffers);
+    }
+
+    index_free(&writer->index);
+    pfree(writer);
+}
+
+extern pino_async_writer_t *pino_async_writer_open(const char *path, pino_async_backend_t backend, size_t depth)
+{
+    pino_async_writer_t *writer;
+    uint8_t header[PINO_CONTAINER_HEADER_SIZE];
+    void *datas[AIO_DEPTH_MAX];
+    size_t i;
+
+    if (!path) {
+        return NULL;
+    }
+
+    depth = depth == 0 ? AIO_BUFFERS : depth;
+    if (depth > AIO_DEPTH_MAX) {
+        return NULL;
+    }
+
+    writer = (pino_async_writer_t *)pcalloc(1, sizeof(pino_async_writer_t));
+    if (!writer) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    writer->fd = pfd_open(path, true);
+    if (writer->fd == PFD_INVALID) {
+        PINO_SUPRTF("open failed: %s", path);
+        pfree(writer);
+        return NULL;
+    }
+
+    encode_header(header);
+    writer->depth = depth;
+    writer->buffers = (async_buffer_t *)pcalloc(depth, sizeof(async_buffer_t));
+    writer->aio = pfd_pwrite(writer->fd, header, sizeof(header), 0) ? paio_create(writer->fd, depth, backend) : NULL;
+    if (!writer->buffers || !writer->aio) {
+        pfd_close(writer->fd);
+        async_writer_free(writer);
+        return NULL;
+    }
+
+    for (i = 0; i < depth; i++) {
+        writer->buffers[i].data = (uint8_t *)pmalloc(AIO_BUFFER_SIZE);
+        if (!writer->buffers[i].data) {
+            /* LCOV_EXCL_START */
+            pfd_close(writer->fd);
+            async_writer_free(writer);
+            return NULL;
+            /* LCOV_EXCL_STOP */
+        }
+        datas[i] = writer->buffers[i].data;
+    }
+
+    /* pinned once here instead of mapped again for every write */
+    paio_register(writer->aio, datas, depth, AIO_BUFFER_SIZE);
+
+    writer->offset = PINO_CONTAINER_HEADER_SIZE;
+
+    return writer;
+}
+
+extern pino_async_backend_t pino_async_writer_backend(const pino_async_writer_t *writer)
+{
+    return writer ? paio_backend(writer->aio) : PINO_ASYNC_AUTO;
+}
+
+extern bool pino_async_writer_append(pino_async_writer_t *writer, const pino_t *pino)
+{
+    uint8_t *dest;
+    size_t size;
+
+    if (!writer || !pino || writer->failed) {
+        return false;
+    }
+
+    size = record_size(pino);
+    if (size == 0) {
+        return false;
+    }
+
+    /* buffers cover contiguous file ranges, so the filling one goes first */
+    if (size > AIO_BUFFER_SIZE - PINO_CONTAINER_RECORD_SIZE) {
+        if (!async_writer_flush(writer)) {
+            /* LCOV_EXCL_START */
+            writer->failed = true;
+            return false;
+            /* LCOV_EXCL_STOP */
+        }
+
+        return async_writer_append_oversized(writer, pino, size);
+    }
+
+    if (writer->usage + PINO_CONTAINER_RECORD_SIZE + size > AIO_BUFFER_SIZE && !async_writer_flush(writer)) {
+        /* LCOV_EXCL_START */
+        writer->failed = true;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    dest = writer->buffers[writer->current].data + writer->usage;
+    put_u64(dest, (uint64_t)size);
+    if (!pino_serialize(pino, dest + PINO_CONTAINER_RECORD_SIZE)) {
+        return false;
+    }
+
+    if (!index_push(&writer->index, (const char *)pino->magic, writer->offset, (uint64_t)size)) {
+        /* LCOV_EXCL_START */
+        writer->failed = true;
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    writer->usage += PINO_CONTAINER_RECORD_SIZE + size;
+    writer->offset += PINO_CONTAINER_RECORD_SIZE + size;
+
+    return true;
+}
+
+extern bool pino_async_writer_poll(pino_async_writer_t *writer)
+{
+    if (!writer) {
+        return false;
+    }
+
+    paio_reap(writer->aio, false, async_writer_done, writer);
+
+    return !writer->failed;
+}
+
+extern size_t pino_async_writer_count(const pino_async_writer_t *writer)
+{
+    return writer ? writer->index.count : 0;
+}
+
+static inline bool async_writer_finish(pino_async_writer_t *writer)
+{
+    uint8_t *tail;
+    size_t size, i;
+    bool result;
+
+    size = writer->index.count * PINO_CONTAINER_INDEX_ENTRY_SIZE + PINO_CONTAINER_FOOTER_SIZE;
+    tail = (uint8_t *)pmalloc(size);
+    if (!tail) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    for (i = 0; i < writer->index.count; i++) {
+        encode_entry(tail + i * PINO_CONTAINER_INDEX_ENTRY_SIZE, &writer->index.entries[i]);
+    }
+
+    encode_footer(tail + writer->index.count * PINO_CONTAINER_INDEX_ENTRY_SIZE, writer->offset, writer->index.count);
+
+    result = pfd_pwrite(writer->fd, tail, size, writer->offset);
+    pfree(tail);
+
+    return result;
+}
+
+extern bool pino_async_writer_close(pino_async_writer_t *writer)
+{
+    bool result;
+
+    if (!writer) {
+        return false;
+    }
+
+    if (!writer->failed && !async_writer_flush(writer)) {
+        writer->failed = true; /* LCOV_EXCL_LINE */
+    }
+
+    /* every record has to be on disk before the index points at it */
+    while (paio_inflight(writer->aio) > 0 && paio_reap(writer->aio, true, async_writer_done, writer) > 0) {
+        continue;
+    }
+
+    result = !writer->failed && paio_inflight(writer->aio) == 0 && async_writer_finish(writer);
+    result = pfd_close(writer->fd) && result;
+
+    async_writer_free(writer);
+
+    return result;
+}
+
+static inline bool reader_pread(pino_container_reader_t *reader, uint64_t offset, void *dest, size_t size)
+{
+    if (offset > reader->file_size || size > reader->file_size - offset) {
+        return false;
+    }
+
+    if (reader->map.addr) {
+        pmemcpy(dest, ((const uint8_t *)reader->map.addr) + offset, size);
+        return true;
+    }
+
+    return pfseek(reader->fp, offset, SEEK_SET) == 0 && pfread(reader->fp, dest, size);
+}
+
+static inline bool reader_load_index(pino_container_reader_t *reader, uint64_t index_offset)
+{
+    uint8_t *index;
+    uint64_t next;
+    size_t i;
+
+    index = (uint8_t *)pmalloc(reader->count * PINO_CONTAINER_INDEX_ENTRY_SIZE);
+    if (!index) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    if (!reader_pread(reader, index_offset, index, reader->count * PINO_CONTAINER_INDEX_ENTRY_SIZE)) {
+        /* LCOV_EXCL_START */
+        pfree(index);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    for (i = 0; i < reader->count; i++) {
+        pmemcpy(reader->entries[i].magic, index + i * PINO_CONTAINER_INDEX_ENTRY_SIZE, sizeof(pino_magic_t));
+        reader->entries[i].offset = get_u64(index + i * PINO_CONTAINER_INDEX_ENTRY_SIZE + sizeof(pino_magic_t));
+    }
+
+    pfree(index);
+
+    /* records are back to back, so sizes come from the neighbours */
+    for (i = 0; i < reader->count; i++) {
+        next = i + 1 < reader->count ? reader->entries[i + 1].offset : index_offset;
+        if (reader->entries[i].offset < PINO_CONTAINER_HEADER_SIZE ||
+            next > index_offset ||
+            reader->entries[i].offset > next ||
+            next - reader->entries[i].offset <= PINO_CONTAINER_RECORD_SIZE ||
+            next - reader->entries[i].offset - PINO_CONTAINER_RECORD_SIZE > SIZE_MAX
+        ) {
+            PINO_SUPRTF("invalid index entry: %zu", i);
+            return false;
+        }
+
+        reader->entries[i].size = next - reader->entries[i].offset - PINO_CONTAINER_RECORD_SIZE;
+    }
+
+    return true;
+}
+
+static inline bool reader_load(pino_container_reader_t *reader)
+{
+    uint8_t header[PINO_CONTAINER_HEADER_SIZE], footer[PINO_CONTAINER_FOOTER_SIZE];
+    uint64_t index_offset, count;
+    uint32_t version;
+    int64_t file_size;
+
+    if (reader->map.addr) {
+        reader->file_size = (uint64_t)reader->map.size;
+    } else {
+        if (pfseek(reader->fp, 0, SEEK_END) != 0 || (file_size = pftell(reader->fp)) < 0) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+        reader->file_size = (uint64_t)file_size;
+    }
+
+    if (!reader_pread(reader, 0, header, sizeof(header)) ||
+        memcmp(header, PINO_CONTAINER_MAGIC, sizeof(pino_magic_t)) != 0
+    ) {
+        PINO_SUPRTF("invalid container header");
+        return false;
+    }
+
+    pmemcpy_l2n(&version, header + sizeof(pino_magic_t), sizeof(uint32_t));
+    if (version != PINO_CONTAINER_VERSION) {
+        PINO_SUPRTF("unsupported container version: %u", version);
+        return false;
+    }
+
+    if (reader->file_size < PINO_CONTAINER_HEADER_SIZE + PINO_CONTAINER_FOOTER_SIZE ||
+        !reader_pread(reader, reader->file_size - PINO_CONTAINER_FOOTER_SIZE, footer, sizeof(footer)) ||
+        memcmp(footer + 16, PINO_CONTAINER_INDEX_MAGIC, sizeof(pino_magic_t)) != 0
+    ) {
+        PINO_SUPRTF("invalid container footer");
+        return false;
+    }
+
+    index_offset = get_u64(footer);
+    count = get_u64(footer + 8);
+
+    /* the index must exactly fill the gap between the records and the footer */
+    if (index_offset < PINO_CONTAINER_HEADER_SIZE ||
+        index_offset > reader->file_size - PINO_CONTAINER_FOOTER_SIZE ||
+        count > SIZE_MAX / sizeof(container_entry_t) ||
+        count != (reader->file_size - PINO_CONTAINER_FOOTER_SIZE - index_offset) / PINO_CONTAINER_INDEX_ENTRY_SIZE ||
+        (reader->file_size - PINO_CONTAINER_FOOTER_SIZE - index_offset) % PINO_CONTAINER_INDEX_ENTRY_SIZE != 0
+    ) {
+        PINO_SUPRTF("invalid container index");
+        return false;
+    }
+
+    reader->count = (size_t)count;
+    if (reader->count == 0) {
+        return true;
+    }
+
+    reader->entries = (container_entry_t *)pmalloc(reader->count * sizeof(container_entry_t));
+    if (!reader->entries) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    return reader_load_index(reader, index_offset);
+}
+
+static inline pino_container_reader_t *reader_open(const char *path, bool mapped)
+{
+    pino_container_reader_t *reader;
+
+    if (!path) {
+        return NULL;
+    }
+
+    reader = (pino_container_reader_t *)pcalloc(1, sizeof(pino_container_reader_t));
+    if (!reader) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    if (mapped ? !pmap_open(path, &reader->map) : !(reader->fp = fopen(path, "rb"))) {
+        PINO_SUPRTF("open failed: %s", path);
+        pfree(reader);
+        return NULL;
+    }
+
+    if (!reader_load(reader)) {
+        pino_container_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+extern pino_container_reader_t *pino_container_reader_open(const char *path)
+{
+    return reader_open(path, false);
+}
+
+extern pino_container_reader_t *pino_container_reader_open_mmap(const char *path)
+{
+    return reader_open(path, true);
+}
+
+extern size_t pino_container_reader_count(const pino_container_reader_t *reader)
+{
+    return reader ? reader->count : 0;
+}
+
+extern bool pino_container_reader_magic(const pino_container_reader_t *reader, size_t index, pino_magic_safe_t magic)
+{
+    if (!reader || !magic || index >= reader->count) {
+        return false;
+    }
+
+    pmemcpy(magic, reader->entries[index].magic, sizeof(pino_magic_t));
+    magic[sizeof(pino_magic_t)] = '\0';
+
+    return true;
+}
+
+extern size_t pino_container_reader_size(const pino_container_reader_t *reader, size_t index)
+{
+    if (!reader || index >= reader->count) {
+        return 0;
+    }
+
+    return (size_t)reader->entries[index].size;
+}
+
+static inline bool reader_check_prefix(const uint8_t *prefix, const container_entry_t *entry)
+{
+    return get_u64(prefix) == entry->size;
+}
+
+extern bool pino_container_reader_read(pino_container_reader_t *reader, size_t index, void *dest)
+{
+    uint8_t prefix[PINO_CONTAINER_RECORD_SIZE];
+
+    if (!reader || !dest || index >= reader->count) {
+        return false;
+    }
+
+    if (!reader_pread(reader, reader->entries[index].offset, prefix, sizeof(prefix)) ||
+        !reader_check_prefix(prefix, &reader->entries[index])
+    ) {
+        PINO_SUPRTF("record size mismatch: %zu", index);
+        return false;
+    }
+
+    return reader_pread(reader, reader->entries[index].offset + PINO_CONTAINER_RECORD_SIZE, dest, (size_t)reader->entries[index].size);
+}
+
+extern const void *pino_container_reader_view(const pino_container_reader_t *reader, size_t index, size_t *size)
+{
+    const uint8_t *record;
+
+    if (!reader || !reader->map.addr || index >= reader->count) {
+        return NULL;
+    }
+
+    record = ((const uint8_t *)reader->map.addr) + reader->entries[index].offset;
+    if (!reader_check_prefix(record, &reader->entries[index])) {
+        PINO_SUPRTF("record size mismatch: %zu", index);
+        return NULL;
+    }
+
+    if (size) {
+        *size = (size_t)reader->entries[index].size;
+    }
+
+    return record + PINO_CONTAINER_RECORD_SIZE;
+}
+
+extern pino_t *pino_container_reader_get(pino_container_reader_t *reader, size_t index)
+{
+    const void *view;
+    pino_t *pino;
+    void *buffer;
+    size_t size;
+
+    if (!reader || index >= reader->count) {
+        return NULL;
+    }
+
+    /* mapped records are decoded straight from the page cache */
+    if (reader->map.addr) {
+        view = pino_container_reader_view(reader, index, &size);
+
+        return view ? pino_unserialize(view, size) : NULL;
+    }
+
+    buffer = pmalloc((size_t)reader->entries[index].size);
+    if (!buffer) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    /* the record buffer is handed over instead of copied again */
+    pino = NULL;
+    if (pino_container_reader_read(reader, index, buffer)) {
+        pino = pino_unserialize_adopt(buffer, (size_t)reader->entries[index].size, free);
+    }
+
+    if (!pino) {
+        pfree(buffer);
+    }
+
+    return pino;
+}
+
+extern void pino_container_reader_rewind(pino_container_reader_t *reader)
+{
+    if (!reader) {
+        return;
+    }
+
+    reader->cursor = 0;
+    reader->readahead = 0;
+}
+
+extern const void *pino_container_reader_next(pino_container_reader_t *reader, size_t *size)
+{
+    const container_entry_t *next;
+    const void *view;
+    size_t offset;
+
+    if (!reader || !reader->map.addr || reader->cursor >= reader->count) {
+        return NULL;
+    }
+
+    if (reader->cursor == 0 && reader->readahead == 0) {
+        pmap_advise_sequential(&reader->map);
+    }
+
+    /* ask the kernel for the next window before the cursor gets there */
+    offset = (size_t)reader->entries[reader->cursor].offset;
+    if (offset > reader->readahead) {
+        reader->readahead = offset;
+    }
+    if (offset + CONTAINER_READAHEAD / 2 >= reader->readahead) {
+        pmap_advise_willneed(&reader->map, reader->readahead, CONTAINER_READAHEAD);
+        reader->readahead += CONTAINER_READAHEAD;
+    }
+
+    view = pino_container_reader_view(reader, reader->cursor, size);
+    if (!view) {
+        return NULL;
+    }
+
+    ++reader->cursor;
+
+    /* the size prefix and pino header of the following record */
+    if (reader->cursor < reader->count) {
+        next = &reader->entries[reader->cursor];
+        pprefetch(((const uint8_t *)reader->map.addr) + next->offset);
+    }
+
+    return view;
+}
+
+extern void pino_container_reader_close(pino_container_reader_t *reader)
+{
+    if (!reader) {
+        return;
+    }
+
+    if (reader->fp) {
+        fclose(reader->fp);
+    }
+
+    pmap_close(&reader->map);
+
+    if (reader->entries) {
+        pfree(reader->entries);
+    }
+
+    pfree(reader);
+}
+
+static void async_reader_done(void *arg, void *user, bool result)
+{
+    async_poll_t *poll = (async_poll_t *)arg;
+    async_read_t *read = (async_read_t *)user;
+    pino_t *pino;
+
+    read->reader->inflight--;
+
+    /* the read buffer becomes the payload backing store */
+    pino = result ? pino_unserialize_adopt(read->buffer, read->size, free) : NULL;
+    if (!pino) {
+        pfree(read->buffer);
+    }
+
+    if (poll && poll->fn) {
+        poll->fn(poll->arg, read->index, pino);
+    } else if (pino) {
+        pino_destroy(pino);
+    }
+
+    pfree(read);
+}
+
+extern pino_async_reader_t *pino_async_reader_open(const char *path, pino_async_backend_t backend, size_t depth)
+{
+    pino_async_reader_t *reader;
+
+    if (!path) {
+        return NULL;
+    }
+
+    reader = (pino_async_reader_t *)pcalloc(1, sizeof(pino_async_reader_t));
+    if (!reader) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    reader->container = pino_container_reader_open(path);
+    if (!reader->container) {
+        pfree(reader);
+        return NULL;
+    }
+
+    reader->fd = pfd_open(path, false);
+    reader->aio = reader->fd != PFD_INVALID ? paio_create(reader->fd, depth == 0 ? AIO_DEPTH : depth, backend) : NULL;
+    if (!reader->aio) {
+        if (reader->fd != PFD_INVALID) {
+            pfd_close(reader->fd);
+        }
+        pino_container_reader_close(reader->container);
+        pfree(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+extern pino_async_backend_t pino_async_reader_backend(const pino_async_reader_t *reader)
+{
+    return reader ? paio_backend(reader->aio) : PINO_ASYNC_AUTO;
+}
+
+extern size_t pino_async_reader_count(const pino_async_reader_t *reader)
+{
+    return reader ? reader->container->count : 0;
+}
+
+extern bool pino_async_reader_submit(pino_async_reader_t *reader, size_t index)
+{
+    const container_entry_t *entry;
+    async_read_t *read;
+
+    if (!reader || index >= reader->container->count) {
+        return false;
+    }
+
+    entry = &reader->container->entries[index];
+
+    read = (async_read_t *)pmalloc(sizeof(async_read_t));
+    if (!read) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    read->reader = reader;
+    read->index = index;
+    read->size = (size_t)entry->size;
+    read->buffer = pmalloc(read->size);
+    if (!read->buffer) {
+        /* LCOV_EXCL_START */
+        pfree(read);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    /* the index already bounds every record by its neighbours, the size prefix is skipped */
+    if (!paio_read(reader->aio, read->buffer, read->size, entry->offset + PINO_CONTAINER_RECORD_SIZE, -1, read)) {
+        pfree(read->buffer);
+        pfree(read);
+        return false;
+    }
+
+    reader->inflight++;
+
+    return true;
+}
+
+extern size_t pino_async_reader_poll(pino_async_reader_t *reader, bool wait, pino_async_read_fn_t fn, void *arg)
+{
+    async_poll_t poll;
+
+    if (!reader) {
+        return 0;
+    }
+
+    poll.fn = fn;
+    poll.arg = arg;
+
+    return paio_reap(reader->aio, wait, async_reader_done, &poll);
+}
+
+extern size_t pino_async_reader_inflight(const pino_async_reader_t *reader)
+{
+    return reader ? reader->inflight : 0;
+}
+
+extern void pino_async_reader_close(pino_async_reader_t *reader)
+{
+    if (!reader) {
+        return;
+    }
+
+    paio_destroy(reader->aio, async_reader_done, NULL);
+    pfd_close(reader->fd);
+    pino_container_reader_close(reader->container);
+    pfree(reader);
+}
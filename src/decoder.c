@@ -0,0 +1,629 @@
+/*
+ * libpino - decoder.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/decoder.h>
+
+#include <pino_internal.h>
+
+/* payloads up to this size are always handed to the handler in one piece */
+#define DECODER_CHUNK_MIN   8
+
+typedef enum {
+    DECODER_STATE_HEADER = 0,
+    DECODER_STATE_PADDING,
+    DECODER_STATE_STATIC_FIELDS,
+    DECODER_STATE_PAYLOAD,
+    DECODER_STATE_CHECKSUM,
+    DECODER_STATE_DONE,
+    DECODER_STATE_ERROR
+} decoder_state_t;
+
+struct _pino_decoder_t {
+    decoder_state_t state;
+    uint8_t header[PINO_COMPACT_HEADER_MAX];   /* either layout, classic ones are shorter */
+    uint8_t trailer[PINO_CHECKSUM_SIZE];
+    size_t usage;
+    pino_magic_safe_t magic;
+    pino_static_fields_size_t static_fields_size;
+    bool checked;   /* PINO_SERIALIZE_CRC32C, crc runs over everything fed so far */
+    uint32_t crc;
+    bool compressed;    /* PINO_SERIALIZE_COMPRESS, payload_size grows to the whole block once its header is in */
+    bool big_endian;    /* PINO_SERIALIZE_NATIVE, the payload is in big endian order */
+    bool compact;       /* PINO_SERIALIZE_COMPACT, the header carries the payload size */
+    size_t record_payload_size;
+    size_t alignment;   /* PINO_SERIALIZE_ALIGN*, padding runs up to the static fields and the payload */
+    size_t padding;
+    decoder_state_t resume;
+    bool block_sized;
+    pino_handler_t *handler;
+    uint8_t *static_fields;
+    bool has_payload_size;
+    bool streaming;
+    size_t payload_size;
+    pino_t *pino;
+    uint8_t *buffer;
+    size_t buffer_capacity;
+};
+
+static inline pino_decoder_status_t decoder_fail(pino_decoder_t *decoder)
+{
+    if (decoder->pino) {
+        pino_destroy(decoder->pino);
+        decoder->pino = NULL;
+    }
+
+    decoder->state = DECODER_STATE_ERROR;
+
+    return PINO_DECODER_ERROR;
+}
+
+static inline bool decoder_reserve(pino_decoder_t *decoder, size_t size)
+{
+    uint8_t *buffer;
+    size_t capacity;
+
+    if (size <= decoder->buffer_capacity) {
+        return true;
+    }
+
+    capacity = decoder->buffer_capacity > 0 ? decoder->buffer_capacity : DECODER_STEP;
+    while (capacity < size) {
+        if (capacity > SIZE_MAX / 2) {
+            capacity = size;
+            break;
+        }
+        capacity *= 2;
+    }
+
+    buffer = (uint8_t *)prealloc(decoder->buffer, capacity);
+    if (!buffer) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    decoder->buffer = buffer;
+    decoder->buffer_capacity = capacity;
+
+    PINO_SUPRTF("glowed capacity: %zu", decoder->buffer_capacity);
+
+    return true;
+}
+
+/* header bytes needed so far, compact ones grow byte by byte through their varints; 0 when malformed */
+static inline size_t decoder_header_need(const pino_decoder_t *decoder)
+{
+    size_t offset, ends;
+
+    if (decoder->usage == 0) {
+        return 1;
+    }
+
+    if (!(decoder->header[0] & PINO_COMPACT_MARKER)) {
+        return PINO_HEADER_SIZE;
+    }
+
+    switch (decoder->header[0] & 0x3) {
+        case PINO_COMPACT_MAGIC_FULL:
+            offset = 1 + sizeof(pino_magic_t);
+            break;
+        case PINO_COMPACT_MAGIC_ALIAS8:
+        case PINO_COMPACT_MAGIC_ALIAS16:
+            offset = 1 + (size_t)(decoder->header[0] & 0x3);
+            break;
+        default:
+            return 0;
+    }
+
+    /* both sizes are complete once two bytes without the continuation bit are in */
+    for (ends = 0; offset < decoder->usage; ) {
+        if (!(decoder->header[offset++] & 0x80) && ++ends == 2) {
+            return offset;
+        }
+    }
+
+    offset = offset > decoder->usage ? offset : decoder->usage + 1;
+
+    return offset <= PINO_COMPACT_HEADER_MAX ? offset : 0;
+}
+
+static inline bool decoder_header(pino_decoder_t *decoder)
+{
+    pino_header_t header;
+    uint8_t *static_fields;
+    uint32_t flags;
+
+    decoder->compact = (decoder->header[0] & PINO_COMPACT_MARKER) != 0;
+    if (decoder->compact) {
+        if (pino_compact_header(decoder->header, decoder->usage, &header) != decoder->usage) {
+            return false;
+        }
+
+        pmemcpy(decoder->magic, header.magic, sizeof(pino_magic_safe_t));
+        decoder->static_fields_size = header.static_fields_size;
+        decoder->record_payload_size = header.payload_size;
+        flags = header.flags;
+    } else {
+        pmemcpy(decoder->magic, decoder->header, sizeof(pino_magic_t));
+        decoder->magic[sizeof(pino_magic_t)] = '\0';
+        pmemcpy_l2n(&decoder->static_fields_size, decoder->header + sizeof(pino_magic_t), sizeof(pino_static_fields_size_t));
+
+        flags = (uint32_t)(decoder->static_fields_size >> PINO_FLAGS_SHIFT);
+        decoder->static_fields_size &= (((pino_static_fields_size_t)1) << PINO_FLAGS_SHIFT) - 1;
+        if (flags & ~PINO_FLAGS_WIRE) {
+            PINO_SUPRTF("unknown flags: %u", (unsigned)flags);
+            return false;
+        }
+    }
+
+    decoder->alignment = flags_alignment(flags);
+    decoder->checked = (flags & PINO_SERIALIZE_CRC32C) != 0;
+    decoder->compressed = (flags & PINO_SERIALIZE_COMPRESS) != 0;
+    decoder->big_endian = (flags & PINO_SERIALIZE_NATIVE) != 0;
+    decoder->crc = decoder->checked ? pino_crc32c_update(0, decoder->header, decoder->usage) : 0;
+
+    decoder->handler = pino_handler_find(decoder->magic);
+    if (!decoder->handler) {
+        return false;
+    }
+
+    if (decoder->static_fields_size != decoder->handler->static_fields_size) {
+        PINO_SUPRTF("static_fields_size mismatch: %zu", (size_t)decoder->static_fields_size);
+        return false;
+    }
+
+    if (decoder->static_fields_size > 0) {
+        static_fields = (uint8_t *)prealloc(decoder->static_fields, (size_t)decoder->static_fields_size);
+        if (!static_fields) {
+            return false; /* LCOV_EXCL_LINE */
+        }
+        decoder->static_fields = static_fields;
+    }
+
+    return true;
+}
+
+static inline void decoder_pad(pino_decoder_t *decoder, size_t padding, decoder_state_t resume)
+{
+    decoder->usage = 0;
+    decoder->padding = padding;
+    decoder->resume = resume;
+    decoder->state = DECODER_STATE_PADDING;
+}
+
+static inline bool decoder_begin_payload(pino_decoder_t *decoder)
+{
+    if (decoder->compressed) {
+        /* buffered whole and unpacked in decoder_complete() */
+        decoder->has_payload_size = true;
+        decoder->streaming = false;
+        decoder->block_sized = false;
+        decoder->payload_size = PINO_COMPRESS_HEADER_SIZE;
+
+        return decoder_reserve(decoder, decoder->payload_size);
+    }
+
+    if (!decoder->compact && !decoder->handler->payload_size) {
+        /* length is implied by the end of the stream, see pino_decoder_finish() */
+        decoder->has_payload_size = false;
+        decoder->streaming = false;
+
+        return true;
+    }
+
+    /* the size only frames the record, a wrong one is caught by the trailer */
+    decoder->has_payload_size = true;
+    decoder->payload_size = decoder->compact ? decoder->record_payload_size : pino_handler_payload_size(decoder->handler, decoder->static_fields);
+
+    /* unverified static fields and payload bytes only reach the handler once the trailer matched, see decoder_complete() */
+    if (decoder->checked && !decoder->handler->checksum_fused) {
+        decoder->streaming = false;
+
+        return decoder_reserve(decoder, decoder->payload_size);
+    }
+
+    decoder->streaming = decoder->handler->unserialize_chunk && decoder->payload_size > DECODER_CHUNK_MIN;
+
+    decoder->pino = pino_create(decoder->magic, decoder->handler, decoder->payload_size);
+    if (!decoder->pino) {
+        return false;
+    }
+
+    /* always LE */
+    pino_static_fields_from_wire(decoder->handler, decoder->pino->static_fields, decoder->static_fields);
+
+    if (!decoder->streaming && !decoder_reserve(decoder, decoder->payload_size)) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    return true;
+}
+
+static inline bool decoder_block(pino_decoder_t *decoder)
+{
+    uint64_t packed_size;
+
+    pmemcpy_l2n(&packed_size, decoder->buffer + sizeof(uint64_t), sizeof(uint64_t));
+    if (packed_size > (uint64_t)(SIZE_MAX - PINO_COMPRESS_HEADER_SIZE - PINO_CHECKSUM_SIZE)) {
+        return false;
+    }
+
+    decoder->payload_size = PINO_COMPRESS_HEADER_SIZE + (size_t)packed_size;
+    decoder->block_sized = true;
+
+    return decoder_reserve(decoder, decoder->payload_size);
+}
+
+static inline bool decoder_checksum(pino_decoder_t *decoder, const uint8_t *trailer)
+{
+    uint32_t crc;
+
+    pmemcpy_l2n(&crc, trailer, sizeof(uint32_t));
+    if (decoder->crc != crc) {
+        PINO_SUPRTF("checksum mismatch");
+        return false;
+    }
+
+    return true;
+}
+
+static inline bool decoder_chunk(pino_decoder_t *decoder, const uint8_t *src, size_t size)
+{
+    bool saved, result;
+
+    saved = pino_payload_big_endian(decoder->big_endian);
+    result = decoder->handler->unserialize_chunk(decoder->pino->this, decoder->pino->static_fields, src, size, decoder->usage);
+    pino_payload_big_endian(saved);
+
+    return result;
+}
+
+static inline bool decoder_complete(pino_decoder_t *decoder)
+{
+    pino_header_t header;
+    bool saved, result;
+
+    if (decoder->streaming) {
+        return true;
+    }
+
+    if (decoder->compressed) {
+        pmemcpy(header.magic, decoder->magic, sizeof(pino_magic_safe_t));
+        header.static_fields_size = decoder->static_fields_size;
+        header.static_fields = decoder->static_fields;
+        header.payload = decoder->buffer;
+        header.payload_size = decoder->usage;
+        /* the checksum already is checked */
+        header.flags = PINO_SERIALIZE_COMPRESS | (decoder->big_endian ? PINO_SERIALIZE_NATIVE : 0);
+
+        decoder->pino = pino_record_unserialize(&header, decoder->handler);
+
+        return decoder->pino != NULL;
+    }
+
+    if (!decoder->pino) {
+        decoder->pino = pino_create(decoder->magic, decoder->handler, decoder->usage);
+        if (!decoder->pino) {
+            return false;
+        }
+
+        /* always LE */
+        pino_static_fields_from_wire(decoder->handler, decoder->pino->static_fields, decoder->static_fields);
+    }
+
+    saved = pino_payload_big_endian(decoder->big_endian);
+    result = decoder->handler->unserialize(
+        decoder->pino->this, decoder->pino->static_fields,
+        decoder->buffer ? (const void *)decoder->buffer : (const void *)decoder->header, decoder->usage
+    );
+    pino_payload_big_endian(saved);
+
+    return result;
+}
+
+extern pino_decoder_t *pino_decoder_create(void)
+{
+    pino_decoder_t *decoder;
+
+    decoder = (pino_decoder_t *)pcalloc(1, sizeof(pino_decoder_t));
+    if (!decoder) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    decoder->state = DECODER_STATE_HEADER;
+
+    return decoder;
+}
+
+extern pino_decoder_status_t pino_decoder_feed(pino_decoder_t *decoder, const void *src, size_t size, size_t *consumed)
+{
+    const uint8_t *p;
+    size_t n, need, remaining;
+
+    if (consumed) {
+        *consumed = 0;
+    }
+
+    if (!decoder || (!src && size > 0)) {
+        return PINO_DECODER_ERROR;
+    }
+
+    p = (const uint8_t *)src;
+    remaining = size;
+
+    while (true) {
+        switch (decoder->state) {
+            case DECODER_STATE_HEADER:
+                need = decoder_header_need(decoder);
+                if (need == 0) {
+                    return decoder_fail(decoder);
+                }
+
+                if (decoder->usage < need) {
+                    n = need - decoder->usage;
+                    n = n < remaining ? n : remaining;
+                    if (n > 0) {
+                        pmemcpy(decoder->header + decoder->usage, p, n);
+                    }
+                    decoder->usage += n;
+                    p += n;
+                    remaining -= n;
+
+                    if (decoder->usage < need) {
+                        break;
+                    }
+                    continue;
+                }
+
+                if (!decoder_header(decoder)) {
+                    return decoder_fail(decoder);
+                }
+
+                decoder_pad(decoder, align_up(decoder->usage, decoder->alignment) - decoder->usage, DECODER_STATE_STATIC_FIELDS);
+                continue;
+            case DECODER_STATE_PADDING:
+                n = decoder->padding < remaining ? decoder->padding : remaining;
+                if (decoder->checked) {
+                    decoder->crc = pino_crc32c_update(decoder->crc, p, n);
+                }
+                decoder->padding -= n;
+                p += n;
+                remaining -= n;
+
+                if (decoder->padding > 0) {
+                    break;
+                }
+
+                decoder->state = decoder->resume;
+                continue;
+            case DECODER_STATE_STATIC_FIELDS:
+                n = (size_t)decoder->static_fields_size - decoder->usage;
+                n = n < remaining ? n : remaining;
+                if (n > 0) {
+                    pmemcpy(decoder->static_fields + decoder->usage, p, n);
+                }
+                decoder->usage += n;
+                p += n;
+                remaining -= n;
+
+                if (decoder->usage < (size_t)decoder->static_fields_size) {
+                    break;
+                }
+
+                if (decoder->checked) {
+                    decoder->crc = pino_crc32c_update(decoder->crc, decoder->static_fields, (size_t)decoder->static_fields_size);
+                }
+
+                if (!decoder_begin_payload(decoder)) {
+                    return decoder_fail(decoder);
+                }
+
+                /* the static fields start aligned, so their size alone decides the padding */
+                decoder_pad(decoder, align_up((size_t)decoder->static_fields_size, decoder->alignment) - (size_t)decoder->static_fields_size, DECODER_STATE_PAYLOAD);
+                continue;
+            case DECODER_STATE_PAYLOAD:
+                if (!decoder->has_payload_size) {
+                    if (!decoder_reserve(decoder, decoder->usage + remaining)) {
+                        return decoder_fail(decoder); /* LCOV_EXCL_LINE */
+                    }
+                    if (remaining > 0) {
+                        pmemcpy(decoder->buffer + decoder->usage, p, remaining);
+                    }
+                    decoder->usage += remaining;
+                    p += remaining;
+                    remaining = 0;
+                    break;
+                }
+
+                n = decoder->payload_size - decoder->usage;
+                n = n < remaining ? n : remaining;
+                if (decoder->checked) {
+                    decoder->crc = pino_crc32c_update(decoder->crc, p, n);
+                }
+                if (decoder->streaming) {
+                    if (n > 0 && !decoder_chunk(decoder, p, n)) {
+                        return decoder_fail(decoder);
+                    }
+                } else if (n > 0) {
+                    pmemcpy(decoder->buffer + decoder->usage, p, n);
+                }
+                decoder->usage += n;
+                p += n;
+                remaining -= n;
+
+                if (decoder->usage < decoder->payload_size) {
+                    break;
+                }
+
+                if (decoder->compressed && !decoder->block_sized) {
+                    if (!decoder_block(decoder)) {
+                        return decoder_fail(decoder);
+                    }
+                    continue;
+                }
+
+                if (decoder->checked) {
+                    decoder->state = DECODER_STATE_CHECKSUM;
+                    continue;
+                }
+
+                if (!decoder_complete(decoder)) {
+                    return decoder_fail(decoder);
+                }
+
+                decoder->state = DECODER_STATE_DONE;
+                continue;
+            case DECODER_STATE_CHECKSUM:
+                /* collected behind the payload so streamed chunks need no extra buffer */
+                n = decoder->payload_size + PINO_CHECKSUM_SIZE - decoder->usage;
+                n = n < remaining ? n : remaining;
+                if (n > 0) {
+                    pmemcpy(decoder->trailer + (decoder->usage - decoder->payload_size), p, n);
+                }
+                decoder->usage += n;
+                p += n;
+                remaining -= n;
+
+                if (decoder->usage < decoder->payload_size + PINO_CHECKSUM_SIZE) {
+                    break;
+                }
+
+                decoder->usage = decoder->payload_size;
+                if (!decoder_checksum(decoder, decoder->trailer) || !decoder_complete(decoder)) {
+                    return decoder_fail(decoder);
+                }
+
+                decoder->state = DECODER_STATE_DONE;
+                continue;
+            case DECODER_STATE_DONE:
+                if (consumed) {
+                    *consumed = size - remaining;
+                }
+                return PINO_DECODER_DONE;
+            case DECODER_STATE_ERROR:
+            /* LCOV_EXCL_START */
+            default:
+                return PINO_DECODER_ERROR;
+            /* LCOV_EXCL_STOP */
+        }
+
+        break;
+    }
+
+    if (consumed) {
+        *consumed = size - remaining;
+    }
+
+    return PINO_DECODER_NEED_MORE;
+}
+
+extern pino_decoder_status_t pino_decoder_finish(pino_decoder_t *decoder)
+{
+    if (!decoder) {
+        return PINO_DECODER_ERROR;
+    }
+
+    if (decoder->state == DECODER_STATE_DONE) {
+        return PINO_DECODER_DONE;
+    }
+
+    if (decoder->state != DECODER_STATE_PAYLOAD || decoder->has_payload_size) {
+        PINO_SUPRTF("truncated record");
+        return decoder_fail(decoder);
+    }
+
+    /* without payload_size the trailer is the last bytes of the stream */
+    if (decoder->checked) {
+        if (decoder->usage < PINO_CHECKSUM_SIZE) {
+            return decoder_fail(decoder);
+        }
+
+        decoder->usage -= PINO_CHECKSUM_SIZE;
+        decoder->crc = pino_crc32c_update(decoder->crc, decoder->buffer, decoder->usage);
+        if (!decoder_checksum(decoder, decoder->buffer + decoder->usage)) {
+            return decoder_fail(decoder);
+        }
+    }
+
+    if (!decoder_complete(decoder)) {
+        return decoder_fail(decoder);
+    }
+
+    decoder->state = DECODER_STATE_DONE;
+
+    return PINO_DECODER_DONE;
+}
+
+extern const pino_handler_t *pino_decoder_handler(const pino_decoder_t *decoder)
+{
+    if (!decoder || decoder->state == DECODER_STATE_HEADER || decoder->state == DECODER_STATE_ERROR) {
+        return NULL;
+    }
+
+    return decoder->handler;
+}
+
+extern pino_t *pino_decoder_take(pino_decoder_t *decoder)
+{
+    pino_t *pino;
+
+    if (!decoder || decoder->state != DECODER_STATE_DONE) {
+        return NULL;
+    }
+
+    pino = decoder->pino;
+    decoder->pino = NULL;
+    pino_decoder_reset(decoder);
+
+    return pino;
+}
+
+extern void pino_decoder_reset(pino_decoder_t *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+
+    if (decoder->pino) {
+        pino_destroy(decoder->pino);
+        decoder->pino = NULL;
+    }
+
+    decoder->state = DECODER_STATE_HEADER;
+    decoder->usage = 0;
+    decoder->handler = NULL;
+    decoder->static_fields_size = 0;
+    decoder->checked = false;
+    decoder->crc = 0;
+    decoder->compressed = false;
+    decoder->big_endian = false;
+    decoder->compact = false;
+    decoder->record_payload_size = 0;
+    decoder->alignment = 1;
+    decoder->padding = 0;
+    decoder->block_sized = false;
+    decoder->has_payload_size = false;
+    decoder->streaming = false;
+    decoder->payload_size = 0;
+}
+
+extern void pino_decoder_destroy(pino_decoder_t *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+
+    pino_decoder_reset(decoder);
+
+    if (decoder->static_fields) {
+        pfree(decoder->static_fields);
+    }
+
+    if (decoder->buffer) {
+        pfree(decoder->buffer);
+    }
+
+    pfree(decoder);
+}
@@ -0,0 +1,450 @@
+/*
+ * libpino - delta.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include <pino_internal.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define DELTA_SSE2         1
+#else
+# define DELTA_SSE2         0
+#endif
+
+/*
+ * magic | mode (u8) | base checksum (u32 LE) | static field ranges | payload
+ *   DELTA_MODE_RANGES:  payload size (LEB128) | payload ranges
+ *   DELTA_MODE_HANDLER: handler->delta size (LEB128) | handler->delta output
+ * ranges are { skip (LEB128) | length (LEB128) | bytes }, closed by a zero skip and length.
+ * The base checksum covers the static fields, plus the serialized payload in DELTA_MODE_RANGES.
+ */
+#define DELTA_MODE_RANGES   0
+#define DELTA_MODE_HANDLER  1
+#define DELTA_HEADER_SIZE   (sizeof(pino_magic_t) + sizeof(uint8_t) + sizeof(uint32_t))
+#define DELTA_BLOCK         64
+
+typedef struct {
+    uint8_t *dest;      /* NULL only counts */
+    size_t size;
+    size_t capacity;
+    bool overflow;
+} delta_writer_t;
+
+static inline void delta_put(delta_writer_t *writer, const void *src, size_t size)
+{
+    if (writer->dest) {
+        if (writer->overflow || size > writer->capacity - writer->size) {
+            writer->overflow = true;
+        } else {
+            pmemcpy(writer->dest + writer->size, src, size);
+        }
+    }
+
+    writer->size += size;
+}
+
+static inline void delta_put_leb128(delta_writer_t *writer, uint64_t value)
+{
+    uint8_t buffer[LEB128_MAX];
+
+    delta_put(writer, buffer, leb128_write(buffer, value));
+}
+
+static inline void delta_put_header(delta_writer_t *writer, const pino_t *pino, uint8_t mode, uint32_t crc)
+{
+    uint8_t header[DELTA_HEADER_SIZE];
+
+    pmemcpy(header, pino->magic, sizeof(pino_magic_t));
+    header[sizeof(pino_magic_t)] = mode;
+    pmemcpy_n2l(header + sizeof(pino_magic_t) + sizeof(uint8_t), &crc, sizeof(uint32_t));
+
+    delta_put(writer, header, sizeof(header));
+}
+
+/* first differing offset in [pos, size) or size */
+static inline size_t delta_equal_run(const uint8_t *a, const uint8_t *b, size_t pos, size_t size)
+{
+#if DELTA_SSE2
+    __m128i eq;
+
+    while (size - pos >= DELTA_BLOCK) {
+        eq = _mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + pos)), _mm_loadu_si128((const __m128i *)(b + pos))),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + pos + 16)), _mm_loadu_si128((const __m128i *)(b + pos + 16)))
+            ),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + pos + 32)), _mm_loadu_si128((const __m128i *)(b + pos + 32))),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + pos + 48)), _mm_loadu_si128((const __m128i *)(b + pos + 48)))
+            )
+        );
+        if (_mm_movemask_epi8(eq) != 0xFFFF) {
+            break;
+        }
+        pos += DELTA_BLOCK;
+    }
+#else
+    while (size - pos >= DELTA_BLOCK && pmemcmp(a + pos, b + pos, DELTA_BLOCK) == 0) {
+        pos += DELTA_BLOCK;
+    }
+#endif
+
+    while (pos < size && a[pos] == b[pos]) {
+        pos++;
+    }
+
+    return pos;
+}
+
+/* end of the changed run starting at pos, equal gaps shorter than DELTA_GAP_MIN are cheaper to resend */
+static inline size_t delta_changed_run(const uint8_t *a, const uint8_t *b, size_t pos, size_t size)
+{
+    size_t equal;
+
+    while (pos < size) {
+        while (pos < size && a[pos] != b[pos]) {
+            pos++;
+        }
+
+        equal = delta_equal_run(a, b, pos, size);
+        if (equal - pos >= DELTA_GAP_MIN || equal == size) {
+            break;
+        }
+        pos = equal;
+    }
+
+    return pos;
+}
+
+static inline void delta_put_ranges(delta_writer_t *writer, const uint8_t *base, size_t base_size, const uint8_t *current, size_t size)
+{
+    size_t common, last, begin, end;
+
+    common = base_size < size ? base_size : size;
+    last = 0;
+    begin = delta_equal_run(base, current, 0, common);
+    while (begin < common) {
+        end = delta_changed_run(base, current, begin, common);
+        if (end == common) {
+            /* runs straight into the grown tail */
+            end = size;
+        }
+
+        delta_put_leb128(writer, begin - last);
+        delta_put_leb128(writer, end - begin);
+        delta_put(writer, current + begin, end - begin);
+
+        last = end;
+        begin = end < common ? delta_equal_run(base, current, end, common) : common;
+    }
+
+    if (size > common && last <= common) {
+        delta_put_leb128(writer, common - last);
+        delta_put_leb128(writer, size - common);
+        delta_put(writer, current + common, size - common);
+    }
+
+    delta_put_leb128(writer, 0);
+    delta_put_leb128(writer, 0);
+}
+
+static inline bool delta_apply_ranges(uint8_t *image, size_t size, const uint8_t **src, const uint8_t *end)
+{
+    uint64_t skip, length;
+    size_t pos, n;
+
+    pos = 0;
+    while (true) {
+        n = leb128_read(*src, (size_t)(end - *src), &skip);
+        if (n == 0) {
+            return false;
+        }
+        *src += n;
+
+        n = leb128_read(*src, (size_t)(end - *src), &length);
+        if (n == 0) {
+            return false;
+        }
+        *src += n;
+
+        if (length == 0) {
+            return skip == 0;
+        }
+
+        if (skip > size - pos || length > size - pos - skip || length > (uint64_t)(end - *src)) {
+            PINO_SUPRTF("delta range out of bounds");
+            return false;
+        }
+
+        pos += (size_t)skip;
+        pmemcpy(image + pos, *src, (size_t)length);
+        pos += (size_t)length;
+        *src += length;
+    }
+}
+
+/* static fields are diffed and checked in their wire form, the base image first and room for a second one */
+static inline uint8_t *delta_wire_fields(const pino_t *pino)
+{
+    uint8_t *fields;
+    size_t size = (size_t)pino->static_fields_size;
+
+    fields = (uint8_t *)pmalloc(size > 0 ? size * 2 : 1);
+    if (!fields) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    pino_static_fields_to_wire(pino->handler, fields, pino->static_fields);
+
+    return fields;
+}
+
+static inline size_t delta_serialize_handler(delta_writer_t *writer, const pino_t *base, const pino_t *current, const uint8_t *fields)
+{
+    pino_handler_t *handler = current->handler;
+    size_t size;
+
+    size = handler->delta(base->this, base->static_fields, current->this, current->static_fields, NULL, 0);
+    if (size == 0) {
+        return 0;
+    }
+
+    delta_put_header(writer, current, DELTA_MODE_HANDLER, pino_crc32c_update(0, fields, (size_t)base->static_fields_size));
+    delta_put_ranges(writer, fields, (size_t)base->static_fields_size, fields + base->static_fields_size, (size_t)current->static_fields_size);
+    delta_put_leb128(writer, (uint64_t)size);
+
+    if (writer->dest) {
+        if (writer->overflow || size > writer->capacity - writer->size) {
+            return 0;
+        }
+
+        if (handler->delta(base->this, base->static_fields, current->this, current->static_fields, writer->dest + writer->size, size) != size) {
+            PINO_SUPRTF("handler->delta failed");
+            return 0;
+        }
+    }
+    writer->size += size;
+
+    return writer->size;
+}
+
+static inline size_t delta_serialize_ranges(delta_writer_t *writer, const pino_t *base, const pino_t *current, const uint8_t *fields)
+{
+    uint8_t *buffer;
+    size_t base_size, size;
+    uint32_t crc;
+
+    base_size = base->handler->serialize_size(base->this, base->static_fields);
+    size = current->handler->serialize_size(current->this, current->static_fields);
+    if (base_size > SIZE_MAX - size) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    buffer = (uint8_t *)pmalloc(base_size + size > 0 ? base_size + size : 1);
+    if (!buffer) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    if (!base->handler->serialize(base->this, base->static_fields, buffer) ||
+        !current->handler->serialize(current->this, current->static_fields, buffer + base_size)
+    ) {
+        PINO_SUPRTF("handler->serialize failed");
+        pfree(buffer);
+        return 0;
+    }
+
+    crc = pino_crc32c_update(pino_crc32c_update(0, fields, (size_t)base->static_fields_size), buffer, base_size);
+
+    delta_put_header(writer, current, DELTA_MODE_RANGES, crc);
+    delta_put_ranges(writer, fields, (size_t)base->static_fields_size, fields + base->static_fields_size, (size_t)current->static_fields_size);
+    delta_put_leb128(writer, (uint64_t)size);
+    delta_put_ranges(writer, buffer, base_size, buffer + base_size, size);
+
+    pfree(buffer);
+
+    return writer->overflow ? 0 : writer->size;
+}
+
+extern size_t pino_serialize_delta(const pino_t *base, const pino_t *current, void *dest, size_t capacity)
+{
+    delta_writer_t writer;
+    uint8_t *fields;
+    size_t size;
+
+    if (!base || !current || base->handler != current->handler || !magic_equal((char *)base->magic, (char *)current->magic)) {
+        return 0;
+    }
+
+    if (!pino_ensure_payload(base) || !pino_ensure_payload(current)) {
+        return 0;
+    }
+
+    writer.dest = (uint8_t *)dest;
+    writer.size = 0;
+    writer.capacity = dest ? capacity : 0;
+    writer.overflow = false;
+
+    fields = delta_wire_fields(base);
+    if (!fields) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+    pino_static_fields_to_wire(current->handler, fields + base->static_fields_size, current->static_fields);
+
+    size = 0;
+    if (current->handler->delta) {
+        size = delta_serialize_handler(&writer, base, current, fields);
+    }
+
+    if (size == 0 && writer.size == 0) {
+        size = delta_serialize_ranges(&writer, base, current, fields);
+    }
+
+    pfree(fields);
+
+    return size;
+}
+
+static inline pino_t *delta_apply_handler(pino_t *base, const uint8_t *fields, const uint8_t *src, const uint8_t *end)
+{
+    pino_t *pino;
+    uint64_t size;
+    size_t n;
+
+    n = leb128_read(src, (size_t)(end - src), &size);
+    if (n == 0 || size != (uint64_t)(end - src - n) || !base->handler->apply_delta) {
+        return NULL;
+    }
+    src += n;
+
+    pino = pino_clone(base);
+    if (!pino) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    if (!pino_touch(pino)) {
+        pino_destroy(pino); /* LCOV_EXCL_LINE */
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    pino_static_fields_from_wire(pino->handler, pino->static_fields, fields);
+    if (!pino->handler->apply_delta(base->static_fields, pino->this, pino->static_fields, src, (size_t)(end - src))) {
+        PINO_SUPRTF("handler->apply_delta failed");
+        pino_destroy(pino);
+        return NULL;
+    }
+
+    return pino;
+}
+
+static inline pino_t *delta_apply_ranges_payload(pino_t *base, const uint8_t *base_fields, const uint8_t *fields, const uint8_t *src, const uint8_t *end, uint32_t crc)
+{
+    pino_header_t header;
+    uint8_t *buffer;
+    uint64_t size;
+    size_t base_size, n;
+
+    n = leb128_read(src, (size_t)(end - src), &size);
+    if (n == 0) {
+        return NULL;
+    }
+    src += n;
+
+    /* bytes past the base payload can only come from the delta itself */
+    base_size = base->handler->serialize_size(base->this, base->static_fields);
+    if (size > base_size && size - base_size > (uint64_t)(end - src)) {
+        return NULL;
+    }
+
+    buffer = (uint8_t *)pmalloc((size_t)(size > base_size ? size : base_size) + 1);
+    if (!buffer) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    if (!base->handler->serialize(base->this, base->static_fields, buffer)) {
+        PINO_SUPRTF("handler->serialize failed");
+        pfree(buffer);
+        return NULL;
+    }
+
+    if (pino_crc32c_update(pino_crc32c_update(0, base_fields, (size_t)base->static_fields_size), buffer, base_size) != crc) {
+        PINO_SUPRTF("delta base mismatch");
+        pfree(buffer);
+        return NULL;
+    }
+
+    if (size > base_size) {
+        memset(buffer + base_size, 0, (size_t)size - base_size);
+    }
+
+    if (!delta_apply_ranges(buffer, (size_t)size, &src, end) || src != end) {
+        pfree(buffer);
+        return NULL;
+    }
+
+    pmemcpy(header.magic, base->magic, sizeof(pino_magic_safe_t));
+    header.static_fields_size = base->static_fields_size;
+    header.static_fields = fields;
+    header.payload = buffer;
+    header.payload_size = (size_t)size;
+    header.flags = 0;
+
+    return pino_record_unserialize_owned(&header, base->handler, buffer, true);
+}
+
+extern pino_t *pino_apply_delta(pino_t *base, const void *delta, size_t size)
+{
+    const uint8_t *src, *end;
+    uint8_t *fields;
+    pino_t *pino;
+    uint32_t crc;
+    uint8_t mode;
+
+    if (!base || !delta || size < DELTA_HEADER_SIZE || !pino_ensure_payload(base)) {
+        return NULL;
+    }
+
+    src = (const uint8_t *)delta;
+    end = src + size;
+    if (!magic_equal((char *)src, base->magic)) {
+        PINO_SUPRTF("delta magic mismatch");
+        return NULL;
+    }
+    mode = src[sizeof(pino_magic_t)];
+    pmemcpy_l2n(&crc, src + sizeof(pino_magic_t) + sizeof(uint8_t), sizeof(uint32_t));
+    src += DELTA_HEADER_SIZE;
+
+    if (mode != DELTA_MODE_RANGES && mode != DELTA_MODE_HANDLER) {
+        return NULL;
+    }
+
+    fields = delta_wire_fields(base);
+    if (!fields) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    /* always LE */
+    pmemcpy(fields + base->static_fields_size, fields, (size_t)base->static_fields_size);
+    if (!delta_apply_ranges(fields + base->static_fields_size, (size_t)base->static_fields_size, &src, end)) {
+        pfree(fields);
+        return NULL;
+    }
+
+    pino = NULL;
+    if (mode == DELTA_MODE_HANDLER) {
+        if (pino_crc32c_update(0, fields, (size_t)base->static_fields_size) == crc) {
+            pino = delta_apply_handler(base, fields + base->static_fields_size, src, end);
+        } else {
+            PINO_SUPRTF("delta base mismatch");
+        }
+    } else {
+        pino = delta_apply_ranges_payload(base, fields, fields + base->static_fields_size, src, end, crc);
+    }
+
+    pfree(fields);
+
+    return pino;
+}
@@ -4,9 +4,17 @@
  */
 
 #include <pino/endianness.h>
+#include <pino/pool.h>
 
 #include <pino_internal.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define STREAMING_AVAILABLE    1
+#else
+# define STREAMING_AVAILABLE    0
+#endif
+
 #define ENDIANNESS_UNKNOWN      0
 #define ENDIANNESS_LITTLE       1
 #define ENDIANNESS_BIG          2
@@ -19,6 +27,22 @@ static uint8_t g_endianness = ENDIANNESS_BIG;
 static uint8_t g_endianness = ENDIANNESS_UNKNOWN;
 #endif
 
+typedef struct {
+    uint8_t *dest;
+    const uint8_t *src;
+    size_t size;
+    size_t elem_size;
+    size_t chunk;
+    bool is_native;
+    bool streaming;
+} parallel_ctx_t;
+
+static pino_pool_t *g_parallel_pool = NULL;
+static size_t g_parallel_threshold = PARALLEL_THRESHOLD;
+
+static bool g_streaming_enabled = STREAMING_AVAILABLE;
+static size_t g_streaming_threshold = STREAMING_THRESHOLD;
+
 static inline uint8_t platform_endianness(void)
 {
     uint32_t i;
@@ -117,6 +141,130 @@ static inline void *bswap_memcpy(void *dest, const void *src, size_t size, size_
     return dest;
 }
 
+#if STREAMING_AVAILABLE
+static inline __m128i stream_bswap(__m128i v, size_t elem_size)
+{
+    /* swap the bytes of every 16bit lane, then reorder the lanes */
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+    if (elem_size == 4) {
+        v = _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    } else if (elem_size == 8) {
+        v = _mm_shufflelo_epi16(_mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    return v;
+}
+
+static inline bool stream_memcpy(uint8_t *dest, const uint8_t *src, size_t size, size_t elem_size, bool is_native)
+{
+    __m128i v0, v1, v2, v3;
+    size_t head, i;
+
+    is_native = is_native || elem_size == 1;
+    if (!is_native && elem_size != 2 && elem_size != 4 && elem_size != 8) {
+        return false;
+    }
+
+    /* non-temporal stores need an aligned destination, reached only on element boundaries */
+    head = (16 - ((uintptr_t)dest & 0xF)) & 0xF;
+    if (head > size || (!is_native && head % elem_size != 0)) {
+        return false;
+    }
+
+    if (is_native) {
+        pmemcpy(dest, src, head);
+    } else {
+        bswap_memcpy(dest, src, head, elem_size);
+    }
+    dest += head;
+    src += head;
+    size -= head;
+
+    for (i = 0; i + 64 <= size; i += 64) {
+        v0 = _mm_loadu_si128((const __m128i *)(src + i));
+        v1 = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        v2 = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        v3 = _mm_loadu_si128((const __m128i *)(src + i + 48));
+
+        if (!is_native) {
+            v0 = stream_bswap(v0, elem_size);
+            v1 = stream_bswap(v1, elem_size);
+            v2 = stream_bswap(v2, elem_size);
+            v3 = stream_bswap(v3, elem_size);
+        }
+
+        _mm_stream_si128((__m128i *)(dest + i), v0);
+        _mm_stream_si128((__m128i *)(dest + i + 16), v1);
+        _mm_stream_si128((__m128i *)(dest + i + 32), v2);
+        _mm_stream_si128((__m128i *)(dest + i + 48), v3);
+    }
+
+    /* streamed stores are weakly ordered, publish them before anyone else reads dest */
+    _mm_sfence();
+
+    if (is_native) {
+        pmemcpy(dest + i, src + i, size - i);
+    } else {
+        bswap_memcpy(dest + i, src + i, size - i, elem_size);
+    }
+
+    return true;
+}
+#endif
+
+static inline void *copy_range(void *dest, const void *src, size_t size, size_t elem_size, bool is_native, bool streaming)
+{
+#if STREAMING_AVAILABLE
+    if (streaming && stream_memcpy((uint8_t *)dest, (const uint8_t *)src, size, elem_size, is_native)) {
+        return dest;
+    }
+#endif
+
+    return is_native ? pmemcpy(dest, src, size) : bswap_memcpy(dest, src, size, elem_size);
+}
+
+static void parallel_fn(void *arg, size_t begin, size_t end)
+{
+    parallel_ctx_t *ctx = (parallel_ctx_t *)arg;
+    size_t i, offset, size;
+
+    for (i = begin; i < end; i++) {
+        offset = i * ctx->chunk;
+        size = ctx->size - offset < ctx->chunk ? ctx->size - offset : ctx->chunk;
+
+        copy_range(ctx->dest + offset, ctx->src + offset, size, ctx->elem_size, ctx->is_native, ctx->streaming);
+    }
+}
+
+static inline void *copy_common(void *dest, const void *src, size_t size, size_t elem_size, bool is_native)
+{
+    parallel_ctx_t ctx;
+    pino_pool_t *pool;
+    bool streaming;
+
+    streaming = g_streaming_enabled && size >= g_streaming_threshold;
+
+    pool = g_parallel_pool;
+    if (!pool || size < g_parallel_threshold || pino_pool_workers(pool) <= 1) {
+        return copy_range(dest, src, size, elem_size, is_native, streaming);
+    }
+
+    /* chunks never split an element */
+    ctx.dest = (uint8_t *)dest;
+    ctx.src = (const uint8_t *)src;
+    ctx.size = size;
+    ctx.elem_size = elem_size;
+    ctx.chunk = PARALLEL_CHUNK - PARALLEL_CHUNK % elem_size;
+    ctx.chunk = ctx.chunk > 0 ? ctx.chunk : elem_size;
+    ctx.is_native = is_native;
+    ctx.streaming = streaming;
+
+    pino_pool_parallel_for(pool, (size + ctx.chunk - 1) / ctx.chunk, 1, parallel_fn, &ctx);
+
+    return dest;
+}
+
 static inline size_t elem_sizeof(size_t size)
 {
     if (size == 1 || size == 2 || size == 4 || size == 8) {
@@ -126,14 +274,19 @@ static inline size_t elem_sizeof(size_t size)
     return 1;
 }
 
-static inline void *conv_memcpy(void *dest, const void *src, size_t size)
+static inline void *memcpy_common(void *dest, const void *src, size_t size, bool is_native)
 {
-    return bswap_memcpy(dest, src, size, elem_sizeof(size));
+    return copy_common(dest, src, size, elem_sizeof(size), is_native);
 }
 
-static inline void *memcpy_common(void *dest, const void *src, size_t size, bool is_native)
+static inline void *memcpy_array_common(void *dest, const void *src, size_t count, size_t elem_size, bool is_native)
 {
-    return is_native ? pmemcpy(dest, src, size) : conv_memcpy(dest, src, size);
+    if (elem_size == 0 || count > SIZE_MAX / elem_size) {
+        PINO_SUPRTF("invalid elem_size: %zu, count: %zu", elem_size, count);
+        return NULL;
+    }
+
+    return copy_common(dest, src, count * elem_size, elem_size, is_native);
 }
 
 static inline void *memmove_common(void *dest, const void *src, size_t size, bool is_native)
@@ -269,3 +422,47 @@ extern int pino_endianness_memcmp_native2be(const void *s1, const void *s2, size
 {
     return memcmp_common(s1, s2, size, (platform_endianness() == ENDIANNESS_BIG));
 }
+
+extern void *pino_endianness_memcpy_array_le2native(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    return memcpy_array_common(dest, src, count, elem_size, (platform_endianness() == ENDIANNESS_LITTLE));
+}
+
+extern void *pino_endianness_memcpy_array_be2native(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    return memcpy_array_common(dest, src, count, elem_size, (platform_endianness() == ENDIANNESS_BIG));
+}
+
+extern void *pino_endianness_memcpy_array_native2le(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    return memcpy_array_common(dest, src, count, elem_size, (platform_endianness() == ENDIANNESS_LITTLE));
+}
+
+extern void *pino_endianness_memcpy_array_native2be(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    return memcpy_array_common(dest, src, count, elem_size, (platform_endianness() == ENDIANNESS_BIG));
+}
+
+extern bool pino_endianness_le2native_noop(size_t size)
+{
+    return platform_endianness() == ENDIANNESS_LITTLE || elem_sizeof(size) == 1;
+}
+
+extern bool pino_endianness_be2native_noop(size_t size)
+{
+    return platform_endianness() == ENDIANNESS_BIG || elem_sizeof(size) == 1;
+}
+
+extern void pino_endianness_parallel(struct _pino_pool_t *pool, size_t threshold)
+{
+    g_parallel_pool = pool;
+    g_parallel_threshold = threshold > 0 ? threshold : PARALLEL_THRESHOLD;
+}
+
+extern bool pino_endianness_streaming(bool enabled, size_t threshold)
+{
+    g_streaming_enabled = enabled && STREAMING_AVAILABLE;
+    g_streaming_threshold = threshold > 0 ? threshold : STREAMING_THRESHOLD;
+
+    return g_streaming_enabled == enabled;
+}
@@ -0,0 +1,242 @@
+/*
+ * libpino - fields.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/fields.h>
+#include <pino/handler.h>
+
+#include <pino_internal.h>
+
+static inline bool field_size_valid(size_t size)
+{
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+static inline uint32_t *field_count(const pino_field_t *op, const void *object)
+{
+    return (uint32_t *)(((uint8_t *)object) + op->count_offset);
+}
+
+static inline void **field_vector(const pino_field_t *op, const void *object)
+{
+    return (void **)(((uint8_t *)object) + op->offset);
+}
+
+extern bool pino_fields_compile(pino_fields_t *fields)
+{
+    const pino_field_t *desc;
+    pino_field_t *op;
+    size_t count, i;
+
+    desc = fields->describe(&count);
+    fields->op_count = 0;
+
+    for (i = 0; i < count; i++) {
+        if (!field_size_valid(desc[i].size)) {
+            PINO_SUPRTF("invalid field size: %zu", desc[i].size);
+            return false;
+        }
+
+        /* neighbours of the same width without padding in between become one bulk conversion */
+        op = fields->op_count > 0 ? &fields->ops[fields->op_count - 1] : NULL;
+        if (op && op->count > 0 && desc[i].count > 0 && op->size == desc[i].size &&
+            op->offset + op->size * op->count == desc[i].offset
+        ) {
+            op->count += desc[i].count;
+            continue;
+        }
+
+        fields->ops[fields->op_count++] = desc[i];
+    }
+
+    return true;
+}
+
+/* wire copies follow the record byte order, native ones (pack / unpack) are plain */
+static inline void fields_copy_out(void *dest, const void *src, size_t count, size_t elem_size, bool wire)
+{
+    if (wire) {
+        pino_handler_serialize_memcpy_array(dest, src, count, elem_size);
+    } else {
+        pmemcpy(dest, src, count * elem_size);
+    }
+}
+
+static inline void fields_copy_in(void *dest, const void *src, size_t count, size_t elem_size, bool wire)
+{
+    if (wire) {
+        pino_handler_unserialize_memcpy_array(dest, src, count, elem_size);
+    } else {
+        pmemcpy(dest, src, count * elem_size);
+    }
+}
+
+static inline void fields_write(const pino_fields_t *fields, const void *object, uint8_t *dest, bool wire)
+{
+    const pino_field_t *op, *end;
+    uint32_t count;
+
+    for (op = fields->ops, end = fields->ops + fields->op_count; op < end; op++) {
+        if (op->count > 0) {
+            fields_copy_out(dest, ((const uint8_t *)object) + op->offset, op->count, op->size, wire);
+            dest += op->size * op->count;
+            continue;
+        }
+
+        count = *field_count(op, object);
+        fields_copy_out(dest, &count, 1, sizeof(uint32_t), wire);
+        dest += sizeof(uint32_t);
+        if (count > 0) {
+            fields_copy_out(dest, *field_vector(op, object), count, op->size, wire);
+            dest += op->size * count;
+        }
+    }
+}
+
+static inline bool fields_read(const pino_fields_t *fields, void *object, const uint8_t *src, size_t size, bool wire)
+{
+    const pino_field_t *op, *end;
+    void **vector;
+    uint32_t *count;
+    size_t n;
+
+    for (op = fields->ops, end = fields->ops + fields->op_count; op < end; op++) {
+        if (op->count > 0) {
+            n = op->size * op->count;
+            if (n > size) {
+                return false;
+            }
+
+            fields_copy_in(((uint8_t *)object) + op->offset, src, op->count, op->size, wire);
+            src += n;
+            size -= n;
+            continue;
+        }
+
+        count = field_count(op, object);
+        if (sizeof(uint32_t) > size) {
+            return false;
+        }
+        fields_copy_in(count, src, 1, sizeof(uint32_t), wire);
+        src += sizeof(uint32_t);
+        size -= sizeof(uint32_t);
+
+        if ((size_t)*count > size / op->size) {
+            *count = 0;
+            return false;
+        }
+        n = op->size * (size_t)*count;
+
+        vector = field_vector(op, object);
+        if (*vector) {
+            pfree(*vector);
+            *vector = NULL;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        *vector = pmalloc(n);
+        if (!*vector) {
+            /* LCOV_EXCL_START */
+            *count = 0;
+            return false;
+            /* LCOV_EXCL_STOP */
+        }
+
+        fields_copy_in(*vector, src, (size_t)*count, op->size, wire);
+        src += n;
+        size -= n;
+    }
+
+    return size == 0;
+}
+
+extern bool pino_fields_serialize(const pino_fields_t *fields, const void *object, void *dest)
+{
+    fields_write(fields, object, (uint8_t *)dest, true);
+
+    return true;
+}
+
+extern bool pino_fields_unserialize(const pino_fields_t *fields, void *object, const void *src, size_t size)
+{
+    return fields_read(fields, object, (const uint8_t *)src, size, true);
+}
+
+extern bool pino_fields_pack(const pino_fields_t *fields, void *object, const void *src, size_t size)
+{
+    return fields_read(fields, object, (const uint8_t *)src, size, false);
+}
+
+extern bool pino_fields_unpack(const pino_fields_t *fields, const void *object, void *dest)
+{
+    fields_write(fields, object, (uint8_t *)dest, false);
+
+    return true;
+}
+
+extern void pino_fields_destroy(const pino_fields_t *fields, void *object)
+{
+    const pino_field_t *op, *end;
+    void **vector;
+
+    for (op = fields->ops, end = fields->ops + fields->op_count; op < end; op++) {
+        vector = field_vector(op, object);
+        if (op->count == 0 && *vector) {
+            pfree(*vector);
+            *vector = NULL;
+        }
+    }
+}
+
+extern bool pino_fields_resize(pino_t *pino, size_t offset, size_t count)
+{
+    const pino_field_t *op, *end;
+    pino_fields_t *fields;
+    uint8_t *vector;
+    uint32_t *current, size;
+    size_t payload_size;
+
+    if (!pino || !pino->handler->fields || count > UINT32_MAX || !pino_touch(pino)) {
+        return false;
+    }
+
+    fields = pino->handler->fields;
+    for (op = fields->ops, end = fields->ops + fields->op_count; op < end; op++) {
+        if (op->count == 0 && op->offset == offset) {
+            break;
+        }
+    }
+
+    if (op == end || count > SIZE_MAX / op->size) {
+        return false;
+    }
+
+    current = field_count(op, pino->this);
+
+    /* sized up front so that a rejected resize leaves the pino as it was */
+    payload_size = pino->handler->serialize_size(pino->this, pino->static_fields) - (size_t)*current * op->size;
+    if (payload_size > UINT32_MAX || count * op->size > UINT32_MAX - payload_size) {
+        return false;
+    }
+    payload_size += count * op->size;
+
+    vector = (uint8_t *)prealloc(*field_vector(op, pino->this), count > 0 ? count * op->size : 1);
+    if (!vector) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+    if (count > (size_t)*current) {
+        memset(vector + (size_t)*current * op->size, 0, (count - (size_t)*current) * op->size);
+    }
+    *field_vector(op, pino->this) = vector;
+    *current = (uint32_t)count;
+
+    /* the static fields carry the payload size for readers */
+    size = (uint32_t)payload_size;
+    pmemcpy_n2l(pino->static_fields, &size, sizeof(uint32_t));
+
+    return true;
+}
@@ -90,6 +90,27 @@ extern void pino_handler_free(void)
     g_handlers.initialized = false;
 }
 
+/* packed wire size of an aligned static fields layout, 0 when a member does not fit the struct */
+static inline size_t layout_wire_size(const pino_handler_t *handler)
+{
+    const pino_static_field_t *field;
+    size_t i, size = 0;
+
+    for (i = 0; i < handler->static_fields_layout_count; i++) {
+        field = &handler->static_fields_layout[i];
+        if ((field->size != 1 && field->size != 2 && field->size != 4 && field->size != 8) ||
+            field->offset > handler->static_fields_memory_size ||
+            field->count > (handler->static_fields_memory_size - field->offset) / field->size
+        ) {
+            return 0;
+        }
+
+        size += field->size * field->count;
+    }
+
+    return size;
+}
+
 extern bool pino_handler_register(pino_magic_safe_t magic, pino_handler_t *handler)
 {
     handler_entry_t *entry;
@@ -110,6 +131,24 @@ extern bool pino_handler_register(pino_magic_safe_t magic, pino_handler_t *handl
         return false;
     }
 
+    /* an adopted payload is used in place, these are its only bounds checks */
+    if (handler->adopt && !handler->validate && !handler->payload_size) {
+        PINO_SUPRTF("adopt needs validate or payload_size");
+        return false;
+    }
+
+    if (handler->fields && !pino_fields_compile(handler->fields)) {
+        return false;
+    }
+
+    if (handler->static_fields_layout) {
+        handler->static_fields_size = (pino_static_fields_size_t)layout_wire_size(handler);
+        if (handler->static_fields_size == 0) {
+            PINO_SUPRTF("static_fields_layout is invalid");
+            return false;
+        }
+    }
+
     if (g_handlers.usage >= g_handlers.capacity) {
         if (!glow_handlers(g_handlers.capacity + HANDLER_STEP)) {
             return false; /* LCOV_EXCL_LINE */
@@ -130,6 +169,7 @@ extern bool pino_handler_register(pino_magic_safe_t magic, pino_handler_t *handl
     }
 
     pmemcpy(entry->magic, magic, sizeof(pino_magic_t));
+    entry->alias = 0;
     entry->handler = handler;
     handler->entry = entry;
 
@@ -201,3 +241,186 @@ extern pino_handler_t *pino_handler_find(pino_magic_safe_t magic)
     return NULL;
     /* LCOV_EXCL_STOP */
 }
+
+extern bool pino_handler_alias(pino_magic_safe_t magic, uint16_t alias)
+{
+    handler_entry_t *entry = NULL;
+    size_t i;
+
+    if (!g_handlers.initialized || !validate_magic(magic)) {
+        return false;
+    }
+
+    for (i = 0; i < g_handlers.capacity; i++) {
+        if (!g_handlers.entries[i]) {
+            continue;
+        }
+
+        if (magic_equal(g_handlers.entries[i]->magic, magic)) {
+            entry = g_handlers.entries[i];
+        } else if (alias != 0 && g_handlers.entries[i]->alias == alias) {
+            PINO_SUPRTF("alias: %u already used by magic: %.4s", (unsigned)alias, g_handlers.entries[i]->magic);
+            return false;
+        }
+    }
+
+    if (!entry) {
+        PINO_SUPRTF("magic: %.4s not found", magic);
+        return false;
+    }
+
+    entry->alias = alias;
+
+    return true;
+}
+
+extern bool pino_handler_find_alias(uint16_t alias, pino_magic_safe_t magic)
+{
+    size_t i;
+
+    if (!g_handlers.initialized || alias == 0) {
+        return false;
+    }
+
+    for (i = 0; i < g_handlers.capacity; i++) {
+        if (g_handlers.entries[i] && g_handlers.entries[i]->alias == alias) {
+            pmemcpy(magic, g_handlers.entries[i]->magic, sizeof(pino_magic_t));
+            magic[sizeof(pino_magic_t)] = '\0';
+            return true;
+        }
+    }
+
+    PINO_SUPRTF("alias: %u not found", (unsigned)alias);
+
+    return false;
+}
+
+extern size_t pino_static_fields_wire_offset(const pino_static_field_t *layout, size_t count, size_t offset, size_t size)
+{
+    size_t i, wire_offset = 0;
+
+    if (!layout) {
+        return SIZE_MAX;
+    }
+
+    /* arrays of wider elements are swapped one element at a time on the wire */
+    for (i = 0; i < count; i++) {
+        if (layout[i].offset == offset) {
+            return (layout[i].size * layout[i].count == size && (layout[i].count == 1 || layout[i].size == 1)) ? wire_offset : SIZE_MAX;
+        }
+
+        wire_offset += layout[i].size * layout[i].count;
+    }
+
+    return SIZE_MAX;
+}
+
+extern void pino_static_fields_to_wire(const pino_handler_t *handler, void *dest, const void *src)
+{
+    const pino_static_field_t *field;
+    uint8_t *d = (uint8_t *)dest;
+    size_t i, j;
+
+    if (!handler->static_fields_layout) {
+        pmemcpy(dest, src, (size_t)handler->static_fields_size);
+        return;
+    }
+
+    for (i = 0; i < handler->static_fields_layout_count; i++) {
+        field = &handler->static_fields_layout[i];
+        for (j = 0; j < field->count; j++) {
+            pmemcpy_n2l(d, ((const uint8_t *)src) + field->offset + j * field->size, field->size);
+            d += field->size;
+        }
+    }
+}
+
+extern void pino_static_fields_from_wire(const pino_handler_t *handler, void *dest, const void *src)
+{
+    const pino_static_field_t *field;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t i, j;
+
+    if (!handler->static_fields_layout) {
+        pmemcpy(dest, src, (size_t)handler->static_fields_size);
+        return;
+    }
+
+    /* padding stays zero so clones and caches compare equal */
+    memset(dest, 0, handler->static_fields_memory_size);
+    for (i = 0; i < handler->static_fields_layout_count; i++) {
+        field = &handler->static_fields_layout[i];
+        for (j = 0; j < field->count; j++) {
+            pmemcpy_l2n(((uint8_t *)dest) + field->offset + j * field->size, s, field->size);
+            s += field->size;
+        }
+    }
+}
+
+/* payload_size() and validate() run on records before there is a pino, aligned handlers still get their own layout */
+#define STATIC_FIELDS_LOCAL_SIZE 16
+
+static inline void *static_fields_unpacked(const pino_handler_t *handler, const void *src, uint64_t *local)
+{
+    void *fields = local;
+
+    if (handler->static_fields_memory_size > sizeof(uint64_t) * STATIC_FIELDS_LOCAL_SIZE) {
+        fields = pmalloc(handler->static_fields_memory_size);
+        if (!fields) {
+            return NULL; /* LCOV_EXCL_LINE */
+        }
+    }
+
+    pino_static_fields_from_wire(handler, fields, src);
+
+    return fields;
+}
+
+static inline void static_fields_unpacked_free(void *fields, uint64_t *local)
+{
+    if (fields != local) {
+        pfree(fields);
+    }
+}
+
+extern size_t pino_handler_payload_size(const pino_handler_t *handler, const void *static_fields)
+{
+    uint64_t local[STATIC_FIELDS_LOCAL_SIZE];
+    void *fields;
+    size_t size;
+
+    if (!handler->static_fields_layout) {
+        return handler->payload_size(static_fields);
+    }
+
+    fields = static_fields_unpacked(handler, static_fields, local);
+    if (!fields) {
+        return SIZE_MAX; /* LCOV_EXCL_LINE */
+    }
+
+    size = handler->payload_size(fields);
+    static_fields_unpacked_free(fields, local);
+
+    return size;
+}
+
+extern bool pino_handler_validate(const pino_handler_t *handler, const void *static_fields, const void *src, size_t size)
+{
+    uint64_t local[STATIC_FIELDS_LOCAL_SIZE];
+    void *fields;
+    bool result;
+
+    if (!handler->static_fields_layout) {
+        return handler->validate(static_fields, src, size);
+    }
+
+    fields = static_fields_unpacked(handler, static_fields, local);
+    if (!fields) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    result = handler->validate(fields, src, size);
+    static_fields_unpacked_free(fields, local);
+
+    return result;
+}
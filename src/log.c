@@ -0,0 +1,460 @@
+/*
+ * libpino - log.c
+ * 
+ */
+
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+# define _FILE_OFFSET_BITS 64
+#endif
+
+#include <pino.h>
+#include <pino/log.h>
+
+#include <pino_internal.h>
+#include <pino_file.h>
+#include <pino_aio.h>
+
+struct _pino_log_t {
+    pfd_t fd;
+    paio_t *aio;        /* NULL writes and syncs on the committing thread */
+    uint64_t offset;
+    pmutex_t lock;
+    pcond_t done;
+    uint8_t *buffer;    /* frames waiting for the next commit */
+    size_t usage;
+    size_t capacity;
+    uint8_t *spare;     /* written by the committer while the lock is released */
+    size_t spare_capacity;
+    uint64_t appended;
+    uint64_t durable;
+    uint64_t recovered;
+    size_t group_bytes;
+    uint32_t group_delay_us;
+    bool committing;
+    bool failed;
+};
+
+static inline uint32_t frame_crc(const uint8_t *frame, const void *record, size_t size)
+{
+    return pino_crc32c_update(pino_crc32c_update(0, frame, sizeof(uint64_t)), record, size);
+}
+
+static inline void encode_frame(uint8_t *frame, const void *record, size_t size)
+{
+    uint64_t size64;
+    uint32_t crc;
+
+    size64 = (uint64_t)size;
+    memset(frame, 0, PINO_LOG_FRAME_SIZE);
+    pmemcpy_n2l(frame, &size64, sizeof(uint64_t));
+    crc = frame_crc(frame, record, size);
+    pmemcpy_n2l(frame + sizeof(uint64_t), &crc, sizeof(uint32_t));
+}
+
+static void log_write_done(void *arg, void *user, bool result)
+{
+    (void)user;
+
+    *(bool *)arg = result;
+}
+
+/* only the committer gets here, so at most one write is in flight */
+static inline bool log_write(pino_log_t *log, const uint8_t *buffer, size_t usage)
+{
+    bool result;
+
+    if (usage == 0) {
+        return pfd_sync(log->fd);
+    }
+
+    if (!log->aio || !paio_write_sync(log->aio, buffer, usage, log->offset, NULL)) {
+        return pfd_pwrite(log->fd, buffer, usage, log->offset) && pfd_sync(log->fd);
+    }
+
+    result = false;
+    if (paio_reap(log->aio, true, log_write_done, &result) == 0) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    return result;
+}
+
+/* lock held on entry and on return */
+static inline void log_commit(pino_log_t *log)
+{
+    uint8_t *buffer;
+    size_t usage, capacity;
+    uint64_t target;
+    bool result;
+
+    log->committing = true;
+
+    /* let concurrent appenders join this commit */
+    if (log->group_delay_us > 0) {
+        pmutex_unlock(&log->lock);
+        pthrd_sleep_us(log->group_delay_us);
+        pmutex_lock(&log->lock);
+    }
+
+    buffer = log->buffer;
+    usage = log->usage;
+    capacity = log->capacity;
+    target = log->appended;
+
+    log->buffer = log->spare;
+    log->capacity = log->spare_capacity;
+    log->usage = 0;
+    log->spare = buffer;
+    log->spare_capacity = capacity;
+
+    pmutex_unlock(&log->lock);
+    result = log_write(log, buffer, usage);
+    pmutex_lock(&log->lock);
+
+    if (result) {
+        log->offset += usage;
+        log->durable = target;
+    } else {
+        PINO_SUPRTF("commit failed");
+        log->failed = true;
+    }
+
+    log->committing = false;
+    pcond_broadcast(&log->done);
+}
+
+/* lock held on entry and on return */
+static inline bool log_wait(pino_log_t *log, uint64_t seq)
+{
+    while (log->durable < seq && !log->failed) {
+        if (!log->committing) {
+            log_commit(log);
+        } else {
+            pcond_wait(&log->done, &log->lock);
+        }
+    }
+
+    return log->durable >= seq;
+}
+
+static inline bool log_reserve(pino_log_t *log, size_t size)
+{
+    uint8_t *buffer;
+    size_t capacity;
+
+    if (log->capacity - log->usage >= size) {
+        return true;
+    }
+
+    if (size > SIZE_MAX / 2 - log->usage) {
+        return false;
+    }
+
+    capacity = (log->usage + size) * 2;
+    buffer = (uint8_t *)prealloc(log->buffer, capacity);
+    if (!buffer) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    log->buffer = buffer;
+    log->capacity = capacity;
+
+    return true;
+}
+
+static inline bool log_scan(const char *path, pino_log_scan_fn_t fn, void *arg, uint64_t *count, uint64_t *end, bool *empty)
+{
+    uint8_t header[PINO_LOG_HEADER_SIZE], frame[PINO_LOG_FRAME_SIZE], *record;
+    uint64_t size, offset;
+    uint32_t crc, version;
+    size_t capacity;
+    int64_t file_size;
+    FILE *fp;
+    bool torn;
+
+    *count = 0;
+    *end = 0;
+    *empty = false;
+
+    fp = fopen(path, "rb");
+    if (!fp) {
+        *empty = true;
+        return true;
+    }
+
+    if (pfseek(fp, 0, SEEK_END) != 0 || (file_size = pftell(fp)) < 0 || pfseek(fp, 0, SEEK_SET) != 0) {
+        /* LCOV_EXCL_START */
+        fclose(fp);
+        return false;
+        /* LCOV_EXCL_STOP */
+    }
+
+    /* a header that never made it to disk */
+    if ((uint64_t)file_size < PINO_LOG_HEADER_SIZE) {
+        fclose(fp);
+        *empty = true;
+        return file_size == 0 || pfile_truncate(path, 0);
+    }
+
+    if (!pfread(fp, header, sizeof(header)) || memcmp(header, PINO_LOG_MAGIC, sizeof(pino_magic_t)) != 0) {
+        PINO_SUPRTF("invalid log header");
+        fclose(fp);
+        return false;
+    }
+
+    pmemcpy_l2n(&version, header + sizeof(pino_magic_t), sizeof(uint32_t));
+    if (version != PINO_LOG_VERSION) {
+        PINO_SUPRTF("unsupported log version: %u", version);
+        fclose(fp);
+        return false;
+    }
+
+    record = NULL;
+    capacity = 0;
+    offset = PINO_LOG_HEADER_SIZE;
+    torn = false;
+
+    while (offset < (uint64_t)file_size) {
+        if ((uint64_t)file_size - offset < PINO_LOG_FRAME_SIZE || !pfread(fp, frame, sizeof(frame))) {
+            torn = true;
+            break;
+        }
+
+        pmemcpy_l2n(&size, frame, sizeof(uint64_t));
+        pmemcpy_l2n(&crc, frame + sizeof(uint64_t), sizeof(uint32_t));
+        if (size > (uint64_t)file_size - offset - PINO_LOG_FRAME_SIZE || size > SIZE_MAX) {
+            torn = true;
+            break;
+        }
+
+        if ((size_t)size > capacity) {
+            capacity = (size_t)size > LOG_SCAN_STEP ? (size_t)size : LOG_SCAN_STEP;
+            pfree(record);
+            record = (uint8_t *)pmalloc(capacity);
+            if (!record) {
+                /* LCOV_EXCL_START */
+                fclose(fp);
+                return false;
+                /* LCOV_EXCL_STOP */
+            }
+        }
+
+        if (!pfread(fp, record, (size_t)size) || frame_crc(frame, record, (size_t)size) != crc) {
+            torn = true;
+            break;
+        }
+
+        offset += PINO_LOG_FRAME_SIZE + size;
+        ++*count;
+
+        if (fn && !fn(arg, record, (size_t)size)) {
+            break;
+        }
+    }
+
+    pfree(record);
+    fclose(fp);
+
+    *end = offset;
+
+    if (torn) {
+        PINO_SUPRTF("torn tail at offset: %llu", (unsigned long long)offset);
+        return pfile_truncate(path, offset);
+    }
+
+    return true;
+}
+
+extern bool pino_log_recover(const char *path, pino_log_scan_fn_t fn, void *arg, uint64_t *count)
+{
+    uint64_t recovered, end;
+    bool empty;
+
+    if (!path) {
+        return false;
+    }
+
+    if (!log_scan(path, fn, arg, &recovered, &end, &empty)) {
+        return false;
+    }
+
+    if (count) {
+        *count = recovered;
+    }
+
+    return true;
+}
+
+extern pino_log_t *pino_log_open(const char *path, const pino_log_options_t *options)
+{
+    pino_log_t *log;
+    uint8_t header[PINO_LOG_HEADER_SIZE];
+    pino_async_backend_t backend;
+    uint32_t version;
+    bool empty;
+
+    if (!path) {
+        return NULL;
+    }
+
+    log = (pino_log_t *)pcalloc(1, sizeof(pino_log_t));
+    if (!log) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    if (!log_scan(path, NULL, NULL, &log->recovered, &log->offset, &empty)) {
+        pfree(log);
+        return NULL;
+    }
+
+    log->fd = pfd_open_append(path);
+    if (log->fd == PFD_INVALID) {
+        PINO_SUPRTF("open failed: %s", path);
+        pfree(log);
+        return NULL;
+    }
+
+    if (empty) {
+        version = PINO_LOG_VERSION;
+        memset(header, 0, sizeof(header));
+        pmemcpy(header, PINO_LOG_MAGIC, sizeof(pino_magic_t));
+        pmemcpy_n2l(header + sizeof(pino_magic_t), &version, sizeof(uint32_t));
+
+        if (!pfd_write(log->fd, header, sizeof(header)) || !pfd_sync(log->fd)) {
+            /* LCOV_EXCL_START */
+            pfd_close(log->fd);
+            pfree(log);
+            return NULL;
+            /* LCOV_EXCL_STOP */
+        }
+
+        log->offset = PINO_LOG_HEADER_SIZE;
+    }
+
+    /* one commit is in flight at a time, so a single slot is enough */
+    backend = options ? options->backend : PINO_ASYNC_AUTO;
+    log->aio = paio_create(log->fd, 1, backend);
+    if (!log->aio && backend == PINO_ASYNC_IO_URING) {
+        pfd_close(log->fd);
+        pfree(log);
+        return NULL;
+    }
+
+    log->group_bytes = options && options->group_bytes > 0 ? options->group_bytes : LOG_GROUP_BYTES;
+    log->group_delay_us = options ? options->group_delay_us : 0;
+
+    pmutex_init(&log->lock);
+    pcond_init(&log->done);
+
+    return log;
+}
+
+extern bool pino_log_append(pino_log_t *log, const pino_t *pino, bool durable)
+{
+    uint8_t *frame;
+    uint64_t seq;
+    size_t size;
+    bool result;
+
+    if (!log || !pino) {
+        return false;
+    }
+
+    size = pino_serialize_size(pino);
+    if (size == 0 || size > SIZE_MAX - PINO_LOG_FRAME_SIZE) {
+        return false;
+    }
+
+    /* serialized and checksummed outside of the lock */
+    frame = (uint8_t *)pmalloc(PINO_LOG_FRAME_SIZE + size);
+    if (!frame) {
+        return false; /* LCOV_EXCL_LINE */
+    }
+
+    if (!pino_serialize(pino, frame + PINO_LOG_FRAME_SIZE)) {
+        pfree(frame);
+        return false;
+    }
+
+    encode_frame(frame, frame + PINO_LOG_FRAME_SIZE, size);
+
+    pmutex_lock(&log->lock);
+
+    result = !log->failed && log_reserve(log, PINO_LOG_FRAME_SIZE + size);
+    if (result) {
+        pmemcpy(log->buffer + log->usage, frame, PINO_LOG_FRAME_SIZE + size);
+        log->usage += PINO_LOG_FRAME_SIZE + size;
+        seq = ++log->appended;
+
+        if (durable) {
+            result = log_wait(log, seq);
+        } else if (log->usage >= log->group_bytes && !log->committing) {
+            log_commit(log);
+            result = !log->failed;
+        }
+    }
+
+    pmutex_unlock(&log->lock);
+
+    pfree(frame);
+
+    return result;
+}
+
+extern bool pino_log_sync(pino_log_t *log)
+{
+    bool result;
+
+    if (!log) {
+        return false;
+    }
+
+    pmutex_lock(&log->lock);
+    result = log_wait(log, log->appended);
+    pmutex_unlock(&log->lock);
+
+    return result;
+}
+
+extern pino_async_backend_t pino_log_backend(const pino_log_t *log)
+{
+    if (!log) {
+        return PINO_ASYNC_AUTO;
+    }
+
+    /* without an aio context commits are written inline, like the thread backend without workers */
+    return log->aio ? paio_backend(log->aio) : PINO_ASYNC_THREADS;
+}
+
+extern uint64_t pino_log_count(const pino_log_t *log)
+{
+    return log ? log->recovered + log->appended : 0;
+}
+
+extern bool pino_log_close(pino_log_t *log)
+{
+    bool result;
+
+    if (!log) {
+        return false;
+    }
+
+    result = pino_log_sync(log);
+    paio_destroy(log->aio, NULL, NULL);
+    result = pfd_close(log->fd) && result;
+
+    pcond_destroy(&log->done);
+    pmutex_destroy(&log->lock);
+
+    if (log->buffer) {
+        pfree(log->buffer);
+    }
+
+    if (log->spare) {
+        pfree(log->spare);
+    }
+
+    pfree(log);
+
+    return result;
+}
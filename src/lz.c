@@ -0,0 +1,391 @@
+/*
+ * libpino - lz.c
+ * 
+ */
+
+#include <pino_internal.h>
+
+/*
+ * byte oriented LZ77 in the spirit of LZ4: every sequence is
+ *   token (literal length << 4 | match length - LZ_MIN_MATCH) | literal length extension | literals |
+ *   offset (u16 LE) | match length extension
+ * where a nibble of 15 continues in extension bytes that add up while they are 255.
+ * The last sequence carries literals only and ends the block.
+ */
+#define LZ_HASH_BITS        12
+#define LZ_MIN_MATCH        4
+#define LZ_LAST_LITERALS    5
+#define LZ_MATCH_LIMIT      12  /* no match starts in the last bytes, keeps the search loads in bounds */
+#define LZ_MAX_OFFSET       65535
+#define LZ_NIBBLE_MAX       15
+#define LZ_SKIP_TRIGGER     6   /* stride grows by one every 64 misses, incompressible data is skipped quickly */
+#define LZ_WILD_COPY        16  /* short runs are copied as one fixed block when both buffers have room past the run */
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define LZ_CTZ64(x)        __builtin_ctzll(x)
+#endif
+
+static inline uint32_t lz_load32(const uint8_t *src)
+{
+    uint32_t value;
+
+    pmemcpy(&value, src, sizeof(uint32_t));
+
+    return value;
+}
+
+static inline uint64_t lz_load64(const uint8_t *src)
+{
+    uint64_t value;
+
+    pmemcpy(&value, src, sizeof(uint64_t));
+
+    return value;
+}
+
+static inline void lz_copy16(uint8_t *dest, const uint8_t *src)
+{
+    pmemcpy(dest, src, 8);
+    pmemcpy(dest + 8, src + 8, 8);
+}
+
+static inline uint32_t lz_hash(uint32_t value)
+{
+    return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static inline size_t lz_count(const uint8_t *p, const uint8_t *match, const uint8_t *limit)
+{
+    const uint8_t *start = p;
+
+    uint64_t diff;
+
+    while ((size_t)(limit - p) >= sizeof(uint64_t)) {
+        diff = lz_load64(p) ^ lz_load64(match);
+        if (diff != 0) {
+#ifdef LZ_CTZ64
+            return (size_t)(p - start) + (size_t)(LZ_CTZ64(diff) / 8);
+#else
+            break;
+#endif
+        }
+        p += sizeof(uint64_t);
+        match += sizeof(uint64_t);
+    }
+
+    while (p < limit && *p == *match) {
+        p++;
+        match++;
+    }
+
+    return (size_t)(p - start);
+}
+
+static inline uint8_t *lz_put_length(uint8_t *op, size_t length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+
+    return op;
+}
+
+static inline bool lz_get_length(const uint8_t **ip, const uint8_t *iend, size_t *length)
+{
+    uint8_t byte;
+
+    do {
+        if (*ip >= iend || *length > SIZE_MAX - 255) {
+            return false;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/* NULL when the sequence does not fit */
+static inline uint8_t *lz_put_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *literals, const uint8_t *iend, size_t literal_size, size_t offset, size_t match_size)
+{
+    uint8_t *token;
+    size_t need;
+
+    need = 1 + literal_size + literal_size / 255 + 1;
+    if (match_size > 0) {
+        need += sizeof(uint16_t) + match_size / 255 + 1;
+    }
+    if ((size_t)(oend - op) < need) {
+        return NULL;
+    }
+
+    token = op++;
+    if (literal_size >= LZ_NIBBLE_MAX) {
+        *token = LZ_NIBBLE_MAX << 4;
+        op = lz_put_length(op, literal_size - LZ_NIBBLE_MAX);
+    } else {
+        *token = (uint8_t)(literal_size << 4);
+    }
+
+    if (literal_size <= LZ_WILD_COPY && (size_t)(oend - op) >= LZ_WILD_COPY && (size_t)(iend - literals) >= LZ_WILD_COPY) {
+        lz_copy16(op, literals);
+    } else {
+        pmemcpy(op, literals, literal_size);
+    }
+    op += literal_size;
+
+    if (match_size == 0) {
+        return op;
+    }
+
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+
+    match_size -= LZ_MIN_MATCH;
+    if (match_size >= LZ_NIBBLE_MAX) {
+        *token |= LZ_NIBBLE_MAX;
+        op = lz_put_length(op, match_size - LZ_NIBBLE_MAX);
+    } else {
+        *token |= (uint8_t)match_size;
+    }
+
+    return op;
+}
+
+static inline void lz_copy_match(uint8_t *op, const uint8_t *oend, size_t offset, size_t length)
+{
+    const uint8_t *match = op - offset;
+    size_t i, distance;
+
+    /* 8 byte steps never read bytes they have not written yet, overshooting is fine while there is room */
+    if ((size_t)(oend - op) >= length + sizeof(uint64_t)) {
+        distance = offset;
+        i = 0;
+        if (offset < sizeof(uint64_t)) {
+            /* short periods are seeded bytewise, then copied from a whole number of periods back */
+            for (; i < sizeof(uint64_t); i++) {
+                op[i] = match[i];
+            }
+            distance = offset * ((sizeof(uint64_t) + offset - 1) / offset);
+        }
+        for (; i < length; i += sizeof(uint64_t)) {
+            pmemcpy(op + i, op + i - distance, sizeof(uint64_t));
+        }
+        return;
+    }
+
+    /* overlapping matches repeat the last offset bytes, the period-aligned source doubles on every pass */
+    while (length > offset) {
+        pmemcpy(op, match, offset);
+        op += offset;
+        length -= offset;
+        offset *= 2;
+    }
+
+    pmemcpy(op, match, length);
+}
+
+extern size_t pino_lz_compress(void *dest, size_t capacity, const void *src, size_t size)
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    const uint8_t *base, *ip, *anchor, *iend, *mlimit, *match;
+    uint8_t *op, *oend;
+    size_t misses, length;
+    uint32_t h;
+
+    if (!dest || (!src && size > 0) || size > UINT32_MAX) {
+        return 0;
+    }
+
+    base = (const uint8_t *)src;
+    ip = anchor = base;
+    iend = base + size;
+    op = (uint8_t *)dest;
+    oend = op + capacity;
+
+    if (size > LZ_MATCH_LIMIT) {
+        memset(table, 0, sizeof(table));
+        mlimit = iend - LZ_MATCH_LIMIT;
+        misses = 0;
+
+        while (ip < mlimit) {
+            h = lz_hash(lz_load32(ip));
+            match = base + table[h];
+            table[h] = (uint32_t)(ip - base);
+
+            if (match >= ip || (size_t)(ip - match) > LZ_MAX_OFFSET || lz_load32(match) != lz_load32(ip)) {
+                ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+
+            length = LZ_MIN_MATCH + lz_count(ip + LZ_MIN_MATCH, match + LZ_MIN_MATCH, iend - LZ_LAST_LITERALS);
+            op = lz_put_sequence(op, oend, anchor, iend, (size_t)(ip - anchor), (size_t)(ip - match), length);
+            if (!op) {
+                return 0;
+            }
+
+            ip += length;
+            anchor = ip;
+            misses = 0;
+
+            if (ip < mlimit) {
+                table[lz_hash(lz_load32(ip - 2))] = (uint32_t)(ip - 2 - base);
+            }
+        }
+    }
+
+    op = lz_put_sequence(op, oend, anchor, iend, (size_t)(iend - anchor), 0, 0);
+    if (!op) {
+        return 0;
+    }
+
+    return (size_t)(op - (uint8_t *)dest);
+}
+
+extern bool pino_lz_decompress(void *dest, size_t size, const void *src, size_t src_size)
+{
+    const uint8_t *ip, *iend;
+    uint8_t *op, *oend;
+    size_t literals, offset, length;
+    uint8_t token;
+
+    if ((!dest && size > 0) || (!src && src_size > 0)) {
+        return false;
+    }
+
+    ip = (const uint8_t *)src;
+    iend = ip + src_size;
+    op = (uint8_t *)dest;
+    oend = op + size;
+
+    while (ip < iend) {
+        token = *ip++;
+
+        /* short sequences far enough from both ends need no bounds checks besides the offset */
+        if (token < (LZ_NIBBLE_MAX << 4) && (token & LZ_NIBBLE_MAX) != LZ_NIBBLE_MAX &&
+            (size_t)(iend - ip) >= LZ_WILD_COPY + sizeof(uint16_t) && (size_t)(oend - op) >= 2 * LZ_WILD_COPY + sizeof(uint64_t)
+        ) {
+            literals = token >> 4;
+            lz_copy16(op, ip);
+            op += literals;
+            ip += literals;
+
+            offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+            length = (token & LZ_NIBBLE_MAX) + LZ_MIN_MATCH;
+            if (offset >= sizeof(uint64_t) && offset <= (size_t)(op - (uint8_t *)dest)) {
+                ip += sizeof(uint16_t);
+                pmemcpy(op, op - offset, sizeof(uint64_t));
+                pmemcpy(op + 8, op - offset + 8, sizeof(uint64_t));
+                pmemcpy(op + 16, op - offset + 16, sizeof(uint16_t));
+                op += length;
+                continue;
+            }
+
+            /* the remaining checks run on the general path below */
+            token &= LZ_NIBBLE_MAX;
+        }
+
+        literals = token >> 4;
+        if (literals == LZ_NIBBLE_MAX && !lz_get_length(&ip, iend, &literals)) {
+            return false;
+        }
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) {
+            return false;
+        }
+        if (literals <= LZ_WILD_COPY && (size_t)(iend - ip) >= LZ_WILD_COPY && (size_t)(oend - op) >= LZ_WILD_COPY) {
+            lz_copy16(op, ip);
+        } else {
+            pmemcpy(op, ip, literals);
+        }
+        op += literals;
+        ip += literals;
+
+        if (ip == iend) {
+            break;
+        }
+
+        if ((size_t)(iend - ip) < sizeof(uint16_t)) {
+            return false;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += sizeof(uint16_t);
+        if (offset == 0 || offset > (size_t)(op - (uint8_t *)dest)) {
+            return false;
+        }
+
+        length = token & LZ_NIBBLE_MAX;
+        if (length == LZ_NIBBLE_MAX && !lz_get_length(&ip, iend, &length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (length > (size_t)(oend - op)) {
+            return false;
+        }
+        lz_copy_match(op, oend, offset, length);
+        op += length;
+    }
+
+    return op == oend;
+}
+
+extern bool pino_lz_validate(size_t size, const void *src, size_t src_size)
+{
+    const uint8_t *ip, *iend;
+    size_t produced, literals, offset, length;
+    uint8_t token;
+
+    if (!src && src_size > 0) {
+        return false;
+    }
+
+    ip = (const uint8_t *)src;
+    iend = ip + src_size;
+    produced = 0;
+
+    /* the same walk as pino_lz_decompress(), only counting the bytes it would write */
+    while (ip < iend) {
+        token = *ip++;
+
+        literals = token >> 4;
+        if (literals == LZ_NIBBLE_MAX && !lz_get_length(&ip, iend, &literals)) {
+            return false;
+        }
+        if (literals > (size_t)(iend - ip) || literals > size - produced) {
+            return false;
+        }
+        produced += literals;
+        ip += literals;
+
+        if (ip == iend) {
+            break;
+        }
+
+        if ((size_t)(iend - ip) < sizeof(uint16_t)) {
+            return false;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += sizeof(uint16_t);
+        if (offset == 0 || offset > produced) {
+            return false;
+        }
+
+        length = token & LZ_NIBBLE_MAX;
+        if (length == LZ_NIBBLE_MAX && !lz_get_length(&ip, iend, &length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (length > size - produced) {
+            return false;
+        }
+        produced += length;
+    }
+
+    return produced == size;
+}
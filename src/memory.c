@@ -8,124 +8,150 @@
 
 #include <pino_internal.h>
 
-static inline bool glow_mm(mm_t *mm, size_t step)
+#if MM_SHARDS > 1
+static pino_refcount_t g_mm_next_shard;
+static PTHRD_LOCAL size_t g_mm_shard = SIZE_MAX;
+#endif
+
+static inline size_t mm_shard(void)
 {
-    void **ptrs;
-    size_t i;
+#if MM_SHARDS > 1
+    if (g_mm_shard == SIZE_MAX) {
+        g_mm_shard = (size_t)patomic_inc(&g_mm_next_shard) % MM_SHARDS;
+    }
+
+    return g_mm_shard;
+#else
+    return 0;
+#endif
+}
 
-    ptrs = (void **)prealloc(mm->ptrs, (mm->capacity + step) * sizeof(void *));
+static inline bool glow_mm(mm_shard_t *shard)
+{
+    mm_header_t **blocks;
+    size_t capacity;
+
+    capacity = shard->capacity > 0 ? shard->capacity * 2 : MM_STEP;
+    blocks = (mm_header_t **)prealloc(shard->blocks, capacity * sizeof(mm_header_t *));
     /* LCOV_EXCL_START */
-    if (!ptrs) {
+    if (!blocks) {
         PINO_SUPRTF("prealloc failed");
         return false;
     }
     /* LCOV_EXCL_STOP */
 
-    for (i = mm->capacity; i < mm->capacity + step; i++) {
-        ptrs[i] = NULL;
-    }
-
-    mm->ptrs = ptrs;
-    mm->capacity += step;
+    shard->blocks = blocks;
+    shard->capacity = capacity;
 
-    PINO_SUPRTF("glowed capacity: %zu, usage: %zu", mm->capacity, mm->usage);
+    PINO_SUPRTF("glowed capacity: %zu, usage: %zu", shard->capacity, shard->usage);
 
     return true;
 }
 
 extern bool pino_memory_manager_obj_init(mm_t *mm, size_t initialize_size)
 {
+    size_t i;
+
     /* LCOV_EXCL_START */
     if (initialize_size == 0) {
         return false;
     }
     /* LCOV_EXCL_STOP */
 
-    mm->usage = 0;
-    mm->capacity = 0;
-    mm->ptrs = (void **)pcalloc(initialize_size, sizeof(void *));
-    /* LCOV_EXCL_START */
-    if (!mm->ptrs) {
-        return false;
+    /* shards grow on first use, only the calling thread's one is likely to be needed */
+    for (i = 0; i < MM_SHARDS; i++) {
+        mm->shards[i].usage = 0;
+        mm->shards[i].capacity = 0;
+        mm->shards[i].blocks = NULL;
+        pmutex_init(&mm->shards[i].lock);
     }
-    /* LCOV_EXCL_STOP */
-
-    mm->usage = 0;
-    mm->capacity = initialize_size;
 
-    PINO_SUPRTF("usage: %zu, capacity: %zu", mm->usage, mm->capacity);
+    PINO_SUPRTF("shards: %d, initialize_size: %zu", MM_SHARDS, initialize_size);
 
-    return mm;
+    return true;
 }
 
 extern void pino_memory_manager_obj_free(mm_t *mm)
 {
-    size_t i;
+    mm_shard_t *shard;
+    size_t i, j;
 
     if (!mm) {
         return; /* LCOV_EXCL_LINE */
     }
 
-    for (i = 0; i < mm->capacity; i++) {
-        if (mm->ptrs[i]) {
-            pfree(mm->ptrs[i]);
-            mm->ptrs[i] = NULL;
-            --mm->usage;
+    for (i = 0; i < MM_SHARDS; i++) {
+        shard = &mm->shards[i];
+        for (j = 0; j < shard->usage; j++) {
+            pfree(shard->blocks[j]);
 
-            PINO_SUPRTF("freeing: %zu, usage: %zu, capacity: %zu", i, mm->usage, mm->capacity);
+            PINO_SUPRTF("freeing: %zu/%zu, capacity: %zu", i, j, shard->capacity);
         }
+
+        if (shard->blocks) {
+            pfree(shard->blocks);
+        }
+        shard->blocks = NULL;
+        shard->usage = 0;
+        shard->capacity = 0;
+
+        pmutex_destroy(&shard->lock);
+    }
+}
+
+static inline bool mm_track(mm_shard_t *shard, mm_header_t *block)
+{
+    if (shard->usage >= shard->capacity) {
+        /* LCOV_EXCL_START */
+        if (!glow_mm(shard)) {
+            PINO_SUPRTF("glow_mm failed");
+            return false;
+        }
+        /* LCOV_EXCL_STOP */
     }
 
-    pfree(mm->ptrs);
-    mm->ptrs = NULL;
-    mm->usage = 0;
-    mm->capacity = 0;
+    block->index.slot = shard->usage;
+    shard->blocks[shard->usage++] = block;
+
+    return true;
 }
 
 extern void *pino_memory_manager_malloc(/* handler_entry_t */ void *entry, size_t size)
 {
-    size_t i;
+    mm_shard_t *shard;
+    mm_header_t *block;
+    bool tracked;
 
-    if (!entry || size == 0) {
+    if (!entry || size == 0 || size > SIZE_MAX - sizeof(mm_header_t)) {
         PINO_SUPRTF("entry or size is NULL");
         return NULL;
     }
 
-    if (((handler_entry_t *)entry)->mm.usage >= ((handler_entry_t *)entry)->mm.capacity) {
-        /* LCOV_EXCL_START */
-        if (!glow_mm(&((handler_entry_t *)entry)->mm, HANDLER_STEP)) {
-            PINO_SUPRTF("glow_mm failed");
-            return NULL;
-        }
-        /* LCOV_EXCL_STOP */
+    block = (mm_header_t *)pmalloc(sizeof(mm_header_t) + size);
+    /* LCOV_EXCL_START */
+    if (!block) {
+        PINO_SUPRTF("pmalloc failed");
+        return NULL;
     }
+    /* LCOV_EXCL_STOP */
+
+    block->index.shard = mm_shard();
+    shard = &((handler_entry_t *)entry)->mm.shards[block->index.shard];
+
+    pmutex_lock(&shard->lock);
+    tracked = mm_track(shard, block);
+    pmutex_unlock(&shard->lock);
 
-    for (i = 0; i < ((handler_entry_t *)entry)->mm.capacity; i++) {
-        if (!((handler_entry_t *)entry)->mm.ptrs[i]) {
-            ((handler_entry_t *)entry)->mm.ptrs[i] = pmalloc(size);
-            /* LCOV_EXCL_START */
-            if (!((handler_entry_t *)entry)->mm.ptrs[i]) {
-                PINO_SUPRTF("pmalloc failed");
-                return NULL;
-            }
-            /* LCOV_EXCL_STOP */
-
-            ++((handler_entry_t *)entry)->mm.usage;
-
-            PINO_SUPRTF("magic: %.4s, using: %zu, usage: %zu, capacity: %zu",
-                ((handler_entry_t *)entry)->magic,
-                i,
-                ((handler_entry_t *)entry)->mm.usage,
-                ((handler_entry_t *)entry)->mm.capacity
-            );
-
-            return ((handler_entry_t *)entry)->mm.ptrs[i];
-        }
-    }
     /* LCOV_EXCL_START */
-    PINO_SUPUNREACH();
-    return NULL;
+    if (!tracked) {
+        pfree(block);
+        return NULL;
+    }
     /* LCOV_EXCL_STOP */
+
+    PINO_SUPRTF("magic: %.4s, shard: %zu, slot: %zu", ((handler_entry_t *)entry)->magic, block->index.shard, block->index.slot);
+
+    return block + 1;
 }
 
 extern void *pino_memory_manager_calloc(/* handler_entry_t */ void *entry, size_t count, size_t size)
@@ -145,31 +171,56 @@ extern void *pino_memory_manager_calloc(/* handler_entry_t */ void *entry, size_
     return ptr;
 }
 
+static inline bool mm_untrack(mm_shard_t *shard, mm_header_t *block)
+{
+    mm_header_t *last;
+    size_t slot = block->index.slot;
+
+    if (slot >= shard->usage || shard->blocks[slot] != block) {
+        return false;
+    }
+
+    last = shard->blocks[--shard->usage];
+    shard->blocks[slot] = last;
+    last->index.slot = slot;
+
+    return true;
+}
+
 extern void pino_memory_manager_free(/* handler_entry_t */ void *entry, void *ptr)
 {
-    size_t i;
+    mm_shard_t *shard;
+    mm_header_t *block;
+    bool tracked;
 
     if (!entry || !ptr) {
         PINO_SUPRTF("mm or ptr is NULL");
         return;
     }
 
-    for (i = 0; i < ((handler_entry_t *)entry)->mm.capacity; i++) {
-        if (((handler_entry_t *)entry)->mm.ptrs[i] && ((handler_entry_t *)entry)->mm.ptrs[i] == ptr) {
-            pfree(ptr);
-            ((handler_entry_t *)entry)->mm.ptrs[i] = NULL;
-            ptr = NULL;
-            --((handler_entry_t *)entry)->mm.usage;
+    block = ((mm_header_t *)ptr) - 1;
+    if (block->index.shard >= MM_SHARDS) {
+        /* LCOV_EXCL_START */
+        PINO_SUPUNREACH();
+        return;
+        /* LCOV_EXCL_STOP */
+    }
 
-            PINO_SUPRTF("freeing: %zu, usage: %zu, capacity: %zu",
-                i, ((handler_entry_t *)entry)->mm.usage, ((handler_entry_t *)entry)->mm.capacity);
+    /* the block may have been allocated on another thread, it stays in that thread's shard */
+    shard = &((handler_entry_t *)entry)->mm.shards[block->index.shard];
 
-            return;
-        }
-    }
+    pmutex_lock(&shard->lock);
+    tracked = mm_untrack(shard, block);
+    pmutex_unlock(&shard->lock);
 
     /* LCOV_EXCL_START */
-    PINO_SUPUNREACH();
-    return;
+    if (!tracked) {
+        PINO_SUPUNREACH();
+        return;
+    }
     /* LCOV_EXCL_STOP */
+
+    PINO_SUPRTF("freeing: %zu/%zu", block->index.shard, block->index.slot);
+
+    pfree(block);
 }
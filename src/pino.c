@@ -13,7 +13,19 @@
 
 #include <pino_internal.h>
 
-static inline pino_t *pino_create(pino_magic_safe_t magic, pino_handler_t *handler, size_t size)
+/* how far the handler has copied the payload of the record being unserialized on this thread */
+typedef struct {
+    const uint8_t *next;    /* NULL when nothing is being checked */
+    const uint8_t *end;
+    uint32_t crc;
+} checksum_cursor_t;
+
+static PTHRD_LOCAL checksum_cursor_t g_checksum_cursor;
+/* PINO_SERIALIZE_NATIVE of the record being (un)serialized on this thread, set on the wire only by big endian writers */
+static PTHRD_LOCAL bool g_payload_big_endian;
+
+/* wire_static_fields are the record's ones, set before the handler runs so adopt sees them as unserialize would */
+static inline pino_t *create_common(pino_magic_safe_t magic, pino_handler_t *handler, void *adopt_src, size_t size, const void *wire_static_fields)
 {
     pino_t *pino;
 
@@ -25,7 +37,7 @@ static inline pino_t *pino_create(pino_magic_safe_t magic, pino_handler_t *handl
     pmemcpy(pino->magic, magic, sizeof(pino_magic_t));
     pino->magic[sizeof(pino_magic_t)] = '\0';
     pino->static_fields_size = handler->static_fields_size;
-    pino->static_fields = pcalloc(1, pino->static_fields_size);
+    pino->static_fields = pcalloc(1, static_fields_memory_size(handler));
     if (!pino->static_fields) {
         /* LCOV_EXCL_START */
         pfree(pino);
@@ -33,94 +45,1043 @@ static inline pino_t *pino_create(pino_magic_safe_t magic, pino_handler_t *handl
         /* LCOV_EXCL_STOP */
     }
     pino->handler = handler;
-    pino->this = handler->create(size, pino->static_fields);
+    pino->lazy_src = NULL;
+    pino->lazy_size = 0;
+    pino->lazy_state = LAZY_LOADED;
+    pino->adopted = NULL;
+    pino->adopted_free = NULL;
+    pino->refcount = 1;
+    pino->share = NULL;
+    pino->cache = NULL;
+    pino->cache_enabled = false;
+    if (wire_static_fields) {
+        pino_static_fields_from_wire(handler, pino->static_fields, wire_static_fields);
+    }
+    pino->this = adopt_src ? handler->adopt(adopt_src, size, pino->static_fields) : handler->create(size, pino->static_fields);
     if (!pino->this) {
         PINO_SUPRTF("handler->create failed");
+        pfree(pino->static_fields);
         pfree(pino);
         return NULL;
     }
 
-    return pino;
-}
+    return pino;
+}
+
+extern pino_t *pino_create(pino_magic_safe_t magic, pino_handler_t *handler, size_t size)
+{
+    return create_common(magic, handler, NULL, size, NULL);
+}
+
+extern bool pino_ensure_payload(const pino_t *pino)
+{
+    pino_t *mutable_pino = (pino_t *)pino;
+    pino_refcount_t state;
+    bool result;
+
+    state = patomic_load(&pino->lazy_state);
+    if (state == LAZY_LOADED) {
+        return true;
+    }
+
+    if (state == LAZY_PENDING && patomic_cas(&mutable_pino->lazy_state, LAZY_PENDING, LAZY_RUNNING)) {
+        result = pino->handler->unserialize(pino->this, pino->static_fields, pino->lazy_src, pino->lazy_size);
+        if (!result) {
+            PINO_SUPRTF("deferred handler->unserialize failed");
+        }
+
+        mutable_pino->lazy_src = NULL;
+        mutable_pino->lazy_size = 0;
+        patomic_store(&mutable_pino->lazy_state, result ? LAZY_LOADED : LAZY_FAILED);
+
+        return result;
+    }
+
+    /* another thread is decoding, the handler state is only published once it is done */
+    while ((state = patomic_load(&pino->lazy_state)) == LAZY_RUNNING) {
+        pthrd_sleep_us(1);
+    }
+
+    return state == LAZY_LOADED;
+}
+
+extern bool pino_init(void)
+{
+    return pino_handler_init(HANDLER_STEP);
+}
+
+extern void pino_free(void)
+{
+    pino_handler_free();
+}
+
+static inline uint64_t record_generation(const pino_t *pino)
+{
+    return pino->handler->generation ? pino->handler->generation(pino->this, pino->static_fields) : 0;
+}
+
+/* static fields set without pino_touch() are caught here, payload changes only through the handler's generation */
+static inline bool record_cache_fresh(const pino_t *pino, const pino_cache_t *cache)
+{
+    size_t fields_size = static_fields_memory_size(pino->handler);
+
+    return cache->generation == record_generation(pino) &&
+        (fields_size == 0 || memcmp(cache->data + cache->size, pino->static_fields, fields_size) == 0);
+}
+
+static inline pino_cache_t *record_cache(const pino_t *pino, uint32_t flags)
+{
+    pino_cache_t *cache = pino->cache;
+
+    return (cache && cache->flags == flags && record_cache_fresh(pino, cache)) ? cache : NULL;
+}
+
+/* nothing cached yet, or only a record of a pino that changed since */
+static inline bool record_cache_vacant(const pino_t *pino)
+{
+    return !pino->cache || !record_cache_fresh(pino, pino->cache);
+}
+
+static inline pino_cache_t *record_cache_new(const pino_t *pino, size_t size, uint32_t flags)
+{
+    pino_cache_t *cache;
+    size_t fields_size;
+
+    fields_size = static_fields_memory_size(pino->handler);
+    cache = (pino_cache_t *)pmalloc(sizeof(pino_cache_t) + size + fields_size);
+    if (!cache) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    cache->stale = NULL;
+    cache->size = size;
+    cache->generation = record_generation(pino);
+    cache->flags = flags;
+    cache->viewed = 0;
+    if (fields_size > 0) {
+        pmemcpy(cache->data + size, pino->static_fields, fields_size);
+    }
+
+    return cache;
+}
+
+/* the first record written wins, concurrent writers of the same pino drop their copy */
+static inline pino_cache_t *record_cache_install(const pino_t *pino, pino_cache_t *cache)
+{
+    pino_t *mutable_pino = (pino_t *)pino;
+    pino_cache_t *current = pino->cache;
+    uint32_t flags = cache->flags;
+    bool keep;
+
+    if (current && record_cache_fresh(pino, current)) {
+        pfree(cache);
+        return record_cache(pino, flags);
+    }
+
+    /* only records someone may still be reading from are kept around */
+    keep = current && patomic_load(&current->viewed);
+    cache->stale = keep ? current : (current ? current->stale : NULL);
+    if (!patomic_cas_ptr(&mutable_pino->cache, current, cache)) {
+        pfree(cache);
+        return record_cache(pino, flags);
+    }
+
+    if (current && !keep) {
+        pfree(current);
+    }
+
+    return cache;
+}
+
+static inline void record_cache_drop(pino_t *pino)
+{
+    pino_cache_t *cache, *stale;
+
+    for (cache = pino->cache; cache; cache = stale) {
+        stale = cache->stale;
+        pfree(cache);
+    }
+
+    pino->cache = NULL;
+}
+
+static inline uint16_t record_alias(const pino_t *pino)
+{
+    return pino->handler->entry ? ((const handler_entry_t *)pino->handler->entry)->alias : 0;
+}
+
+/* bytes in front of the static fields */
+static inline size_t record_header_size(const pino_t *pino, size_t payload_size, uint32_t flags)
+{
+    uint16_t alias;
+
+    if (!(flags & PINO_SERIALIZE_COMPACT)) {
+        return align_up(PINO_HEADER_SIZE, flags_alignment(flags));
+    }
+
+    alias = record_alias(pino);
+
+    return 1 + (alias == 0 ? sizeof(pino_magic_t) : (alias <= UINT8_MAX ? 1 : 2)) +
+        leb128_size((uint64_t)pino->static_fields_size) + leb128_size((uint64_t)payload_size);
+}
+
+/* bytes in front of the payload */
+static inline size_t record_payload_offset(const pino_t *pino, size_t payload_size, uint32_t flags)
+{
+    return align_up(record_header_size(pino, payload_size, flags) + (size_t)pino->static_fields_size, flags_alignment(flags));
+}
+
+extern size_t pino_record_size(const pino_t *pino, uint32_t flags)
+{
+    pino_cache_t *cache;
+    size_t payload_size;
+
+    cache = record_cache(pino, flags);
+    if (cache) {
+        return cache->size;
+    }
+
+    PINO_SUPRTF("magic: %.4s, serialize_size: %zu, magic_size: %zu", pino->magic, pino->handler->serialize_size(pino->this, pino->static_fields), sizeof(pino_magic_t));
+
+    payload_size = pino->handler->serialize_size(pino->this, pino->static_fields);
+
+    return payload_size + record_payload_offset(pino, payload_size, flags) +
+        ((flags & PINO_SERIALIZE_CRC32C) ? PINO_CHECKSUM_SIZE : 0);
+}
+
+static inline size_t record_write_compact_header(const pino_t *pino, uint8_t *dest, size_t payload_size, uint32_t flags)
+{
+    uint16_t alias;
+    size_t n;
+
+    alias = record_alias(pino);
+    dest[0] = (uint8_t)(PINO_COMPACT_MARKER | (PINO_COMPACT_VERSION << PINO_COMPACT_VERSION_SHIFT) | (wire_flags(flags) << PINO_COMPACT_FLAGS_SHIFT));
+    n = 1;
+
+    if (alias == 0) {
+        pmemcpy(dest + n, pino->magic, sizeof(pino_magic_t));
+        n += sizeof(pino_magic_t);
+    } else if (alias <= UINT8_MAX) {
+        dest[0] |= PINO_COMPACT_MAGIC_ALIAS8;
+        dest[n++] = (uint8_t)alias;
+    } else {
+        dest[0] |= PINO_COMPACT_MAGIC_ALIAS16;
+        dest[n++] = (uint8_t)alias;
+        dest[n++] = (uint8_t)(alias >> 8);
+    }
+
+    n += leb128_write(dest + n, (uint64_t)pino->static_fields_size);
+    n += leb128_write(dest + n, (uint64_t)payload_size);
+
+    return n;
+}
+
+/* the header, the static fields and the zeroed alignment padding, returns the payload offset */
+static inline size_t record_write_header(const pino_t *pino, void *dest, size_t payload_size, uint32_t flags)
+{
+    pino_static_fields_size_t fields_size;
+    size_t header_size, offset;
+
+    if (flags & PINO_SERIALIZE_COMPACT) {
+        header_size = record_write_compact_header(pino, (uint8_t *)dest, payload_size, flags);
+    } else {
+        fields_size = pino->static_fields_size | ((pino_static_fields_size_t)wire_flags(flags) << PINO_FLAGS_SHIFT);
+
+        pmemcpy(dest, pino->magic, sizeof(pino_magic_t));
+        pmemcpy_n2l(((char *)dest) + sizeof(pino_magic_t), &fields_size, sizeof(pino_static_fields_size_t));
+        header_size = align_up(PINO_HEADER_SIZE, flags_alignment(flags));
+        memset(((char *)dest) + PINO_HEADER_SIZE, 0, header_size - PINO_HEADER_SIZE);
+    }
+
+    /* fields always use LE */
+    pino_static_fields_to_wire(pino->handler, ((char *)dest) + header_size, pino->static_fields);
+    offset = align_up(header_size + (size_t)pino->static_fields_size, flags_alignment(flags));
+    memset(((char *)dest) + header_size + (size_t)pino->static_fields_size, 0, offset - header_size - (size_t)pino->static_fields_size);
+
+    return offset;
+}
+
+static inline void record_write_checksum(void *dest, size_t size)
+{
+    uint32_t crc;
+
+    crc = pino_crc32c_update(0, dest, size);
+    pmemcpy_n2l(((char *)dest) + size, &crc, sizeof(uint32_t));
+}
+
+static inline bool record_serialize_payload(const pino_t *pino, void *dest, uint32_t flags)
+{
+    bool saved, result;
+
+    saved = pino_payload_big_endian((wire_flags(flags) & PINO_SERIALIZE_NATIVE) != 0);
+    result = pino->handler->serialize(pino->this, pino->static_fields, dest);
+    pino_payload_big_endian(saved);
+
+    return result;
+}
+
+static inline bool record_write_uncached(const pino_t *pino, void *dest, uint32_t flags)
+{
+    size_t payload_size, offset;
+
+    payload_size = pino->handler->serialize_size(pino->this, pino->static_fields);
+    offset = record_write_header(pino, dest, payload_size, flags);
+
+    if (!record_serialize_payload(pino, ((char *)dest) + offset, flags)) {
+        return false;
+    }
+
+    if (flags & PINO_SERIALIZE_CRC32C) {
+        record_write_checksum(dest, offset + payload_size);
+    }
+
+    return true;
+}
+
+extern bool pino_record_write(const pino_t *pino, void *dest, uint32_t flags)
+{
+    pino_cache_t *cache;
+    size_t size;
+
+    cache = record_cache(pino, flags);
+    if (cache) {
+        pmemcpy(dest, cache->data, cache->size);
+        return true;
+    }
+
+    if (!record_write_uncached(pino, dest, flags)) {
+        return false;
+    }
+
+    if (pino->cache_enabled && record_cache_vacant(pino)) {
+        size = pino_record_size(pino, flags);
+        cache = record_cache_new(pino, size, flags);
+        if (cache) {
+            pmemcpy(cache->data, dest, size);
+            record_cache_install(pino, cache);
+        }
+    }
+
+    return true;
+}
+
+extern bool pino_serialize_cache(pino_t *pino, bool enabled)
+{
+    if (!pino) {
+        return false;
+    }
+
+    pino->cache_enabled = enabled;
+    if (!enabled) {
+        record_cache_drop(pino);
+    }
+
+    return true;
+}
+
+extern const void *pino_serialize_view(const pino_t *pino, uint32_t flags, size_t *size)
+{
+    pino_cache_t *cache;
+    size_t record_size;
+
+    if (!pino || !size || !pino->cache_enabled || !flags_valid(flags) || (flags & PINO_SERIALIZE_COMPRESS)) {
+        return NULL;
+    }
+
+    cache = record_cache(pino, flags);
+    if (!cache) {
+        if (!pino_ensure_payload(pino) || !record_cache_vacant(pino)) {
+            return NULL;
+        }
+
+        record_size = pino_record_size(pino, flags);
+        cache = record_cache_new(pino, record_size, flags);
+        if (!cache) {
+            return NULL; /* LCOV_EXCL_LINE */
+        }
+
+        if (!record_write_uncached(pino, cache->data, flags)) {
+            pfree(cache);
+            return NULL;
+        }
+
+        cache = record_cache_install(pino, cache);
+        if (!cache) {
+            return NULL; /* LCOV_EXCL_LINE */
+        }
+    }
+
+    if (!patomic_load(&cache->viewed)) {
+        patomic_store(&cache->viewed, 1);
+    }
+    *size = cache->size;
+
+    return cache->data;
+}
+
+static inline size_t record_write_compressed(const pino_t *pino, void *dest, uint32_t flags)
+{
+    uint8_t *payload, *raw;
+    size_t raw_size, packed_size, size, offset, packed_offset;
+    uint64_t block_size;
+
+    raw_size = pino->handler->serialize_size(pino->this, pino->static_fields);
+    if (raw_size < COMPRESS_THRESHOLD) {
+        flags &= ~(uint32_t)PINO_SERIALIZE_COMPRESS;
+        return pino_record_write(pino, dest, flags) ? pino_record_size(pino, flags) : 0;
+    }
+
+    raw = (uint8_t *)pmalloc(raw_size);
+    if (!raw) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    if (!record_serialize_payload(pino, raw, flags)) {
+        pfree(raw);
+        return 0;
+    }
+
+    /* packed straight into dest, kept only when it ends up smaller than the raw payload */
+    offset = record_payload_offset(pino, raw_size, flags);
+    payload = ((uint8_t *)dest) + offset;
+    packed_size = pino_lz_compress(payload + PINO_COMPRESS_HEADER_SIZE, raw_size - PINO_COMPRESS_HEADER_SIZE - 1, raw, raw_size);
+    if (packed_size > 0) {
+        block_size = (uint64_t)raw_size;
+        pmemcpy_n2l(payload, &block_size, sizeof(uint64_t));
+        block_size = (uint64_t)packed_size;
+        pmemcpy_n2l(payload + sizeof(uint64_t), &block_size, sizeof(uint64_t));
+        size = PINO_COMPRESS_HEADER_SIZE + packed_size;
+    } else {
+        PINO_SUPRTF("incompressible payload: %zu", raw_size);
+        flags &= ~(uint32_t)PINO_SERIALIZE_COMPRESS;
+        pmemcpy(payload, raw, raw_size);
+        size = raw_size;
+    }
+    pfree(raw);
+
+    /* a compact header sized for the raw payload may shrink with the packed one */
+    packed_offset = record_payload_offset(pino, size, flags);
+    if (packed_offset < offset) {
+        pmemmove(((uint8_t *)dest) + packed_offset, payload, size);
+    }
+
+    record_write_header(pino, dest, size, flags);
+    size += packed_offset;
+
+    if (flags & PINO_SERIALIZE_CRC32C) {
+        record_write_checksum(dest, size);
+        size += PINO_CHECKSUM_SIZE;
+    }
+
+    return size;
+}
+
+extern bool pino_record_checksum(const pino_header_t *header)
+{
+    const uint8_t *record;
+    size_t size;
+    uint32_t crc;
+
+    if (!(header->flags & PINO_SERIALIZE_CRC32C)) {
+        return true;
+    }
+
+    record = ((const uint8_t *)header->static_fields) - header->header_size;
+    size = (size_t)((const uint8_t *)header->payload - record) + header->payload_size;
+    pmemcpy_l2n(&crc, record + size, sizeof(uint32_t));
+
+    return pino_crc32c_update(0, record, size) == crc;
+}
+
+extern bool pino_payload_big_endian(bool big_endian)
+{
+    bool previous = g_payload_big_endian;
+
+    g_payload_big_endian = big_endian;
+
+    return previous;
+}
+
+extern void *pino_handler_serialize_memcpy(void *dest, const void *src, size_t size)
+{
+    if (g_payload_big_endian) {
+        return pino_endianness_memcpy_native2be(dest, src, size);
+    }
+
+    return pino_endianness_memcpy_native2le(dest, src, size);
+}
+
+extern void *pino_handler_unserialize_memcpy(void *dest, const void *src, size_t size)
+{
+    checksum_cursor_t *cursor = &g_checksum_cursor;
+    bool noop;
+
+    noop = g_payload_big_endian ? pino_endianness_be2native_noop(size) : pino_endianness_le2native_noop(size);
+
+    /* in order copies of the payload are checked on the way, anything else is caught up afterwards */
+    if (cursor->next && (const uint8_t *)src == cursor->next &&
+        size <= (size_t)(cursor->end - cursor->next) && noop
+    ) {
+        cursor->crc = pino_crc32c_copy(cursor->crc, dest, src, size);
+        cursor->next += size;
+
+        return dest;
+    }
+
+    if (g_payload_big_endian) {
+        return pino_endianness_memcpy_be2native(dest, src, size);
+    }
+
+    return pino_endianness_memcpy_le2native(dest, src, size);
+}
+
+extern void *pino_handler_serialize_memcpy_array(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    if (g_payload_big_endian) {
+        return pino_endianness_memcpy_array_native2be(dest, src, count, elem_size);
+    }
+
+    return pino_endianness_memcpy_array_native2le(dest, src, count, elem_size);
+}
+
+extern void *pino_handler_unserialize_memcpy_array(void *dest, const void *src, size_t count, size_t elem_size)
+{
+    checksum_cursor_t *cursor = &g_checksum_cursor;
+    size_t size;
+    bool noop;
+
+    if (elem_size == 0 || count > SIZE_MAX / elem_size) {
+        return NULL;
+    }
+    size = count * elem_size;
+
+    noop = g_payload_big_endian ? pino_endianness_be2native_noop(elem_size) : pino_endianness_le2native_noop(elem_size);
+
+    if (cursor->next && (const uint8_t *)src == cursor->next &&
+        size <= (size_t)(cursor->end - cursor->next) && noop
+    ) {
+        cursor->crc = pino_crc32c_copy(cursor->crc, dest, src, size);
+        cursor->next += size;
+
+        return dest;
+    }
+
+    if (g_payload_big_endian) {
+        return pino_endianness_memcpy_array_be2native(dest, src, count, elem_size);
+    }
+
+    return pino_endianness_memcpy_array_le2native(dest, src, count, elem_size);
+}
+
+extern size_t pino_serialize_size(const pino_t *pino)
+{
+    return pino_serialize_size_ex(pino, 0);
+}
+
+extern bool pino_serialize(const pino_t *pino, void *dest)
+{
+    return pino_serialize_ex(pino, dest, 0);
+}
+
+extern size_t pino_serialize_size_ex(const pino_t *pino, uint32_t flags)
+{
+    if (!pino || !flags_valid(flags)) {
+        return 0;
+    }
+
+    if (!pino_ensure_payload(pino)) {
+        return 0;
+    }
+
+    return pino_record_size(pino, flags);
+}
+
+extern bool pino_serialize_ex(const pino_t *pino, void *dest, uint32_t flags)
+{
+    if (!pino || !dest || !flags_valid(flags) || (flags & PINO_SERIALIZE_COMPRESS)) {
+        return false;
+    }
+
+    if (!pino_ensure_payload(pino)) {
+        return false;
+    }
+
+    return pino_record_write(pino, dest, flags);
+}
+
+extern size_t pino_serialize_record(const pino_t *pino, void *dest, size_t capacity, uint32_t flags)
+{
+    size_t size;
+
+    size = pino_serialize_size_ex(pino, flags);
+    if (size == 0 || !dest) {
+        return size;
+    }
+
+    if (capacity < size) {
+        return 0;
+    }
+
+    if (flags & PINO_SERIALIZE_COMPRESS) {
+        return record_write_compressed(pino, dest, flags);
+    }
+
+    return pino_record_write(pino, dest, flags) ? size : 0;
+}
+
+static inline pino_validate_result_t validate_header(const void *src, size_t size, pino_header_t *header, pino_handler_t **handler)
+{
+    if (!src) {
+        return PINO_VALIDATE_INVALID_ARGUMENT;
+    }
+
+    if (!pino_peek(src, size, header)) {
+        return PINO_VALIDATE_TRUNCATED;
+    }
+
+    *handler = pino_handler_find(header->magic);
+    if (!*handler) {
+        return PINO_VALIDATE_HANDLER_MISSING;
+    }
+
+    if (header->static_fields_size != (*handler)->static_fields_size) {
+        return PINO_VALIDATE_STATIC_FIELDS_SIZE;
+    }
+
+    return PINO_VALIDATE_OK;
+}
+
+static inline pino_validate_result_t validate_payload(const pino_header_t *header, const pino_handler_t *handler)
+{
+    if (handler->validate) {
+        return pino_handler_validate(handler, header->static_fields, header->payload, header->payload_size) ? PINO_VALIDATE_OK : PINO_VALIDATE_PAYLOAD;
+    }
+
+    if (handler->payload_size && pino_handler_payload_size(handler, header->static_fields) > header->payload_size) {
+        return PINO_VALIDATE_TRUNCATED;
+    }
+
+    return PINO_VALIDATE_OK;
+}
+
+static inline bool unserialize_checked(pino_t *pino, const pino_header_t *header, pino_handler_t *handler)
+{
+    checksum_cursor_t saved, cursor;
+    const uint8_t *record;
+    size_t size;
+    uint32_t crc;
+    bool result;
+
+    record = ((const uint8_t *)header->static_fields) - header->header_size;
+    size = (size_t)((const uint8_t *)header->payload - record);
+
+    /* handlers may unserialize nested records */
+    saved = g_checksum_cursor;
+
+    /* anything sized from the static fields only runs on a verified record */
+    if (!handler->checksum_fused) {
+        if (!pino_record_checksum(header)) {
+            PINO_SUPRTF("checksum mismatch");
+            return false;
+        }
+
+        memset(&g_checksum_cursor, 0, sizeof(checksum_cursor_t));
+        pino_static_fields_from_wire(handler, pino->static_fields, header->static_fields);
+        result = handler->unserialize(pino->this, pino->static_fields, header->payload, header->payload_size);
+        g_checksum_cursor = saved;
+
+        return result;
+    }
+
+    /* everything in front of the payload, alignment padding included */
+    g_checksum_cursor.crc = pino_crc32c_update(0, record, size);
+    pino_static_fields_from_wire(handler, pino->static_fields, header->static_fields);
+    g_checksum_cursor.next = (const uint8_t *)header->payload;
+    g_checksum_cursor.end = g_checksum_cursor.next + header->payload_size;
+
+    result = handler->unserialize(pino->this, pino->static_fields, header->payload, header->payload_size);
+
+    cursor = g_checksum_cursor;
+    g_checksum_cursor = saved;
+
+    if (!result) {
+        return false;
+    }
+
+    pmemcpy_l2n(&crc, record + size + header->payload_size, sizeof(uint32_t));
+    if (pino_crc32c_update(cursor.crc, cursor.next, (size_t)(cursor.end - cursor.next)) != crc) {
+        PINO_SUPRTF("checksum mismatch");
+        return false;
+    }
+
+    return true;
+}
+
+static inline pino_t *unserialize_common(const pino_header_t *header, pino_handler_t *handler)
+{
+    pino_t *pino;
+    bool saved, result;
+
+    pino = pino_create((char *)header->magic, handler, header->payload_size);
+    if (!pino) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    saved = pino_payload_big_endian((header->flags & PINO_SERIALIZE_NATIVE) != 0);
+    if (header->flags & PINO_SERIALIZE_CRC32C) {
+        result = unserialize_checked(pino, header, handler);
+    } else {
+        pino_static_fields_from_wire(handler, pino->static_fields, header->static_fields);
+        result = handler->unserialize(pino->this, pino->static_fields, header->payload, header->payload_size);
+    }
+
+    pino_payload_big_endian(saved);
+
+    if (!result) {
+        pino_destroy(pino);
+        return NULL;
+    }
+
+    return pino;
+}
+
+static void payload_free(void *ptr)
+{
+    pfree(ptr);
+}
+
+/* checks the block header and the checksum of a PINO_SERIALIZE_COMPRESS record, nothing is unpacked yet */
+static inline pino_validate_result_t packed_payload(const pino_header_t *header, uint64_t *raw_size, uint64_t *packed_size)
+{
+    const uint8_t *payload;
+
+    if (header->payload_size < PINO_COMPRESS_HEADER_SIZE) {
+        return PINO_VALIDATE_TRUNCATED;
+    }
+
+    payload = (const uint8_t *)header->payload;
+    pmemcpy_l2n(raw_size, payload, sizeof(uint64_t));
+    pmemcpy_l2n(packed_size, payload + sizeof(uint64_t), sizeof(uint64_t));
+    if (*packed_size > (uint64_t)(header->payload_size - PINO_COMPRESS_HEADER_SIZE)) {
+        return PINO_VALIDATE_TRUNCATED;
+    }
+
+    /* a packed byte never expands to more than 255 bytes, so corrupted sizes fail before the allocation */
+    if (*packed_size != (uint64_t)(header->payload_size - PINO_COMPRESS_HEADER_SIZE) ||
+        *raw_size > (uint64_t)SIZE_MAX || *raw_size / 256 > *packed_size
+    ) {
+        return PINO_VALIDATE_PAYLOAD;
+    }
+
+    /* the packed bytes are not copied anywhere to fuse the check into */
+    if (!pino_record_checksum(header)) {
+        return PINO_VALIDATE_CHECKSUM;
+    }
+
+    return PINO_VALIDATE_OK;
+}
+
+/* on success header describes the raw payload, which lives in *buffer for PINO_SERIALIZE_COMPRESS records */
+static inline pino_validate_result_t expand_payload(pino_header_t *header, void **buffer)
+{
+    pino_validate_result_t result;
+    uint64_t raw_size, packed_size;
+
+    *buffer = NULL;
+
+    if (!(header->flags & PINO_SERIALIZE_COMPRESS)) {
+        return PINO_VALIDATE_OK;
+    }
+
+    result = packed_payload(header, &raw_size, &packed_size);
+    if (result != PINO_VALIDATE_OK) {
+        return result;
+    }
+
+    *buffer = pmalloc(raw_size > 0 ? (size_t)raw_size : 1);
+    if (!*buffer) {
+        return PINO_VALIDATE_PAYLOAD; /* LCOV_EXCL_LINE */
+    }
+
+    if (!pino_lz_decompress(*buffer, (size_t)raw_size, ((const uint8_t *)header->payload) + PINO_COMPRESS_HEADER_SIZE, (size_t)packed_size)) {
+        PINO_SUPRTF("corrupted compressed payload");
+        pfree(*buffer);
+        *buffer = NULL;
+        return PINO_VALIDATE_PAYLOAD;
+    }
+
+    header->payload = *buffer;
+    header->payload_size = (size_t)raw_size;
+    header->flags &= ~(uint32_t)(PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C);
+
+    return PINO_VALIDATE_OK;
+}
+
+extern pino_t *pino_record_unserialize_owned(const pino_header_t *header, pino_handler_t *handler, void *buffer, bool validate)
+{
+    pino_t *pino;
+
+    if (validate && validate_payload(header, handler) != PINO_VALIDATE_OK) {
+        PINO_SUPRTF("payload validation failed");
+        pfree(buffer);
+        return NULL;
+    }
+
+    if (!handler->adopt || header->payload_size == 0 || payload_foreign(header->flags)) {
+        pino = unserialize_common(header, handler);
+        pfree(buffer);
+
+        return pino;
+    }
+
+    /* the handler takes over the buffer the payload was built in */
+    pino = create_common((char *)header->magic, handler, buffer, header->payload_size, header->static_fields);
+    if (!pino) {
+        pfree(buffer);
+        return NULL;
+    }
+
+    pino->adopted = buffer;
+    pino->adopted_free = payload_free;
+
+    return pino;
+}
+
+/* pino_validate() only walks the packed block, the handler validate callback always runs here */
+static inline pino_t *unserialize_compressed(pino_header_t *header, pino_handler_t *handler)
+{
+    void *buffer;
+
+    if (expand_payload(header, &buffer) != PINO_VALIDATE_OK) {
+        return NULL;
+    }
+
+    return pino_record_unserialize_owned(header, handler, buffer, true);
+}
+
+static inline pino_t *unserialize_record(pino_header_t *header, pino_handler_t *handler, bool validate)
+{
+    if (header->flags & PINO_SERIALIZE_COMPRESS) {
+        return unserialize_compressed(header, handler);
+    }
+
+    if (validate && validate_payload(header, handler) != PINO_VALIDATE_OK) {
+        PINO_SUPRTF("payload validation failed");
+        return NULL;
+    }
+
+    return unserialize_common(header, handler);
+}
+
+extern pino_validate_result_t pino_record_scan(const void *src, size_t size, handler_cache_t *cache, pino_header_t *header, size_t *record_size)
+{
+    pino_handler_t *handler;
+    size_t payload_size;
+    uint64_t packed_size;
+
+    if (!pino_peek(src, size, header)) {
+        return PINO_VALIDATE_TRUNCATED;
+    }
+
+    if (cache->handler && magic_equal(cache->magic, header->magic)) {
+        handler = cache->handler;
+    } else {
+        handler = pino_handler_find(header->magic);
+        if (!handler) {
+            return PINO_VALIDATE_HANDLER_MISSING;
+        }
+
+        pmemcpy(cache->magic, header->magic, sizeof(pino_magic_t));
+        cache->handler = handler;
+    }
+
+    if (header->static_fields_size != handler->static_fields_size) {
+        return PINO_VALIDATE_STATIC_FIELDS_SIZE;
+    }
+
+    /* compressed blocks carry their own size */
+    if (header->flags & PINO_SERIALIZE_COMPRESS) {
+        if (header->payload_size < PINO_COMPRESS_HEADER_SIZE) {
+            return PINO_VALIDATE_TRUNCATED;
+        }
+
+        pmemcpy_l2n(&packed_size, ((const char *)header->payload) + sizeof(uint64_t), sizeof(uint64_t));
+        if (packed_size > (uint64_t)(header->payload_size - PINO_COMPRESS_HEADER_SIZE)) {
+            return PINO_VALIDATE_TRUNCATED;
+        }
+        payload_size = PINO_COMPRESS_HEADER_SIZE + (size_t)packed_size;
+    } else if (*(const uint8_t *)src & PINO_COMPACT_MARKER) {
+        /* compact headers carry the payload size */
+        payload_size = header->payload_size;
+    } else if (!handler->payload_size) {
+        /* classic records are self-delimiting only through payload_size */
+        return PINO_VALIDATE_PAYLOAD;
+    } else {
+        payload_size = pino_handler_payload_size(handler, header->static_fields);
+        if (payload_size > header->payload_size) {
+            return PINO_VALIDATE_TRUNCATED;
+        }
+    }
+    header->payload_size = payload_size;
+
+    /* the trailer follows the payload, peek only made room for it at the end of src */
+    *record_size = (size_t)((const uint8_t *)header->payload - (const uint8_t *)src) + payload_size +
+        ((header->flags & PINO_SERIALIZE_CRC32C) ? PINO_CHECKSUM_SIZE : 0);
 
-extern bool pino_init(void)
-{
-    return pino_handler_init(HANDLER_STEP);
+    return PINO_VALIDATE_OK;
 }
 
-extern void pino_free(void)
+extern pino_t *pino_record_unserialize(const pino_header_t *header, pino_handler_t *handler)
 {
-    pino_handler_free();
+    pino_header_t record = *header;
+
+    return unserialize_record(&record, handler, true);
 }
 
-extern size_t pino_serialize_size(const pino_t *pino)
+extern pino_validate_result_t pino_validate(const void *src, size_t size)
 {
-    if (!pino) {
-        return 0;
+    pino_header_t header;
+    pino_handler_t *handler;
+    pino_validate_result_t result;
+    uint64_t raw_size, packed_size;
+
+    result = validate_header(src, size, &header, &handler);
+    if (result != PINO_VALIDATE_OK) {
+        return result;
     }
 
-    PINO_SUPRTF("magic: %.4s, serialize_size: %zu, magic_size: %zu", pino->magic, pino->handler->serialize_size(pino->this, pino->static_fields), sizeof(pino_magic_t));
+    /* the block is walked without unpacking it, the raw payload is only seen by unserialize */
+    if (header.flags & PINO_SERIALIZE_COMPRESS) {
+        result = packed_payload(&header, &raw_size, &packed_size);
+        if (result == PINO_VALIDATE_OK &&
+            !pino_lz_validate((size_t)raw_size, ((const uint8_t *)header.payload) + PINO_COMPRESS_HEADER_SIZE, (size_t)packed_size)
+        ) {
+            result = PINO_VALIDATE_PAYLOAD;
+        }
+
+        return result;
+    }
 
-    return pino->handler->serialize_size(pino->this, pino->static_fields) + sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t) + pino->static_fields_size;
+    if (!pino_record_checksum(&header)) {
+        return PINO_VALIDATE_CHECKSUM;
+    }
+
+    return validate_payload(&header, handler);
 }
 
-extern bool pino_serialize(const pino_t *pino, void *dest)
+extern pino_t *pino_unserialize(const void *src, size_t size)
 {
-    if (!pino || !dest) {
-        return false;
+    pino_header_t header;
+    pino_handler_t *handler;
+
+    if (validate_header(src, size, &header, &handler) != PINO_VALIDATE_OK) {
+        return NULL;
     }
 
-    pmemcpy(dest, pino->magic, sizeof(pino_magic_t));
-    pmemcpy_n2l(((char *)dest) + sizeof(pino_magic_t), &pino->static_fields_size, sizeof(pino_static_fields_size_t));
+    return unserialize_record(&header, handler, true);
+}
 
-    /* fields always use LE */
-    pmemcpy(((char *)dest) + sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t), pino->static_fields, pino->static_fields_size);
+extern pino_t *pino_unserialize_validated(const void *src, size_t size)
+{
+    pino_header_t header;
+    pino_handler_t *handler;
 
-    return pino->handler->serialize(pino->this, pino->static_fields, ((char *)dest) + sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t) + pino->handler->static_fields_size);
+    if (validate_header(src, size, &header, &handler) != PINO_VALIDATE_OK) {
+        return NULL;
+    }
+
+    return unserialize_record(&header, handler, false);
 }
 
-extern pino_t *pino_unserialize(const void *src, size_t size)
+extern pino_t *pino_unserialize_lazy(const void *src, size_t size)
 {
     pino_t *pino;
+    pino_header_t header;
     pino_handler_t *handler;
-    pino_magic_safe_t magic;
-    pino_static_fields_size_t fields_size;
 
-    if (!src) {
+    if (validate_header(src, size, &header, &handler) != PINO_VALIDATE_OK) {
         return NULL;
     }
 
-    if (size < sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t)) {
+    /* a compressed payload has to be unpacked anyway, there is nothing to defer; the byte order is only known now */
+    if (header.flags & (PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_NATIVE)) {
+        return unserialize_record(&header, handler, true);
+    }
+
+    /* nothing is copied here, so the checksum is checked up front */
+    if (!pino_record_checksum(&header) || validate_payload(&header, handler) != PINO_VALIDATE_OK) {
+        PINO_SUPRTF("payload validation failed");
         return NULL;
     }
 
-    pmemcpy(magic, src, sizeof(pino_magic_t));
-    pmemcpy_l2n(&fields_size, ((char *)src) + sizeof(pino_magic_t), sizeof(pino_static_fields_size_t));
+    pino = pino_create((char *)header.magic, handler, header.payload_size);
+    if (!pino) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    pino_static_fields_from_wire(handler, pino->static_fields, header.static_fields);
+    pino->lazy_src = header.payload;
+    pino->lazy_size = header.payload_size;
+    pino->lazy_state = LAZY_PENDING;
 
-    if (size < sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t) + fields_size) {
+    return pino;
+}
+
+extern pino_t *pino_unserialize_adopt(void *src, size_t size, pino_adopt_free_t free_fn)
+{
+    pino_t *pino;
+    pino_header_t header;
+    pino_handler_t *handler;
+
+    if (!free_fn || validate_header(src, size, &header, &handler) != PINO_VALIDATE_OK) {
         return NULL;
     }
 
-    handler = pino_handler_find(magic);
-    if (!handler) {
+    if (header.flags & PINO_SERIALIZE_COMPRESS) {
+        pino = unserialize_record(&header, handler, true);
+        if (pino) {
+            free_fn(src);
+        }
+
+        return pino;
+    }
+
+    if (validate_payload(&header, handler) != PINO_VALIDATE_OK) {
+        PINO_SUPRTF("payload validation failed");
         return NULL;
     }
 
-    pino = pino_create(magic, handler, size - sizeof(pino_magic_t) - sizeof(pino_static_fields_size_t) - fields_size);
-    if (!pino) {
-        return NULL; /* LCOV_EXCL_LINE */
+    if (!handler->adopt || header.payload_size == 0 || payload_foreign(header.flags)) {
+        pino = unserialize_common(&header, handler);
+        if (pino) {
+            free_fn(src);
+        }
+
+        return pino;
     }
 
-    /* always LE */
-    pmemcpy(pino->static_fields, ((char *)src) + sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t), fields_size);
-    if (!handler->unserialize(pino->this, pino->static_fields, ((char *)src) + sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t) + fields_size, size)) {
-        pino_destroy(pino);
+    /* the payload is taken over without a copy to fuse the check into */
+    if (!pino_record_checksum(&header)) {
+        PINO_SUPRTF("checksum mismatch");
         return NULL;
     }
-    
+
+    pino = create_common((char *)header.magic, handler, (void *)header.payload, header.payload_size, header.static_fields);
+    if (!pino) {
+        return NULL;
+    }
+
+    pino->adopted = src;
+    pino->adopted_free = free_fn;
+
     return pino;
 }
 
+extern bool pino_is_loaded(const pino_t *pino)
+{
+    return pino && patomic_load(&pino->lazy_state) == LAZY_LOADED;
+}
+
 extern pino_t *pino_pack(pino_magic_safe_t magic, const void *src, size_t size)
 {
     pino_t *pino;
@@ -147,8 +1108,48 @@ extern pino_t *pino_pack(pino_magic_safe_t magic, const void *src, size_t size)
     return pino;
 }
 
+extern pino_t *pino_pack_adopt(pino_magic_safe_t magic, void *buf, size_t size, pino_adopt_free_t free_fn)
+{
+    pino_t *pino;
+    pino_handler_t *handler;
+
+    if (!buf || !free_fn) {
+        return NULL;
+    }
+
+    handler = pino_handler_find(magic);
+    if (!handler) {
+        PINO_SUPRTF("handler not found : %s", magic);
+        return NULL;
+    }
+
+    if (!handler->adopt || size == 0) {
+        pino = pino_pack(magic, buf, size);
+        if (pino) {
+            free_fn(buf);
+        }
+
+        return pino;
+    }
+
+    pino = create_common(magic, handler, buf, size, NULL);
+    if (!pino) {
+        PINO_SUPRTF("handler->adopt failed");
+        return NULL;
+    }
+
+    pino->adopted = buf;
+    pino->adopted_free = free_fn;
+
+    return pino;
+}
+
 extern size_t pino_unpack_size(const pino_t *pino)
 {
+    if (!pino_ensure_payload(pino)) {
+        return 0;
+    }
+
     PINO_SUPRTF("magic: %.4s, unpack_size: %zu", pino->magic, pino->handler->unpack_size(pino->this, pino->static_fields));
 
     return pino->handler->unpack_size(pino->this, pino->static_fields);
@@ -156,26 +1157,395 @@ extern size_t pino_unpack_size(const pino_t *pino)
 
 extern bool pino_unpack(const pino_t *pino, void *dest)
 {
+    if (!pino_ensure_payload(pino)) {
+        return false;
+    }
+
     return pino->handler->unpack(pino->this, pino->static_fields, dest);
 }
 
+extern bool pino_unpack_view(const pino_t *pino, const void **ptr, size_t *len)
+{
+    if (!pino || !ptr || !len) {
+        return false;
+    }
+
+    if (!pino->handler->unpack_view || !pino_ensure_payload(pino)) {
+        return false;
+    }
+
+    return pino->handler->unpack_view(pino->this, pino->static_fields, ptr, len);
+}
+
+static inline void destroy_payload(pino_handler_t *handler, void *this, void *static_fields, void *adopted, pino_adopt_free_t adopted_free)
+{
+    if (this) {
+        handler->destroy(this, static_fields);
+    }
+
+    if (adopted) {
+        adopted_free(adopted);
+    }
+}
+
+static inline void share_release(pino_share_t *share, pino_handler_t *handler, void *static_fields)
+{
+    if (patomic_dec(&share->refcount) > 0) {
+        return;
+    }
+
+    destroy_payload(handler, share->this, static_fields, share->adopted, share->adopted_free);
+    pfree(share);
+}
+
+static inline void *duplicate_this(const pino_t *pino)
+{
+    void *this, *static_fields;
+    uint8_t *buf;
+    size_t size;
+
+    size = pino->handler->serialize_size(pino->this, pino->static_fields);
+    buf = (uint8_t *)pmalloc(size > 0 ? size : 1);
+    static_fields = pmalloc(static_fields_memory_size(pino->handler) > 0 ? static_fields_memory_size(pino->handler) : 1);
+    /* LCOV_EXCL_START */
+    if (!buf || !static_fields) {
+        if (buf) {
+            pfree(buf);
+        }
+        if (static_fields) {
+            pfree(static_fields);
+        }
+        return NULL;
+    }
+    /* LCOV_EXCL_STOP */
+
+    this = NULL;
+    pmemcpy(static_fields, pino->static_fields, static_fields_memory_size(pino->handler));
+    if (pino->handler->serialize(pino->this, pino->static_fields, buf)) {
+        this = pino->handler->create(size, pino->static_fields);
+        /* create may initialize static fields, keep the current ones */
+        pmemcpy(pino->static_fields, static_fields, static_fields_memory_size(pino->handler));
+        if (this && !pino->handler->unserialize(this, pino->static_fields, buf, size)) {
+            pino->handler->destroy(this, pino->static_fields);
+            this = NULL;
+        }
+    }
+
+    pfree(static_fields);
+    pfree(buf);
+
+    return this;
+}
+
+extern pino_t *pino_retain(pino_t *pino)
+{
+    if (!pino) {
+        return NULL;
+    }
+
+    patomic_inc(&pino->refcount);
+
+    return pino;
+}
+
+extern void pino_release(pino_t *pino)
+{
+    pino_destroy(pino);
+}
+
+extern pino_t *pino_clone(pino_t *pino)
+{
+    pino_t *clone;
+    pino_share_t *share;
+
+    if (!pino || !pino_ensure_payload(pino)) {
+        return NULL;
+    }
+
+    share = pino->share;
+    if (!share) {
+        share = (pino_share_t *)pmalloc(sizeof(pino_share_t));
+        if (!share) {
+            return NULL; /* LCOV_EXCL_LINE */
+        }
+
+        share->refcount = 1;
+        share->this = pino->this;
+        share->adopted = pino->adopted;
+        share->adopted_free = pino->adopted_free;
+
+        if (patomic_cas_ptr(&pino->share, NULL, share)) {
+            pino->adopted = NULL;
+            pino->adopted_free = NULL;
+        } else {
+            /* LCOV_EXCL_START */
+            pfree(share);
+            share = pino->share;
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    clone = (pino_t *)pmalloc(sizeof(pino_t));
+    if (!clone) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    *clone = *pino;
+    clone->static_fields = pmalloc(static_fields_memory_size(pino->handler) > 0 ? static_fields_memory_size(pino->handler) : 1);
+    if (!clone->static_fields) {
+        /* LCOV_EXCL_START */
+        pfree(clone);
+        return NULL;
+        /* LCOV_EXCL_STOP */
+    }
+    pmemcpy(clone->static_fields, pino->static_fields, static_fields_memory_size(pino->handler));
+    clone->lazy_src = NULL;
+    clone->lazy_size = 0;
+    clone->lazy_state = LAZY_LOADED;
+    clone->adopted = NULL;
+    clone->adopted_free = NULL;
+    clone->refcount = 1;
+    clone->share = share;
+    clone->cache = NULL;
+
+    patomic_inc(&share->refcount);
+
+    return clone;
+}
+
+extern bool pino_touch(pino_t *pino)
+{
+    pino_share_t *share;
+    void *this;
+
+    if (!pino || !pino_ensure_payload(pino)) {
+        return false;
+    }
+
+    record_cache_drop(pino);
+
+    share = pino->share;
+    if (!share) {
+        return true;
+    }
+
+    if (patomic_load(&share->refcount) == 1) {
+        /* last one standing, take the payload back */
+        pino->adopted = share->adopted;
+        pino->adopted_free = share->adopted_free;
+        pino->share = NULL;
+        pfree(share);
+
+        return true;
+    }
+
+    this = duplicate_this(pino);
+    if (!this) {
+        PINO_SUPRTF("duplicate_this failed");
+        return false;
+    }
+
+    pino->this = this;
+    pino->share = NULL;
+    share_release(share, pino->handler, pino->static_fields);
+
+    return true;
+}
+
 extern void pino_destroy(pino_t *pino)
 {
     if (!pino) {
         return;
     }
 
-    if (pino->this) {
-        pino->handler->destroy(pino->this, pino->static_fields);
+    if (patomic_dec(&pino->refcount) > 0) {
+        return;
+    }
+
+    if (pino->share) {
+        share_release(pino->share, pino->handler, pino->static_fields);
+    } else {
+        destroy_payload(pino->handler, pino->this, pino->static_fields, pino->adopted, pino->adopted_free);
     }
 
     if (pino->static_fields) {
         pfree(pino->static_fields);
     }
 
+    record_cache_drop(pino);
     pfree(pino);
 }
 
+extern size_t pino_compact_header(const uint8_t *src, size_t size, pino_header_t *header)
+{
+    uint64_t fields_size, payload_size;
+    size_t offset, n;
+    uint16_t alias;
+
+    if (size == 0 || ((src[0] >> PINO_COMPACT_VERSION_SHIFT) & 0x3) != PINO_COMPACT_VERSION) {
+        return 0;
+    }
+
+    offset = 1;
+    switch (src[0] & 0x3) {
+        case PINO_COMPACT_MAGIC_FULL:
+            if (size < offset + sizeof(pino_magic_t)) {
+                return 0;
+            }
+            pmemcpy(header->magic, src + offset, sizeof(pino_magic_t));
+            header->magic[sizeof(pino_magic_t)] = '\0';
+            offset += sizeof(pino_magic_t);
+            break;
+        case PINO_COMPACT_MAGIC_ALIAS8:
+        case PINO_COMPACT_MAGIC_ALIAS16:
+            n = src[0] & 0x3;
+            if (size < offset + n) {
+                return 0;
+            }
+            alias = n == 1 ? src[offset] : (uint16_t)(src[offset] | (src[offset + 1] << 8));
+            if (!pino_handler_find_alias(alias, header->magic)) {
+                return 0;
+            }
+            offset += n;
+            break;
+        default:
+            return 0;
+    }
+
+    n = leb128_read(src + offset, size - offset, &fields_size);
+    if (n == 0) {
+        return 0;
+    }
+    offset += n;
+
+    n = leb128_read(src + offset, size - offset, &payload_size);
+    if (n == 0 || payload_size > (uint64_t)SIZE_MAX) {
+        return 0;
+    }
+    offset += n;
+
+    header->static_fields_size = (pino_static_fields_size_t)fields_size;
+    header->payload_size = (size_t)payload_size;
+    header->flags = (uint32_t)((src[0] >> PINO_COMPACT_FLAGS_SHIFT) & 0x7);
+    header->header_size = offset;
+
+    return offset;
+}
+
+static inline bool peek_compact(const uint8_t *src, size_t size, pino_header_t *header)
+{
+    size_t offset, trailer;
+
+    offset = pino_compact_header(src, size, header);
+    if (offset == 0) {
+        return false;
+    }
+
+    /* the sizes are explicit, anything after the record is left to the caller */
+    trailer = (header->flags & PINO_SERIALIZE_CRC32C) ? PINO_CHECKSUM_SIZE : 0;
+    if (header->static_fields_size > (pino_static_fields_size_t)(size - offset) ||
+        header->payload_size > size - offset - (size_t)header->static_fields_size ||
+        trailer > size - offset - (size_t)header->static_fields_size - header->payload_size
+    ) {
+        return false;
+    }
+
+    header->static_fields = src + offset;
+    header->payload = src + offset + (size_t)header->static_fields_size;
+
+    return true;
+}
+
+extern bool pino_peek(const void *src, size_t size, pino_header_t *header)
+{
+    pino_static_fields_size_t fields_size;
+    uint32_t flags;
+    size_t trailer, alignment, offset, payload;
+
+    if (!src || !header || size == 0) {
+        return false;
+    }
+
+    if (*(const uint8_t *)src & PINO_COMPACT_MARKER) {
+        return peek_compact((const uint8_t *)src, size, header);
+    }
+
+    if (size < PINO_HEADER_SIZE) {
+        return false;
+    }
+
+    pmemcpy_l2n(&fields_size, ((const char *)src) + sizeof(pino_magic_t), sizeof(pino_static_fields_size_t));
+
+    flags = (uint32_t)(fields_size >> PINO_FLAGS_SHIFT);
+    fields_size &= (((pino_static_fields_size_t)1) << PINO_FLAGS_SHIFT) - 1;
+    if (flags & ~PINO_FLAGS_WIRE) {
+        PINO_SUPRTF("unknown flags: %u", (unsigned)flags);
+        return false;
+    }
+
+    trailer = (flags & PINO_SERIALIZE_CRC32C) ? PINO_CHECKSUM_SIZE : 0;
+    alignment = flags_alignment(flags);
+    offset = align_up(PINO_HEADER_SIZE, alignment);
+    if (size < offset || size - offset < trailer || fields_size > size - offset - trailer) {
+        return false;
+    }
+
+    payload = align_up(offset + (size_t)fields_size, alignment);
+    if (payload > size - trailer) {
+        return false;
+    }
+
+    pmemcpy(header->magic, src, sizeof(pino_magic_t));
+    header->magic[sizeof(pino_magic_t)] = '\0';
+    header->static_fields_size = fields_size;
+    header->static_fields = ((const char *)src) + offset;
+    header->payload = ((const char *)src) + payload;
+    header->payload_size = size - payload - trailer;
+    header->flags = flags;
+    header->header_size = offset;
+
+    return true;
+}
+
+extern const void *pino_peek_payload(const void *src, size_t size, size_t alignment, pino_header_t *header)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || !pino_peek(src, size, header)) {
+        return NULL;
+    }
+
+    if (flags_alignment(header->flags) < alignment || ((uintptr_t)header->payload & (alignment - 1)) != 0) {
+        return NULL;
+    }
+
+    /* the handler knows the element sizes, so only a payload that needs no swap at all is handed out */
+    if ((header->flags & PINO_SERIALIZE_COMPRESS) || payload_foreign(header->flags)) {
+        return NULL;
+    }
+
+    if (!pino_record_checksum(header)) {
+        PINO_SUPRTF("checksum mismatch");
+        return NULL;
+    }
+
+    return header->payload;
+}
+
+extern bool pino_peek_static(const pino_header_t *header, size_t offset, void *dest, size_t size)
+{
+    if (!header || !dest) {
+        return false;
+    }
+
+    if (offset > header->static_fields_size || size > header->static_fields_size - offset) {
+        return false;
+    }
+
+    /* fields always use LE */
+    pmemcpy_l2n(dest, ((const char *)header->static_fields) + offset, size);
+
+    return true;
+}
+
 extern uint32_t pino_version_id()
 {
     return (uint32_t)PINO_VERSION_ID;
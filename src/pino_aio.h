@@ -0,0 +1,40 @@
+/*
+ * libpino - pino_aio.h
+ * 
+ */
+
+#ifndef PINO_AIO_H
+#define PINO_AIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pino/container.h>
+
+#include "pino_file.h"
+
+typedef struct _paio_t paio_t;
+
+/* called from paio_reap() on the reaping thread, result is false for failed or short transfers */
+typedef void (*paio_done_t)(void *arg, void *user, bool result);
+
+/* PINO_ASYNC_AUTO picks io_uring when the kernel has it, NULL if the requested backend is missing */
+paio_t *paio_create(pfd_t fd, size_t depth, pino_async_backend_t backend);
+pino_async_backend_t paio_backend(const paio_t *aio);
+/* pins buffers for fixed transfers, false just means plain transfers are used */
+bool paio_register(paio_t *aio, void *const *buffers, size_t count, size_t size);
+/* false when depth requests are already in flight, buf_index is a registered buffer or -1 */
+bool paio_write(paio_t *aio, const void *src, size_t size, uint64_t offset, int buf_index, void *user);
+bool paio_read(paio_t *aio, void *dest, size_t size, uint64_t offset, int buf_index, void *user);
+/* a write chained to a data sync, the result covers both */
+bool paio_write_sync(paio_t *aio, const void *src, size_t size, uint64_t offset, void *user);
+/* hands queued requests to the backend */
+bool paio_submit(paio_t *aio);
+/* submits, then runs fn for every finished request, waits for at least one if wait and any are in flight */
+size_t paio_reap(paio_t *aio, bool wait, paio_done_t fn, void *arg);
+size_t paio_inflight(const paio_t *aio);
+/* waits for everything in flight, the fd stays open */
+void paio_destroy(paio_t *aio, paio_done_t fn, void *arg);
+
+#endif  /* PINO_AIO_H */
@@ -0,0 +1,563 @@
+/*
+ * libpino - pino_file.h
+ * 
+ */
+
+#ifndef PINO_FILE_H
+#define PINO_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+# define PINO_MMAP_AVAILABLE 1
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define PINO_MMAP_AVAILABLE 1
+#else
+# define PINO_MMAP_AVAILABLE 0
+#endif
+
+/* 64bit file offsets, sources define _FILE_OFFSET_BITS before any include */
+#if defined(_WIN32)
+# define pfseek(fp, offset, whence)         _fseeki64(fp, (__int64)(offset), whence)
+# define pftell(fp)                         ((int64_t)_ftelli64(fp))
+#else
+# define pfseek(fp, offset, whence)         fseeko(fp, (off_t)(offset), whence)
+# define pftell(fp)                         ((int64_t)ftello(fp))
+#endif
+
+static inline bool pfwrite(FILE *fp, const void *src, size_t size)
+{
+    return fwrite(src, 1, size, fp) == size;
+}
+
+static inline bool pfread(FILE *fp, void *dest, size_t size)
+{
+    return fread(dest, 1, size, fp) == size;
+}
+
+typedef struct {
+    void *addr;
+    size_t size;
+} pmap_t;
+
+/* read-only mapping of a whole file */
+static inline bool pmap_open(const char *path, pmap_t *map)
+{
+#if defined(_WIN32)
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+
+    map->addr = NULL;
+    map->size = 0;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+
+    /* the view keeps the mapping alive */
+    map->addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    map->size = (size_t)size.QuadPart;
+
+    return map->addr != NULL;
+#elif PINO_MMAP_AVAILABLE
+    struct stat st;
+    void *addr;
+    int fd;
+
+    map->addr = NULL;
+    map->size = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    map->addr = addr;
+    map->size = (size_t)st.st_size;
+
+    return true;
+#else
+    map->addr = NULL;
+    map->size = 0;
+
+    return false;
+#endif
+}
+
+static inline void pmap_close(pmap_t *map)
+{
+    if (!map->addr) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(map->addr);
+#elif PINO_MMAP_AVAILABLE
+    munmap(map->addr, map->size);
+#endif
+
+    map->addr = NULL;
+    map->size = 0;
+}
+
+/* hints only, failures are ignored */
+static inline void pmap_advise_sequential(const pmap_t *map)
+{
+#if !defined(_WIN32) && PINO_MMAP_AVAILABLE && defined(MADV_SEQUENTIAL)
+    madvise(map->addr, map->size, MADV_SEQUENTIAL);
+#else
+    (void)map;
+#endif
+}
+
+static inline void pmap_advise_willneed(const pmap_t *map, size_t offset, size_t size)
+{
+#if !defined(_WIN32) && PINO_MMAP_AVAILABLE && defined(MADV_WILLNEED)
+    uintptr_t page, begin;
+
+    if (offset >= map->size) {
+        return;
+    }
+
+    size = size < map->size - offset ? size : map->size - offset;
+    page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    begin = ((uintptr_t)map->addr + offset) & ~(page - 1);
+    madvise((void *)begin, (uintptr_t)map->addr + offset + size - begin, MADV_WILLNEED);
+#else
+    (void)map;
+    (void)offset;
+    (void)size;
+#endif
+}
+
+/* append-only descriptor with explicit durability */
+#if defined(_WIN32)
+typedef HANDLE pfd_t;
+# define PFD_INVALID                        INVALID_HANDLE_VALUE
+#else
+typedef int pfd_t;
+# define PFD_INVALID                        (-1)
+#endif
+
+static inline pfd_t pfd_open_append(const char *path)
+{
+#if defined(_WIN32)
+    return CreateFileA(path, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+#elif PINO_MMAP_AVAILABLE
+    return open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+#else
+    (void)path;
+
+    return PFD_INVALID;
+#endif
+}
+
+static inline pfd_t pfd_open(const char *path, bool write)
+{
+#if defined(_WIN32)
+    return write ?
+        CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL) :
+        CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#elif PINO_MMAP_AVAILABLE
+    return write ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+#else
+    (void)path;
+    (void)write;
+
+    return PFD_INVALID;
+#endif
+}
+
+/* positional, never moves a file pointer shared with other threads */
+static inline bool pfd_pwrite(pfd_t fd, const void *src, size_t size, uint64_t offset)
+{
+#if defined(_WIN32)
+    OVERLAPPED ov;
+    DWORD written, chunk;
+
+    while (size > 0) {
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        if (!WriteFile(fd, src, chunk, &written, &ov) || written == 0) {
+            return false;
+        }
+        src = ((const char *)src) + written;
+        size -= written;
+        offset += written;
+    }
+
+    return true;
+#elif PINO_MMAP_AVAILABLE
+    ssize_t written;
+
+    while (size > 0) {
+        written = pwrite(fd, src, size, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        src = ((const char *)src) + written;
+        size -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+
+    return true;
+#else
+    (void)fd;
+    (void)src;
+    (void)offset;
+
+    return size == 0;
+#endif
+}
+
+static inline bool pfd_pread(pfd_t fd, void *dest, size_t size, uint64_t offset)
+{
+#if defined(_WIN32)
+    OVERLAPPED ov;
+    DWORD read, chunk;
+
+    while (size > 0) {
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        if (!ReadFile(fd, dest, chunk, &read, &ov) || read == 0) {
+            return false;
+        }
+        dest = ((char *)dest) + read;
+        size -= read;
+        offset += read;
+    }
+
+    return true;
+#elif PINO_MMAP_AVAILABLE
+    ssize_t read_size;
+
+    while (size > 0) {
+        read_size = pread(fd, dest, size, (off_t)offset);
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size <= 0) {
+            return false;
+        }
+        dest = ((char *)dest) + read_size;
+        size -= (size_t)read_size;
+        offset += (uint64_t)read_size;
+    }
+
+    return true;
+#else
+    (void)fd;
+    (void)dest;
+    (void)offset;
+
+    return size == 0;
+#endif
+}
+
+static inline bool pfd_write(pfd_t fd, const void *src, size_t size)
+{
+#if defined(_WIN32)
+    DWORD written, chunk;
+
+    while (size > 0) {
+        chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        if (!WriteFile(fd, src, chunk, &written, NULL) || written == 0) {
+            return false;
+        }
+        src = ((const char *)src) + written;
+        size -= written;
+    }
+
+    return true;
+#elif PINO_MMAP_AVAILABLE
+    ssize_t written;
+
+    while (size > 0) {
+        written = write(fd, src, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        src = ((const char *)src) + written;
+        size -= (size_t)written;
+    }
+
+    return true;
+#else
+    (void)fd;
+    (void)src;
+
+    return size == 0;
+#endif
+}
+
+static inline bool pfd_sync(pfd_t fd)
+{
+#if defined(_WIN32)
+    return FlushFileBuffers(fd) != 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#elif PINO_MMAP_AVAILABLE
+    return fsync(fd) == 0;
+#else
+    (void)fd;
+
+    return false;
+#endif
+}
+
+static inline bool pfd_close(pfd_t fd)
+{
+#if defined(_WIN32)
+    return CloseHandle(fd) != 0;
+#elif PINO_MMAP_AVAILABLE
+    return close(fd) == 0;
+#else
+    (void)fd;
+
+    return false;
+#endif
+}
+
+static inline bool pfile_truncate(const char *path, uint64_t size)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER offset;
+    HANDLE file;
+    bool result;
+
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    offset.QuadPart = (LONGLONG)size;
+    result = SetFilePointerEx(file, offset, NULL, FILE_BEGIN) && SetEndOfFile(file);
+
+    return CloseHandle(file) && result;
+#elif PINO_MMAP_AVAILABLE
+    return truncate(path, (off_t)size) == 0;
+#else
+    (void)path;
+    (void)size;
+
+    return false;
+#endif
+}
+
+/* writable mapping of a file that is being created */
+typedef struct {
+    void *addr;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file;
+#else
+    int fd;
+#endif
+} pmap_file_t;
+
+static inline bool pmap_file_create(const char *path, pmap_file_t *mf)
+{
+    mf->addr = NULL;
+    mf->size = 0;
+
+#if defined(_WIN32)
+    mf->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    return mf->file != INVALID_HANDLE_VALUE;
+#elif PINO_MMAP_AVAILABLE
+    mf->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    return mf->fd >= 0;
+#else
+    (void)path;
+
+    return false;
+#endif
+}
+
+static inline void pmap_file_unmap(pmap_file_t *mf)
+{
+    if (!mf->addr) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(mf->addr);
+#elif PINO_MMAP_AVAILABLE
+    munmap(mf->addr, mf->size);
+#endif
+
+    mf->addr = NULL;
+}
+
+#if defined(_WIN32)
+static inline bool pmap_file_truncate(pmap_file_t *mf, size_t size)
+{
+    LARGE_INTEGER offset;
+
+    offset.QuadPart = (LONGLONG)size;
+
+    return SetFilePointerEx(mf->file, offset, NULL, FILE_BEGIN) && SetEndOfFile(mf->file);
+}
+#elif PINO_MMAP_AVAILABLE
+static inline bool pmap_file_truncate(pmap_file_t *mf, size_t size)
+{
+    return ftruncate(mf->fd, (off_t)size) == 0;
+}
+#endif
+
+/* reserves size bytes on disk and maps all of them, old contents are kept */
+static inline bool pmap_file_resize(pmap_file_t *mf, size_t size)
+{
+#if defined(_WIN32)
+    HANDLE mapping;
+    LARGE_INTEGER large;
+
+    pmap_file_unmap(mf);
+
+    large.QuadPart = (LONGLONG)size;
+    mapping = CreateFileMappingA(mf->file, NULL, PAGE_READWRITE, (DWORD)(large.QuadPart >> 32), (DWORD)(large.QuadPart & 0xFFFFFFFF), NULL);
+    if (!mapping) {
+        return false;
+    }
+
+    mf->addr = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    CloseHandle(mapping);
+    mf->size = mf->addr ? size : 0;
+
+    return mf->addr != NULL;
+#elif PINO_MMAP_AVAILABLE
+    void *addr;
+# if defined(__linux__)
+    int error;
+# endif
+
+    pmap_file_unmap(mf);
+
+    /* real blocks where supported so a full disk fails here and not as SIGBUS later */
+# if defined(__linux__)
+    error = posix_fallocate(mf->fd, 0, (off_t)size);
+    if (error == ENOSPC || error == EFBIG || (error != 0 && !pmap_file_truncate(mf, size))) {
+        return false;
+    }
+# else
+    if (!pmap_file_truncate(mf, size)) {
+        return false;
+    }
+# endif
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mf->fd, 0);
+    if (addr == MAP_FAILED) {
+        mf->size = 0;
+        return false;
+    }
+
+    mf->addr = addr;
+    mf->size = size;
+
+    return true;
+#else
+    (void)mf;
+    (void)size;
+
+    return false;
+#endif
+}
+
+/* flushes the mapping once, cuts the file to size and closes it */
+static inline bool pmap_file_finish(pmap_file_t *mf, size_t size)
+{
+#if defined(_WIN32)
+    bool result;
+
+    result = FlushViewOfFile(mf->addr, size) != 0;
+    pmap_file_unmap(mf);
+    result = pmap_file_truncate(mf, size) && result;
+    result = FlushFileBuffers(mf->file) && result;
+    result = CloseHandle(mf->file) && result;
+    mf->file = INVALID_HANDLE_VALUE;
+
+    return result;
+#elif PINO_MMAP_AVAILABLE
+    bool result;
+
+    result = msync(mf->addr, size, MS_SYNC) == 0;
+    pmap_file_unmap(mf);
+    result = pmap_file_truncate(mf, size) && result;
+    result = close(mf->fd) == 0 && result;
+    mf->fd = -1;
+
+    return result;
+#else
+    (void)mf;
+    (void)size;
+
+    return false;
+#endif
+}
+
+static inline void pmap_file_abort(pmap_file_t *mf)
+{
+    pmap_file_unmap(mf);
+
+#if defined(_WIN32)
+    if (mf->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(mf->file);
+        mf->file = INVALID_HANDLE_VALUE;
+    }
+#elif PINO_MMAP_AVAILABLE
+    if (mf->fd >= 0) {
+        close(mf->fd);
+        mf->fd = -1;
+    }
+#endif
+}
+
+#endif  /* PINO_FILE_H */
@@ -21,8 +21,59 @@
 #include <pino/handler.h>
 #include <pino/endianness.h>
 
+#include "pino_thread.h"
+
 #define HANDLER_STEP        8
 #define MM_STEP             16
+#if PINO_THREADS_AVAILABLE
+# define MM_SHARDS          16
+#else
+# define MM_SHARDS          1
+#endif
+#define DECODER_STEP        256
+#define BATCH_GROUP_MAX     16
+#define BATCH_WINDOW        64
+#define POOL_STEP           64
+#define POOL_GRAIN_MIN      64
+#define PARALLEL_CHUNK      (256 * 1024)
+#define PARALLEL_THRESHOLD  (4 * 1024 * 1024)
+#define STREAMING_THRESHOLD (32 * 1024 * 1024)
+#define CONTAINER_STEP      256
+#define CONTAINER_READAHEAD (4 * 1024 * 1024)
+#define MMAP_INITIAL_SIZE   (1024 * 1024)
+#define LOG_GROUP_BYTES     (1024 * 1024)
+#define LOG_SCAN_STEP       (64 * 1024)
+#define AIO_DEPTH           32
+#define AIO_DEPTH_MAX       4096
+#define AIO_WORKERS         2
+#define AIO_BUFFERS         8
+#define AIO_BUFFER_SIZE     (256 * 1024)
+#define COMPRESS_THRESHOLD  1024
+#define DELTA_GAP_MIN       8
+
+#define PINO_HEADER_SIZE    (sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t))
+#define PINO_CHECKSUM_SIZE  sizeof(uint32_t)
+/* a PINO_SERIALIZE_COMPRESS payload starts with the raw and the packed size (u64 LE) */
+#define PINO_COMPRESS_HEADER_SIZE   (2 * sizeof(uint64_t))
+
+/* the wire static_fields_size keeps PINO_SERIALIZE_* flags in its top byte */
+#define PINO_FLAGS_SHIFT    56
+#define PINO_FLAGS_ALIGN    ((uint32_t)PINO_SERIALIZE_ALIGN64)
+#define PINO_FLAGS_WIRE     ((uint32_t)(PINO_SERIALIZE_CRC32C | PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_NATIVE) | PINO_FLAGS_ALIGN)
+#define PINO_FLAGS_KNOWN    (PINO_FLAGS_WIRE | (uint32_t)PINO_SERIALIZE_COMPACT)
+
+/*
+ * compact header: marker | magic (4) or alias (1 - 2, LE) | static_fields_size (LEB128) | payload_size (LEB128)
+ * the marker is 1vvfffmm (version, wire flags, magic mode) and never an alphanumeric classic magic byte
+ */
+#define PINO_COMPACT_MARKER         0x80
+#define PINO_COMPACT_VERSION        1
+#define PINO_COMPACT_VERSION_SHIFT  5
+#define PINO_COMPACT_FLAGS_SHIFT    2
+#define PINO_COMPACT_MAGIC_FULL     0
+#define PINO_COMPACT_MAGIC_ALIAS8   1
+#define PINO_COMPACT_MAGIC_ALIAS16  2
+#define PINO_COMPACT_HEADER_MAX     (1 + sizeof(pino_magic_t) + 2 * LEB128_MAX)
 
 #define PINO_VERSION_ID 10000000
 
@@ -42,18 +93,96 @@
 #define prealloc(ptr, size)                 realloc(ptr, size)
 #define pfree(ptr)                          free(ptr)
 
+#if defined(__GNUC__) || defined(__clang__)
+# define pprefetch(ptr)                     __builtin_prefetch(ptr)
+#else
+# define pprefetch(ptr)                     ((void)(ptr))
+#endif
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+# define patomic_load(ptr)                  _InterlockedOr((volatile long *)(ptr), 0)
+# define patomic_inc(ptr)                   _InterlockedIncrement((volatile long *)(ptr))
+# define patomic_dec(ptr)                   _InterlockedDecrement((volatile long *)(ptr))
+# define patomic_store(ptr, value)          _InterlockedExchange((volatile long *)(ptr), (value))
+# define patomic_cas(ptr, old, new)         (_InterlockedCompareExchange((volatile long *)(ptr), (new), (old)) == (old))
+# define patomic_cas_ptr(ptr, old, new)     (_InterlockedCompareExchangePointer((void *volatile *)(ptr), (new), (old)) == (old))
+#elif defined(__GNUC__) || defined(__clang__)
+# define patomic_load(ptr)                  __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+# define patomic_inc(ptr)                   __atomic_add_fetch(ptr, 1, __ATOMIC_ACQ_REL)
+# define patomic_dec(ptr)                   __atomic_sub_fetch(ptr, 1, __ATOMIC_ACQ_REL)
+# define patomic_store(ptr, value)          __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+# define patomic_cas(ptr, old, new)         __sync_bool_compare_and_swap(ptr, old, new)
+# define patomic_cas_ptr(ptr, old, new)     __sync_bool_compare_and_swap(ptr, old, new)
+#else
+# define patomic_load(ptr)                  (*(ptr))
+# define patomic_inc(ptr)                   (++*(ptr))
+# define patomic_dec(ptr)                   (--*(ptr))
+# define patomic_store(ptr, value)          (*(ptr) = (value))
+# define patomic_cas(ptr, old, new)         ((*(ptr) == (old)) ? (*(ptr) = (new), true) : false)
+# define patomic_cas_ptr(ptr, old, new)     ((*(ptr) == (old)) ? (*(ptr) = (new), true) : false)
+# warning "Unknown compiler, reference counting is not thread safe"
+#endif
+
+/* pino->lazy_state, PENDING moves to LOADED or FAILED exactly once */
+#define LAZY_LOADED         0
+#define LAZY_PENDING        1
+#define LAZY_RUNNING        2
+#define LAZY_FAILED         3
+
+/* the record is followed by the static fields it was written from */
+struct _pino_cache_t {
+    pino_cache_t *stale;    /* replaced records that were viewed, they stay valid until the pino is touched */
+    size_t size;
+    uint64_t generation;
+    uint32_t flags;
+    uint32_t viewed;        /* handed out by pino_serialize_view(), otherwise freed once replaced */
+    uint8_t data[];
+};
+
+struct _pino_share_t {
+    pino_refcount_t refcount;
+    void *this;
+    void *adopted;
+    pino_adopt_free_t adopted_free;
+};
+
+/* in front of every handler allocation, keeps the returned pointer aligned like malloc()'s */
+typedef union {
+    struct {
+        size_t slot;    /* in the shard's blocks */
+        size_t shard;
+    } index;
+    long double align_ld;
+    uint64_t align_u64;
+    void *align_ptr;
+} mm_header_t;
+
+/* blocks is dense, frees move the last block into the hole */
 typedef struct {
     size_t usage;
     size_t capacity;
-    void **ptrs;
+    mm_header_t **blocks;
+    pmutex_t lock;
+} mm_shard_t;
+
+/* threads allocate from their own shard, so parallel decodes of one handler rarely share a lock */
+typedef struct {
+    mm_shard_t shards[MM_SHARDS];
 } mm_t;
 
 typedef struct {
     pino_magic_t magic;
+    uint16_t alias;     /* PINO_SERIALIZE_COMPACT short name, 0 for none */
     mm_t mm;
     pino_handler_t *handler;
 } handler_entry_t;
 
+typedef struct {
+    pino_magic_t magic;
+    pino_handler_t *handler;
+} handler_cache_t;
+
 static inline bool validate_magic(pino_magic_safe_t magic)
 {
     if (!magic) {
@@ -68,14 +197,181 @@ static inline bool validate_magic(pino_magic_safe_t magic)
         strlen((const char *)magic) == sizeof(pino_magic_t);
 }
 
+static inline bool host_big_endian(void)
+{
+    return !pino_endianness_le2native_noop(sizeof(uint16_t));
+}
+
+/* a payload carries PINO_SERIALIZE_NATIVE on the wire only when it is big endian */
+static inline uint32_t wire_flags(uint32_t flags)
+{
+    flags &= PINO_FLAGS_WIRE;
+
+    return host_big_endian() ? flags : (flags & ~(uint32_t)PINO_SERIALIZE_NATIVE);
+}
+
+/* the payload is in the other byte order, so the handler has to copy it instead of taking it as is */
+static inline bool payload_foreign(uint32_t flags)
+{
+    return ((flags & PINO_SERIALIZE_NATIVE) != 0) != host_big_endian();
+}
+
+/* the compact marker has no room for the alignment */
+static inline bool flags_valid(uint32_t flags)
+{
+    return !(flags & ~PINO_FLAGS_KNOWN) && !((flags & PINO_SERIALIZE_COMPACT) && (flags & PINO_FLAGS_ALIGN));
+}
+
+static inline size_t flags_alignment(uint32_t flags)
+{
+    switch (flags & PINO_FLAGS_ALIGN) {
+        case PINO_SERIALIZE_ALIGN8:
+            return 8;
+        case PINO_SERIALIZE_ALIGN16:
+            return 16;
+        case PINO_SERIALIZE_ALIGN64:
+            return 64;
+        default:
+            return 1;
+    }
+}
+
+/* bytes behind pino->static_fields */
+static inline size_t static_fields_memory_size(const pino_handler_t *handler)
+{
+    return handler->static_fields_layout ? handler->static_fields_memory_size : (size_t)handler->static_fields_size;
+}
+
+static inline size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 static inline bool magic_equal(pino_magic_t magic, pino_magic_safe_t smagic)
 {
     return strncmp(magic, smagic, sizeof(pino_magic_t)) == 0;
 }
 
+#define LEB128_MAX          10
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define LEB128_WORD_READ   1
+#else
+# define LEB128_WORD_READ   0
+#endif
+
+static inline size_t leb128_size(uint64_t value)
+{
+    size_t n = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+
+    return n;
+}
+
+static inline size_t leb128_write(uint8_t *dest, uint64_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        dest[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dest[n++] = (uint8_t)value;
+
+    return n;
+}
+
+/* bytes consumed, 0 on truncated or overlong input */
+static inline size_t leb128_read(const uint8_t *src, size_t size, uint64_t *value)
+{
+    uint64_t result = 0;
+    size_t n;
+#if LEB128_WORD_READ
+    uint64_t word, stop;
+
+    /* values up to 56 bits end within one 8 byte load: find the last byte, then gather the 7 bit groups without branching */
+    if (size >= sizeof(uint64_t)) {
+        pmemcpy(&word, src, sizeof(uint64_t));
+        stop = ~word & 0x8080808080808080ULL;
+        if (stop) {
+            n = (size_t)__builtin_ctzll(stop) / 8 + 1;
+            word &= n == sizeof(uint64_t) ? ~(uint64_t)0 : (((uint64_t)1 << (8 * n)) - 1);
+            *value =
+                (word & 0x7FULL) |
+                ((word >> 1) & (0x7FULL << 7)) |
+                ((word >> 2) & (0x7FULL << 14)) |
+                ((word >> 3) & (0x7FULL << 21)) |
+                ((word >> 4) & (0x7FULL << 28)) |
+                ((word >> 5) & (0x7FULL << 35)) |
+                ((word >> 6) & (0x7FULL << 42)) |
+                ((word >> 7) & (0x7FULL << 49));
+
+            return n;
+        }
+    }
+#endif
+
+    for (n = 0; n < size && n < LEB128_MAX; n++) {
+        if (n == LEB128_MAX - 1 && src[n] > 1) {
+            return 0;
+        }
+
+        result |= (uint64_t)(src[n] & 0x7F) << (7 * n);
+        if (!(src[n] & 0x80)) {
+            *value = result;
+            return n + 1;
+        }
+    }
+
+    return 0;
+}
+
 bool pino_handler_init(size_t initialize_size);
 void pino_handler_free(void);
 pino_handler_t *pino_handler_find(pino_magic_safe_t magic);
+/* false for unknown aliases */
+bool pino_handler_find_alias(uint16_t alias, pino_magic_safe_t magic);
+/* between pino->static_fields and the packed LE wire form, a plain copy unless the handler has an aligned layout */
+void pino_static_fields_to_wire(const pino_handler_t *handler, void *dest, const void *src);
+void pino_static_fields_from_wire(const pino_handler_t *handler, void *dest, const void *src);
+/* handler->payload_size() / validate() on wire static fields */
+size_t pino_handler_payload_size(const pino_handler_t *handler, const void *static_fields);
+bool pino_handler_validate(const pino_handler_t *handler, const void *static_fields, const void *src, size_t size);
+/* merges the field list of a PH_FIELDS_HANDLER() into its bulk conversions */
+bool pino_fields_compile(struct _pino_fields_t *fields);
+
+pino_t *pino_create(pino_magic_safe_t magic, pino_handler_t *handler, size_t size);
+/* decodes a lazy payload once, concurrent callers wait for it; a failed decode keeps failing */
+bool pino_ensure_payload(const pino_t *pino);
+/* byte order PH_MEMCPY_SERIALIZE/PH_MEMCPY_UNSERIALIZE use on this thread, returns the previous one */
+bool pino_payload_big_endian(bool big_endian);
+size_t pino_record_size(const pino_t *pino, uint32_t flags);
+bool pino_record_write(const pino_t *pino, void *dest, uint32_t flags);
+/* standalone check of the PINO_SERIALIZE_CRC32C trailer, true for records without one */
+bool pino_record_checksum(const pino_header_t *header);
+pino_validate_result_t pino_record_scan(const void *src, size_t size, handler_cache_t *cache, pino_header_t *header, size_t *record_size);
+pino_t *pino_record_unserialize(const pino_header_t *header, pino_handler_t *handler);
+/* magic, sizes, flags and header_size of a PINO_SERIALIZE_COMPACT header, returns its size or 0 when malformed or truncated */
+size_t pino_compact_header(const uint8_t *src, size_t size, pino_header_t *header);
+/* header->payload points into buffer (pmalloc), which is released or adopted by the new pino either way */
+pino_t *pino_record_unserialize_owned(const pino_header_t *header, pino_handler_t *handler, void *buffer, bool validate);
+
+uint32_t pino_crc32c_update(uint32_t crc, const void *data, size_t size);
+/* memcpy() that also returns the updated checksum of the copied bytes */
+uint32_t pino_crc32c_copy(uint32_t crc, void *dest, const void *src, size_t size);
+/* true when SSE4.2 / ARMv8 CRC instructions are used, false falls back to slicing-by-8 */
+bool pino_crc32c_hardware(bool enabled);
+
+/* 0 when the packed form does not fit into capacity */
+size_t pino_lz_compress(void *dest, size_t capacity, const void *src, size_t size);
+/* false unless src unpacks to exactly size bytes */
+bool pino_lz_decompress(void *dest, size_t size, const void *src, size_t src_size);
+/* same answer as pino_lz_decompress() without writing anything */
+bool pino_lz_validate(size_t size, const void *src, size_t src_size);
 
 bool pino_memory_manager_obj_init(mm_t *mm, size_t initialize_size);
 void pino_memory_manager_obj_free(mm_t *mm);
@@ -0,0 +1,154 @@
+/*
+ * libpino - pino_thread.h
+ * 
+ */
+
+#ifndef PINO_THREAD_H
+#define PINO_THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+# include <process.h>
+# define PINO_THREADS_AVAILABLE 1
+#elif defined(PINO_THREADS)
+# include <pthread.h>
+# include <time.h>
+# include <unistd.h>
+# define PINO_THREADS_AVAILABLE 1
+#else
+# define PINO_THREADS_AVAILABLE 0
+#endif
+
+#if defined(_WIN32)
+
+typedef SRWLOCK pmutex_t;
+typedef CONDITION_VARIABLE pcond_t;
+typedef HANDLE pthrd_t;
+
+# define PTHRD_RETURN                       unsigned __stdcall
+# define PTHRD_RETURN_VALUE                 0
+# define PTHRD_LOCAL                        __declspec(thread)
+
+# define pmutex_init(m)                     InitializeSRWLock(m)
+# define pmutex_destroy(m)                  ((void)(m))
+# define pmutex_lock(m)                     AcquireSRWLockExclusive(m)
+# define pmutex_unlock(m)                   ReleaseSRWLockExclusive(m)
+# define pcond_init(c)                      InitializeConditionVariable(c)
+# define pcond_destroy(c)                   ((void)(c))
+# define pcond_wait(c, m)                   SleepConditionVariableSRW(c, m, INFINITE, 0)
+# define pcond_signal(c)                    WakeConditionVariable(c)
+# define pcond_broadcast(c)                 WakeAllConditionVariable(c)
+
+static inline bool pthrd_create(pthrd_t *thread, unsigned (__stdcall *fn)(void *), void *arg)
+{
+    *thread = (HANDLE)_beginthreadex(NULL, 0, fn, arg, 0, NULL);
+
+    return *thread != NULL;
+}
+
+static inline void pthrd_join(pthrd_t thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static inline void pthrd_sleep_us(uint32_t us)
+{
+    Sleep((DWORD)((us + 999) / 1000));
+}
+
+static inline size_t pthrd_cpu_count(void)
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+#elif defined(PINO_THREADS)
+
+typedef pthread_mutex_t pmutex_t;
+typedef pthread_cond_t pcond_t;
+typedef pthread_t pthrd_t;
+
+# define PTHRD_RETURN                       void *
+# define PTHRD_RETURN_VALUE                 NULL
+# define PTHRD_LOCAL                        __thread
+
+# define pmutex_init(m)                     pthread_mutex_init(m, NULL)
+# define pmutex_destroy(m)                  pthread_mutex_destroy(m)
+# define pmutex_lock(m)                     pthread_mutex_lock(m)
+# define pmutex_unlock(m)                   pthread_mutex_unlock(m)
+# define pcond_init(c)                      pthread_cond_init(c, NULL)
+# define pcond_destroy(c)                   pthread_cond_destroy(c)
+# define pcond_wait(c, m)                   pthread_cond_wait(c, m)
+# define pcond_signal(c)                    pthread_cond_signal(c)
+# define pcond_broadcast(c)                 pthread_cond_broadcast(c)
+
+static inline bool pthrd_create(pthrd_t *thread, void *(*fn)(void *), void *arg)
+{
+    return pthread_create(thread, NULL, fn, arg) == 0;
+}
+
+static inline void pthrd_join(pthrd_t thread)
+{
+    pthread_join(thread, NULL);
+}
+
+static inline void pthrd_sleep_us(uint32_t us)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(us / 1000000);
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+static inline size_t pthrd_cpu_count(void)
+{
+    long count;
+
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (size_t)count : 1;
+}
+
+#else
+
+/* single threaded build, everything runs on the calling thread */
+typedef char pmutex_t;
+typedef char pcond_t;
+
+# define PTHRD_LOCAL
+
+# define pmutex_init(m)                     ((void)(m))
+# define pmutex_destroy(m)                  ((void)(m))
+# define pmutex_lock(m)                     ((void)(m))
+# define pmutex_unlock(m)                   ((void)(m))
+# define pcond_init(c)                      ((void)(c))
+# define pcond_destroy(c)                   ((void)(c))
+# define pcond_wait(c, m)                   ((void)(c), (void)(m))
+# define pcond_signal(c)                    ((void)(c))
+# define pcond_broadcast(c)                 ((void)(c))
+
+static inline void pthrd_sleep_us(uint32_t us)
+{
+    (void)us;
+}
+
+static inline size_t pthrd_cpu_count(void)
+{
+    return 1;
+}
+
+#endif
+
+#endif  /* PINO_THREAD_H */
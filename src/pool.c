@@ -0,0 +1,566 @@
+/*
+ * libpino - pool.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/pool.h>
+
+#include <pino_internal.h>
+
+typedef struct {
+    pino_pool_fn_t fn;
+    void *arg;
+    pino_refcount_t remaining;
+} pool_job_t;
+
+typedef struct {
+    pool_job_t *job;
+    size_t begin;
+    size_t end;
+} pool_task_t;
+
+/* owner pops from the bottom, thieves steal from the top */
+typedef struct {
+    pmutex_t lock;
+    pool_task_t *tasks;
+    size_t top;
+    size_t usage;
+    size_t capacity;
+} pool_deque_t;
+
+#if PINO_THREADS_AVAILABLE
+typedef struct {
+    pino_pool_t *pool;
+    size_t index;
+} pool_worker_t;
+#endif
+
+struct _pino_pool_t {
+    size_t workers;
+    pool_deque_t *deques;   /* one per worker, the last one belongs to the callers */
+    pmutex_t lock;
+    pcond_t work;
+    pcond_t done;
+    pino_refcount_t pending;
+    bool shutdown;
+#if PINO_THREADS_AVAILABLE
+    pthrd_t *threads;
+    pool_worker_t *args;
+#endif
+};
+
+static inline bool deque_push(pool_deque_t *deque, const pool_task_t *task)
+{
+    pool_task_t *tasks;
+    size_t i, capacity;
+
+    pmutex_lock(&deque->lock);
+
+    if (deque->usage >= deque->capacity) {
+        capacity = deque->capacity + POOL_STEP;
+        tasks = (pool_task_t *)pmalloc(capacity * sizeof(pool_task_t));
+        if (!tasks) {
+            /* LCOV_EXCL_START */
+            pmutex_unlock(&deque->lock);
+            return false;
+            /* LCOV_EXCL_STOP */
+        }
+
+        for (i = 0; i < deque->usage; i++) {
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        }
+
+        if (deque->tasks) {
+            pfree(deque->tasks);
+        }
+
+        deque->tasks = tasks;
+        deque->top = 0;
+        deque->capacity = capacity;
+    }
+
+    deque->tasks[(deque->top + deque->usage) % deque->capacity] = *task;
+    ++deque->usage;
+
+    pmutex_unlock(&deque->lock);
+
+    return true;
+}
+
+static inline bool deque_pop(pool_deque_t *deque, pool_task_t *task)
+{
+    bool found = false;
+
+    pmutex_lock(&deque->lock);
+
+    if (deque->usage > 0) {
+        --deque->usage;
+        *task = deque->tasks[(deque->top + deque->usage) % deque->capacity];
+        found = true;
+    }
+
+    pmutex_unlock(&deque->lock);
+
+    return found;
+}
+
+static inline bool deque_steal(pool_deque_t *deque, pool_task_t *task)
+{
+    bool found = false;
+
+    pmutex_lock(&deque->lock);
+
+    if (deque->usage > 0) {
+        *task = deque->tasks[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        --deque->usage;
+        found = true;
+    }
+
+    pmutex_unlock(&deque->lock);
+
+    return found;
+}
+
+static inline bool pool_take(pino_pool_t *pool, size_t index, pool_task_t *task)
+{
+    size_t i;
+
+    if (deque_pop(&pool->deques[index], task)) {
+        patomic_dec(&pool->pending);
+        return true;
+    }
+
+    for (i = 1; i < pool->workers; i++) {
+        if (deque_steal(&pool->deques[(index + i) % pool->workers], task)) {
+            patomic_dec(&pool->pending);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline void pool_run(pino_pool_t *pool, const pool_task_t *task)
+{
+    task->job->fn(task->job->arg, task->begin, task->end);
+
+    if (patomic_dec(&task->job->remaining) == 0) {
+        pmutex_lock(&pool->lock);
+        pcond_broadcast(&pool->done);
+        pmutex_unlock(&pool->lock);
+    }
+}
+
+#if PINO_THREADS_AVAILABLE
+static PTHRD_RETURN pool_worker_main(void *arg)
+{
+    pino_pool_t *pool;
+    pool_task_t task;
+    size_t index;
+
+    pool = ((pool_worker_t *)arg)->pool;
+    index = ((pool_worker_t *)arg)->index;
+
+    while (true) {
+        if (pool_take(pool, index, &task)) {
+            pool_run(pool, &task);
+            continue;
+        }
+
+        pmutex_lock(&pool->lock);
+        while (!pool->shutdown && patomic_load(&pool->pending) <= 0) {
+            pcond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pmutex_unlock(&pool->lock);
+            break;
+        }
+        pmutex_unlock(&pool->lock);
+    }
+
+    return PTHRD_RETURN_VALUE;
+}
+#endif
+
+extern pino_pool_t *pino_pool_create(size_t workers)
+{
+    pino_pool_t *pool;
+    size_t i;
+
+    if (workers == 0) {
+        workers = pthrd_cpu_count();
+    }
+
+#if !PINO_THREADS_AVAILABLE
+    workers = 1;
+#endif
+
+    pool = (pino_pool_t *)pcalloc(1, sizeof(pino_pool_t));
+    if (!pool) {
+        return NULL; /* LCOV_EXCL_LINE */
+    }
+
+    pool->deques = (pool_deque_t *)pcalloc(workers, sizeof(pool_deque_t));
+    if (!pool->deques) {
+        /* LCOV_EXCL_START */
+        pfree(pool);
+        return NULL;
+        /* LCOV_EXCL_STOP */
+    }
+
+    for (i = 0; i < workers; i++) {
+        pmutex_init(&pool->deques[i].lock);
+    }
+
+    pmutex_init(&pool->lock);
+    pcond_init(&pool->work);
+    pcond_init(&pool->done);
+    pool->pending = 0;
+    pool->shutdown = false;
+    pool->workers = 1;
+
+#if PINO_THREADS_AVAILABLE
+    if (workers > 1) {
+        pool->threads = (pthrd_t *)pcalloc(workers - 1, sizeof(pthrd_t));
+        pool->args = (pool_worker_t *)pcalloc(workers - 1, sizeof(pool_worker_t));
+        if (!pool->threads || !pool->args) {
+            /* LCOV_EXCL_START */
+            pino_pool_destroy(pool);
+            return NULL;
+            /* LCOV_EXCL_STOP */
+        }
+    }
+
+    /* the callers use the last deque, workers.deques[0..workers - 2] */
+    pool->workers = workers;
+    for (i = 0; i + 1 < workers; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].index = i;
+        if (!pthrd_create(&pool->threads[i], pool_worker_main, &pool->args[i])) {
+            /* LCOV_EXCL_START */
+            PINO_SUPRTF("pthrd_create failed: %zu", i);
+            pool->workers = i + 1;
+            pino_pool_destroy(pool);
+            return NULL;
+            /* LCOV_EXCL_STOP */
+        }
+    }
+#endif
+
+    PINO_SUPRTF("workers: %zu", pool->workers);
+
+    return pool;
+}
+
+extern size_t pino_pool_workers(const pino_pool_t *pool)
+{
+    return pool ? pool->workers : 1;
+}
+
+extern bool pino_pool_parallel_for(pino_pool_t *pool, size_t n, size_t grain, pino_pool_fn_t fn, void *arg)
+{
+    pool_job_t job;
+    pool_task_t task;
+    size_t chunks, caller, i;
+
+    if (!fn) {
+        return false;
+    }
+
+    if (n == 0) {
+        return true;
+    }
+
+    if (grain == 0) {
+        grain = pool ? n / (pool->workers * 4) : n;
+        grain = grain > 0 ? grain : 1;
+    }
+
+    if (!pool || pool->workers <= 1 || n <= grain) {
+        fn(arg, 0, n);
+        return true;
+    }
+
+    chunks = (n + grain - 1) / grain;
+    caller = pool->workers - 1;
+
+    job.fn = fn;
+    job.arg = arg;
+    job.remaining = (pino_refcount_t)chunks;
+
+    pmutex_lock(&pool->lock);
+    for (i = 0; i < chunks; i++) {
+        task.job = &job;
+        task.begin = i * grain;
+        task.end = task.begin + grain < n ? task.begin + grain : n;
+
+        patomic_inc(&pool->pending);
+        if (!deque_push(&pool->deques[i % pool->workers], &task)) {
+            /* LCOV_EXCL_START */
+            patomic_dec(&pool->pending);
+            pmutex_unlock(&pool->lock);
+            pool_run(pool, &task);
+            pmutex_lock(&pool->lock);
+            /* LCOV_EXCL_STOP */
+        }
+    }
+    pcond_broadcast(&pool->work);
+    pmutex_unlock(&pool->lock);
+
+    /* the calling thread works too */
+    while (patomic_load(&job.remaining) > 0) {
+        if (pool_take(pool, caller, &task)) {
+            pool_run(pool, &task);
+            continue;
+        }
+
+        pmutex_lock(&pool->lock);
+        while (patomic_load(&job.remaining) > 0) {
+            pcond_wait(&pool->done, &pool->lock);
+        }
+        pmutex_unlock(&pool->lock);
+    }
+
+    return true;
+}
+
+extern void pino_pool_destroy(pino_pool_t *pool)
+{
+    size_t i;
+
+    if (!pool) {
+        return;
+    }
+
+#if PINO_THREADS_AVAILABLE
+    pmutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pcond_broadcast(&pool->work);
+    pmutex_unlock(&pool->lock);
+
+    for (i = 0; pool->threads && i + 1 < pool->workers; i++) {
+        pthrd_join(pool->threads[i]);
+    }
+
+    if (pool->threads) {
+        pfree(pool->threads);
+    }
+
+    if (pool->args) {
+        pfree(pool->args);
+    }
+#endif
+
+    for (i = 0; i < pool->workers; i++) {
+        if (pool->deques[i].tasks) {
+            pfree(pool->deques[i].tasks);
+        }
+        pmutex_destroy(&pool->deques[i].lock);
+    }
+
+    pcond_destroy(&pool->done);
+    pcond_destroy(&pool->work);
+    pmutex_destroy(&pool->lock);
+    pfree(pool->deques);
+    pfree(pool);
+}
+
+typedef struct {
+    const pino_t **pinos;
+    void *dest;
+    size_t *offsets;
+    pino_refcount_t failed;
+} serialize_batch_ctx_t;
+
+static void serialize_batch_size_fn(void *arg, size_t begin, size_t end)
+{
+    serialize_batch_ctx_t *ctx = (serialize_batch_ctx_t *)arg;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        if (!ctx->pinos[i] || !pino_ensure_payload(ctx->pinos[i])) {
+            patomic_inc(&ctx->failed);
+            return;
+        }
+
+        ctx->offsets[i] = pino_record_size(ctx->pinos[i], 0);
+    }
+}
+
+static void serialize_batch_write_fn(void *arg, size_t begin, size_t end)
+{
+    serialize_batch_ctx_t *ctx = (serialize_batch_ctx_t *)arg;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        if (!pino_record_write(ctx->pinos[i], ((char *)ctx->dest) + ctx->offsets[i], 0)) {
+            patomic_inc(&ctx->failed);
+            return;
+        }
+    }
+}
+
+static inline size_t batch_grain(const pino_pool_t *pool, size_t n)
+{
+    size_t grain;
+
+    grain = n / (pino_pool_workers(pool) * 4);
+
+    return grain > POOL_GRAIN_MIN ? grain : POOL_GRAIN_MIN;
+}
+
+static inline size_t serialize_batch_parallel(pino_pool_t *pool, serialize_batch_ctx_t *ctx, size_t n, size_t capacity)
+{
+    size_t total, size, i;
+
+    if (!pino_pool_parallel_for(pool, n, batch_grain(pool, n), serialize_batch_size_fn, ctx) || ctx->failed) {
+        return 0;
+    }
+
+    /* sizes -> offsets */
+    total = 0;
+    for (i = 0; i < n; i++) {
+        size = ctx->offsets[i];
+        if (size > SIZE_MAX - total) {
+            return 0; /* LCOV_EXCL_LINE */
+        }
+        ctx->offsets[i] = total;
+        total += size;
+    }
+
+    if (!ctx->dest) {
+        return total;
+    }
+
+    if (total > capacity) {
+        PINO_SUPRTF("capacity: %zu, required: %zu", capacity, total);
+        return 0;
+    }
+
+    if (!pino_pool_parallel_for(pool, n, batch_grain(pool, n), serialize_batch_write_fn, ctx) || ctx->failed) {
+        return 0;
+    }
+
+    return total;
+}
+
+extern size_t pino_serialize_batch_parallel(pino_pool_t *pool, const pino_t **pinos, size_t n, void *dest, size_t capacity, size_t *offsets_out)
+{
+    serialize_batch_ctx_t ctx;
+    size_t total;
+
+    if (!pinos || n == 0) {
+        return 0;
+    }
+
+    ctx.pinos = pinos;
+    ctx.dest = dest;
+    ctx.failed = 0;
+    ctx.offsets = offsets_out ? offsets_out : (size_t *)pmalloc(n * sizeof(size_t));
+    if (!ctx.offsets) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    total = serialize_batch_parallel(pool, &ctx, n, capacity);
+
+    if (ctx.offsets != offsets_out) {
+        pfree(ctx.offsets);
+    }
+
+    return total;
+}
+
+typedef struct {
+    const char *src;
+    size_t *offsets;
+    size_t *sizes;
+    pino_handler_t **handlers;
+    pino_t **out;
+} unserialize_batch_ctx_t;
+
+static void unserialize_batch_fn(void *arg, size_t begin, size_t end)
+{
+    unserialize_batch_ctx_t *ctx = (unserialize_batch_ctx_t *)arg;
+    pino_header_t header;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        pino_peek(ctx->src + ctx->offsets[i], ctx->sizes[i], &header);
+        ctx->out[i] = pino_record_unserialize(&header, ctx->handlers[i]);
+    }
+}
+
+static inline size_t unserialize_batch_parallel(pino_pool_t *pool, unserialize_batch_ctx_t *ctx, size_t size, size_t n)
+{
+    handler_cache_t cache;
+    pino_header_t header;
+    size_t offset, count, i;
+
+    /* boundaries are only known by walking the headers */
+    cache.handler = NULL;
+    offset = 0;
+    count = 0;
+    while (count < n && offset < size) {
+        if (pino_record_scan(ctx->src + offset, size - offset, &cache, &header, &ctx->sizes[count]) != PINO_VALIDATE_OK) {
+            PINO_SUPRTF("invalid record at offset: %zu", offset);
+            break;
+        }
+
+        ctx->offsets[count] = offset;
+        ctx->handlers[count] = cache.handler;
+        offset += ctx->sizes[count];
+        ++count;
+    }
+
+    if (!pino_pool_parallel_for(pool, count, batch_grain(pool, count), unserialize_batch_fn, ctx)) {
+        return 0; /* LCOV_EXCL_LINE */
+    }
+
+    for (i = 0; i < count && ctx->out[i]; i++);
+
+    /* keep the leading run, like pino_unserialize_batch() */
+    for (offset = i; offset < count; offset++) {
+        pino_destroy(ctx->out[offset]);
+        ctx->out[offset] = NULL;
+    }
+
+    return i;
+}
+
+extern size_t pino_unserialize_batch_parallel(pino_pool_t *pool, const void *src, size_t size, pino_t **out, size_t n)
+{
+    unserialize_batch_ctx_t ctx;
+    size_t count;
+
+    if (!src || !out || n == 0) {
+        return 0;
+    }
+
+    ctx.src = (const char *)src;
+    ctx.out = out;
+    ctx.offsets = (size_t *)pmalloc(n * sizeof(size_t));
+    ctx.sizes = (size_t *)pmalloc(n * sizeof(size_t));
+    ctx.handlers = (pino_handler_t **)pmalloc(n * sizeof(pino_handler_t *));
+
+    count = 0;
+    if (ctx.offsets && ctx.sizes && ctx.handlers) {
+        count = unserialize_batch_parallel(pool, &ctx, size, n);
+    }
+
+    if (ctx.offsets) {
+        pfree(ctx.offsets);
+    }
+
+    if (ctx.sizes) {
+        pfree(ctx.sizes);
+    }
+
+    if (ctx.handlers) {
+        pfree(ctx.handlers);
+    }
+
+    return count;
+}
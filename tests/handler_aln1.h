@@ -0,0 +1,108 @@
+/*
+ * libpino tests - handler_aln1.h
+ * 
+ */
+
+#ifndef PINO_TESTS_HANDLER_ALN1_H
+#define PINO_TESTS_HANDLER_ALN1_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+/* spl1 with naturally aligned structs, the members are read and written directly */
+PH_BEGIN(aln1);
+
+PH_DEF_STATIC_FIELDS_STRUCT_ALIGNED(aln1) {
+    uint8_t kind;
+    uint64_t id;
+    uint32_t size;
+    uint16_t tags[3];
+} PH_DEF_STATIC_FIELDS_STRUCT_ALIGNED_END;
+
+PH_DEF_STATIC_FIELDS_LAYOUT(aln1) {
+    PH_STATIC_FIELD(aln1, kind),
+    PH_STATIC_FIELD(aln1, id),
+    PH_STATIC_FIELD(aln1, size),
+    PH_STATIC_FIELD_ARRAY(aln1, tags)
+};
+
+PH_DEF_STRUCT_ALIGNED(aln1) {
+    uint8_t *data;
+} PH_DEF_STRUCT_ALIGNED_END;
+
+PH_DEFUN_SERIALIZE_SIZE(aln1) {
+    return (size_t)PH_THIS_STATIC(aln1)->size;
+}
+
+PH_DEFUN_SERIALIZE(aln1) {
+    PH_SERIALIZE_DATA(aln1, data, (size_t)PH_THIS_STATIC(aln1)->size);
+
+    return true;
+}
+
+PH_DEFUN_UNSERIALIZE(aln1) {
+    PH_UNSERIALIZE_DATA(aln1, data, (size_t)PH_THIS_STATIC(aln1)->size);
+
+    return true;
+}
+
+PH_DEFUN_PAYLOAD_SIZE(aln1) {
+    return (size_t)PH_THIS_STATIC(aln1)->size;
+}
+
+PH_DEFUN_VALIDATE(aln1) {
+    if (PH_THIS_STATIC(aln1)->kind > 3) {
+        return false;
+    }
+    PH_VALIDATE_DATA((size_t)PH_THIS_STATIC(aln1)->size);
+
+    return true;
+}
+
+PH_DEFUN_PACK(aln1) {
+    PH_PACK_DATA(aln1, data, (size_t)PH_THIS_STATIC(aln1)->size);
+
+    return true;
+}
+
+PH_DEFUN_UNPACK_SIZE(aln1) {
+    return (size_t)PH_THIS_STATIC(aln1)->size;
+}
+
+PH_DEFUN_UNPACK(aln1) {
+    PH_UNPACK_DATA(aln1, data, (size_t)PH_THIS_STATIC(aln1)->size);
+
+    return true;
+}
+
+PH_DEFUN_CREATE(aln1) {
+    PH_CREATE_THIS(aln1);
+
+    PH_THIS(aln1)->data = (uint8_t *)PH_CALLOC(aln1, 1, PH_ARG_SIZE > 0 ? PH_ARG_SIZE : 1);
+    if (!PH_THIS(aln1)->data) {
+        PH_DESTROY_THIS(aln1);
+        return NULL;
+    }
+
+    PH_THIS_STATIC(aln1)->size = (uint32_t)PH_ARG_SIZE;
+
+    return PH_THIS(aln1);
+}
+
+PH_DEFUN_DESTROY(aln1) {
+    PH_FREE(aln1, PH_THIS(aln1)->data);
+    PH_DESTROY_THIS(aln1);
+}
+
+PH_END_EX(aln1,
+    PH_EXT_STATIC_FIELDS_ALIGNED(aln1),
+    PH_EXT_PAYLOAD_SIZE(aln1),
+    PH_EXT_VALIDATE(aln1)
+);
+
+#endif  /* PINO_TESTS_HANDLER_ALN1_H */
@@ -0,0 +1,31 @@
+/*
+ * libpino tests - handler_fld1.h
+ * 
+ */
+
+#ifndef PINO_TESTS_HANDLER_FLD1_H
+#define PINO_TESTS_HANDLER_FLD1_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <pino.h>
+#include <pino/fields.h>
+#include <pino/handler.h>
+
+/* seq and flags, kind and ports share their conversions */
+#define FLD1_FIELDS(SCALAR, ARRAY, VECTOR) \
+    SCALAR(uint64_t, id) \
+    SCALAR(uint32_t, seq) \
+    SCALAR(uint32_t, flags) \
+    SCALAR(uint16_t, kind) \
+    ARRAY(uint16_t, ports, 3) \
+    SCALAR(uint8_t, level) \
+    VECTOR(uint8_t, body) \
+    VECTOR(uint32_t, values)
+
+PH_FIELDS_HANDLER(fld1, FLD1_FIELDS);
+
+#endif  /* PINO_TESTS_HANDLER_FLD1_H */
@@ -26,6 +26,7 @@ PH_DEF_STATIC_FIELDS_STRUCT(spl1) {
 
 PH_DEF_STRUCT(spl1) {
     uint8_t *data;
+    bool adopted;
 } PH_DEF_STRUCT_END;
 
 PH_DEFUN_SERIALIZE_SIZE(spl1) {
@@ -54,6 +55,32 @@ PH_DEFUN_UNSERIALIZE(spl1) {
     return PH_THIS(spl1);
 }
 
+PH_DEFUN_PAYLOAD_SIZE(spl1) {
+    spl1_size_t payload_size;
+
+    PH_THIS_STATIC_GET(spl1, size, &payload_size);
+
+    return (size_t)payload_size;
+}
+
+PH_DEFUN_UNSERIALIZE_CHUNK(spl1) {
+    spl1_size_t unserialize_size;
+
+    PH_THIS_STATIC_GET(spl1, size, &unserialize_size);
+    PH_UNSERIALIZE_CHUNK_DATA(spl1, data, (size_t)unserialize_size);
+
+    return true;
+}
+
+PH_DEFUN_VALIDATE(spl1) {
+    spl1_size_t validate_size;
+
+    PH_THIS_STATIC_GET(spl1, size, &validate_size);
+    PH_VALIDATE_DATA((size_t)validate_size);
+
+    return true;
+}
+
 PH_DEFUN_PACK(spl1) {
     spl1_size_t pack_size;
 
@@ -80,6 +107,15 @@ PH_DEFUN_UNPACK(spl1) {
     return true;
 }
 
+PH_DEFUN_UNPACK_VIEW(spl1) {
+    spl1_size_t unpack_size;
+
+    PH_THIS_STATIC_GET(spl1, size, &unpack_size);
+    PH_UNPACK_VIEW_DATA(spl1, data, (size_t)unpack_size);
+
+    return true;
+}
+
 PH_DEFUN_CREATE(spl1) {
     spl1_size_t data_size = (spl1_size_t)PH_ARG_SIZE;
 
@@ -102,14 +138,35 @@ PH_DEFUN_CREATE(spl1) {
     return PH_THIS(spl1);
 }
 
+PH_DEFUN_ADOPT(spl1) {
+    spl1_size_t data_size = (spl1_size_t)PH_ARG_SIZE;
+
+    PH_CREATE_THIS(spl1);
+
+    PH_ADOPT_DATA(spl1, data);
+    PH_THIS(spl1)->adopted = true;
+
+    PH_THIS_STATIC_SET(spl1, size, &data_size);
+
+    return PH_THIS(spl1);
+}
+
 PH_DEFUN_DESTROY(spl1) {
-    PH_FREE(spl1, PH_THIS(spl1)->data);
+    if (!PH_THIS(spl1)->adopted) {
+        PH_FREE(spl1, PH_THIS(spl1)->data);
+    }
     /* Accidentally memleak, but it's destroyed by memory manager.
     PH_FREE(spl1, PH_THIS(spl1)); 
     */
 }
 
-PH_END(spl1);
+PH_END_EX(spl1,
+    PH_EXT_PAYLOAD_SIZE(spl1),
+    PH_EXT_UNSERIALIZE_CHUNK(spl1),
+    PH_EXT_VALIDATE(spl1),
+    PH_EXT_ADOPT(spl1),
+    PH_EXT_UNPACK_VIEW(spl1)
+);
 
 extern void set_u32(pino_t *pino, uint32_t u32val)
 {
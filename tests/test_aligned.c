@@ -0,0 +1,180 @@
+/*
+ * libpino test - test_aligned.c
+ * 
+ */
+
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  (4096 + 48)
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+/* records are aligned relative to their start, so the buffer itself has to be */
+static uint8_t *aligned(uint8_t *buffer)
+{
+    return buffer + ((64 - ((uintptr_t)buffer & 63)) & 63);
+}
+
+static uint32_t sum_payload(const uint8_t *payload, size_t size, size_t alignment)
+{
+    uint32_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    uint32_t lanes[4];
+
+    /* _mm_load_si128() faults on unaligned addresses */
+    for (; alignment >= 16 && i + 16 <= size; i += 16) {
+        acc = _mm_add_epi32(acc, _mm_sad_epu8(_mm_load_si128((const __m128i *)(payload + i)), _mm_setzero_si128()));
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum = lanes[0] + lanes[2];
+#endif
+
+    for (; i < size; i++) {
+        sum += payload[i];
+    }
+
+    return sum;
+}
+
+void test_aligned(void)
+{
+    pino_header_t header;
+    pino_t *pino;
+    uint8_t *data, *buffer, *record;
+    const void *payload;
+    size_t sizes[] = {1, 20, 200, TEST_DATA_SIZE}, alignments[] = {8, 16, 64}, size, i, a, f;
+    uint32_t aligns[] = {PINO_SERIALIZE_ALIGN8, PINO_SERIALIZE_ALIGN16, PINO_SERIALIZE_ALIGN64};
+    uint32_t flags[] = {0, PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C}, sum;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    buffer = (uint8_t *)malloc(TEST_DATA_SIZE + 256);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(buffer);
+    generate_random_data(data, TEST_DATA_SIZE);
+    memset(data + 1024, 'x', 2048);
+    record = aligned(buffer);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (sum = 0, f = 0; f < sizes[i]; f++) {
+            sum += data[f];
+        }
+
+        for (a = 0; a < sizeof(aligns) / sizeof(aligns[0]); a++) {
+            for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+                pino = pino_pack("spl1", data, sizes[i]);
+                TEST_ASSERT_NOT_NULL(pino);
+                set_u32(pino, 0xC0FFEE);
+
+                size = pino_serialize_record(pino, record, TEST_DATA_SIZE + 192, flags[f] | aligns[a]);
+                TEST_ASSERT_TRUE(size > 0);
+                TEST_ASSERT_EQUAL_size_t(0, pino_serialize_size_ex(pino, PINO_SERIALIZE_COMPACT | aligns[a]));
+                pino_destroy(pino);
+
+                TEST_ASSERT_TRUE(pino_peek(record, size, &header));
+                TEST_ASSERT_EQUAL_UINT32(0, ((uintptr_t)header.static_fields) % alignments[a]);
+                TEST_ASSERT_EQUAL_UINT32(0, ((uintptr_t)header.payload) % alignments[a]);
+                TEST_ASSERT_EQUAL_UINT32(aligns[a], header.flags & aligns[a]);
+
+                assert_unpacked(pino_unserialize(record, size), data, sizes[i]);
+                assert_unpacked(pino_unserialize_validated(record, size), data, sizes[i]);
+                assert_unpacked(pino_unserialize_lazy(record, size), data, sizes[i]);
+                assert_decoded(record, size, 7, data, sizes[i]);
+                TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(record, size));
+
+                /* in place on little endian hosts, compressed records always need the copy */
+                payload = pino_peek_payload(record, size, alignments[a], &header);
+                if (header.flags & PINO_SERIALIZE_COMPRESS || !pino_endianness_le2native_noop(sizeof(uint16_t))) {
+                    TEST_ASSERT_NULL(payload);
+                    continue;
+                }
+                TEST_ASSERT_NOT_NULL(payload);
+                TEST_ASSERT_EQUAL_PTR(header.payload, payload);
+                TEST_ASSERT_EQUAL_UINT32(sum, sum_payload((const uint8_t *)payload, header.payload_size, alignments[a]));
+                TEST_ASSERT_NULL(pino_peek_payload(record, size, alignments[a] * 2, &header));
+                TEST_ASSERT_NULL(pino_peek_payload(record + 1, size - 1, 1, &header));
+                TEST_ASSERT_NULL(pino_peek_payload(record, size, 3, &header));
+
+                if (flags[f] & PINO_SERIALIZE_CRC32C) {
+                    record[size - 5] ^= 0x01;
+                    TEST_ASSERT_NULL(pino_peek_payload(record, size, alignments[a], &header));
+                    TEST_ASSERT_NULL(pino_unserialize(record, size));
+                }
+            }
+        }
+    }
+
+    free(buffer);
+    free(data);
+}
+
+void test_aligned_batch(void)
+{
+    pino_t *pinos[3], *out[3];
+    uint8_t data[100], *buffer, *record;
+    size_t sizes[3], offset, i;
+    uint32_t flags[] = {PINO_SERIALIZE_ALIGN16, 0, PINO_SERIALIZE_ALIGN64 | PINO_SERIALIZE_CRC32C};
+
+    generate_random_data(data, sizeof(data));
+
+    /* the padding is inside the record, its end is not rounded up */
+    buffer = (uint8_t *)malloc(1024);
+    TEST_ASSERT_NOT_NULL(buffer);
+    record = aligned(buffer);
+    offset = 0;
+    for (i = 0; i < 3; i++) {
+        pinos[i] = pino_pack("spl1", data, sizeof(data) - i);
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], 0xC0FFEE);
+        sizes[i] = pino_serialize_record(pinos[i], record + offset, 960 - offset, flags[i]);
+        TEST_ASSERT_TRUE(sizes[i] > 0);
+        offset += sizes[i];
+    }
+
+    TEST_ASSERT_EQUAL_size_t(3, pino_unserialize_batch(record, offset, out, 3));
+    for (i = 0; i < 3; i++) {
+        assert_unpacked(out[i], data, sizeof(data) - i);
+        pino_destroy(pinos[i]);
+    }
+
+    free(buffer);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_aligned);
+    RUN_TEST(test_aligned_batch);
+
+    return UNITY_END();
+}
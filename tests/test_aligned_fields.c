@@ -0,0 +1,271 @@
+/*
+ * libpino test - test_aligned_fields.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/decoder.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_aln1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE      300
+#define TEST_WIRE_SIZE      (sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) * 3)
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(aln1)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!PH_UNREG(aln1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static void set_fields(pino_t *pino, uint8_t kind, uint64_t id)
+{
+    TEST_ASSERT_TRUE(pino_touch(pino));
+    PH_PINO_STATIC_P(aln1, pino)->kind = kind;
+    PH_PINO_STATIC_P(aln1, pino)->id = id;
+    PH_PINO_STATIC_P(aln1, pino)->tags[0] = 0x0102;
+    PH_PINO_STATIC_P(aln1, pino)->tags[1] = 0x0304;
+    PH_PINO_STATIC_P(aln1, pino)->tags[2] = 0x0506;
+}
+
+static void assert_fields(pino_t *pino, uint8_t kind, uint64_t id, const uint8_t *data, size_t size)
+{
+    uint8_t out[TEST_DATA_SIZE];
+
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT8(kind, PH_PINO_STATIC_P(aln1, pino)->kind);
+    TEST_ASSERT_EQUAL_UINT64(id, PH_PINO_STATIC_P(aln1, pino)->id);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)size, PH_PINO_STATIC_P(aln1, pino)->size);
+    TEST_ASSERT_EQUAL_HEX16(0x0102, PH_PINO_STATIC_P(aln1, pino)->tags[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x0304, PH_PINO_STATIC_P(aln1, pino)->tags[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x0506, PH_PINO_STATIC_P(aln1, pino)->tags[2]);
+    TEST_ASSERT_EQUAL_size_t(size, pino_unpack_size(pino));
+    TEST_ASSERT_TRUE(pino_unpack(pino, out));
+    TEST_ASSERT_EQUAL_MEMORY(data, out, size);
+}
+
+static pino_t *decode(const uint8_t *record, size_t size)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    size_t offset, consumed;
+    pino_decoder_status_t status;
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    status = PINO_DECODER_NEED_MORE;
+    for (offset = 0; offset < size && status == PINO_DECODER_NEED_MORE; offset += consumed) {
+        status = pino_decoder_feed(decoder, record + offset, 3, &consumed);
+    }
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, status);
+    pino = pino_decoder_take(decoder);
+    pino_decoder_destroy(decoder);
+
+    return pino;
+}
+
+void test_aligned_fields_layout(void)
+{
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], *record, wire[TEST_WIRE_SIZE];
+    uint64_t id = 0x1122334455667788ULL;
+    uint32_t size = 20, peek_size;
+    uint64_t peek_id;
+    uint16_t tag, tags[3];
+    uint8_t kind;
+    pino_header_t header;
+    size_t record_size;
+
+    /* aligned in memory, packed on the wire */
+    TEST_ASSERT_EQUAL_size_t(0, offsetof(struct PH_NAME_STATIC_FIELDS_STRUCT(aln1), id) % sizeof(uint64_t));
+    TEST_ASSERT_EQUAL_size_t(TEST_WIRE_SIZE, (size_t)PH_NAME_HANDLER(aln1).static_fields_size);
+    TEST_ASSERT_TRUE(PH_SIZE_STATIC(aln1) > TEST_WIRE_SIZE);
+
+    generate_random_data(data, sizeof(data));
+    pino = pino_pack("aln1", data, size);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_fields(pino, 2, id);
+
+    record = serialize(pino, 0, &record_size);
+    TEST_ASSERT_EQUAL_size_t(PINO_HEADER_SIZE + TEST_WIRE_SIZE + size, record_size);
+
+    wire[0] = 2;
+    pino_endianness_memcpy_native2le(wire + 1, &id, sizeof(id));
+    pino_endianness_memcpy_native2le(wire + 9, &size, sizeof(size));
+    for (tag = 0; tag < 3; tag++) {
+        pino_endianness_memcpy_native2le(wire + 13 + tag * 2, &PH_PINO_STATIC_P(aln1, pino)->tags[tag], sizeof(uint16_t));
+    }
+    TEST_ASSERT_EQUAL_MEMORY(wire, record + PINO_HEADER_SIZE, TEST_WIRE_SIZE);
+    TEST_ASSERT_EQUAL_MEMORY(data, record + PINO_HEADER_SIZE + TEST_WIRE_SIZE, size);
+
+    /* peeks use the packed offsets, arrays of wider elements are not read in one copy */
+    TEST_ASSERT_TRUE(pino_peek(record, record_size, &header));
+    kind = 0;
+    peek_id = 0;
+    peek_size = 0;
+    TEST_ASSERT_TRUE(PH_PEEK_STATIC_GET_ALIGNED(aln1, &header, kind, &kind));
+    TEST_ASSERT_TRUE(PH_PEEK_STATIC_GET_ALIGNED(aln1, &header, id, &peek_id));
+    TEST_ASSERT_TRUE(PH_PEEK_STATIC_GET_ALIGNED(aln1, &header, size, &peek_size));
+    TEST_ASSERT_EQUAL_UINT8(2, kind);
+    TEST_ASSERT_EQUAL_UINT64(id, peek_id);
+    TEST_ASSERT_EQUAL_UINT32(size, peek_size);
+    TEST_ASSERT_FALSE(PH_PEEK_STATIC_GET_ALIGNED(aln1, &header, tags, tags));
+    TEST_ASSERT_EQUAL_size_t(SIZE_MAX, pino_static_fields_wire_offset(PH_NAME_STATIC_FIELDS_LAYOUT(aln1), 4, 2, sizeof(uint64_t)));
+    TEST_ASSERT_EQUAL_size_t(SIZE_MAX, pino_static_fields_wire_offset(NULL, 0, 0, 1));
+
+    /* validate() sees the aligned fields as well */
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(record, record_size));
+    record[PINO_HEADER_SIZE] = 9;
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_PAYLOAD, pino_validate(record, record_size));
+    TEST_ASSERT_NULL(pino_unserialize(record, record_size));
+
+    free(record);
+    pino_destroy(pino);
+}
+
+void test_aligned_fields_roundtrip(void)
+{
+    pino_t *pino, *out, *pinos[2], *outs[2];
+    uint8_t data[TEST_DATA_SIZE], *record, *batch;
+    size_t sizes[] = {0, 1, 19, TEST_DATA_SIZE}, record_size, batch_size, i, f;
+    uint32_t flags[] = {
+        0, PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_COMPRESS, PINO_SERIALIZE_COMPACT,
+        PINO_SERIALIZE_ALIGN16 | PINO_SERIALIZE_CRC32C
+    };
+
+    generate_random_data(data, sizeof(data));
+    memset(data + 64, 'a', 128);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        pino = pino_pack("aln1", data, sizes[i]);
+        TEST_ASSERT_NOT_NULL(pino);
+        set_fields(pino, 3, 0xDEADBEEFCAFEULL + i);
+
+        for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+            record = serialize(pino, flags[f], &record_size);
+
+            out = pino_unserialize(record, record_size);
+            assert_fields(out, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+            pino_destroy(out);
+            out = pino_unserialize_validated(record, record_size);
+            assert_fields(out, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+            pino_destroy(out);
+            out = pino_unserialize_lazy(record, record_size);
+            assert_fields(out, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+            pino_destroy(out);
+            out = decode(record, record_size);
+            assert_fields(out, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+            pino_destroy(out);
+
+            free(record);
+        }
+
+        /* clones copy the whole aligned struct */
+        out = pino_clone(pino);
+        assert_fields(out, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+        set_fields(out, 1, 7);
+        assert_fields(pino, 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+
+        pinos[0] = pino;
+        pinos[1] = out;
+        batch_size = pino_serialize_batch((const pino_t **)pinos, 2, NULL, 0, NULL);
+        batch = (uint8_t *)malloc(batch_size);
+        TEST_ASSERT_NOT_NULL(batch);
+        TEST_ASSERT_EQUAL_size_t(batch_size, pino_serialize_batch((const pino_t **)pinos, 2, batch, batch_size, NULL));
+        TEST_ASSERT_EQUAL_size_t(2, pino_unserialize_batch(batch, batch_size, outs, 2));
+        assert_fields(outs[0], 3, 0xDEADBEEFCAFEULL + i, data, sizes[i]);
+        assert_fields(outs[1], 1, 7, data, sizes[i]);
+
+        free(batch);
+        pino_destroy(outs[0]);
+        pino_destroy(outs[1]);
+        pino_destroy(out);
+        pino_destroy(pino);
+    }
+}
+
+void test_aligned_fields_delta(void)
+{
+    pino_t *base, *current, *out;
+    uint8_t data[TEST_DATA_SIZE], *delta;
+    size_t size;
+
+    generate_random_data(data, sizeof(data));
+    base = pino_pack("aln1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(base);
+    set_fields(base, 1, 100);
+
+    current = pino_clone(base);
+    TEST_ASSERT_NOT_NULL(current);
+    set_fields(current, 1, 101);
+    TEST_ASSERT_TRUE(pino_touch(current));
+    PH_PINO_P(aln1, current)->data[5] ^= 0xFF;
+
+    size = pino_serialize_delta(base, current, NULL, 0);
+    TEST_ASSERT_TRUE(size > 0);
+    delta = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(delta);
+    TEST_ASSERT_EQUAL_size_t(size, pino_serialize_delta(base, current, delta, size));
+
+    out = pino_apply_delta(base, delta, size);
+    data[5] ^= 0xFF;
+    assert_fields(out, 1, 101, data, sizeof(data));
+
+    /* the base check runs on the wire form of the static fields */
+    set_fields(base, 1, 102);
+    TEST_ASSERT_NULL(pino_apply_delta(base, delta, size));
+
+    free(delta);
+    pino_destroy(out);
+    pino_destroy(current);
+    pino_destroy(base);
+}
+
+void test_aligned_fields_invalid_layout(void)
+{
+    pino_handler_t handler = PH_NAME_HANDLER(aln1);
+    pino_static_field_t layout[] = {{0, 3, 1}};
+
+    handler.static_fields_layout = layout;
+    handler.static_fields_layout_count = 1;
+    TEST_ASSERT_FALSE(pino_handler_register("bad1", &handler));
+
+    layout[0].size = 8;
+    layout[0].offset = PH_SIZE_STATIC(aln1) - 4;
+    TEST_ASSERT_FALSE(pino_handler_register("bad1", &handler));
+
+    layout[0].offset = 0;
+    TEST_ASSERT_TRUE(pino_handler_register("bad1", &handler));
+    TEST_ASSERT_EQUAL_size_t(8, (size_t)handler.static_fields_size);
+    TEST_ASSERT_TRUE(pino_handler_unregister("bad1"));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_aligned_fields_layout);
+    RUN_TEST(test_aligned_fields_roundtrip);
+    RUN_TEST(test_aligned_fields_delta);
+    RUN_TEST(test_aligned_fields_invalid_layout);
+
+    return UNITY_END();
+}
@@ -108,6 +108,33 @@ void test_pack(void)
     free(unpacked_data);
 }
 
+void test_unpack_view(void)
+{
+    pino_t *pino;
+    uint8_t *data;
+    const void *view;
+    size_t view_size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+
+    TEST_ASSERT_TRUE(pino_unpack_view(pino, &view, &view_size));
+    TEST_ASSERT_TRUE(view == PH_PINO_P(spl1, pino)->data);
+    TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE, view_size);
+    TEST_ASSERT_EQUAL_MEMORY(data, view, TEST_DATA_SIZE);
+
+    TEST_ASSERT_FALSE(pino_unpack_view(NULL, &view, &view_size));
+    TEST_ASSERT_FALSE(pino_unpack_view(pino, NULL, &view_size));
+
+    pino_destroy(pino);
+    free(data);
+}
+
 void test_pack_fail(void)
 {
     pino_t *pino;
@@ -157,6 +184,45 @@ void test_pack_glowing(void)
     free(pinos);
 }
 
+static void assert_filled(const void *ptr, uint8_t value, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_UINT8(value, ((const uint8_t *)ptr)[i]);
+    }
+}
+
+void test_memory_manager(void)
+{
+    void *ptrs[100];
+    size_t i;
+
+    TEST_ASSERT_NULL(PH_MALLOC(spl1, 0));
+    TEST_ASSERT_NULL(pino_memory_manager_malloc(NULL, 16));
+
+    for (i = 0; i < 100; i++) {
+        ptrs[i] = PH_MALLOC(spl1, i + 1);
+        TEST_ASSERT_NOT_NULL(ptrs[i]);
+        TEST_ASSERT_EQUAL_size_t(0, (uintptr_t)ptrs[i] % sizeof(void *));
+        memset(ptrs[i], (int)i, i + 1);
+    }
+
+    /* frees from the middle move other blocks around, they must stay intact */
+    for (i = 0; i < 100; i += 2) {
+        PH_FREE(spl1, ptrs[i]);
+    }
+    for (i = 1; i < 100; i += 4) {
+        assert_filled(ptrs[i], (uint8_t)i, i + 1);
+        PH_FREE(spl1, ptrs[i]);
+    }
+
+    /* the rest is released on unregister */
+    for (i = 3; i < 100; i += 4) {
+        assert_filled(ptrs[i], (uint8_t)i, i + 1);
+    }
+}
+
 void test_pino_serialize(void)
 {
     pino_t *pino, *unserialized_pino;
@@ -179,6 +245,13 @@ void test_pino_serialize(void)
 
     TEST_ASSERT_TRUE(pino_serialize(pino, serialized_data));
 
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(serialized_data, serialize_size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_PAYLOAD, pino_validate(serialized_data, serialize_size - 1));
+
+    unserialized_pino = pino_unserialize_validated(serialized_data, serialize_size);
+    TEST_ASSERT_NOT_NULL(unserialized_pino);
+    pino_destroy(unserialized_pino);
+
     unserialized_pino = pino_unserialize(serialized_data, serialize_size);
     TEST_ASSERT_NOT_NULL(unserialized_pino);
 
@@ -198,6 +271,237 @@ void test_pino_serialize(void)
     free(unserialized_data);
 }
 
+void test_clone(void)
+{
+    pino_t *pino, *clone, *clone2;
+    uint8_t *data, *unpacked_data;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    unpacked_data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(unpacked_data);
+
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 1);
+
+    TEST_ASSERT_TRUE(pino_retain(pino) == pino);
+    pino_release(pino);
+
+    clone = pino_clone(pino);
+    clone2 = pino_clone(clone);
+    TEST_ASSERT_NOT_NULL(clone);
+    TEST_ASSERT_NOT_NULL(clone2);
+    TEST_ASSERT_TRUE(PH_PINO_P(spl1, clone)->data == PH_PINO_P(spl1, pino)->data);
+    TEST_ASSERT_TRUE(PH_PINO_P(spl1, clone2)->data == PH_PINO_P(spl1, pino)->data);
+    TEST_ASSERT_EQUAL_UINT32(1, get_u32(clone));
+
+    /* copy on write */
+    set_u32(clone, 2);
+    TEST_ASSERT_TRUE(PH_PINO_P(spl1, clone)->data != PH_PINO_P(spl1, pino)->data);
+    TEST_ASSERT_EQUAL_UINT32(1, get_u32(pino));
+    TEST_ASSERT_EQUAL_UINT32(2, get_u32(clone));
+    TEST_ASSERT_TRUE(pino_unpack(clone, unpacked_data));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked_data, TEST_DATA_SIZE);
+
+    /* original dropped, clone2 is the sole owner of the shared payload */
+    pino_destroy(pino);
+    TEST_ASSERT_TRUE(pino_touch(clone2));
+    TEST_ASSERT_TRUE(pino_unpack(clone2, unpacked_data));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked_data, TEST_DATA_SIZE);
+
+    TEST_ASSERT_NULL(pino_clone(NULL));
+    TEST_ASSERT_FALSE(pino_touch(NULL));
+    TEST_ASSERT_NULL(pino_retain(NULL));
+
+    pino_destroy(clone);
+    pino_release(clone2);
+    free(unpacked_data);
+    free(data);
+}
+
+void test_pack_adopt(void)
+{
+    pino_t *pino, *unserialized_pino;
+    uint8_t *data, *buf, *serialized_data, *unpacked_data;
+    size_t serialize_size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    buf = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(buf);
+
+    generate_random_data(data, TEST_DATA_SIZE);
+    memcpy(buf, data, TEST_DATA_SIZE);
+
+    TEST_ASSERT_NULL(pino_pack_adopt("spl2", buf, TEST_DATA_SIZE, free));
+    TEST_ASSERT_NULL(pino_pack_adopt("spl1", buf, TEST_DATA_SIZE, NULL));
+
+    pino = pino_pack_adopt("spl1", buf, TEST_DATA_SIZE, free);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_TRUE(PH_PINO_P(spl1, pino)->data == buf);
+    TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE, pino_unpack_size(pino));
+
+    serialize_size = pino_serialize_size(pino);
+    serialized_data = (uint8_t *)malloc(serialize_size);
+    TEST_ASSERT_NOT_NULL(serialized_data);
+    TEST_ASSERT_TRUE(pino_serialize(pino, serialized_data));
+
+    unserialized_pino = pino_unserialize_adopt(serialized_data, serialize_size, free);
+    TEST_ASSERT_NOT_NULL(unserialized_pino);
+    TEST_ASSERT_TRUE(PH_PINO_P(spl1, unserialized_pino)->data == serialized_data + serialize_size - TEST_DATA_SIZE);
+
+    unpacked_data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(unpacked_data);
+    TEST_ASSERT_TRUE(pino_unpack(unserialized_pino, unpacked_data));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked_data, TEST_DATA_SIZE);
+
+    pino_destroy(pino);
+    pino_destroy(unserialized_pino);
+    free(unpacked_data);
+    free(data);
+}
+
+static uint32_t g_adopted_u32;
+
+static void *adopt_spy(void *src, size_t size, void *static_fields)
+{
+    PH_THIS_STATIC_GET_P(spl1, static_fields, u32, &g_adopted_u32);
+
+    return PH_NAME_FUNC_ADOPT(spl1)(src, size, static_fields);
+}
+
+void test_adopt_handler(void)
+{
+    static pino_handler_t unchecked, spy;
+    pino_t *pino, *adopted;
+    uint8_t data[TEST_DATA_SIZE], *serialized_data;
+    size_t serialize_size;
+
+    /* nothing would bound the adopted payload */
+    unchecked = g_ph_handler_spl1_obj;
+    unchecked.validate = NULL;
+    unchecked.payload_size = NULL;
+    TEST_ASSERT_FALSE(pino_handler_register("spl2", &unchecked));
+    unchecked.payload_size = g_ph_handler_spl1_obj.payload_size;
+    TEST_ASSERT_TRUE(pino_handler_register("spl2", &unchecked));
+    TEST_ASSERT_TRUE(pino_handler_unregister("spl2"));
+
+    spy = g_ph_handler_spl1_obj;
+    spy.adopt = adopt_spy;
+    TEST_ASSERT_TRUE(pino_handler_register("spl3", &spy));
+
+    generate_fixed_data(data, TEST_DATA_SIZE);
+    pino = pino_pack("spl3", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 13579);
+
+    serialize_size = pino_serialize_size(pino);
+    serialized_data = (uint8_t *)malloc(serialize_size);
+    TEST_ASSERT_NOT_NULL(serialized_data);
+    TEST_ASSERT_TRUE(pino_serialize(pino, serialized_data));
+
+    /* adopt runs on the record's static fields */
+    g_adopted_u32 = 0;
+    adopted = pino_unserialize_adopt(serialized_data, serialize_size, free);
+    TEST_ASSERT_NOT_NULL(adopted);
+    TEST_ASSERT_EQUAL_UINT32(13579, g_adopted_u32);
+    TEST_ASSERT_EQUAL_UINT32(13579, get_u32(adopted));
+
+    pino_destroy(adopted);
+    pino_destroy(pino);
+    TEST_ASSERT_TRUE(pino_handler_unregister("spl3"));
+}
+
+void test_unserialize_lazy(void)
+{
+    pino_t *pino, *lazy_pino;
+    uint8_t *data, *serialized_data, *unpacked_data;
+    size_t serialize_size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+
+    generate_fixed_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 24680);
+    TEST_ASSERT_TRUE(pino_is_loaded(pino));
+
+    serialize_size = pino_serialize_size(pino);
+    serialized_data = (uint8_t *)malloc(serialize_size);
+    TEST_ASSERT_NOT_NULL(serialized_data);
+    TEST_ASSERT_TRUE(pino_serialize(pino, serialized_data));
+
+    lazy_pino = pino_unserialize_lazy(serialized_data, serialize_size);
+    TEST_ASSERT_NOT_NULL(lazy_pino);
+    TEST_ASSERT_FALSE(pino_is_loaded(lazy_pino));
+    TEST_ASSERT_EQUAL_UINT32(24680, get_u32(lazy_pino));
+
+    /* payload is still read from the source buffer */
+    serialized_data[serialize_size - 1] ^= 0xFF;
+    data[TEST_DATA_SIZE - 1] ^= 0xFF;
+
+    TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE, pino_unpack_size(lazy_pino));
+    TEST_ASSERT_TRUE(pino_is_loaded(lazy_pino));
+
+    unpacked_data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(unpacked_data);
+    TEST_ASSERT_TRUE(pino_unpack(lazy_pino, unpacked_data));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked_data, TEST_DATA_SIZE);
+
+    TEST_ASSERT_NULL(pino_unserialize_lazy(serialized_data, serialize_size - 1));
+    TEST_ASSERT_FALSE(pino_is_loaded(NULL));
+
+    pino_destroy(pino);
+    pino_destroy(lazy_pino);
+    free(unpacked_data);
+    free(serialized_data);
+    free(data);
+}
+
+void test_peek(void)
+{
+    pino_t *pino;
+    pino_header_t header;
+    uint8_t *data, *serialized_data;
+    size_t serialize_size;
+    uint32_t u32;
+    spl1_size_t size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 987654321);
+
+    serialize_size = pino_serialize_size(pino);
+    serialized_data = (uint8_t *)malloc(serialize_size);
+    TEST_ASSERT_NOT_NULL(serialized_data);
+    TEST_ASSERT_TRUE(pino_serialize(pino, serialized_data));
+
+    TEST_ASSERT_TRUE(pino_peek(serialized_data, serialize_size, &header));
+    TEST_ASSERT_EQUAL_MEMORY("spl1", header.magic, sizeof(pino_magic_safe_t));
+    TEST_ASSERT_EQUAL_size_t(PH_SIZE_STATIC(spl1), header.static_fields_size);
+    TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE, header.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(data, header.payload, TEST_DATA_SIZE);
+
+    TEST_ASSERT_TRUE(PH_PEEK_STATIC_GET(spl1, &header, u32, &u32));
+    TEST_ASSERT_EQUAL_UINT32(987654321, u32);
+    TEST_ASSERT_TRUE(PH_PEEK_STATIC_GET(spl1, &header, size, &size));
+    TEST_ASSERT_EQUAL_UINT32(TEST_DATA_SIZE, size);
+
+    pino_destroy(pino);
+    free(serialized_data);
+    free(data);
+}
+
 void test_version_id(void)
 {
     TEST_ASSERT_EQUAL_UINT32(PINO_VERSION_ID, pino_version_id());
@@ -266,9 +570,16 @@ int main(void)
     RUN_TEST(test_register_unregistered);
     RUN_TEST(test_register_glowing);
     RUN_TEST(test_pack);
+    RUN_TEST(test_unpack_view);
     RUN_TEST(test_pack_fail);
     RUN_TEST(test_pack_glowing);
+    RUN_TEST(test_memory_manager);
     RUN_TEST(test_pino_serialize);
+    RUN_TEST(test_clone);
+    RUN_TEST(test_pack_adopt);
+    RUN_TEST(test_adopt_handler);
+    RUN_TEST(test_unserialize_lazy);
+    RUN_TEST(test_peek);
 
     RUN_TEST(test_version_id);
     RUN_TEST(test_buildtime);
@@ -0,0 +1,332 @@
+/*
+ * libpino test - test_batch.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/pool.h>
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  1024
+#define TEST_BATCH_SIZE 10
+#define TEST_PARALLEL_SIZE 1000
+#define TEST_POOL_WORKERS 4
+#define TEST_LAZY_SIZE (1024 * 1024)
+
+static pino_handler_t g_spl2_handler;
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    g_spl2_handler = g_ph_handler_spl1_obj;
+    if (!pino_handler_register("spl2", &g_spl2_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("spl2") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static void create_batch(pino_t **pinos, const uint8_t *data)
+{
+    size_t i;
+
+    for (i = 0; i < TEST_BATCH_SIZE; i++) {
+        pinos[i] = pino_pack(i % 2 == 0 ? "spl1" : "spl2", data, TEST_DATA_SIZE - i * 10);
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], (uint32_t)i);
+    }
+}
+
+static void destroy_batch(pino_t **pinos, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        pino_destroy(pinos[i]);
+    }
+}
+
+void test_serialize_batch(void)
+{
+    pino_t *pinos[TEST_BATCH_SIZE], *unserialized[TEST_BATCH_SIZE];
+    uint8_t *data, *serialized_data, *single, *unpacked_data;
+    size_t offsets[TEST_BATCH_SIZE], total, size, consumed, i;
+    pino_validate_result_t result;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    unpacked_data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(unpacked_data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    create_batch(pinos, data);
+
+    total = pino_serialize_batch((const pino_t **)pinos, TEST_BATCH_SIZE, NULL, 0, NULL);
+    TEST_ASSERT_GREATER_THAN_size_t(0, total);
+
+    serialized_data = (uint8_t *)malloc(total);
+    TEST_ASSERT_NOT_NULL(serialized_data);
+
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch((const pino_t **)pinos, TEST_BATCH_SIZE, serialized_data, total - 1, offsets));
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch((const pino_t **)pinos, TEST_BATCH_SIZE, serialized_data, total, offsets));
+
+    for (i = 0; i < TEST_BATCH_SIZE; i++) {
+        size = pino_serialize_size(pinos[i]);
+        single = (uint8_t *)malloc(size);
+        TEST_ASSERT_NOT_NULL(single);
+        TEST_ASSERT_TRUE(pino_serialize(pinos[i], single));
+        TEST_ASSERT_EQUAL_MEMORY(single, serialized_data + offsets[i], size);
+        free(single);
+    }
+
+    /* without offsets_out */
+    memset(serialized_data, 0, total);
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch((const pino_t **)pinos, TEST_BATCH_SIZE, serialized_data, total, NULL));
+
+    TEST_ASSERT_EQUAL_size_t(TEST_BATCH_SIZE, pino_unserialize_batch(serialized_data, total, unserialized, TEST_BATCH_SIZE));
+    for (i = 0; i < TEST_BATCH_SIZE; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(pinos[i]->magic, unserialized[i]->magic, sizeof(pino_magic_safe_t));
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)i, get_u32(unserialized[i]));
+        TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE - i * 10, pino_unpack_size(unserialized[i]));
+        TEST_ASSERT_TRUE(pino_unpack(unserialized[i], unpacked_data));
+        TEST_ASSERT_EQUAL_MEMORY(data, unpacked_data, TEST_DATA_SIZE - i * 10);
+    }
+    destroy_batch(unserialized, TEST_BATCH_SIZE);
+
+    /* the stop reason tells a clean end from a cut off record */
+    TEST_ASSERT_EQUAL_size_t(TEST_BATCH_SIZE, pino_unserialize_batch_ex(serialized_data, total, unserialized, TEST_BATCH_SIZE, &consumed, &result));
+    TEST_ASSERT_EQUAL_size_t(total, consumed);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, result);
+    destroy_batch(unserialized, TEST_BATCH_SIZE);
+    TEST_ASSERT_EQUAL_size_t(TEST_BATCH_SIZE - 1, pino_unserialize_batch_ex(serialized_data, total - 1, unserialized, TEST_BATCH_SIZE, &consumed, &result));
+    TEST_ASSERT_EQUAL_size_t(offsets[TEST_BATCH_SIZE - 1], consumed);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, result);
+    destroy_batch(unserialized, TEST_BATCH_SIZE - 1);
+    TEST_ASSERT_EQUAL_size_t(2, pino_unserialize_batch_ex(serialized_data, total, unserialized, 2, &consumed, &result));
+    TEST_ASSERT_EQUAL_size_t(offsets[2], consumed);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, result);
+    destroy_batch(unserialized, 2);
+
+    /* stops at the first broken record */
+    serialized_data[offsets[3]] = '\0';
+    TEST_ASSERT_EQUAL_size_t(3, pino_unserialize_batch_ex(serialized_data, total, unserialized, TEST_BATCH_SIZE, &consumed, &result));
+    TEST_ASSERT_EQUAL_size_t(offsets[3], consumed);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_HANDLER_MISSING, result);
+    destroy_batch(unserialized, 3);
+
+    TEST_ASSERT_EQUAL_size_t(2, pino_unserialize_batch(serialized_data, total, unserialized, 2));
+    destroy_batch(unserialized, 2);
+
+    destroy_batch(pinos, TEST_BATCH_SIZE);
+    free(serialized_data);
+    free(unpacked_data);
+    free(data);
+}
+
+void test_serialize_batch_invalid(void)
+{
+    pino_t *pinos[2] = {NULL, NULL};
+
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch(NULL, 1, NULL, 0, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch((const pino_t **)pinos, 0, NULL, 0, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch((const pino_t **)pinos, 2, NULL, 0, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_unserialize_batch(NULL, 0, pinos, 2));
+    TEST_ASSERT_EQUAL_size_t(0, pino_unserialize_batch_ex(NULL, 0, pinos, 2, NULL, NULL));
+}
+
+static void parallel_for_fn(void *arg, size_t begin, size_t end)
+{
+    uint32_t *values = (uint32_t *)arg;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        values[i] += (uint32_t)i;
+    }
+}
+
+void test_pool_parallel_for(void)
+{
+    pino_pool_t *pool;
+    uint32_t *values;
+    size_t i;
+
+    values = (uint32_t *)calloc(TEST_PARALLEL_SIZE, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(values);
+
+    pool = pino_pool_create(TEST_POOL_WORKERS);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_GREATER_THAN_size_t(0, pino_pool_workers(pool));
+
+    TEST_ASSERT_FALSE(pino_pool_parallel_for(pool, TEST_PARALLEL_SIZE, 1, NULL, values));
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(pool, 0, 1, parallel_for_fn, values));
+
+    /* every index is visited exactly once */
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(pool, TEST_PARALLEL_SIZE, 1, parallel_for_fn, values));
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(pool, TEST_PARALLEL_SIZE, 0, parallel_for_fn, values));
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(pool, TEST_PARALLEL_SIZE, 7, parallel_for_fn, values));
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(NULL, TEST_PARALLEL_SIZE, 0, parallel_for_fn, values));
+    for (i = 0; i < TEST_PARALLEL_SIZE; i++) {
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)(i * 4), values[i]);
+    }
+
+    pino_pool_destroy(pool);
+    pino_pool_destroy(NULL);
+    free(values);
+}
+
+void test_serialize_batch_parallel(void)
+{
+    pino_t **pinos, **unserialized;
+    pino_pool_t *pool;
+    uint8_t data[TEST_BATCH_SIZE * 10], *serial_data, *parallel_data;
+    size_t *offsets, *parallel_offsets, total, i;
+
+    generate_random_data(data, sizeof(data));
+
+    pinos = (pino_t **)calloc(TEST_PARALLEL_SIZE, sizeof(pino_t *));
+    unserialized = (pino_t **)calloc(TEST_PARALLEL_SIZE, sizeof(pino_t *));
+    offsets = (size_t *)calloc(TEST_PARALLEL_SIZE, sizeof(size_t));
+    parallel_offsets = (size_t *)calloc(TEST_PARALLEL_SIZE, sizeof(size_t));
+    TEST_ASSERT_NOT_NULL(pinos);
+    TEST_ASSERT_NOT_NULL(unserialized);
+    TEST_ASSERT_NOT_NULL(offsets);
+    TEST_ASSERT_NOT_NULL(parallel_offsets);
+
+    for (i = 0; i < TEST_PARALLEL_SIZE; i++) {
+        pinos[i] = pino_pack(i % 2 == 0 ? "spl1" : "spl2", data, i % sizeof(data) + 1);
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], (uint32_t)i);
+    }
+
+    pool = pino_pool_create(TEST_POOL_WORKERS);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    total = pino_serialize_batch((const pino_t **)pinos, TEST_PARALLEL_SIZE, NULL, 0, NULL);
+    TEST_ASSERT_GREATER_THAN_size_t(0, total);
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch_parallel(pool, (const pino_t **)pinos, TEST_PARALLEL_SIZE, NULL, 0, NULL));
+
+    serial_data = (uint8_t *)malloc(total);
+    parallel_data = (uint8_t *)malloc(total);
+    TEST_ASSERT_NOT_NULL(serial_data);
+    TEST_ASSERT_NOT_NULL(parallel_data);
+
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch_parallel(pool, (const pino_t **)pinos, TEST_PARALLEL_SIZE, parallel_data, total - 1, NULL));
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch((const pino_t **)pinos, TEST_PARALLEL_SIZE, serial_data, total, offsets));
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch_parallel(pool, (const pino_t **)pinos, TEST_PARALLEL_SIZE, parallel_data, total, parallel_offsets));
+    TEST_ASSERT_EQUAL_MEMORY(serial_data, parallel_data, total);
+    TEST_ASSERT_EQUAL_MEMORY(offsets, parallel_offsets, TEST_PARALLEL_SIZE * sizeof(size_t));
+
+    /* no pool runs on the calling thread */
+    memset(parallel_data, 0, total);
+    TEST_ASSERT_EQUAL_size_t(total, pino_serialize_batch_parallel(NULL, (const pino_t **)pinos, TEST_PARALLEL_SIZE, parallel_data, total, NULL));
+    TEST_ASSERT_EQUAL_MEMORY(serial_data, parallel_data, total);
+
+    TEST_ASSERT_EQUAL_size_t(TEST_PARALLEL_SIZE, pino_unserialize_batch_parallel(pool, parallel_data, total, unserialized, TEST_PARALLEL_SIZE));
+    for (i = 0; i < TEST_PARALLEL_SIZE; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(pinos[i]->magic, unserialized[i]->magic, sizeof(pino_magic_safe_t));
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)i, get_u32(unserialized[i]));
+        TEST_ASSERT_EQUAL_size_t(i % sizeof(data) + 1, pino_unpack_size(unserialized[i]));
+    }
+    destroy_batch(unserialized, TEST_PARALLEL_SIZE);
+
+    /* the serial reader decodes window by window, one handler at a time */
+    TEST_ASSERT_EQUAL_size_t(TEST_PARALLEL_SIZE, pino_unserialize_batch(parallel_data, total, unserialized, TEST_PARALLEL_SIZE));
+    for (i = 0; i < TEST_PARALLEL_SIZE; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(pinos[i]->magic, unserialized[i]->magic, sizeof(pino_magic_safe_t));
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)i, get_u32(unserialized[i]));
+    }
+    destroy_batch(unserialized, TEST_PARALLEL_SIZE);
+
+    /* stops at the first broken record */
+    parallel_data[offsets[500]] = '\0';
+    TEST_ASSERT_EQUAL_size_t(500, pino_unserialize_batch_parallel(pool, parallel_data, total, unserialized, TEST_PARALLEL_SIZE));
+    destroy_batch(unserialized, 500);
+    TEST_ASSERT_EQUAL_size_t(500, pino_unserialize_batch(parallel_data, total, unserialized, TEST_PARALLEL_SIZE));
+    destroy_batch(unserialized, 500);
+
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_batch_parallel(pool, NULL, 1, NULL, 0, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_unserialize_batch_parallel(pool, NULL, 0, unserialized, 1));
+
+    pino_pool_destroy(pool);
+    destroy_batch(pinos, TEST_PARALLEL_SIZE);
+    free(parallel_offsets);
+    free(offsets);
+    free(parallel_data);
+    free(serial_data);
+    free(unserialized);
+    free(pinos);
+}
+
+void test_serialize_batch_parallel_lazy(void)
+{
+    pino_pool_t *pool;
+    pino_t *pino, *lazy, **pinos;
+    uint8_t *data, *record, *unpacked;
+    size_t record_size, i;
+
+    data = (uint8_t *)malloc(TEST_LAZY_SIZE);
+    unpacked = (uint8_t *)malloc(TEST_LAZY_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(unpacked);
+    generate_fixed_data(data, TEST_LAZY_SIZE);
+
+    pino = pino_pack("spl1", data, TEST_LAZY_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    record_size = pino_serialize_size(pino);
+    record = (uint8_t *)malloc(record_size);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_TRUE(pino_serialize(pino, record));
+
+    /* every worker hits the same undecoded pino at once, the payload is decoded a single time */
+    lazy = pino_unserialize_lazy(record, record_size);
+    TEST_ASSERT_NOT_NULL(lazy);
+    pinos = (pino_t **)calloc(TEST_PARALLEL_SIZE, sizeof(pino_t *));
+    TEST_ASSERT_NOT_NULL(pinos);
+    for (i = 0; i < TEST_PARALLEL_SIZE; i++) {
+        pinos[i] = pino_retain(lazy);
+    }
+
+    pool = pino_pool_create(TEST_POOL_WORKERS);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL_size_t(record_size * TEST_PARALLEL_SIZE, pino_serialize_batch_parallel(pool, (const pino_t **)pinos, TEST_PARALLEL_SIZE, NULL, 0, NULL));
+    TEST_ASSERT_TRUE(pino_is_loaded(lazy));
+    TEST_ASSERT_TRUE(pino_unpack(lazy, unpacked));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked, TEST_LAZY_SIZE);
+
+    pino_pool_destroy(pool);
+    destroy_batch(pinos, TEST_PARALLEL_SIZE);
+    pino_destroy(lazy);
+    pino_destroy(pino);
+    free(record);
+    free(pinos);
+    free(unpacked);
+    free(data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_serialize_batch);
+    RUN_TEST(test_serialize_batch_invalid);
+    RUN_TEST(test_pool_parallel_for);
+    RUN_TEST(test_serialize_batch_parallel);
+    RUN_TEST(test_serialize_batch_parallel_lazy);
+
+    return UNITY_END();
+}
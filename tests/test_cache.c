@@ -0,0 +1,332 @@
+/*
+ * libpino test - test_cache.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  (64 * 1024 + 3)
+
+static pino_handler_t g_cnt1_handler;
+static size_t g_serialize_count;
+static uint64_t g_generation;
+
+/* spl1 that counts how often the payload really is serialized */
+static bool cnt1_serialize(const void *this, const void *static_fields, void *dest)
+{
+    g_serialize_count++;
+
+    return g_ph_handler_spl1_obj.serialize(this, static_fields, dest);
+}
+
+/* bumped by the tests whenever they modify the payload in place */
+static uint64_t cnt1_generation(const void *this, const void *static_fields)
+{
+    (void)this;
+    (void)static_fields;
+
+    return g_generation;
+}
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    g_cnt1_handler = g_ph_handler_spl1_obj;
+    g_cnt1_handler.serialize = cnt1_serialize;
+    g_cnt1_handler.generation = cnt1_generation;
+    if (!pino_handler_register("cnt1", &g_cnt1_handler)) {
+        TEST_FAIL();
+    }
+
+    g_serialize_count = 0;
+    g_generation = 0;
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("cnt1") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static void assert_record(const void *record, size_t size, const uint8_t *data, size_t data_size, uint32_t u32)
+{
+    pino_t *pino;
+    uint8_t *out;
+
+    pino = pino_unserialize(record, size);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT32(u32, get_u32(pino));
+    TEST_ASSERT_EQUAL_size_t(data_size, pino_unpack_size(pino));
+
+    out = (uint8_t *)malloc(data_size);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_TRUE(pino_unpack(pino, out));
+    TEST_ASSERT_EQUAL_MEMORY(data, out, data_size);
+
+    free(out);
+    pino_destroy(pino);
+}
+
+void test_cache(void)
+{
+    pino_t *pino;
+    uint8_t *data, *plain, *cached;
+    const void *view;
+    size_t size, view_size;
+    int i;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("cnt1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+
+    size = pino_serialize_size(pino);
+    plain = (uint8_t *)malloc(size);
+    cached = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(plain);
+    TEST_ASSERT_NOT_NULL(cached);
+
+    /* off by default */
+    TEST_ASSERT_NULL(pino_serialize_view(pino, 0, &view_size));
+    TEST_ASSERT_TRUE(pino_serialize(pino, plain));
+    TEST_ASSERT_TRUE(pino_serialize(pino, plain));
+    TEST_ASSERT_EQUAL_size_t(2, g_serialize_count);
+
+    /* the first serialize fills the cache, the rest copy it */
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, true));
+    for (i = 0; i < 8; i++) {
+        memset(cached, 0, size);
+        TEST_ASSERT_EQUAL_size_t(size, pino_serialize_size(pino));
+        TEST_ASSERT_TRUE(pino_serialize(pino, cached));
+        TEST_ASSERT_EQUAL_MEMORY(plain, cached, size);
+    }
+    TEST_ASSERT_EQUAL_size_t(3, g_serialize_count);
+
+    view = pino_serialize_view(pino, 0, &view_size);
+    TEST_ASSERT_NOT_NULL(view);
+    TEST_ASSERT_EQUAL_size_t(size, view_size);
+    TEST_ASSERT_EQUAL_PTR(view, pino_serialize_view(pino, 0, &view_size));
+    TEST_ASSERT_EQUAL_MEMORY(plain, view, size);
+    TEST_ASSERT_EQUAL_size_t(3, g_serialize_count);
+
+    /* other flags bypass the cache */
+    TEST_ASSERT_NULL(pino_serialize_view(pino, PINO_SERIALIZE_CRC32C, &view_size));
+    TEST_ASSERT_NULL(pino_serialize_view(pino, PINO_SERIALIZE_COMPRESS, &view_size));
+    TEST_ASSERT_EQUAL_size_t(size + sizeof(uint32_t), pino_serialize_size_ex(pino, PINO_SERIALIZE_CRC32C));
+
+    /* static setters touch the pino, which drops the cache */
+    set_u32(pino, 0xBEEF);
+    view = pino_serialize_view(pino, 0, &view_size);
+    TEST_ASSERT_NOT_NULL(view);
+    assert_record(view, view_size, data, TEST_DATA_SIZE, 0xBEEF);
+    TEST_ASSERT_EQUAL_size_t(4, g_serialize_count);
+
+    /* so does any other mutation through pino_touch() */
+    TEST_ASSERT_TRUE(pino_touch(pino));
+    PH_PINO_P(spl1, pino)->data[0] ^= 0xFF;
+    TEST_ASSERT_TRUE(pino_serialize(pino, cached));
+    TEST_ASSERT_EQUAL_size_t(5, g_serialize_count);
+    data[0] ^= 0xFF;
+    assert_record(cached, size, data, TEST_DATA_SIZE, 0xBEEF);
+
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, false));
+    TEST_ASSERT_NULL(pino_serialize_view(pino, 0, &view_size));
+    TEST_ASSERT_TRUE(pino_serialize(pino, cached));
+    TEST_ASSERT_EQUAL_size_t(6, g_serialize_count);
+    TEST_ASSERT_FALSE(pino_serialize_cache(NULL, true));
+
+    free(plain);
+    free(cached);
+    pino_destroy(pino);
+    free(data);
+}
+
+void test_cache_clone(void)
+{
+    pino_t *pino, *clone;
+    uint8_t *data, *buffer;
+    const void *view;
+    size_t size, view_size;
+    const pino_t *pinos[2];
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("cnt1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, true));
+    view = pino_serialize_view(pino, PINO_SERIALIZE_CRC32C, &view_size);
+    TEST_ASSERT_NOT_NULL(view);
+
+    /* clones keep the setting but build their own record */
+    clone = pino_clone(pino);
+    TEST_ASSERT_NOT_NULL(clone);
+    set_u32(clone, 0xBEEF);
+    TEST_ASSERT_EQUAL_PTR(view, pino_serialize_view(pino, PINO_SERIALIZE_CRC32C, &view_size));
+    view = pino_serialize_view(clone, PINO_SERIALIZE_CRC32C, &view_size);
+    TEST_ASSERT_NOT_NULL(view);
+    assert_record(view, view_size, data, TEST_DATA_SIZE, 0xBEEF);
+    /* the copy-on-write duplicate of the payload is one more */
+    TEST_ASSERT_EQUAL_size_t(3, g_serialize_count);
+
+    /* one flags combination is kept, batches write plain records and reuse them as well */
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, false));
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, true));
+    pinos[0] = pino;
+    pinos[1] = pino;
+    size = pino_serialize_batch(pinos, 2, NULL, 0, NULL);
+    buffer = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(buffer);
+    TEST_ASSERT_EQUAL_size_t(size, pino_serialize_batch(pinos, 2, buffer, size, NULL));
+    TEST_ASSERT_EQUAL_size_t(4, g_serialize_count);
+    assert_record(buffer, size / 2, data, TEST_DATA_SIZE, 0);
+    assert_record(buffer + size / 2, size / 2, data, TEST_DATA_SIZE, 0);
+
+    free(buffer);
+    pino_destroy(clone);
+    pino_destroy(pino);
+    free(data);
+}
+
+void test_cache_stale(void)
+{
+    pino_t *pino;
+    uint8_t *data, *first, *buffer;
+    const void *view, *stale;
+    size_t size, view_size;
+    uint32_t u32;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("cnt1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, true));
+
+    stale = pino_serialize_view(pino, 0, &size);
+    TEST_ASSERT_NOT_NULL(stale);
+    first = (uint8_t *)malloc(size);
+    buffer = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(buffer);
+    memcpy(first, stale, size);
+
+    /* static fields written without pino_touch() are noticed */
+    u32 = 0xBEEF;
+    PH_THIS_STATIC_SET_P(spl1, pino->static_fields, u32, &u32);
+    view = pino_serialize_view(pino, 0, &view_size);
+    TEST_ASSERT_NOT_NULL(view);
+    TEST_ASSERT_TRUE(view != stale);
+    assert_record(view, view_size, data, TEST_DATA_SIZE, 0xBEEF);
+    TEST_ASSERT_EQUAL_size_t(2, g_serialize_count);
+
+    /* the replaced record stays readable until the pino is touched */
+    TEST_ASSERT_EQUAL_MEMORY(first, stale, size);
+
+    /* payloads modified in place are noticed through the handler's generation */
+    PH_PINO_P(spl1, pino)->data[0] ^= 0xFF;
+    g_generation++;
+    TEST_ASSERT_TRUE(pino_serialize(pino, buffer));
+    TEST_ASSERT_EQUAL_size_t(3, g_serialize_count);
+    data[0] ^= 0xFF;
+    assert_record(buffer, size, data, TEST_DATA_SIZE, 0xBEEF);
+    TEST_ASSERT_TRUE(pino_serialize(pino, buffer));
+    TEST_ASSERT_EQUAL_size_t(3, g_serialize_count);
+
+    TEST_ASSERT_TRUE(pino_touch(pino));
+    TEST_ASSERT_TRUE(pino_serialize(pino, buffer));
+    TEST_ASSERT_EQUAL_size_t(4, g_serialize_count);
+
+    free(first);
+    free(buffer);
+    pino_destroy(pino);
+    free(data);
+}
+
+static size_t cache_stale_count(const pino_t *pino)
+{
+    const pino_cache_t *cache;
+    size_t count = 0;
+
+    for (cache = pino->cache ? pino->cache->stale : NULL; cache; cache = cache->stale) {
+        count++;
+    }
+
+    return count;
+}
+
+void test_cache_sequence(void)
+{
+    pino_t *pino;
+    uint8_t *data, *buffer;
+    const void *view;
+    size_t size;
+    uint32_t u32;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    pino = pino_pack("cnt1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_TRUE(pino_serialize_cache(pino, true));
+    size = pino_serialize_size(pino);
+    buffer = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(buffer);
+
+    /* a sequence bumped before every publish must not leave a record behind each time */
+    for (u32 = 0; u32 < 64; u32++) {
+        PH_THIS_STATIC_SET_P(spl1, pino->static_fields, u32, &u32);
+        TEST_ASSERT_TRUE(pino_serialize(pino, buffer));
+        assert_record(buffer, size, data, TEST_DATA_SIZE, u32);
+        TEST_ASSERT_EQUAL_size_t(0, cache_stale_count(pino));
+    }
+
+    /* viewed records are kept, the unviewed ones after them are not */
+    view = pino_serialize_view(pino, 0, &size);
+    TEST_ASSERT_NOT_NULL(view);
+    for (u32 = 64; u32 < 128; u32++) {
+        PH_THIS_STATIC_SET_P(spl1, pino->static_fields, u32, &u32);
+        TEST_ASSERT_TRUE(pino_serialize(pino, buffer));
+        TEST_ASSERT_EQUAL_size_t(1, cache_stale_count(pino));
+    }
+    assert_record(view, size, data, TEST_DATA_SIZE, 63);
+
+    free(buffer);
+    pino_destroy(pino);
+    free(data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cache);
+    RUN_TEST(test_cache_clone);
+    RUN_TEST(test_cache_stale);
+    RUN_TEST(test_cache_sequence);
+
+    return UNITY_END();
+}
@@ -0,0 +1,394 @@
+/*
+ * libpino test - test_checksum.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/decoder.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  4099
+
+static pino_handler_t g_spl3_handler;
+static pino_handler_t g_spl4_handler;
+static size_t g_spl3_unserialized;
+static size_t g_spl4_chunks;
+
+static bool spl3_unserialize(void *this, void *static_fields, const void *src, size_t size)
+{
+    g_spl3_unserialized++;
+
+    return PH_NAME_FUNC_UNSERIALIZE(spl1)(this, static_fields, src, size);
+}
+
+static bool spl4_unserialize_chunk(void *this, void *static_fields, const void *src, size_t size, size_t offset)
+{
+    g_spl4_chunks++;
+
+    return g_ph_handler_spl1_obj.unserialize_chunk(this, static_fields, src, size, offset);
+}
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    /* no payload_size, so the decoder only finds the trailer at the end of the stream */
+    g_spl3_handler = g_ph_handler_spl1_obj;
+    g_spl3_handler.payload_size = NULL;
+    g_spl3_handler.unserialize_chunk = NULL;
+    g_spl3_handler.unserialize = spl3_unserialize;
+    if (!pino_handler_register("spl3", &g_spl3_handler)) {
+        TEST_FAIL();
+    }
+
+    /* spl1 that counts what reaches it through the decoder */
+    g_spl4_handler = g_ph_handler_spl1_obj;
+    g_spl4_handler.unserialize = spl3_unserialize;
+    g_spl4_handler.unserialize_chunk = spl4_unserialize_chunk;
+    if (!pino_handler_register("spl4", &g_spl4_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    pino_crc32c_hardware(true);
+
+    if (!pino_handler_unregister("spl4") || !pino_handler_unregister("spl3") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static uint32_t crc32c_bitwise(const uint8_t *data, size_t size)
+{
+    uint32_t crc;
+    size_t i;
+    int bit;
+
+    crc = 0xFFFFFFFF;
+    for (i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        }
+    }
+
+    return ~crc;
+}
+
+void test_crc32c(void)
+{
+    uint8_t data[TEST_DATA_SIZE], copy[TEST_DATA_SIZE];
+    size_t offset, size;
+    int hardware;
+
+    generate_random_data(data, sizeof(data));
+
+    for (hardware = 0; hardware <= 1; hardware++) {
+        pino_crc32c_hardware(hardware == 1);
+
+        TEST_ASSERT_EQUAL_HEX32(0xE3069283, pino_crc32c_update(0, "123456789", 9));
+        TEST_ASSERT_EQUAL_HEX32(0, pino_crc32c_update(0, NULL, 0));
+
+        /* every alignment and tail length, also split in two */
+        for (offset = 0; offset < 16; offset++) {
+            for (size = 0; size < 64; size++) {
+                TEST_ASSERT_EQUAL_HEX32(crc32c_bitwise(data + offset, size), pino_crc32c_update(0, data + offset, size));
+                TEST_ASSERT_EQUAL_HEX32(
+                    crc32c_bitwise(data + offset, size + 100),
+                    pino_crc32c_update(pino_crc32c_update(0, data + offset, size), data + offset + size, 100)
+                );
+
+                memset(copy, 0, sizeof(copy));
+                TEST_ASSERT_EQUAL_HEX32(crc32c_bitwise(data + offset, size), pino_crc32c_copy(0, copy + offset, data + offset, size));
+                TEST_ASSERT_EQUAL_MEMORY(data + offset, copy + offset, size);
+            }
+        }
+
+        TEST_ASSERT_EQUAL_HEX32(crc32c_bitwise(data, sizeof(data)), pino_crc32c_update(0, data, sizeof(data)));
+    }
+}
+
+void test_checksum(void)
+{
+    pino_header_t header;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], *plain, *checked, *copy;
+    size_t plain_size, checked_size;
+    int hardware;
+
+    generate_random_data(data, sizeof(data));
+    pino = pino_pack("spl1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+
+    plain = serialize(pino, 0, &plain_size);
+    checked = serialize(pino, PINO_SERIALIZE_CRC32C, &checked_size);
+    TEST_ASSERT_EQUAL_size_t(plain_size + sizeof(uint32_t), checked_size);
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_size_ex(pino, 0x80));
+    TEST_ASSERT_FALSE(pino_serialize_ex(pino, checked, 0x80));
+    TEST_ASSERT_FALSE(pino_serialize_ex(NULL, checked, PINO_SERIALIZE_CRC32C));
+
+    /* only the flag byte and the trailer differ */
+    TEST_ASSERT_EQUAL_MEMORY(plain, checked, sizeof(pino_magic_t) + 7);
+    TEST_ASSERT_EQUAL_UINT8(PINO_SERIALIZE_CRC32C, checked[sizeof(pino_magic_t) + 7]);
+    TEST_ASSERT_EQUAL_MEMORY(plain + PINO_HEADER_SIZE, checked + PINO_HEADER_SIZE, plain_size - PINO_HEADER_SIZE);
+
+    TEST_ASSERT_TRUE(pino_peek(checked, checked_size, &header));
+    TEST_ASSERT_EQUAL_UINT32(PINO_SERIALIZE_CRC32C, header.flags);
+    TEST_ASSERT_EQUAL_size_t(sizeof(data), header.payload_size);
+    TEST_ASSERT_TRUE(pino_peek(plain, plain_size, &header));
+    TEST_ASSERT_EQUAL_UINT32(0, header.flags);
+
+    for (hardware = 0; hardware <= 1; hardware++) {
+        pino_crc32c_hardware(hardware == 1);
+
+        TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(checked, checked_size));
+        assert_unpacked(pino_unserialize(checked, checked_size), data, sizeof(data));
+        assert_unpacked(pino_unserialize_validated(checked, checked_size), data, sizeof(data));
+        assert_unpacked(pino_unserialize_lazy(checked, checked_size), data, sizeof(data));
+
+        copy = (uint8_t *)malloc(checked_size);
+        TEST_ASSERT_NOT_NULL(copy);
+        memcpy(copy, checked, checked_size);
+        assert_unpacked(pino_unserialize_adopt(copy, checked_size, free), data, sizeof(data));
+    }
+
+    free(plain);
+    free(checked);
+    pino_destroy(pino);
+}
+
+void test_checksum_corrupted(void)
+{
+    pino_t *pino, *spl3;
+    uint8_t data[TEST_DATA_SIZE], *checked, *copy;
+    size_t checked_size, i;
+
+    generate_random_data(data, sizeof(data));
+    pino = pino_pack("spl1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    checked = serialize(pino, PINO_SERIALIZE_CRC32C, &checked_size);
+
+    /* a flipped bit anywhere behind the header never gets through */
+    for (i = PINO_HEADER_SIZE; i < checked_size; i += (i < 64 || i > checked_size - 64) ? 1 : 97) {
+        checked[i] ^= 0x10;
+
+        TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_CHECKSUM, pino_validate(checked, checked_size));
+        TEST_ASSERT_NULL(pino_unserialize(checked, checked_size));
+        TEST_ASSERT_NULL(pino_unserialize_validated(checked, checked_size));
+        TEST_ASSERT_NULL(pino_unserialize_lazy(checked, checked_size));
+
+        copy = (uint8_t *)malloc(checked_size);
+        TEST_ASSERT_NOT_NULL(copy);
+        memcpy(copy, checked, checked_size);
+        TEST_ASSERT_NULL(pino_unserialize_adopt(copy, checked_size, free));
+        free(copy);
+
+        checked[i] ^= 0x10;
+    }
+
+    /* the truncated trailer and unknown flags are rejected before any checksum */
+    TEST_ASSERT_NULL(pino_unserialize(checked, PINO_HEADER_SIZE + 2));
+    checked[sizeof(pino_magic_t) + 7] |= 0x80;
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(checked, checked_size));
+    checked[sizeof(pino_magic_t) + 7] &= 0x7F;
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(checked, checked_size));
+
+    free(checked);
+    pino_destroy(pino);
+
+    spl3 = pino_pack("spl3", data, 100);
+    TEST_ASSERT_NOT_NULL(spl3);
+    set_u32(spl3, 0xC0FFEE);
+    checked = serialize(spl3, PINO_SERIALIZE_CRC32C, &checked_size);
+
+    /* spl1 sizes its copy from the static fields, so it only ever sees verified records */
+    g_spl3_unserialized = 0;
+    checked[checked_size - 1] ^= 0x01;
+    TEST_ASSERT_NULL(pino_unserialize(checked, checked_size));
+    TEST_ASSERT_NULL(pino_unserialize_validated(checked, checked_size));
+    checked[checked_size - 1] ^= 0x01;
+    checked[PINO_HEADER_SIZE] ^= 0x01;
+    TEST_ASSERT_NULL(pino_unserialize_validated(checked, checked_size));
+    TEST_ASSERT_EQUAL_size_t(0, g_spl3_unserialized);
+    checked[PINO_HEADER_SIZE] ^= 0x01;
+    assert_unpacked(pino_unserialize(checked, checked_size), data, 100);
+    TEST_ASSERT_EQUAL_size_t(1, g_spl3_unserialized);
+    free(checked);
+    pino_destroy(spl3);
+}
+
+static pino_decoder_status_t feed_all(pino_decoder_t *decoder, const uint8_t *src, size_t size, size_t step)
+{
+    pino_decoder_status_t status;
+    size_t offset, n, consumed;
+
+    status = PINO_DECODER_NEED_MORE;
+    for (offset = 0; offset < size && status == PINO_DECODER_NEED_MORE; offset += consumed) {
+        n = size - offset < step ? size - offset : step;
+        status = pino_decoder_feed(decoder, src + offset, n, &consumed);
+    }
+
+    return status;
+}
+
+void test_checksum_decoder(void)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], *checked;
+    size_t checked_size, steps[] = {1, 7, 4096, TEST_DATA_SIZE * 2}, i;
+
+    generate_random_data(data, sizeof(data));
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    /* spl1 knows its payload_size and streams in chunks, the trailer follows the payload */
+    pino = pino_pack("spl1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    checked = serialize(pino, PINO_SERIALIZE_CRC32C, &checked_size);
+    pino_destroy(pino);
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, feed_all(decoder, checked, checked_size, steps[i]));
+        assert_unpacked(pino_decoder_take(decoder), data, sizeof(data));
+    }
+
+    checked[checked_size / 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, feed_all(decoder, checked, checked_size, 100));
+    pino_decoder_reset(decoder);
+    checked[checked_size / 2] ^= 0x01;
+    checked[checked_size - 1] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, feed_all(decoder, checked, checked_size, 100));
+    pino_decoder_reset(decoder);
+    free(checked);
+
+    /* spl3 ends with the stream */
+    pino = pino_pack("spl3", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    checked = serialize(pino, PINO_SERIALIZE_CRC32C, &checked_size);
+    pino_destroy(pino);
+
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, feed_all(decoder, checked, checked_size, 13));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, pino_decoder_finish(decoder));
+    assert_unpacked(pino_decoder_take(decoder), data, sizeof(data));
+
+    checked[checked_size - 1] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, feed_all(decoder, checked, checked_size, 13));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_finish(decoder));
+    pino_decoder_reset(decoder);
+
+    /* shorter than the trailer */
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, feed_all(decoder, checked, PINO_HEADER_SIZE + sizeof(spl1_size_t) + sizeof(uint32_t) + 2, 13));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_finish(decoder));
+    pino_decoder_reset(decoder);
+    free(checked);
+
+    /* without a fused check nothing is streamed, the handler only sees records whose trailer matched */
+    pino = pino_pack("spl4", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    checked = serialize(pino, PINO_SERIALIZE_CRC32C, &checked_size);
+
+    g_spl3_unserialized = 0;
+    g_spl4_chunks = 0;
+    checked[PINO_HEADER_SIZE + sizeof(spl1_size_t)] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, feed_all(decoder, checked, checked_size, 100));
+    pino_decoder_reset(decoder);
+    checked[PINO_HEADER_SIZE + sizeof(spl1_size_t)] ^= 0x01;
+    checked[checked_size / 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, feed_all(decoder, checked, checked_size, 100));
+    pino_decoder_reset(decoder);
+    TEST_ASSERT_EQUAL_size_t(0, g_spl3_unserialized);
+    checked[checked_size / 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, feed_all(decoder, checked, checked_size, 100));
+    assert_unpacked(pino_decoder_take(decoder), data, sizeof(data));
+    TEST_ASSERT_EQUAL_size_t(1, g_spl3_unserialized);
+    TEST_ASSERT_EQUAL_size_t(0, g_spl4_chunks);
+
+    /* unchecked records still stream */
+    free(checked);
+    checked = serialize(pino, 0, &checked_size);
+    pino_destroy(pino);
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, feed_all(decoder, checked, checked_size, 100));
+    assert_unpacked(pino_decoder_take(decoder), data, sizeof(data));
+    TEST_ASSERT_EQUAL_size_t(1, g_spl3_unserialized);
+    TEST_ASSERT_NOT_EQUAL(0, g_spl4_chunks);
+
+    free(checked);
+    pino_decoder_destroy(decoder);
+}
+
+void test_checksum_batch(void)
+{
+    pino_t *pinos[3], *out[3];
+    uint8_t data[TEST_DATA_SIZE], *buffer;
+    size_t sizes[3], offset, consumed, i;
+    pino_validate_result_t result;
+
+    generate_random_data(data, sizeof(data));
+
+    offset = 0;
+    for (i = 0; i < 3; i++) {
+        pinos[i] = pino_pack("spl1", data, 100 * (i + 1));
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], 0xC0FFEE);
+        sizes[i] = pino_serialize_size_ex(pinos[i], PINO_SERIALIZE_CRC32C);
+        offset += sizes[i];
+    }
+
+    /* checked records are self-delimiting as well */
+    buffer = (uint8_t *)malloc(offset);
+    TEST_ASSERT_NOT_NULL(buffer);
+    offset = 0;
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(pino_serialize_ex(pinos[i], buffer + offset, PINO_SERIALIZE_CRC32C));
+        offset += sizes[i];
+    }
+
+    TEST_ASSERT_EQUAL_size_t(3, pino_unserialize_batch(buffer, offset, out, 3));
+    for (i = 0; i < 3; i++) {
+        assert_unpacked(out[i], data, 100 * (i + 1));
+    }
+
+    buffer[sizes[0] + sizes[1] - 1] ^= 0x01;
+    TEST_ASSERT_EQUAL_size_t(1, pino_unserialize_batch_ex(buffer, offset, out, 3, &consumed, &result));
+    TEST_ASSERT_EQUAL_size_t(sizes[0], consumed);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_CHECKSUM, result);
+    pino_destroy(out[0]);
+
+    free(buffer);
+    for (i = 0; i < 3; i++) {
+        pino_destroy(pinos[i]);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_crc32c);
+    RUN_TEST(test_checksum);
+    RUN_TEST(test_checksum_corrupted);
+    RUN_TEST(test_checksum_decoder);
+    RUN_TEST(test_checksum_batch);
+
+    return UNITY_END();
+}
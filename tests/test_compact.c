@@ -0,0 +1,249 @@
+/*
+ * libpino test - test_compact.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/decoder.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+static pino_handler_t g_nps1_handler;
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    /* spl1 without payload_size, so only its compact records delimit themselves */
+    g_nps1_handler = g_ph_handler_spl1_obj;
+    g_nps1_handler.payload_size = NULL;
+    if (!pino_handler_register("nps1", &g_nps1_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("nps1") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+void test_compact_leb128(void)
+{
+    uint64_t values[] = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0xFFFFFFFF, ((uint64_t)1 << 49) - 1, (uint64_t)1 << 56, UINT64_MAX}, value;
+    uint8_t buffer[LEB128_MAX + 8];
+    size_t i, n;
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        /* with and without room for the word read */
+        memset(buffer, 0xFF, sizeof(buffer));
+        n = leb128_write(buffer, values[i]);
+        TEST_ASSERT_EQUAL_size_t(leb128_size(values[i]), n);
+        TEST_ASSERT_EQUAL_size_t(n, leb128_read(buffer, sizeof(buffer), &value));
+        TEST_ASSERT_EQUAL_UINT64(values[i], value);
+        TEST_ASSERT_EQUAL_size_t(n, leb128_read(buffer, n, &value));
+        TEST_ASSERT_EQUAL_UINT64(values[i], value);
+        TEST_ASSERT_EQUAL_size_t(0, leb128_read(buffer, n - 1, &value));
+    }
+
+    /* unterminated */
+    memset(buffer, 0xFF, sizeof(buffer));
+    TEST_ASSERT_EQUAL_size_t(0, leb128_read(buffer, sizeof(buffer), &value));
+}
+
+void test_compact(void)
+{
+    pino_header_t header;
+    pino_t *pino;
+    uint8_t *data, *classic, *compact;
+    size_t sizes[] = {1, 20, 200, 64 * 1024}, classic_size, compact_size, i, f;
+    uint32_t flags[] = {0, PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_COMPRESS, PINO_SERIALIZE_CRC32C | PINO_SERIALIZE_COMPRESS};
+
+    data = (uint8_t *)malloc(64 * 1024);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, 64 * 1024);
+    memset(data + 1024, 'x', 32 * 1024);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+            pino = pino_pack("spl1", data, sizes[i]);
+            TEST_ASSERT_NOT_NULL(pino);
+            set_u32(pino, 0xC0FFEE);
+
+            classic = serialize(pino, flags[f], &classic_size);
+            compact = serialize(pino, flags[f] | PINO_SERIALIZE_COMPACT, &compact_size);
+            pino_destroy(pino);
+
+            /* marker, magic and two varints instead of the 8 byte static_fields_size */
+            TEST_ASSERT_TRUE(compact_size < classic_size);
+            TEST_ASSERT_TRUE(pino_peek(compact, compact_size, &header));
+            TEST_ASSERT_EQUAL_STRING("spl1", header.magic);
+            TEST_ASSERT_EQUAL_size_t(compact_size - classic_size + PINO_HEADER_SIZE, header.header_size);
+            TEST_ASSERT_TRUE(pino_peek(classic, classic_size, &header));
+            TEST_ASSERT_EQUAL_size_t(PINO_HEADER_SIZE, header.header_size);
+
+            assert_unpacked(pino_unserialize(compact, compact_size), data, sizes[i]);
+            assert_unpacked(pino_unserialize_validated(compact, compact_size), data, sizes[i]);
+            assert_unpacked(pino_unserialize_lazy(compact, compact_size), data, sizes[i]);
+            assert_decoded(compact, compact_size, 1, data, sizes[i]);
+            TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(compact, compact_size));
+
+            if (flags[f] & PINO_SERIALIZE_CRC32C) {
+                compact[compact_size / 2] ^= 0x01;
+                TEST_ASSERT_NULL(pino_unserialize(compact, compact_size));
+                TEST_ASSERT_TRUE(pino_validate(compact, compact_size) != PINO_VALIDATE_OK);
+            }
+
+            free(classic);
+            free(compact);
+        }
+    }
+
+    free(data);
+}
+
+void test_compact_alias(void)
+{
+    pino_t *pino;
+    uint8_t data[20], *record;
+    size_t size;
+
+    generate_random_data(data, sizeof(data));
+    pino = pino_pack("spl1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+
+    /* a 20 byte payload: 40 bytes classic, 35 with the magic, 32 with a one byte alias */
+    TEST_ASSERT_EQUAL_size_t(40, pino_serialize_size(pino));
+    TEST_ASSERT_EQUAL_size_t(35, pino_serialize_size_ex(pino, PINO_SERIALIZE_COMPACT));
+    TEST_ASSERT_TRUE(pino_handler_alias("spl1", 7));
+    TEST_ASSERT_EQUAL_size_t(32, pino_serialize_size_ex(pino, PINO_SERIALIZE_COMPACT));
+
+    record = serialize(pino, PINO_SERIALIZE_COMPACT, &size);
+    TEST_ASSERT_EQUAL_size_t(32, size);
+    assert_unpacked(pino_unserialize(record, size), data, sizeof(data));
+    assert_decoded(record, size, 1, data, sizeof(data));
+
+    /* readers need the same alias */
+    TEST_ASSERT_TRUE(pino_handler_alias("spl1", 0));
+    TEST_ASSERT_NULL(pino_unserialize(record, size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(record, size));
+    free(record);
+
+    /* two byte aliases */
+    TEST_ASSERT_TRUE(pino_handler_alias("spl1", 300));
+    record = serialize(pino, PINO_SERIALIZE_COMPACT, &size);
+    TEST_ASSERT_EQUAL_size_t(33, size);
+    assert_unpacked(pino_unserialize(record, size), data, sizeof(data));
+    assert_decoded(record, size, 1, data, sizeof(data));
+    free(record);
+
+    /* one alias per handler */
+    TEST_ASSERT_FALSE(pino_handler_alias("nps1", 300));
+    TEST_ASSERT_TRUE(pino_handler_alias("nps1", 301));
+    TEST_ASSERT_FALSE(pino_handler_alias("none", 302));
+    TEST_ASSERT_FALSE(pino_handler_alias(NULL, 303));
+
+    pino_destroy(pino);
+}
+
+void test_compact_batch(void)
+{
+    pino_t *pinos[4], *out[4];
+    uint8_t data[64], *buffer;
+    size_t sizes[4], offset, i;
+    uint32_t flags[] = {0, PINO_SERIALIZE_COMPACT, PINO_SERIALIZE_COMPACT | PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_CRC32C};
+    pino_magic_safe_t magics[] = {"spl1", "nps1", "nps1", "spl1"};
+
+    generate_random_data(data, sizeof(data));
+    TEST_ASSERT_TRUE(pino_handler_alias("nps1", 1));
+
+    offset = 0;
+    for (i = 0; i < 4; i++) {
+        pinos[i] = pino_pack(magics[i], data, 16 * (i + 1));
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], 0xC0FFEE);
+        sizes[i] = pino_serialize_record(pinos[i], NULL, 0, flags[i]);
+        offset += sizes[i];
+    }
+
+    /* classic and compact records side by side, the compact ones need no payload_size */
+    buffer = (uint8_t *)malloc(offset);
+    TEST_ASSERT_NOT_NULL(buffer);
+    offset = 0;
+    for (i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_size_t(sizes[i], pino_serialize_record(pinos[i], buffer + offset, sizes[i], flags[i]));
+        offset += sizes[i];
+    }
+
+    TEST_ASSERT_EQUAL_size_t(4, pino_unserialize_batch(buffer, offset, out, 4));
+    for (i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_STRING(magics[i], out[i]->magic);
+        assert_unpacked(out[i], data, 16 * (i + 1));
+        pino_destroy(pinos[i]);
+    }
+
+    free(buffer);
+}
+
+void test_compact_truncated(void)
+{
+    pino_t *pino;
+    pino_decoder_t *decoder;
+    uint8_t data[300], *record;
+    size_t size, i;
+
+    generate_random_data(data, sizeof(data));
+    pino = pino_pack("nps1", data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    record = serialize(pino, PINO_SERIALIZE_COMPACT | PINO_SERIALIZE_CRC32C, &size);
+    pino_destroy(pino);
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    for (i = 0; i < size; i++) {
+        TEST_ASSERT_NULL(pino_unserialize(record, i));
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, pino_decoder_feed(decoder, record, i, NULL));
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_finish(decoder));
+        pino_decoder_reset(decoder);
+    }
+
+    /* unknown versions and magic modes */
+    record[0] ^= 1 << PINO_COMPACT_VERSION_SHIFT;
+    TEST_ASSERT_NULL(pino_unserialize(record, size));
+    record[0] ^= 1 << PINO_COMPACT_VERSION_SHIFT;
+    record[0] |= 0x3;
+    TEST_ASSERT_NULL(pino_unserialize(record, size));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(decoder, record, size, NULL));
+
+    pino_decoder_destroy(decoder);
+    free(record);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_compact_leb128);
+    RUN_TEST(test_compact);
+    RUN_TEST(test_compact_alias);
+    RUN_TEST(test_compact_batch);
+    RUN_TEST(test_compact_truncated);
+
+    return UNITY_END();
+}
@@ -0,0 +1,387 @@
+/*
+ * libpino test - test_compress.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/decoder.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  (64 * 1024 + 3)
+
+static pino_handler_t g_spl4_handler;
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    /* without adopt the unpacked payload goes through handler->unserialize */
+    g_spl4_handler = g_ph_handler_spl1_obj;
+    g_spl4_handler.adopt = NULL;
+    if (!pino_handler_register("spl4", &g_spl4_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("spl4") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static void generate_compressible_data(uint8_t *out, size_t size)
+{
+    static const char words[] = "pino serialize unserialize handler static fields payload ";
+    size_t i;
+
+    generate_random_data(out, size);
+
+    /* text with some noise, and a long run to exercise overlapping matches */
+    for (i = 0; i < size; i++) {
+        if (out[i] % 16 != 0) {
+            out[i] = (uint8_t)words[(i * 7 / 5) % (sizeof(words) - 1)];
+        }
+    }
+    memset(out + size / 2, 'p', size / 8);
+}
+
+static void assert_unserialize_all(const uint8_t *src, size_t size, const uint8_t *data, size_t data_size)
+{
+    uint8_t *copy;
+
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(src, size));
+    assert_unpacked(pino_unserialize(src, size), data, data_size);
+    assert_unpacked(pino_unserialize_validated(src, size), data, data_size);
+    assert_unpacked(pino_unserialize_lazy(src, size), data, data_size);
+
+    copy = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(copy);
+    memcpy(copy, src, size);
+    assert_unpacked(pino_unserialize_adopt(copy, size, free), data, data_size);
+}
+
+void test_lz(void)
+{
+    uint8_t *data, *packed, *unpacked;
+    size_t sizes[] = {0, 1, 12, 13, 100, 4096, 65535, 65536, 65537, TEST_DATA_SIZE}, packed_size, i, j;
+    int kind;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    packed = (uint8_t *)malloc(TEST_DATA_SIZE * 2);
+    unpacked = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(packed);
+    TEST_ASSERT_NOT_NULL(unpacked);
+
+    for (kind = 0; kind < 3; kind++) {
+        if (kind == 0) {
+            generate_random_data(data, TEST_DATA_SIZE);
+        } else if (kind == 1) {
+            generate_compressible_data(data, TEST_DATA_SIZE);
+        } else {
+            memset(data, 0, TEST_DATA_SIZE);
+        }
+
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            packed_size = pino_lz_compress(packed, TEST_DATA_SIZE * 2, data, sizes[i]);
+            TEST_ASSERT_NOT_EQUAL(0, packed_size);
+            if (kind > 0 && sizes[i] >= 4096) {
+                TEST_ASSERT_TRUE(packed_size < sizes[i] / 2);
+            }
+
+            memset(unpacked, 0xAA, TEST_DATA_SIZE);
+            TEST_ASSERT_TRUE(pino_lz_decompress(unpacked, sizes[i], packed, packed_size));
+            TEST_ASSERT_EQUAL_MEMORY(data, unpacked, sizes[i]);
+            TEST_ASSERT_TRUE(pino_lz_validate(sizes[i], packed, packed_size));
+
+            /* exact sizes on both ends */
+            if (sizes[i] > 0) {
+                TEST_ASSERT_FALSE(pino_lz_decompress(unpacked, sizes[i] - 1, packed, packed_size));
+                TEST_ASSERT_FALSE(pino_lz_decompress(unpacked, sizes[i], packed, packed_size - 1));
+                TEST_ASSERT_FALSE(pino_lz_validate(sizes[i] - 1, packed, packed_size));
+                TEST_ASSERT_FALSE(pino_lz_validate(sizes[i], packed, packed_size - 1));
+            }
+            TEST_ASSERT_FALSE(pino_lz_decompress(unpacked, sizes[i] + 1, packed, packed_size));
+            TEST_ASSERT_FALSE(pino_lz_validate(sizes[i] + 1, packed, packed_size));
+            TEST_ASSERT_EQUAL_size_t(0, pino_lz_compress(packed, packed_size - 1, data, sizes[i]));
+        }
+    }
+
+    /* corrupted streams fail or unpack to garbage, but never leave their buffers; the walk agrees with the decompressor */
+    generate_compressible_data(data, 4096);
+    packed_size = pino_lz_compress(packed, TEST_DATA_SIZE, data, 4096);
+    for (i = 0; i < packed_size; i++) {
+        for (j = 0; j < 8; j++) {
+            packed[i] ^= (uint8_t)(1 << j);
+            TEST_ASSERT_EQUAL(pino_lz_decompress(unpacked, 4096, packed, packed_size), pino_lz_validate(4096, packed, packed_size));
+            packed[i] ^= (uint8_t)(1 << j);
+        }
+    }
+    TEST_ASSERT_TRUE(pino_lz_decompress(unpacked, 4096, packed, packed_size));
+
+    free(data);
+    free(packed);
+    free(unpacked);
+}
+
+void test_compress(void)
+{
+    pino_header_t header;
+    pino_t *pino;
+    uint8_t *data, *plain, *packed, *checked;
+    size_t plain_size, packed_size, checked_size;
+    pino_magic_safe_t magics[] = {"spl1", "spl4"};
+    int i;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_compressible_data(data, TEST_DATA_SIZE);
+
+    for (i = 0; i < 2; i++) {
+        pino = pino_pack(magics[i], data, TEST_DATA_SIZE);
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, 0xC0FFEE);
+
+        plain = serialize(pino, 0, &plain_size);
+        packed = serialize(pino, PINO_SERIALIZE_COMPRESS, &packed_size);
+        checked = serialize(pino, PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C, &checked_size);
+        TEST_ASSERT_EQUAL_size_t(plain_size, pino_serialize_size_ex(pino, PINO_SERIALIZE_COMPRESS));
+        TEST_ASSERT_TRUE(packed_size < plain_size / 2);
+        TEST_ASSERT_EQUAL_size_t(packed_size + sizeof(uint32_t), checked_size);
+
+        /* the size is only known after packing */
+        TEST_ASSERT_FALSE(pino_serialize_ex(pino, packed, PINO_SERIALIZE_COMPRESS));
+        TEST_ASSERT_EQUAL_size_t(0, pino_serialize_record(pino, packed, plain_size - 1, PINO_SERIALIZE_COMPRESS));
+
+        /* static fields stay readable */
+        TEST_ASSERT_TRUE(pino_peek(packed, packed_size, &header));
+        TEST_ASSERT_EQUAL_UINT32(PINO_SERIALIZE_COMPRESS, header.flags);
+        TEST_ASSERT_EQUAL_size_t(packed_size - PINO_HEADER_SIZE - sizeof(spl1_size_t) - sizeof(uint32_t), header.payload_size);
+        TEST_ASSERT_EQUAL_MEMORY(plain + PINO_HEADER_SIZE, packed + PINO_HEADER_SIZE, sizeof(spl1_size_t) + sizeof(uint32_t));
+
+        assert_unserialize_all(packed, packed_size, data, TEST_DATA_SIZE);
+        assert_unserialize_all(checked, checked_size, data, TEST_DATA_SIZE);
+
+        free(plain);
+        free(packed);
+        free(checked);
+        pino_destroy(pino);
+    }
+
+    /* incompressible or short payloads are written as they are */
+    generate_random_data(data, TEST_DATA_SIZE);
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    plain = serialize(pino, PINO_SERIALIZE_CRC32C, &plain_size);
+    packed = serialize(pino, PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C, &packed_size);
+    TEST_ASSERT_EQUAL_size_t(plain_size, packed_size);
+    TEST_ASSERT_EQUAL_MEMORY(plain, packed, plain_size);
+    free(plain);
+    free(packed);
+    pino_destroy(pino);
+
+    generate_compressible_data(data, TEST_DATA_SIZE);
+    pino = pino_pack("spl1", data, COMPRESS_THRESHOLD - 1);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+    packed = serialize(pino, PINO_SERIALIZE_COMPRESS, &packed_size);
+    TEST_ASSERT_TRUE(pino_peek(packed, packed_size, &header));
+    TEST_ASSERT_EQUAL_UINT32(0, header.flags);
+    assert_unserialize_all(packed, packed_size, data, COMPRESS_THRESHOLD - 1);
+    free(packed);
+    pino_destroy(pino);
+
+    free(data);
+}
+
+void test_compress_corrupted(void)
+{
+    pino_t *pino;
+    uint8_t *data, *packed, *payload;
+    size_t packed_size, i;
+    uint64_t value;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_compressible_data(data, TEST_DATA_SIZE);
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+
+    packed = serialize(pino, PINO_SERIALIZE_COMPRESS, &packed_size);
+    payload = packed + PINO_HEADER_SIZE + sizeof(spl1_size_t) + sizeof(uint32_t);
+
+    /* the raw size has to match the handler, the packed size the record */
+    value = TEST_DATA_SIZE - 1;
+    pino_endianness_memcpy_native2le(payload, &value, sizeof(uint64_t));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_PAYLOAD, pino_validate(packed, packed_size));
+    value = (uint64_t)1 << 40;
+    pino_endianness_memcpy_native2le(payload, &value, sizeof(uint64_t));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_PAYLOAD, pino_validate(packed, packed_size));
+    TEST_ASSERT_NULL(pino_unserialize(packed, packed_size));
+    value = TEST_DATA_SIZE;
+    pino_endianness_memcpy_native2le(payload, &value, sizeof(uint64_t));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(packed, packed_size));
+
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(packed, packed_size - 1));
+    TEST_ASSERT_NULL(pino_unserialize(packed, packed_size - 1));
+    TEST_ASSERT_NULL(pino_unserialize_lazy(packed, packed_size - 1));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(packed, PINO_HEADER_SIZE + sizeof(spl1_size_t) + sizeof(uint32_t) + 3));
+
+    /* damaged packed bytes are caught by the decompressor, or without luck by the handler size check;
+       whatever pino_validate() rejects never unserializes */
+    for (i = PINO_COMPRESS_HEADER_SIZE; i < packed_size - (size_t)(payload - packed); i += 13) {
+        payload[i] ^= 0x40;
+        if (pino_validate(packed, packed_size) != PINO_VALIDATE_OK) {
+            TEST_ASSERT_NULL(pino_unserialize(packed, packed_size));
+        }
+        pino_destroy(pino_unserialize(packed, packed_size));
+        payload[i] ^= 0x40;
+    }
+    free(packed);
+
+    /* with a trailer every flipped bit is reported as such */
+    packed = serialize(pino, PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C, &packed_size);
+    for (i = PINO_HEADER_SIZE + sizeof(spl1_size_t) + sizeof(uint32_t) + PINO_COMPRESS_HEADER_SIZE; i < packed_size; i += 7) {
+        packed[i] ^= 0x01;
+        TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_CHECKSUM, pino_validate(packed, packed_size));
+        TEST_ASSERT_NULL(pino_unserialize(packed, packed_size));
+        packed[i] ^= 0x01;
+    }
+    free(packed);
+
+    pino_destroy(pino);
+    free(data);
+}
+
+static pino_decoder_status_t feed_all(pino_decoder_t *decoder, const uint8_t *src, size_t size, size_t step)
+{
+    pino_decoder_status_t status;
+    size_t offset, n, consumed;
+
+    status = PINO_DECODER_NEED_MORE;
+    for (offset = 0; offset < size && status == PINO_DECODER_NEED_MORE; offset += consumed) {
+        n = size - offset < step ? size - offset : step;
+        status = pino_decoder_feed(decoder, src + offset, n, &consumed);
+    }
+
+    return status;
+}
+
+void test_compress_decoder(void)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    uint8_t *data, *packed;
+    size_t packed_size, steps[] = {1, 7, 4096, TEST_DATA_SIZE * 2}, i, j;
+    uint32_t flags[] = {PINO_SERIALIZE_COMPRESS, PINO_SERIALIZE_COMPRESS | PINO_SERIALIZE_CRC32C};
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_compressible_data(data, TEST_DATA_SIZE);
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+    pino = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, 0xC0FFEE);
+
+    for (j = 0; j < sizeof(flags) / sizeof(flags[0]); j++) {
+        packed = serialize(pino, flags[j], &packed_size);
+
+        for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+            TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, feed_all(decoder, packed, packed_size, steps[i]));
+            assert_unpacked(pino_decoder_take(decoder), data, TEST_DATA_SIZE);
+        }
+
+        /* cut inside the block */
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, feed_all(decoder, packed, packed_size - 1, 100));
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_finish(decoder));
+        pino_decoder_reset(decoder);
+
+        /* a flipped literal only shows up in the checksum */
+        if (flags[j] & PINO_SERIALIZE_CRC32C) {
+            packed[packed_size / 2] ^= 0x01;
+            TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, feed_all(decoder, packed, packed_size, 100));
+            pino_decoder_reset(decoder);
+        }
+
+        free(packed);
+    }
+
+    pino_destroy(pino);
+    pino_decoder_destroy(decoder);
+    free(data);
+}
+
+void test_compress_batch(void)
+{
+    pino_t *pinos[3], *out[3];
+    uint8_t *data, *buffer;
+    size_t sizes[3], offset, capacity, i;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_compressible_data(data, TEST_DATA_SIZE);
+
+    /* packed and plain records mix, packed ones are delimited by their block */
+    capacity = 0;
+    for (i = 0; i < 3; i++) {
+        pinos[i] = pino_pack("spl1", data, i == 1 ? 100 : TEST_DATA_SIZE / (i + 1));
+        TEST_ASSERT_NOT_NULL(pinos[i]);
+        set_u32(pinos[i], 0xC0FFEE);
+        capacity += pino_serialize_record(pinos[i], NULL, 0, PINO_SERIALIZE_COMPRESS);
+    }
+
+    buffer = (uint8_t *)malloc(capacity);
+    TEST_ASSERT_NOT_NULL(buffer);
+    offset = 0;
+    for (i = 0; i < 3; i++) {
+        sizes[i] = pino_serialize_record(pinos[i], buffer + offset, capacity - offset, PINO_SERIALIZE_COMPRESS);
+        TEST_ASSERT_NOT_EQUAL(0, sizes[i]);
+        offset += sizes[i];
+    }
+    TEST_ASSERT_TRUE(offset < capacity / 2);
+
+    TEST_ASSERT_EQUAL_size_t(3, pino_unserialize_batch(buffer, offset, out, 3));
+    assert_unpacked(out[0], data, TEST_DATA_SIZE);
+    assert_unpacked(out[1], data, 100);
+    assert_unpacked(out[2], data, TEST_DATA_SIZE / 3);
+
+    TEST_ASSERT_EQUAL_size_t(2, pino_unserialize_batch(buffer, sizes[0] + sizes[1] + 20, out, 3));
+    pino_destroy(out[0]);
+    pino_destroy(out[1]);
+
+    free(buffer);
+    for (i = 0; i < 3; i++) {
+        pino_destroy(pinos[i]);
+    }
+    free(data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_lz);
+    RUN_TEST(test_compress);
+    RUN_TEST(test_compress_corrupted);
+    RUN_TEST(test_compress_decoder);
+    RUN_TEST(test_compress_batch);
+
+    return UNITY_END();
+}
@@ -0,0 +1,489 @@
+/*
+ * libpino test - test_container.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/container.h>
+#include <pino/handler.h>
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE      256
+#define TEST_RECORDS        100
+#define TEST_CONTAINER_PATH "test_container.pinc"
+
+static pino_handler_t g_spl2_handler;
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    g_spl2_handler = g_ph_handler_spl1_obj;
+    if (!pino_handler_register("spl2", &g_spl2_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    remove(TEST_CONTAINER_PATH);
+
+    if (!pino_handler_unregister("spl2") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static size_t record_data_size(size_t i)
+{
+    return (i * 7) % TEST_DATA_SIZE + 1;
+}
+
+static void write_container(const uint8_t *data, size_t n)
+{
+    pino_container_writer_t *writer;
+    pino_t *pino;
+    size_t i;
+
+    writer = pino_container_writer_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(writer);
+
+    for (i = 0; i < n; i++) {
+        pino = pino_pack(i % 3 == 0 ? "spl2" : "spl1", data, record_data_size(i));
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, (uint32_t)i);
+        TEST_ASSERT_TRUE(pino_container_writer_append(writer, pino));
+        pino_destroy(pino);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(n, pino_container_writer_count(writer));
+    TEST_ASSERT_TRUE(pino_container_writer_close(writer));
+}
+
+void test_container(void)
+{
+    pino_container_reader_t *reader;
+    pino_magic_safe_t magic;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], unpacked[TEST_DATA_SIZE], *raw;
+    size_t i, size;
+
+    generate_random_data(data, sizeof(data));
+    write_container(data, TEST_RECORDS);
+
+    reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_size_t(TEST_RECORDS, pino_container_reader_count(reader));
+
+    /* random access, back to front */
+    for (i = TEST_RECORDS; i-- > 0;) {
+        TEST_ASSERT_TRUE(pino_container_reader_magic(reader, i, magic));
+        TEST_ASSERT_EQUAL_STRING(i % 3 == 0 ? "spl2" : "spl1", magic);
+
+        pino = pino_container_reader_get(reader, i);
+        TEST_ASSERT_NOT_NULL(pino);
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)i, get_u32(pino));
+        TEST_ASSERT_EQUAL_size_t(record_data_size(i), pino_unpack_size(pino));
+        TEST_ASSERT_TRUE(pino_unpack(pino, unpacked));
+        TEST_ASSERT_EQUAL_MEMORY(data, unpacked, record_data_size(i));
+
+        size = pino_container_reader_size(reader, i);
+        TEST_ASSERT_EQUAL_size_t(pino_serialize_size(pino), size);
+        raw = (uint8_t *)malloc(size);
+        TEST_ASSERT_NOT_NULL(raw);
+        TEST_ASSERT_TRUE(pino_container_reader_read(reader, i, raw));
+        TEST_ASSERT_EQUAL_MEMORY("spl", raw, 3);
+        free(raw);
+
+        pino_destroy(pino);
+    }
+
+    TEST_ASSERT_FALSE(pino_container_reader_magic(reader, TEST_RECORDS, magic));
+    TEST_ASSERT_EQUAL_size_t(0, pino_container_reader_size(reader, TEST_RECORDS));
+    TEST_ASSERT_NULL(pino_container_reader_get(reader, TEST_RECORDS));
+
+    pino_container_reader_close(reader);
+}
+
+void test_container_mmap(void)
+{
+    pino_container_reader_t *reader, *file_reader;
+    const uint8_t *view;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], *raw;
+    size_t i, size;
+
+    generate_random_data(data, sizeof(data));
+    write_container(data, TEST_RECORDS);
+
+    reader = pino_container_reader_open_mmap(TEST_CONTAINER_PATH);
+    if (!reader) {
+        TEST_IGNORE_MESSAGE("memory mapping is not available");
+    }
+
+    file_reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(file_reader);
+    TEST_ASSERT_NULL(pino_container_reader_view(file_reader, 0, &size));
+    TEST_ASSERT_NULL(pino_container_reader_next(file_reader, &size));
+    TEST_ASSERT_EQUAL_size_t(TEST_RECORDS, pino_container_reader_count(reader));
+
+    /* twice, the second time after a rewind */
+    for (i = 0; i < TEST_RECORDS * 2; i++) {
+        if (i == TEST_RECORDS) {
+            TEST_ASSERT_NULL(pino_container_reader_next(reader, &size));
+            pino_container_reader_rewind(reader);
+        }
+
+        view = (const uint8_t *)pino_container_reader_next(reader, &size);
+        TEST_ASSERT_NOT_NULL(view);
+        TEST_ASSERT_EQUAL_size_t(pino_container_reader_size(file_reader, i % TEST_RECORDS), size);
+
+        raw = (uint8_t *)malloc(size);
+        TEST_ASSERT_NOT_NULL(raw);
+        TEST_ASSERT_TRUE(pino_container_reader_read(file_reader, i % TEST_RECORDS, raw));
+        TEST_ASSERT_EQUAL_MEMORY(raw, view, size);
+        free(raw);
+
+        /* decoded without any intermediate copy of the record */
+        pino = pino_unserialize_lazy(view, size);
+        TEST_ASSERT_NOT_NULL(pino);
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)(i % TEST_RECORDS), get_u32(pino));
+        pino_destroy(pino);
+    }
+
+    pino = pino_container_reader_get(reader, TEST_RECORDS / 2);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS / 2, get_u32(pino));
+    pino_destroy(pino);
+
+    TEST_ASSERT_NOT_NULL(pino_container_reader_view(reader, TEST_RECORDS - 1, NULL));
+    TEST_ASSERT_NULL(pino_container_reader_view(reader, TEST_RECORDS, &size));
+
+    pino_container_reader_close(file_reader);
+    pino_container_reader_close(reader);
+}
+
+void test_mmap_writer(void)
+{
+    pino_container_reader_t *reader;
+    pino_mmap_writer_t *writer;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], unpacked[TEST_DATA_SIZE], *expected, *actual;
+    size_t expected_size, actual_size, i;
+
+    generate_random_data(data, sizeof(data));
+    write_container(data, TEST_RECORDS);
+    TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &expected, &expected_size));
+
+    /* tiny initial mapping, grows several times */
+    writer = pino_mmap_writer_open(TEST_CONTAINER_PATH, 64);
+    if (!writer) {
+        free(expected);
+        TEST_IGNORE_MESSAGE("memory mapping is not available");
+    }
+
+    for (i = 0; i < TEST_RECORDS; i++) {
+        pino = pino_pack(i % 3 == 0 ? "spl2" : "spl1", data, record_data_size(i));
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, (uint32_t)i);
+        TEST_ASSERT_TRUE(pino_mmap_writer_append(writer, pino));
+        pino_destroy(pino);
+    }
+
+    TEST_ASSERT_FALSE(pino_mmap_writer_append(writer, NULL));
+    TEST_ASSERT_EQUAL_size_t(TEST_RECORDS, pino_mmap_writer_count(writer));
+    TEST_ASSERT_TRUE(pino_mmap_writer_close(writer));
+
+    /* byte for byte what the stdio writer produces */
+    TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &actual, &actual_size));
+    TEST_ASSERT_EQUAL_size_t(expected_size, actual_size);
+    TEST_ASSERT_EQUAL_MEMORY(expected, actual, expected_size);
+    free(actual);
+    free(expected);
+
+    reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(reader);
+    pino = pino_container_reader_get(reader, TEST_RECORDS - 1);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_TRUE(pino_unpack(pino, unpacked));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked, record_data_size(TEST_RECORDS - 1));
+    pino_destroy(pino);
+    pino_container_reader_close(reader);
+
+    /* default initial size, no records */
+    writer = pino_mmap_writer_open(TEST_CONTAINER_PATH, 0);
+    TEST_ASSERT_NOT_NULL(writer);
+    TEST_ASSERT_TRUE(pino_mmap_writer_close(writer));
+    reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_size_t(0, pino_container_reader_count(reader));
+    pino_container_reader_close(reader);
+
+    TEST_ASSERT_NULL(pino_mmap_writer_open(NULL, 0));
+    TEST_ASSERT_NULL(pino_mmap_writer_open("not_exists/test.pinc", 0));
+    TEST_ASSERT_FALSE(pino_mmap_writer_close(NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_mmap_writer_count(NULL));
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t big_index;
+    size_t big_size;
+    size_t received;
+    bool *seen;
+} async_check_t;
+
+static void async_check(void *arg, size_t index, pino_t *pino)
+{
+    async_check_t *check = (async_check_t *)arg;
+    uint8_t *unpacked;
+    size_t size;
+
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_FALSE(check->seen[index]);
+    check->seen[index] = true;
+    check->received++;
+
+    size = index == check->big_index ? check->big_size : record_data_size(index);
+    unpacked = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(unpacked);
+    TEST_ASSERT_TRUE(pino_unpack(pino, unpacked));
+    TEST_ASSERT_EQUAL_MEMORY(check->data, unpacked, size);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)index, get_u32(pino));
+    free(unpacked);
+    pino_destroy(pino);
+}
+
+static void async_roundtrip(pino_async_backend_t backend)
+{
+    pino_async_writer_t *writer;
+    pino_async_reader_t *reader;
+    async_check_t check;
+    pino_t *pino;
+    uint8_t *big;
+    size_t records, i;
+
+    /* several buffer switches with only two buffers, plus one record larger than a buffer */
+    records = 4000;
+    check.big_index = records / 2;
+    check.big_size = 1024 * 1024;
+    big = (uint8_t *)malloc(check.big_size);
+    TEST_ASSERT_NOT_NULL(big);
+    generate_random_data(big, check.big_size);
+    check.data = big;
+
+    writer = pino_async_writer_open(TEST_CONTAINER_PATH, backend, 2);
+    TEST_ASSERT_NOT_NULL(writer);
+    TEST_ASSERT_EQUAL_INT(backend, pino_async_writer_backend(writer));
+
+    for (i = 0; i < records; i++) {
+        pino = pino_pack(i % 3 == 0 ? "spl2" : "spl1", big, i == check.big_index ? check.big_size : record_data_size(i));
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, (uint32_t)i);
+        TEST_ASSERT_TRUE(pino_async_writer_append(writer, pino));
+        pino_destroy(pino);
+
+        if (i % 100 == 0) {
+            TEST_ASSERT_TRUE(pino_async_writer_poll(writer));
+        }
+    }
+
+    TEST_ASSERT_EQUAL_size_t(records, pino_async_writer_count(writer));
+    TEST_ASSERT_TRUE(pino_async_writer_close(writer));
+
+    reader = pino_async_reader_open(TEST_CONTAINER_PATH, backend, 8);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_INT(backend, pino_async_reader_backend(reader));
+    TEST_ASSERT_EQUAL_size_t(records, pino_async_reader_count(reader));
+
+    check.received = 0;
+    check.seen = (bool *)calloc(records, sizeof(bool));
+    TEST_ASSERT_NOT_NULL(check.seen);
+
+    /* keep the queue full, make room whenever it refuses */
+    for (i = 0; i < records; i++) {
+        while (!pino_async_reader_submit(reader, i)) {
+            TEST_ASSERT_EQUAL_size_t(8, pino_async_reader_inflight(reader));
+            TEST_ASSERT_TRUE(pino_async_reader_poll(reader, true, async_check, &check) > 0);
+        }
+    }
+
+    while (pino_async_reader_inflight(reader) > 0) {
+        pino_async_reader_poll(reader, true, async_check, &check);
+    }
+
+    TEST_ASSERT_EQUAL_size_t(records, check.received);
+    TEST_ASSERT_EQUAL_size_t(0, pino_async_reader_poll(reader, false, async_check, &check));
+    TEST_ASSERT_FALSE(pino_async_reader_submit(reader, records));
+
+    /* results of reads still in flight are dropped on close */
+    TEST_ASSERT_TRUE(pino_async_reader_submit(reader, 0));
+    TEST_ASSERT_TRUE(pino_async_reader_submit(reader, check.big_index));
+    pino_async_reader_close(reader);
+
+    free(check.seen);
+    free(big);
+}
+
+void test_async_writer(void)
+{
+    pino_async_writer_t *writer;
+    pino_t *pino;
+    uint8_t data[TEST_DATA_SIZE], *expected, *actual;
+    size_t expected_size, actual_size, i;
+    int backend;
+
+    generate_random_data(data, sizeof(data));
+    write_container(data, TEST_RECORDS);
+    TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &expected, &expected_size));
+
+    for (backend = PINO_ASYNC_AUTO; backend <= PINO_ASYNC_THREADS; backend++) {
+        writer = pino_async_writer_open(TEST_CONTAINER_PATH, (pino_async_backend_t)backend, 0);
+        if (!writer) {
+            /* only io_uring may be missing */
+            TEST_ASSERT_EQUAL_INT(PINO_ASYNC_IO_URING, backend);
+            continue;
+        }
+
+        TEST_ASSERT_NOT_EQUAL(PINO_ASYNC_AUTO, pino_async_writer_backend(writer));
+
+        for (i = 0; i < TEST_RECORDS; i++) {
+            pino = pino_pack(i % 3 == 0 ? "spl2" : "spl1", data, record_data_size(i));
+            TEST_ASSERT_NOT_NULL(pino);
+            set_u32(pino, (uint32_t)i);
+            TEST_ASSERT_TRUE(pino_async_writer_append(writer, pino));
+            pino_destroy(pino);
+        }
+
+        TEST_ASSERT_FALSE(pino_async_writer_append(writer, NULL));
+        TEST_ASSERT_TRUE(pino_async_writer_close(writer));
+
+        /* byte for byte what the stdio writer produces */
+        TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &actual, &actual_size));
+        TEST_ASSERT_EQUAL_size_t(expected_size, actual_size);
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, expected_size);
+        free(actual);
+    }
+
+    free(expected);
+
+    TEST_ASSERT_NULL(pino_async_writer_open(NULL, PINO_ASYNC_AUTO, 0));
+    TEST_ASSERT_NULL(pino_async_writer_open("not_exists/test.pinc", PINO_ASYNC_AUTO, 0));
+    TEST_ASSERT_FALSE(pino_async_writer_close(NULL));
+    TEST_ASSERT_FALSE(pino_async_writer_poll(NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_async_writer_count(NULL));
+}
+
+void test_async_reader(void)
+{
+    pino_async_writer_t *writer;
+
+    writer = pino_async_writer_open(TEST_CONTAINER_PATH, PINO_ASYNC_IO_URING, 0);
+    if (writer) {
+        TEST_ASSERT_TRUE(pino_async_writer_close(writer));
+        async_roundtrip(PINO_ASYNC_IO_URING);
+    }
+
+    async_roundtrip(PINO_ASYNC_THREADS);
+
+    TEST_ASSERT_NULL(pino_async_reader_open(NULL, PINO_ASYNC_AUTO, 0));
+    TEST_ASSERT_NULL(pino_async_reader_open("not_exists.pinc", PINO_ASYNC_AUTO, 0));
+    TEST_ASSERT_FALSE(pino_async_reader_submit(NULL, 0));
+    TEST_ASSERT_EQUAL_size_t(0, pino_async_reader_poll(NULL, true, NULL, NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_async_reader_count(NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_async_reader_inflight(NULL));
+    pino_async_reader_close(NULL);
+}
+
+void test_container_empty(void)
+{
+    pino_container_reader_t *reader;
+
+    write_container(NULL, 0);
+
+    reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_EQUAL_size_t(0, pino_container_reader_count(reader));
+    TEST_ASSERT_NULL(pino_container_reader_get(reader, 0));
+    pino_container_reader_close(reader);
+
+    reader = pino_container_reader_open_mmap(TEST_CONTAINER_PATH);
+    if (reader) {
+        TEST_ASSERT_EQUAL_size_t(0, pino_container_reader_count(reader));
+        TEST_ASSERT_NULL(pino_container_reader_next(reader, NULL));
+        pino_container_reader_close(reader);
+    }
+}
+
+void test_container_invalid(void)
+{
+    pino_container_reader_t *reader;
+    uint8_t data[TEST_DATA_SIZE], *file;
+    size_t file_size;
+
+    TEST_ASSERT_NULL(pino_container_writer_open(NULL));
+    TEST_ASSERT_FALSE(pino_container_writer_append(NULL, NULL));
+    TEST_ASSERT_FALSE(pino_container_writer_close(NULL));
+    TEST_ASSERT_NULL(pino_container_reader_open(NULL));
+    TEST_ASSERT_NULL(pino_container_reader_open("not_exists.pinc"));
+    TEST_ASSERT_NULL(pino_container_reader_open_mmap("not_exists.pinc"));
+    TEST_ASSERT_NULL(pino_container_reader_open_mmap(NULL));
+    TEST_ASSERT_EQUAL_size_t(0, pino_container_reader_count(NULL));
+    pino_container_reader_close(NULL);
+
+    generate_random_data(data, sizeof(data));
+    write_container(data, 10);
+    TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &file, &file_size));
+
+    /* torn footer */
+    TEST_ASSERT_TRUE(save_file(TEST_CONTAINER_PATH, file, file_size - 1));
+    TEST_ASSERT_NULL(pino_container_reader_open(TEST_CONTAINER_PATH));
+    TEST_ASSERT_NULL(pino_container_reader_open_mmap(TEST_CONTAINER_PATH));
+
+    /* last index entry is off by one, caught by the size prefix */
+    file[file_size - PINO_CONTAINER_FOOTER_SIZE - PINO_CONTAINER_INDEX_ENTRY_SIZE + sizeof(pino_magic_t)] ^= 0x01;
+    TEST_ASSERT_TRUE(save_file(TEST_CONTAINER_PATH, file, file_size));
+    reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+    TEST_ASSERT_NOT_NULL(reader);
+    TEST_ASSERT_NULL(pino_container_reader_get(reader, 8));
+    TEST_ASSERT_NULL(pino_container_reader_get(reader, 9));
+    pino_container_reader_close(reader);
+
+    /* last index entry is past the index */
+    file[file_size - PINO_CONTAINER_FOOTER_SIZE - PINO_CONTAINER_INDEX_ENTRY_SIZE + sizeof(pino_magic_t) + 3] ^= 0x01;
+    TEST_ASSERT_TRUE(save_file(TEST_CONTAINER_PATH, file, file_size));
+    TEST_ASSERT_NULL(pino_container_reader_open(TEST_CONTAINER_PATH));
+    file[file_size - PINO_CONTAINER_FOOTER_SIZE - PINO_CONTAINER_INDEX_ENTRY_SIZE + sizeof(pino_magic_t) + 3] ^= 0x01;
+    file[file_size - PINO_CONTAINER_FOOTER_SIZE - PINO_CONTAINER_INDEX_ENTRY_SIZE + sizeof(pino_magic_t)] ^= 0x01;
+
+    /* broken file magic */
+    file[0] = 'X';
+    TEST_ASSERT_TRUE(save_file(TEST_CONTAINER_PATH, file, file_size));
+    TEST_ASSERT_NULL(pino_container_reader_open(TEST_CONTAINER_PATH));
+
+    free(file);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_container);
+    RUN_TEST(test_container_mmap);
+    RUN_TEST(test_mmap_writer);
+    RUN_TEST(test_async_writer);
+    RUN_TEST(test_async_reader);
+    RUN_TEST(test_container_empty);
+    RUN_TEST(test_container_invalid);
+
+    return UNITY_END();
+}
@@ -0,0 +1,243 @@
+/*
+ * libpino test - test_decoder.c
+ * 
+ */
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/decoder.h>
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE 1024
+
+static pino_handler_t g_buffered_handler;
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    /* same codec, but without the optional incremental callbacks */
+    g_buffered_handler = g_ph_handler_spl1_obj;
+    g_buffered_handler.payload_size = NULL;
+    g_buffered_handler.unserialize_chunk = NULL;
+
+    if (!pino_handler_register("spl2", &g_buffered_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("spl2") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static uint8_t *serialize_new(pino_magic_safe_t magic, const uint8_t *data, size_t size, uint32_t u32, size_t *out_size)
+{
+    pino_t *pino;
+    uint8_t *serialized;
+
+    pino = pino_pack(magic, data, size);
+    TEST_ASSERT_NOT_NULL(pino);
+    set_u32(pino, u32);
+
+    *out_size = pino_serialize_size(pino);
+    serialized = (uint8_t *)malloc(*out_size);
+    TEST_ASSERT_NOT_NULL(serialized);
+    TEST_ASSERT_TRUE(pino_serialize(pino, serialized));
+
+    pino_destroy(pino);
+
+    return serialized;
+}
+
+static void assert_pino(pino_t *pino, const uint8_t *data, size_t size, uint32_t u32)
+{
+    uint8_t *unpacked;
+
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT32(u32, get_u32(pino));
+    TEST_ASSERT_EQUAL_size_t(size, pino_unpack_size(pino));
+
+    unpacked = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(unpacked);
+    TEST_ASSERT_TRUE(pino_unpack(pino, unpacked));
+    TEST_ASSERT_EQUAL_MEMORY(data, unpacked, size);
+
+    free(unpacked);
+}
+
+void test_decoder_bytewise(void)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    uint8_t *data, *serialized;
+    size_t serialized_size, consumed, i;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    serialized = serialize_new("spl1", data, TEST_DATA_SIZE, 123456789, &serialized_size);
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+    TEST_ASSERT_NULL(pino_decoder_handler(decoder));
+
+    for (i = 0; i < serialized_size - 1; i++) {
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, pino_decoder_feed(decoder, serialized + i, 1, &consumed));
+        TEST_ASSERT_EQUAL_size_t(1, consumed);
+        TEST_ASSERT_NULL(pino_decoder_take(decoder));
+        if (i >= sizeof(pino_magic_t) + sizeof(pino_static_fields_size_t) - 1) {
+            TEST_ASSERT_TRUE(pino_decoder_handler(decoder) == &g_ph_handler_spl1_obj);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, pino_decoder_feed(decoder, serialized + i, 1, &consumed));
+    TEST_ASSERT_EQUAL_size_t(1, consumed);
+
+    pino = pino_decoder_take(decoder);
+    assert_pino(pino, data, TEST_DATA_SIZE, 123456789);
+
+    pino_destroy(pino);
+    pino_decoder_destroy(decoder);
+    free(serialized);
+    free(data);
+}
+
+void test_decoder_stream(void)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    uint8_t *data, *first, *second, *stream;
+    size_t first_size, second_size, consumed, offset;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_fixed_data(data, TEST_DATA_SIZE);
+
+    first = serialize_new("spl1", data, TEST_DATA_SIZE, 1, &first_size);
+    second = serialize_new("spl1", data, TEST_DATA_SIZE / 2, 2, &second_size);
+
+    stream = (uint8_t *)malloc(first_size + second_size);
+    TEST_ASSERT_NOT_NULL(stream);
+    memcpy(stream, first, first_size);
+    memcpy(stream + first_size, second, second_size);
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, pino_decoder_feed(decoder, stream, first_size + second_size, &consumed));
+    TEST_ASSERT_EQUAL_size_t(first_size, consumed);
+    pino = pino_decoder_take(decoder);
+    assert_pino(pino, data, TEST_DATA_SIZE, 1);
+    pino_destroy(pino);
+
+    offset = consumed;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, pino_decoder_feed(decoder, stream + offset, 100, &consumed));
+    offset += consumed;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, pino_decoder_feed(decoder, stream + offset, first_size + second_size - offset, &consumed));
+    TEST_ASSERT_EQUAL_size_t(first_size + second_size, offset + consumed);
+    pino = pino_decoder_take(decoder);
+    assert_pino(pino, data, TEST_DATA_SIZE / 2, 2);
+    pino_destroy(pino);
+
+    pino_decoder_destroy(decoder);
+    free(stream);
+    free(second);
+    free(first);
+    free(data);
+}
+
+void test_decoder_buffered(void)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    uint8_t *data, *serialized;
+    size_t serialized_size, consumed, i;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    serialized = serialize_new("spl2", data, TEST_DATA_SIZE, 42, &serialized_size);
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    for (i = 0; i < serialized_size; i += 100) {
+        TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, pino_decoder_feed(
+            decoder, serialized + i, serialized_size - i < 100 ? serialized_size - i : 100, &consumed
+        ));
+    }
+
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, pino_decoder_finish(decoder));
+    pino = pino_decoder_take(decoder);
+    assert_pino(pino, data, TEST_DATA_SIZE, 42);
+
+    pino_destroy(pino);
+    pino_decoder_destroy(decoder);
+    free(serialized);
+    free(data);
+}
+
+void test_decoder_invalid(void)
+{
+    pino_decoder_t *decoder;
+    uint8_t *data, *serialized;
+    size_t serialized_size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    serialized = serialize_new("spl1", data, TEST_DATA_SIZE, 0, &serialized_size);
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(NULL, serialized, serialized_size, NULL));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(decoder, NULL, 1, NULL));
+
+    /* truncated */
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_NEED_MORE, pino_decoder_feed(decoder, serialized, serialized_size - 1, NULL));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_finish(decoder));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(decoder, serialized + serialized_size - 1, 1, NULL));
+    pino_decoder_reset(decoder);
+
+    /* unregistered magic */
+    memcpy(serialized, "spl9", sizeof(pino_magic_t));
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(decoder, serialized, serialized_size, NULL));
+    TEST_ASSERT_NULL(pino_decoder_take(decoder));
+    pino_decoder_reset(decoder);
+
+    /* static fields size mismatch */
+    memcpy(serialized, "spl1", sizeof(pino_magic_t));
+    serialized[sizeof(pino_magic_t)] ^= 0xFF;
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_ERROR, pino_decoder_feed(decoder, serialized, serialized_size, NULL));
+
+    pino_decoder_destroy(decoder);
+    pino_decoder_destroy(NULL);
+    free(serialized);
+    free(data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_decoder_bytewise);
+    RUN_TEST(test_decoder_stream);
+    RUN_TEST(test_decoder_buffered);
+    RUN_TEST(test_decoder_invalid);
+
+    return UNITY_END();
+}
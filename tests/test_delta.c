@@ -0,0 +1,279 @@
+/*
+ * libpino test - test_delta.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE  (64 * 1024 + 3)
+
+static pino_handler_t g_apnd_handler;
+
+/* appends travel as the new tail only, anything else falls back to byte ranges */
+PH_DEFUN_DELTA(apnd) {
+    spl1_size_t base_size, size;
+
+    PH_BASE_STATIC_GET(spl1, size, &base_size);
+    PH_THIS_STATIC_GET(spl1, size, &size);
+    if (size <= base_size || memcmp(PH_BASE(spl1)->data, PH_THIS(spl1)->data, (size_t)base_size) != 0) {
+        return 0;
+    }
+
+    if (PH_ARG_DST) {
+        if (PH_ARG_SIZE < (size_t)(size - base_size)) {
+            return 0;
+        }
+        PH_MEMCPY(PH_ARG_DST, PH_THIS(spl1)->data + base_size, (size_t)(size - base_size));
+    }
+
+    return (size_t)(size - base_size);
+}
+
+PH_DEFUN_APPLY_DELTA(apnd) {
+    spl1_size_t base_size, size;
+    uint8_t *data;
+
+    PH_BASE_STATIC_GET(spl1, size, &base_size);
+    PH_THIS_STATIC_GET(spl1, size, &size);
+    if (size < base_size || (size_t)(size - base_size) != PH_ARG_SRC_SIZE) {
+        return false;
+    }
+
+    data = (uint8_t *)PH_CALLOC(spl1, 1, (size_t)size);
+    if (!data) {
+        return false;
+    }
+
+    PH_MEMCPY(data, PH_THIS(spl1)->data, (size_t)size - PH_ARG_SRC_SIZE);
+    PH_MEMCPY(data + (size_t)size - PH_ARG_SRC_SIZE, PH_ARG_SRC, PH_ARG_SRC_SIZE);
+    if (!PH_THIS(spl1)->adopted) {
+        PH_FREE(spl1, PH_THIS(spl1)->data);
+    }
+    PH_THIS(spl1)->data = data;
+    PH_THIS(spl1)->adopted = false;
+
+    return true;
+}
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+
+    g_apnd_handler = g_ph_handler_spl1_obj;
+    g_apnd_handler.delta = PH_NAME_FUNC_DELTA(apnd);
+    g_apnd_handler.apply_delta = PH_NAME_FUNC_APPLY_DELTA(apnd);
+    if (!pino_handler_register("apnd", &g_apnd_handler)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!pino_handler_unregister("apnd") || !PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static uint8_t *serialize_delta(const pino_t *base, const pino_t *current, size_t *size)
+{
+    uint8_t *delta;
+
+    *size = pino_serialize_delta(base, current, NULL, 0);
+    TEST_ASSERT_TRUE(*size > 0);
+
+    delta = (uint8_t *)malloc(*size);
+    TEST_ASSERT_NOT_NULL(delta);
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_delta(base, current, delta, *size - 1));
+    TEST_ASSERT_EQUAL_size_t(*size, pino_serialize_delta(base, current, delta, *size));
+
+    return delta;
+}
+
+static void assert_apply(pino_t *base, const uint8_t *delta, size_t size, const uint8_t *data, size_t data_size, uint32_t u32)
+{
+    pino_t *pino;
+    uint8_t *out;
+
+    pino = pino_apply_delta(base, delta, size);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT32(u32, get_u32(pino));
+    TEST_ASSERT_EQUAL_size_t(data_size, pino_unpack_size(pino));
+
+    out = (uint8_t *)malloc(data_size + 1);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_TRUE(pino_unpack(pino, out));
+    TEST_ASSERT_EQUAL_MEMORY(data, out, data_size);
+
+    free(out);
+    pino_destroy(pino);
+}
+
+void test_delta(void)
+{
+    pino_t *base, *current;
+    uint8_t *data, *changed, *delta;
+    size_t delta_size, sizes[] = {TEST_DATA_SIZE, TEST_DATA_SIZE + 100, TEST_DATA_SIZE - 100, 1000}, i;
+    pino_magic_safe_t magics[] = {"spl1", "apnd"};
+    int m;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE + 100);
+    changed = (uint8_t *)malloc(TEST_DATA_SIZE + 100);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(changed);
+    generate_random_data(data, TEST_DATA_SIZE + 100);
+
+    for (m = 0; m < 2; m++) {
+        base = pino_pack(magics[m], data, TEST_DATA_SIZE);
+        TEST_ASSERT_NOT_NULL(base);
+        set_u32(base, 0xC0FFEE);
+
+        /* nothing changed */
+        current = pino_clone(base);
+        delta = serialize_delta(base, current, &delta_size);
+        TEST_ASSERT_TRUE(delta_size < 32);
+        assert_apply(base, delta, delta_size, data, TEST_DATA_SIZE, 0xC0FFEE);
+        free(delta);
+        pino_destroy(current);
+
+        /* a few scattered bytes and a static field, the delta size follows the change */
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            memcpy(changed, data, TEST_DATA_SIZE + 100);
+            changed[0] ^= 0xFF;
+            changed[1000] ^= 0xFF;
+            changed[1003] ^= 0xFF;
+            changed[TEST_DATA_SIZE / 2] ^= 0xFF;
+            changed[TEST_DATA_SIZE - 101] ^= 0xFF;
+
+            current = pino_pack(magics[m], changed, sizes[i]);
+            TEST_ASSERT_NOT_NULL(current);
+            set_u32(current, 0xBEEF);
+
+            delta = serialize_delta(base, current, &delta_size);
+            TEST_ASSERT_TRUE(delta_size < 256 + (sizes[i] > TEST_DATA_SIZE ? sizes[i] - TEST_DATA_SIZE : 0));
+            assert_apply(base, delta, delta_size, changed, sizes[i], 0xBEEF);
+
+            free(delta);
+            pino_destroy(current);
+        }
+
+        pino_destroy(base);
+    }
+
+    free(data);
+    free(changed);
+}
+
+void test_delta_handler(void)
+{
+    pino_t *base, *current, *spl1;
+    uint8_t *data, *delta;
+    size_t delta_size;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    base = pino_pack("apnd", data, TEST_DATA_SIZE - 10);
+    current = pino_pack("apnd", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(base);
+    TEST_ASSERT_NOT_NULL(current);
+    set_u32(current, 0xBEEF);
+
+    /* header, the size and u32 ranges, then just the ten appended bytes */
+    delta = serialize_delta(base, current, &delta_size);
+    TEST_ASSERT_TRUE(delta_size < 40);
+    TEST_ASSERT_EQUAL_MEMORY(data + TEST_DATA_SIZE - 10, delta + delta_size - 10, 10);
+    assert_apply(base, delta, delta_size, data, TEST_DATA_SIZE, 0xBEEF);
+
+    /* the base stays as it was, also for clones of it */
+    spl1 = pino_clone(base);
+    TEST_ASSERT_NOT_NULL(spl1);
+    assert_apply(spl1, delta, delta_size, data, TEST_DATA_SIZE, 0xBEEF);
+    assert_apply(base, delta, delta_size, data, TEST_DATA_SIZE, 0xBEEF);
+    TEST_ASSERT_EQUAL_size_t(TEST_DATA_SIZE - 10, pino_unpack_size(base));
+    pino_destroy(spl1);
+
+    /* another base than the one the delta was made against */
+    TEST_ASSERT_NULL(pino_apply_delta(current, delta, delta_size));
+    free(delta);
+
+    /* different handlers have no delta */
+    spl1 = pino_pack("spl1", data, TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(spl1);
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_delta(base, spl1, NULL, 0));
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_delta(spl1, base, NULL, 0));
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_delta(NULL, base, NULL, 0));
+    TEST_ASSERT_NULL(pino_apply_delta(NULL, data, 16));
+    pino_destroy(spl1);
+
+    pino_destroy(base);
+    pino_destroy(current);
+    free(data);
+}
+
+void test_delta_corrupted(void)
+{
+    pino_t *base, *current, *pino;
+    uint8_t *data, *delta;
+    size_t delta_size, i;
+    pino_magic_safe_t magics[] = {"spl1", "apnd"};
+    int m;
+
+    data = (uint8_t *)malloc(TEST_DATA_SIZE);
+    TEST_ASSERT_NOT_NULL(data);
+    generate_random_data(data, TEST_DATA_SIZE);
+
+    for (m = 0; m < 2; m++) {
+        base = pino_pack(magics[m], data, TEST_DATA_SIZE - 1000);
+        TEST_ASSERT_NOT_NULL(base);
+        /* spl1 goes through byte ranges, apnd through its handler delta */
+        data[10] ^= m == 0 ? 0xFF : 0;
+        current = pino_pack(magics[m], data, TEST_DATA_SIZE);
+        TEST_ASSERT_NOT_NULL(current);
+        data[10] ^= m == 0 ? 0xFF : 0;
+
+        delta = serialize_delta(base, current, &delta_size);
+
+        /* truncated deltas never apply */
+        for (i = 0; i < delta_size; i++) {
+            TEST_ASSERT_NULL(pino_apply_delta(base, delta, i));
+        }
+
+        /* flipped bytes are rejected or at least stay in bounds */
+        for (i = 0; i < delta_size; i += (i < 64 ? 1 : 97)) {
+            delta[i] ^= 0x80;
+            pino = pino_apply_delta(base, delta, delta_size);
+            pino_destroy(pino);
+            delta[i] ^= 0x80;
+        }
+
+        free(delta);
+        pino_destroy(base);
+        pino_destroy(current);
+    }
+
+    free(data);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_delta);
+    RUN_TEST(test_delta_handler);
+    RUN_TEST(test_delta_corrupted);
+
+    return UNITY_END();
+}
@@ -9,6 +9,7 @@
 
 #include <pino/handler.h>
 #include <pino/endianness.h>
+#include <pino/pool.h>
 
 #include "util.h"
 
@@ -636,6 +637,163 @@ void test_memcmp_n2b(void)
     TEST_ASSERT_TRUE(result > 0);
 }
 
+void test_le2native_noop(void)
+{
+    TEST_ASSERT_TRUE(pino_endianness_le2native_noop(1));
+    TEST_ASSERT_TRUE(pino_endianness_le2native_noop(1024));
+
+    if (is_little_endian()) {
+        TEST_ASSERT_TRUE(pino_endianness_le2native_noop(2));
+        TEST_ASSERT_TRUE(pino_endianness_le2native_noop(4));
+        TEST_ASSERT_TRUE(pino_endianness_le2native_noop(8));
+    } else {
+        TEST_ASSERT_FALSE(pino_endianness_le2native_noop(2));
+        TEST_ASSERT_FALSE(pino_endianness_le2native_noop(4));
+        TEST_ASSERT_FALSE(pino_endianness_le2native_noop(8));
+    }
+
+    TEST_ASSERT_TRUE(pino_endianness_be2native_noop(1));
+    TEST_ASSERT_TRUE(pino_endianness_be2native_noop(1024));
+    TEST_ASSERT_EQUAL(!is_little_endian(), pino_endianness_be2native_noop(2));
+    TEST_ASSERT_EQUAL(!is_little_endian(), pino_endianness_be2native_noop(4));
+    TEST_ASSERT_EQUAL(!is_little_endian(), pino_endianness_be2native_noop(8));
+}
+
+void test_memcpy_array(void)
+{
+    uint8_t src[12], dest[12], back[12];
+    size_t i;
+
+    for (i = 0; i < sizeof(src); i++) {
+        src[i] = (uint8_t)i;
+    }
+
+    TEST_ASSERT_NULL(pino_endianness_memcpy_array_be2native(dest, src, 1, 0));
+    TEST_ASSERT_NULL(pino_endianness_memcpy_array_be2native(dest, src, SIZE_MAX, 2));
+
+    /* 4 x 3 byte elements */
+    TEST_ASSERT_EQUAL_PTR(dest, pino_endianness_memcpy_array_native2le(dest, src, 4, 3));
+    TEST_ASSERT_EQUAL_PTR(dest, pino_endianness_memcpy_array_native2be(dest, src, 4, 3));
+    if (is_little_endian()) {
+        TEST_ASSERT_EQUAL_UINT8(2, dest[0]);
+        TEST_ASSERT_EQUAL_UINT8(0, dest[2]);
+        TEST_ASSERT_EQUAL_UINT8(11, dest[9]);
+    } else {
+        TEST_ASSERT_EQUAL_MEMORY(src, dest, sizeof(src));
+    }
+
+    TEST_ASSERT_EQUAL_PTR(back, pino_endianness_memcpy_array_be2native(back, dest, 4, 3));
+    TEST_ASSERT_EQUAL_MEMORY(src, back, sizeof(src));
+    TEST_ASSERT_EQUAL_PTR(dest, pino_endianness_memcpy_array_le2native(dest, src, 3, 4));
+    TEST_ASSERT_EQUAL_MEMORY(src, dest, sizeof(src));
+}
+
+void test_memcpy_parallel(void)
+{
+    static const size_t elem_sizes[] = {1, 2, 3, 4, 8};
+    pino_pool_t *pool;
+    uint8_t *src, *serial, *parallel;
+    size_t size, count, i;
+
+    /* spans several chunks and ends in the middle of one */
+    size = 1024 * 1024 + 24 + 3;
+    src = (uint8_t *)malloc(size);
+    serial = (uint8_t *)malloc(size);
+    parallel = (uint8_t *)malloc(size);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(serial);
+    TEST_ASSERT_NOT_NULL(parallel);
+    generate_random_data(src, size);
+
+    pool = pino_pool_create(4);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    for (i = 0; i < sizeof(elem_sizes) / sizeof(elem_sizes[0]); i++) {
+        count = size / elem_sizes[i];
+
+        pino_endianness_parallel(NULL, 0);
+        TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_native2be(serial, src, count, elem_sizes[i]));
+
+        pino_endianness_parallel(pool, 1);
+        memset(parallel, 0, size);
+        TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_native2be(parallel, src, count, elem_sizes[i]));
+        TEST_ASSERT_EQUAL_MEMORY(serial, parallel, count * elem_sizes[i]);
+
+        TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_be2native(parallel, serial, count, elem_sizes[i]));
+        TEST_ASSERT_EQUAL_MEMORY(src, parallel, count * elem_sizes[i]);
+    }
+
+    /* byte copies of a whole buffer */
+    memset(parallel, 0, size);
+    TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_be2native(parallel, src, size));
+    TEST_ASSERT_EQUAL_MEMORY(src, parallel, size);
+
+    /* below the threshold stays on the caller */
+    pino_endianness_parallel(pool, size + 1);
+    memset(parallel, 0, size);
+    TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_native2le(parallel, src, size));
+    TEST_ASSERT_EQUAL_MEMORY(src, parallel, size);
+
+    pino_endianness_parallel(NULL, 0);
+    pino_pool_destroy(pool);
+    free(parallel);
+    free(serial);
+    free(src);
+}
+
+void test_memcpy_streaming(void)
+{
+    static const size_t elem_sizes[] = {1, 2, 3, 4, 8};
+    static const size_t offsets[] = {0, 1, 4, 8};
+    pino_pool_t *pool;
+    uint8_t *src, *serial, *streamed;
+    size_t size, count, i, j;
+    bool available;
+
+    size = 64 * 1024 + 48 + 7;
+    src = (uint8_t *)malloc(size);
+    serial = (uint8_t *)malloc(size + 8);
+    streamed = (uint8_t *)malloc(size + 8);
+    TEST_ASSERT_NOT_NULL(src);
+    TEST_ASSERT_NOT_NULL(serial);
+    TEST_ASSERT_NOT_NULL(streamed);
+    generate_random_data(src, size);
+
+    pool = pino_pool_create(4);
+    TEST_ASSERT_NOT_NULL(pool);
+
+    for (i = 0; i < sizeof(elem_sizes) / sizeof(elem_sizes[0]); i++) {
+        for (j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+            count = size / elem_sizes[i];
+
+            pino_endianness_streaming(false, 0);
+            TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_native2be(serial + offsets[j], src, count, elem_sizes[i]));
+
+            available = pino_endianness_streaming(true, 1);
+            memset(streamed, 0, size + 8);
+            TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_native2be(streamed + offsets[j], src, count, elem_sizes[i]));
+            TEST_ASSERT_EQUAL_MEMORY(serial + offsets[j], streamed + offsets[j], count * elem_sizes[i]);
+
+            /* together with the parallel path */
+            pino_endianness_parallel(pool, 1);
+            memset(streamed, 0, size + 8);
+            TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_native2le(streamed + offsets[j], src, count, elem_sizes[i]));
+            TEST_ASSERT_NOT_NULL(pino_endianness_memcpy_array_le2native(serial + offsets[j], streamed + offsets[j], count, elem_sizes[i]));
+            TEST_ASSERT_EQUAL_MEMORY(src, serial + offsets[j], count * elem_sizes[i]);
+            pino_endianness_parallel(NULL, 0);
+        }
+    }
+
+    if (available) {
+        TEST_ASSERT_TRUE(pino_endianness_streaming(true, 0));
+    }
+
+    pino_pool_destroy(pool);
+    free(streamed);
+    free(serial);
+    free(src);
+}
+
 int main(void)
 {
     UNITY_BEGIN();
@@ -655,5 +813,11 @@ int main(void)
     RUN_TEST(test_memcmp_n2l);
     RUN_TEST(test_memcmp_n2b);
 
+    RUN_TEST(test_le2native_noop);
+
+    RUN_TEST(test_memcpy_array);
+    RUN_TEST(test_memcpy_parallel);
+    RUN_TEST(test_memcpy_streaming);
+
     return UNITY_END();
 }
@@ -0,0 +1,309 @@
+/*
+ * libpino test - test_fields.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/decoder.h>
+#include <pino/fields.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_fld1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_FIXED_SIZE     (8 + 4 + 4 + 2 + 2 * 3 + 1 + 4 + 4)
+#define TEST_BODY_SIZE      200
+#define TEST_VALUES_SIZE    9
+
+/* sized at compile time */
+static const uint8_t g_fixed[PH_FIELDS_FIXED_SIZE(FLD1_FIELDS)];
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(fld1)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    if (!PH_UNREG(fld1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static uint8_t *put(uint8_t *dest, const void *src, size_t size)
+{
+    memcpy(dest, src, size);
+
+    return dest + size;
+}
+
+/* the pack input, fld1 members in list order and native byte order */
+static size_t build(uint8_t *dest, const uint8_t *body, uint32_t body_count, uint32_t values_count)
+{
+    uint8_t *p = dest;
+    uint64_t id = 0x0102030405060708ULL;
+    uint32_t seq = 42, flags = 0xA5A5F00F, value, i;
+    uint16_t kind = 7, ports[3] = {80, 443, 8080};
+    uint8_t level = 3;
+
+    p = put(p, &id, sizeof(id));
+    p = put(p, &seq, sizeof(seq));
+    p = put(p, &flags, sizeof(flags));
+    p = put(p, &kind, sizeof(kind));
+    p = put(p, ports, sizeof(ports));
+    p = put(p, &level, sizeof(level));
+    p = put(p, &body_count, sizeof(body_count));
+    p = put(p, body, body_count);
+    p = put(p, &values_count, sizeof(values_count));
+    for (i = 0; i < values_count; i++) {
+        value = i * 0x01010101U;
+        p = put(p, &value, sizeof(value));
+    }
+
+    return (size_t)(p - dest);
+}
+
+static void assert_members(pino_t *pino, const uint8_t *body, uint32_t body_count, uint32_t values_count)
+{
+    uint32_t i;
+
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_TRUE(pino_ensure_payload(pino));
+    TEST_ASSERT_EQUAL_HEX64(0x0102030405060708ULL, PH_PINO_P(fld1, pino)->id);
+    TEST_ASSERT_EQUAL_UINT32(42, PH_PINO_P(fld1, pino)->seq);
+    TEST_ASSERT_EQUAL_HEX32(0xA5A5F00F, PH_PINO_P(fld1, pino)->flags);
+    TEST_ASSERT_EQUAL_UINT16(7, PH_PINO_P(fld1, pino)->kind);
+    TEST_ASSERT_EQUAL_UINT16(80, PH_PINO_P(fld1, pino)->ports[0]);
+    TEST_ASSERT_EQUAL_UINT16(443, PH_PINO_P(fld1, pino)->ports[1]);
+    TEST_ASSERT_EQUAL_UINT16(8080, PH_PINO_P(fld1, pino)->ports[2]);
+    TEST_ASSERT_EQUAL_UINT8(3, PH_PINO_P(fld1, pino)->level);
+    TEST_ASSERT_EQUAL_UINT32(body_count, PH_PINO_P(fld1, pino)->body_count);
+    if (body_count > 0) {
+        TEST_ASSERT_EQUAL_MEMORY(body, PH_PINO_P(fld1, pino)->body, body_count);
+    }
+    TEST_ASSERT_EQUAL_UINT32(values_count, PH_PINO_P(fld1, pino)->values_count);
+    for (i = 0; i < values_count; i++) {
+        TEST_ASSERT_EQUAL_HEX32(i * 0x01010101U, PH_PINO_P(fld1, pino)->values[i]);
+    }
+}
+
+static pino_t *decode(const uint8_t *record, size_t size)
+{
+    pino_decoder_t *decoder;
+    pino_t *pino;
+    size_t offset, consumed;
+    pino_decoder_status_t status;
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    status = PINO_DECODER_NEED_MORE;
+    for (offset = 0; offset < size && status == PINO_DECODER_NEED_MORE; offset += consumed) {
+        status = pino_decoder_feed(decoder, record + offset, 5, &consumed);
+    }
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, status);
+    pino = pino_decoder_take(decoder);
+    pino_decoder_destroy(decoder);
+
+    return pino;
+}
+
+void test_fields_layout(void)
+{
+    pino_fields_t *fields = &PH_NAME_FIELDS(fld1);
+
+    TEST_ASSERT_EQUAL_size_t(TEST_FIXED_SIZE, sizeof(g_fixed));
+    TEST_ASSERT_EQUAL_size_t(8, PH_FIELDS_COUNT(FLD1_FIELDS));
+
+    /* id | seq, flags | kind, ports | level | body | values */
+    TEST_ASSERT_EQUAL_size_t(6, fields->op_count);
+    TEST_ASSERT_EQUAL_size_t(2, fields->ops[1].count);
+    TEST_ASSERT_EQUAL_size_t(sizeof(uint32_t), fields->ops[1].size);
+    TEST_ASSERT_EQUAL_size_t(4, fields->ops[2].count);
+    TEST_ASSERT_EQUAL_size_t(sizeof(uint16_t), fields->ops[2].size);
+    TEST_ASSERT_EQUAL_size_t(0, fields->ops[4].count);
+    TEST_ASSERT_EQUAL_size_t(offsetof(struct PH_NAME_STRUCT(fld1), values_count), fields->ops[5].count_offset);
+
+    /* members keep their natural alignment */
+    TEST_ASSERT_EQUAL_size_t(0, offsetof(struct PH_NAME_STRUCT(fld1), values) % sizeof(void *));
+}
+
+void test_fields_roundtrip(void)
+{
+    pino_t *pino, *out, *clone;
+    uint8_t body[TEST_BODY_SIZE], *src, *wire, *record, *unpacked;
+    uint32_t body_counts[] = {0, 1, TEST_BODY_SIZE}, values_counts[] = {0, TEST_VALUES_SIZE};
+    uint32_t flags[] = {0, PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_COMPRESS, PINO_SERIALIZE_COMPACT};
+    size_t size, record_size, b, v, f;
+
+    generate_random_data(body, sizeof(body));
+    src = (uint8_t *)malloc(TEST_FIXED_SIZE + TEST_BODY_SIZE + TEST_VALUES_SIZE * sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(src);
+
+    for (b = 0; b < sizeof(body_counts) / sizeof(body_counts[0]); b++) {
+        for (v = 0; v < sizeof(values_counts) / sizeof(values_counts[0]); v++) {
+            size = build(src, body, body_counts[b], values_counts[v]);
+            pino = pino_pack("fld1", src, size);
+            assert_members(pino, body, body_counts[b], values_counts[v]);
+            TEST_ASSERT_EQUAL_size_t(size, pino_unpack_size(pino));
+
+            unpacked = (uint8_t *)malloc(size);
+            TEST_ASSERT_NOT_NULL(unpacked);
+            TEST_ASSERT_TRUE(pino_unpack(pino, unpacked));
+            TEST_ASSERT_EQUAL_MEMORY(src, unpacked, size);
+            free(unpacked);
+
+            /* every member in list order, LE */
+            wire = (uint8_t *)malloc(pino_serialize_size(pino));
+            TEST_ASSERT_NOT_NULL(wire);
+            TEST_ASSERT_TRUE(pino_serialize(pino, wire));
+            TEST_ASSERT_EQUAL_size_t(PINO_HEADER_SIZE + sizeof(uint32_t) + size, pino_serialize_size(pino));
+            if (pino_endianness_le2native_noop(sizeof(uint32_t))) {
+                TEST_ASSERT_EQUAL_MEMORY(src, wire + PINO_HEADER_SIZE + sizeof(uint32_t), size);
+            }
+            free(wire);
+
+            for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+                record_size = pino_serialize_record(pino, NULL, 0, flags[f]);
+                record = (uint8_t *)malloc(record_size);
+                TEST_ASSERT_NOT_NULL(record);
+                TEST_ASSERT_EQUAL_size_t(record_size, pino_serialize_record(pino, record, record_size, flags[f]));
+
+                out = pino_unserialize(record, record_size);
+                assert_members(out, body, body_counts[b], values_counts[v]);
+                pino_destroy(out);
+                out = pino_unserialize_lazy(record, record_size);
+                assert_members(out, body, body_counts[b], values_counts[v]);
+                pino_destroy(out);
+                out = decode(record, record_size);
+                assert_members(out, body, body_counts[b], values_counts[v]);
+                pino_destroy(out);
+
+                free(record);
+            }
+
+            /* copy-on-write duplicates the vectors too */
+            clone = pino_clone(pino);
+            TEST_ASSERT_NOT_NULL(clone);
+            TEST_ASSERT_TRUE(pino_touch(clone));
+            PH_PINO_P(fld1, clone)->id = 1;
+            if (body_counts[b] > 0) {
+                TEST_ASSERT_TRUE(PH_PINO_P(fld1, clone)->body != PH_PINO_P(fld1, pino)->body);
+            }
+            assert_members(pino, body, body_counts[b], values_counts[v]);
+
+            pino_destroy(clone);
+            pino_destroy(pino);
+        }
+    }
+
+    free(src);
+}
+
+void test_fields_resize(void)
+{
+    pino_t *pino, *outs[2];
+    uint8_t body[TEST_BODY_SIZE], src[TEST_FIXED_SIZE + TEST_BODY_SIZE], *record;
+    size_t size, record_size;
+    uint32_t i;
+
+    generate_random_data(body, sizeof(body));
+    size = build(src, body, 10, 0);
+    pino = pino_pack("fld1", src, size);
+    assert_members(pino, body, 10, 0);
+
+    TEST_ASSERT_TRUE(PH_FIELDS_RESIZE(fld1, pino, values, TEST_VALUES_SIZE));
+    for (i = 0; i < TEST_VALUES_SIZE; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, PH_PINO_P(fld1, pino)->values[i]);
+        PH_PINO_P(fld1, pino)->values[i] = i * 0x01010101U;
+    }
+    TEST_ASSERT_TRUE(PH_FIELDS_RESIZE(fld1, pino, body, TEST_BODY_SIZE));
+    memcpy(PH_PINO_P(fld1, pino)->body, body, TEST_BODY_SIZE);
+    TEST_ASSERT_TRUE(PH_FIELDS_RESIZE(fld1, pino, body, TEST_BODY_SIZE / 2));
+
+    /* only vectors resize */
+    TEST_ASSERT_FALSE(PH_FIELDS_RESIZE(fld1, pino, seq, 2));
+    TEST_ASSERT_FALSE(PH_FIELDS_RESIZE(fld1, NULL, body, 2));
+
+    /* a payload past UINT32_MAX is refused before anything changes */
+    TEST_ASSERT_FALSE(PH_FIELDS_RESIZE(fld1, pino, values, UINT32_MAX / sizeof(uint32_t) + 1));
+    assert_members(pino, body, TEST_BODY_SIZE / 2, TEST_VALUES_SIZE);
+
+    /* the payload size in the static fields follows, records delimit themselves in batches */
+    record_size = pino_serialize_record(pino, NULL, 0, 0);
+    record = (uint8_t *)malloc(record_size * 2);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_EQUAL_size_t(record_size, pino_serialize_record(pino, record, record_size, 0));
+    memcpy(record + record_size, record, record_size);
+    TEST_ASSERT_EQUAL_size_t(2, pino_unserialize_batch(record, record_size * 2, outs, 2));
+    assert_members(outs[0], body, TEST_BODY_SIZE / 2, TEST_VALUES_SIZE);
+    assert_members(outs[1], body, TEST_BODY_SIZE / 2, TEST_VALUES_SIZE);
+
+    free(record);
+    pino_destroy(outs[0]);
+    pino_destroy(outs[1]);
+    pino_destroy(pino);
+}
+
+void test_fields_invalid(void)
+{
+    pino_t *pino;
+    uint8_t body[16], src[TEST_FIXED_SIZE + 16], *record;
+    uint32_t count = 0xFFFFFF;
+    size_t size, record_size;
+
+    generate_random_data(body, sizeof(body));
+    size = build(src, body, sizeof(body), 0);
+
+    /* pack takes exactly one payload */
+    TEST_ASSERT_NULL(pino_pack("fld1", src, size - 1));
+    TEST_ASSERT_NULL(pino_pack("fld1", src, TEST_FIXED_SIZE - 5));
+
+    pino = pino_pack("fld1", src, size);
+    TEST_ASSERT_NOT_NULL(pino);
+    record_size = pino_serialize_size(pino);
+    record = (uint8_t *)malloc(record_size);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_TRUE(pino_serialize(pino, record));
+    pino_destroy(pino);
+
+    /* element counts past the payload */
+    pino_endianness_memcpy_native2le(record + PINO_HEADER_SIZE + sizeof(uint32_t) + TEST_FIXED_SIZE - 8, &count, sizeof(count));
+    TEST_ASSERT_NULL(pino_unserialize(record, record_size));
+
+    /* a lazy pino only finds out on first access, and keeps failing without decoding again */
+    pino = pino_unserialize_lazy(record, record_size);
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_size(pino));
+    TEST_ASSERT_FALSE(pino_is_loaded(pino));
+    count = 0;
+    pino_endianness_memcpy_native2le(record + PINO_HEADER_SIZE + sizeof(uint32_t) + TEST_FIXED_SIZE - 8, &count, sizeof(count));
+    TEST_ASSERT_EQUAL_size_t(0, pino_serialize_size(pino));
+    TEST_ASSERT_FALSE(pino_unpack(pino, src));
+    TEST_ASSERT_FALSE(pino_touch(pino));
+    pino_destroy(pino);
+
+    free(record);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_fields_layout);
+    RUN_TEST(test_fields_roundtrip);
+    RUN_TEST(test_fields_resize);
+    RUN_TEST(test_fields_invalid);
+
+    return UNITY_END();
+}
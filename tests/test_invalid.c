@@ -57,6 +57,60 @@ void test_pino(void)
     pino_destroy(NULL);
 }
 
+void test_peek(void)
+{
+    pino_header_t header;
+    uint8_t *data;
+    size_t size;
+    uint32_t u32;
+
+    TEST_ASSERT_FALSE(pino_peek(NULL, 0, &header));
+
+    TEST_ASSERT_TRUE(load_file(g_invalid_static_fields_size_path, &data, &size));
+    TEST_ASSERT_FALSE(pino_peek(data, size, &header));
+    TEST_ASSERT_FALSE(pino_peek(data, sizeof(pino_magic_t), &header));
+    free(data);
+
+    TEST_ASSERT_TRUE(load_file(g_handler_missing_path, &data, &size));
+    TEST_ASSERT_TRUE(pino_peek(data, size, &header));
+    TEST_ASSERT_FALSE(pino_peek(data, size, NULL));
+    TEST_ASSERT_FALSE(pino_peek_static(&header, header.static_fields_size, &u32, sizeof(u32)));
+    TEST_ASSERT_FALSE(pino_peek_static(&header, SIZE_MAX, &u32, sizeof(u32)));
+    TEST_ASSERT_FALSE(pino_peek_static(NULL, 0, &u32, sizeof(u32)));
+    free(data);
+}
+
+void test_validate(void)
+{
+    uint8_t *data;
+    size_t size;
+
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_INVALID_ARGUMENT, pino_validate(NULL, 0));
+
+    TEST_ASSERT_TRUE(load_file(g_invalid_static_fields_size_path, &data, &size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(data, size));
+    /* static_fields_size fits in the buffer but does not match the handler */
+    data[sizeof(pino_magic_t)] = 0x04;
+    memset(data + sizeof(pino_magic_t) + 1, 0, sizeof(pino_static_fields_size_t) - 1);
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_STATIC_FIELDS_SIZE, pino_validate(data, size));
+    TEST_ASSERT_NULL(pino_unserialize(data, size));
+    TEST_ASSERT_NULL(pino_unserialize_validated(data, size));
+    free(data);
+
+    TEST_ASSERT_TRUE(load_file(g_truncated_path, &data, &size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_TRUNCATED, pino_validate(data, size));
+    free(data);
+
+    TEST_ASSERT_TRUE(load_file(g_broken_path, &data, &size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_PAYLOAD, pino_validate(data, size));
+    free(data);
+
+    TEST_ASSERT_TRUE(load_file(g_handler_missing_path, &data, &size));
+    TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_HANDLER_MISSING, pino_validate(data, size));
+    TEST_ASSERT_NULL(pino_unserialize_validated(data, size));
+    free(data);
+}
+
 void test_endianness(void)
 {
     char i = 1, j = 0, b[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, u[10] = {0};
@@ -150,6 +204,8 @@ int main(void)
     UNITY_BEGIN();
 
     RUN_TEST(test_pino);
+    RUN_TEST(test_peek);
+    RUN_TEST(test_validate);
     RUN_TEST(test_endianness);
     RUN_TEST(test_handler);
 
@@ -0,0 +1,283 @@
+/*
+ * libpino test - test_log.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/handler.h>
+#include <pino/log.h>
+#include <pino/pool.h>
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_DATA_SIZE      128
+#define TEST_RECORDS        200
+#define TEST_LOG_PATH       "test_log.pinl"
+
+typedef struct {
+    uint64_t count;
+    bool ordered;
+} scan_ctx_t;
+
+void setUp(void)
+{
+    remove(TEST_LOG_PATH);
+
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    remove(TEST_LOG_PATH);
+
+    if (!PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+static bool scan_fn(void *arg, const void *record, size_t size)
+{
+    scan_ctx_t *ctx = (scan_ctx_t *)arg;
+    pino_t *pino;
+
+    pino = pino_unserialize(record, size);
+    if (!pino) {
+        return false;
+    }
+
+    ctx->ordered = ctx->ordered && get_u32(pino) == (uint32_t)ctx->count;
+    ++ctx->count;
+    pino_destroy(pino);
+
+    return true;
+}
+
+static void append_records(pino_log_t *log, size_t begin, size_t end, bool durable)
+{
+    uint8_t data[TEST_DATA_SIZE];
+    pino_t *pino;
+    size_t i;
+
+    generate_fixed_data(data, sizeof(data));
+
+    for (i = begin; i < end; i++) {
+        pino = pino_pack("spl1", data, i % TEST_DATA_SIZE + 1);
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, (uint32_t)i);
+        TEST_ASSERT_TRUE(pino_log_append(log, pino, durable));
+        pino_destroy(pino);
+    }
+}
+
+void test_log(void)
+{
+    pino_log_options_t options;
+    pino_log_t *log;
+    scan_ctx_t ctx;
+    uint64_t count;
+
+    /* small groups so that buffered appends commit on their own */
+    options.group_bytes = 1024;
+    options.group_delay_us = 0;
+    options.backend = PINO_ASYNC_AUTO;
+
+    log = pino_log_open(TEST_LOG_PATH, &options);
+    TEST_ASSERT_NOT_NULL(log);
+    append_records(log, 0, TEST_RECORDS / 2, false);
+    append_records(log, TEST_RECORDS / 2, TEST_RECORDS, true);
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)pino_log_count(log));
+    TEST_ASSERT_TRUE(pino_log_close(log));
+
+    ctx.count = 0;
+    ctx.ordered = true;
+    TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, scan_fn, &ctx, &count));
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)count);
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)ctx.count);
+    TEST_ASSERT_TRUE(ctx.ordered);
+
+    /* reopened logs keep appending after the recovered records */
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)pino_log_count(log));
+    append_records(log, TEST_RECORDS, TEST_RECORDS + 10, false);
+    TEST_ASSERT_TRUE(pino_log_sync(log));
+    TEST_ASSERT_TRUE(pino_log_close(log));
+
+    ctx.count = 0;
+    ctx.ordered = true;
+    TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, scan_fn, &ctx, NULL));
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS + 10, (uint32_t)ctx.count);
+    TEST_ASSERT_TRUE(ctx.ordered);
+}
+
+void test_log_torn_tail(void)
+{
+    pino_log_t *log;
+    uint8_t *file;
+    size_t file_size, intact_size;
+    uint64_t count;
+
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    append_records(log, 0, 10, true);
+    TEST_ASSERT_TRUE(pino_log_close(log));
+    TEST_ASSERT_TRUE(load_file(TEST_LOG_PATH, &file, &intact_size));
+    free(file);
+
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    append_records(log, 10, 11, true);
+    TEST_ASSERT_TRUE(pino_log_close(log));
+    TEST_ASSERT_TRUE(load_file(TEST_LOG_PATH, &file, &file_size));
+
+    /* half written last record */
+    TEST_ASSERT_TRUE(save_file(TEST_LOG_PATH, file, intact_size + (file_size - intact_size) / 2));
+    TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, NULL, NULL, &count));
+    TEST_ASSERT_EQUAL_UINT32(10, (uint32_t)count);
+    free(file);
+    TEST_ASSERT_TRUE(load_file(TEST_LOG_PATH, &file, &file_size));
+    TEST_ASSERT_EQUAL_size_t(intact_size, file_size);
+    free(file);
+
+    /* checksum mismatch in the last record, recovered by pino_log_open() */
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    append_records(log, 10, 11, true);
+    TEST_ASSERT_TRUE(pino_log_close(log));
+    TEST_ASSERT_TRUE(load_file(TEST_LOG_PATH, &file, &file_size));
+    file[file_size - 1] ^= 0xFF;
+    TEST_ASSERT_TRUE(save_file(TEST_LOG_PATH, file, file_size));
+    free(file);
+
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    TEST_ASSERT_EQUAL_UINT32(10, (uint32_t)pino_log_count(log));
+    TEST_ASSERT_TRUE(pino_log_close(log));
+
+    /* header only partially written */
+    TEST_ASSERT_TRUE(save_file(TEST_LOG_PATH, (const uint8_t *)PINO_LOG_MAGIC, 3));
+    log = pino_log_open(TEST_LOG_PATH, NULL);
+    TEST_ASSERT_NOT_NULL(log);
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)pino_log_count(log));
+    append_records(log, 0, 1, true);
+    TEST_ASSERT_TRUE(pino_log_close(log));
+    TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, NULL, NULL, &count));
+    TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)count);
+}
+
+static pino_log_t *g_concurrent_log;
+
+static void concurrent_fn(void *arg, size_t begin, size_t end)
+{
+    (void)arg;
+
+    append_records(g_concurrent_log, begin, end, true);
+}
+
+void test_log_group_commit(void)
+{
+    pino_log_options_t options;
+    pino_pool_t *pool;
+    scan_ctx_t ctx;
+
+    options.group_bytes = 0;
+    options.group_delay_us = 100;
+    options.backend = PINO_ASYNC_AUTO;
+
+    g_concurrent_log = pino_log_open(TEST_LOG_PATH, &options);
+    TEST_ASSERT_NOT_NULL(g_concurrent_log);
+
+    pool = pino_pool_create(4);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_TRUE(pino_pool_parallel_for(pool, TEST_RECORDS, 1, concurrent_fn, NULL));
+    pino_pool_destroy(pool);
+
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)pino_log_count(g_concurrent_log));
+    TEST_ASSERT_TRUE(pino_log_close(g_concurrent_log));
+
+    /* every record is there, in whatever order the threads won */
+    ctx.count = 0;
+    ctx.ordered = true;
+    TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, scan_fn, &ctx, NULL));
+    TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS, (uint32_t)ctx.count);
+}
+
+void test_log_backends(void)
+{
+    pino_log_options_t options;
+    pino_log_t *log;
+    scan_ctx_t ctx;
+    int backend;
+
+    options.group_bytes = 1024;
+    options.group_delay_us = 0;
+
+    for (backend = PINO_ASYNC_AUTO; backend <= PINO_ASYNC_THREADS; backend++) {
+        remove(TEST_LOG_PATH);
+
+        options.backend = (pino_async_backend_t)backend;
+        log = pino_log_open(TEST_LOG_PATH, &options);
+        if (!log) {
+            /* only io_uring may be missing */
+            TEST_ASSERT_EQUAL_INT(PINO_ASYNC_IO_URING, backend);
+            continue;
+        }
+
+        TEST_ASSERT_NOT_EQUAL(PINO_ASYNC_AUTO, pino_log_backend(log));
+        append_records(log, 0, TEST_RECORDS / 2, false);
+        append_records(log, TEST_RECORDS / 2, TEST_RECORDS, true);
+        TEST_ASSERT_TRUE(pino_log_close(log));
+
+        /* reopened logs keep appending where the last commit ended */
+        log = pino_log_open(TEST_LOG_PATH, &options);
+        TEST_ASSERT_NOT_NULL(log);
+        append_records(log, TEST_RECORDS, TEST_RECORDS + 10, true);
+        TEST_ASSERT_TRUE(pino_log_close(log));
+
+        ctx.count = 0;
+        ctx.ordered = true;
+        TEST_ASSERT_TRUE(pino_log_recover(TEST_LOG_PATH, scan_fn, &ctx, NULL));
+        TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS + 10, (uint32_t)ctx.count);
+        TEST_ASSERT_TRUE(ctx.ordered);
+    }
+}
+
+void test_log_invalid(void)
+{
+    uint8_t garbage[PINO_LOG_HEADER_SIZE];
+
+    TEST_ASSERT_NULL(pino_log_open(NULL, NULL));
+    TEST_ASSERT_FALSE(pino_log_append(NULL, NULL, true));
+    TEST_ASSERT_FALSE(pino_log_sync(NULL));
+    TEST_ASSERT_FALSE(pino_log_close(NULL));
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)pino_log_count(NULL));
+    TEST_ASSERT_EQUAL_INT(PINO_ASYNC_AUTO, pino_log_backend(NULL));
+    TEST_ASSERT_FALSE(pino_log_recover(NULL, NULL, NULL, NULL));
+
+    memset(garbage, 'X', sizeof(garbage));
+    TEST_ASSERT_TRUE(save_file(TEST_LOG_PATH, garbage, sizeof(garbage)));
+    TEST_ASSERT_NULL(pino_log_open(TEST_LOG_PATH, NULL));
+    TEST_ASSERT_FALSE(pino_log_recover(TEST_LOG_PATH, NULL, NULL, NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_log);
+    RUN_TEST(test_log_torn_tail);
+    RUN_TEST(test_log_group_commit);
+    RUN_TEST(test_log_backends);
+    RUN_TEST(test_log_invalid);
+
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+/*
+ * libpino test - test_native.c
+ * 
+ */
+
+#include <string.h>
+
+#include <pino.h>
+#include <pino/container.h>
+#include <pino/handler.h>
+
+#include "../src/pino_internal.h"
+
+#include "handler_spl1.h"
+#include "util.h"
+
+#include "unity.h"
+
+#define TEST_PAYLOAD_OFFSET (PINO_HEADER_SIZE + sizeof(spl1_size_t) + sizeof(uint32_t))
+#define TEST_FLAGS_OFFSET   (sizeof(pino_magic_t) + PINO_FLAGS_SHIFT / 8)
+#define TEST_CONTAINER_PATH "test_native.pinc"
+#define TEST_RECORD_OFFSET  (PINO_CONTAINER_HEADER_SIZE + PINO_CONTAINER_RECORD_SIZE)
+
+void setUp(void)
+{
+    if (!pino_init() || !PH_REG(spl1)) {
+        TEST_FAIL();
+    }
+}
+
+void tearDown(void)
+{
+    remove(TEST_CONTAINER_PATH);
+
+    if (!PH_UNREG(spl1)) {
+        TEST_FAIL();
+    }
+
+    pino_free();
+}
+
+/* what a big endian writer sends for the little endian record: same fields, the payload element swapped */
+static void make_big_endian(uint8_t *record, size_t size, size_t payload_size, bool checked)
+{
+    uint32_t crc;
+    size_t i;
+    uint8_t tmp;
+
+    record[TEST_FLAGS_OFFSET] |= PINO_SERIALIZE_NATIVE;
+    if (payload_size <= sizeof(uint64_t)) {
+        for (i = 0; i < payload_size / 2; i++) {
+            tmp = record[TEST_PAYLOAD_OFFSET + i];
+            record[TEST_PAYLOAD_OFFSET + i] = record[TEST_PAYLOAD_OFFSET + payload_size - 1 - i];
+            record[TEST_PAYLOAD_OFFSET + payload_size - 1 - i] = tmp;
+        }
+    }
+
+    if (checked) {
+        crc = pino_crc32c_update(0, record, size - PINO_CHECKSUM_SIZE);
+        pino_endianness_memcpy_native2le(record + size - PINO_CHECKSUM_SIZE, &crc, sizeof(uint32_t));
+    }
+}
+
+void test_native(void)
+{
+    pino_header_t header;
+    pino_t *pino;
+    uint8_t data[64], *plain, *native, *big, *adopted;
+    size_t sizes[] = {2, 4, 8, 64}, plain_size, native_size, i;
+    uint32_t flags[] = {0, PINO_SERIALIZE_CRC32C, PINO_SERIALIZE_COMPRESS}, plain_flags, f;
+    bool host_big;
+
+    generate_random_data(data, sizeof(data));
+    host_big = !pino_endianness_le2native_noop(sizeof(uint16_t));
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+            pino = pino_pack("spl1", data, sizes[i]);
+            TEST_ASSERT_NOT_NULL(pino);
+            set_u32(pino, 0xC0FFEE);
+
+            plain = serialize(pino, flags[f], &plain_size);
+            native = serialize(pino, flags[f] | PINO_SERIALIZE_NATIVE, &native_size);
+            big = (uint8_t *)malloc(plain_size);
+            TEST_ASSERT_NOT_NULL(big);
+            memcpy(big, plain, plain_size);
+            make_big_endian(big, plain_size, sizes[i], (flags[f] & PINO_SERIALIZE_CRC32C) != 0);
+            pino_destroy(pino);
+
+            /* little endian writers send the usual record, big endian ones keep their byte order */
+            TEST_ASSERT_EQUAL_size_t(plain_size, native_size);
+            TEST_ASSERT_EQUAL_MEMORY(host_big ? big : plain, native, native_size);
+            TEST_ASSERT_TRUE(pino_peek(plain, plain_size, &header));
+            plain_flags = header.flags;
+            TEST_ASSERT_TRUE(pino_peek(big, plain_size, &header));
+            TEST_ASSERT_EQUAL_UINT32(plain_flags | PINO_SERIALIZE_NATIVE, header.flags);
+
+            /* either order reads back the same on any host */
+            assert_unpacked(pino_unserialize(plain, plain_size), data, sizes[i]);
+            assert_unpacked(pino_unserialize(big, plain_size), data, sizes[i]);
+            assert_unpacked(pino_unserialize_validated(big, plain_size), data, sizes[i]);
+            assert_unpacked(pino_unserialize_lazy(big, plain_size), data, sizes[i]);
+            assert_decoded(big, plain_size, 1, data, sizes[i]);
+            TEST_ASSERT_EQUAL_INT(PINO_VALIDATE_OK, pino_validate(big, plain_size));
+
+            /* spl1 adopts payloads, a swapped one has to be copied instead */
+            adopted = (uint8_t *)malloc(plain_size);
+            TEST_ASSERT_NOT_NULL(adopted);
+            memcpy(adopted, big, plain_size);
+            assert_unpacked(pino_unserialize_adopt(adopted, plain_size, free), data, sizes[i]);
+
+            free(plain);
+            free(native);
+            free(big);
+        }
+    }
+}
+
+static void read_fn(void *arg, size_t index, pino_t *pino)
+{
+    TEST_ASSERT_EQUAL_size_t(0, index);
+    *(pino_t **)arg = pino;
+}
+
+void test_native_container(void)
+{
+    pino_container_writer_t *writer;
+    pino_container_reader_t *reader;
+    pino_async_reader_t *async_reader;
+    pino_t *pino, *read;
+    uint8_t data[8], *plain, *file;
+    size_t sizes[] = {2, 4, 8}, plain_size, file_size, i;
+
+    generate_random_data(data, sizeof(data));
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        pino = pino_pack("spl1", data, sizes[i]);
+        TEST_ASSERT_NOT_NULL(pino);
+        set_u32(pino, 0xC0FFEE);
+        plain = serialize(pino, 0, &plain_size);
+
+        writer = pino_container_writer_open(TEST_CONTAINER_PATH);
+        TEST_ASSERT_NOT_NULL(writer);
+        TEST_ASSERT_TRUE(pino_container_writer_append(writer, pino));
+        TEST_ASSERT_TRUE(pino_container_writer_close(writer));
+        pino_destroy(pino);
+
+        /* the only record turned into what a big endian writer would have stored */
+        TEST_ASSERT_TRUE(load_file(TEST_CONTAINER_PATH, &file, &file_size));
+        TEST_ASSERT_TRUE(file_size > TEST_RECORD_OFFSET + plain_size);
+        TEST_ASSERT_EQUAL_MEMORY(plain, file + TEST_RECORD_OFFSET, plain_size);
+        make_big_endian(file + TEST_RECORD_OFFSET, plain_size, sizes[i], false);
+        TEST_ASSERT_TRUE(save_file(TEST_CONTAINER_PATH, file, file_size));
+        free(file);
+        free(plain);
+
+        /* every reader hands the record to pino_unserialize_adopt() */
+        reader = pino_container_reader_open(TEST_CONTAINER_PATH);
+        TEST_ASSERT_NOT_NULL(reader);
+        assert_unpacked(pino_container_reader_get(reader, 0), data, sizes[i]);
+        pino_container_reader_close(reader);
+
+        reader = pino_container_reader_open_mmap(TEST_CONTAINER_PATH);
+        if (reader) {
+            assert_unpacked(pino_container_reader_get(reader, 0), data, sizes[i]);
+            pino_container_reader_close(reader);
+        }
+
+        async_reader = pino_async_reader_open(TEST_CONTAINER_PATH, PINO_ASYNC_THREADS, 1);
+        TEST_ASSERT_NOT_NULL(async_reader);
+        TEST_ASSERT_TRUE(pino_async_reader_submit(async_reader, 0));
+        read = NULL;
+        TEST_ASSERT_EQUAL_size_t(1, pino_async_reader_poll(async_reader, true, read_fn, &read));
+        assert_unpacked(read, data, sizes[i]);
+        pino_async_reader_close(async_reader);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_native);
+    RUN_TEST(test_native_container);
+
+    return UNITY_END();
+}
@@ -13,6 +13,11 @@
 #include <stdint.h>
 #include <time.h>
 
+#include <pino.h>
+#include <pino/decoder.h>
+
+#include "unity.h"
+
 #if defined(__linux__)
 # include <linux/limits.h>
 #elif defined(__APPLE__)
@@ -200,4 +205,62 @@ static inline void print_hex(uint8_t *data, size_t len)
     printf("\n");
 }
 
+/* compressed records come out smaller than the capacity asked for, the caller frees the buffer */
+static inline uint8_t *serialize(const pino_t *pino, uint32_t flags, size_t *size)
+{
+    uint8_t *buffer;
+    size_t capacity;
+
+    capacity = pino_serialize_record(pino, NULL, 0, flags);
+    TEST_ASSERT_NOT_EQUAL(0, capacity);
+    buffer = (uint8_t *)malloc(capacity);
+    TEST_ASSERT_NOT_NULL(buffer);
+    *size = pino_serialize_record(pino, buffer, capacity, flags);
+    TEST_ASSERT_NOT_EQUAL(0, *size);
+    TEST_ASSERT_TRUE(*size <= capacity);
+
+    return buffer;
+}
+
+#ifdef PINO_TESTS_HANDLER_SPL1_H
+/* the spl1 records of these tests carry 0xC0FFEE, pino is destroyed */
+static inline void assert_unpacked(pino_t *pino, const uint8_t *data, size_t size)
+{
+    uint8_t *out;
+
+    TEST_ASSERT_NOT_NULL(pino);
+    TEST_ASSERT_EQUAL_UINT32(0xC0FFEE, get_u32(pino));
+    TEST_ASSERT_EQUAL_size_t(size, pino_unpack_size(pino));
+
+    out = (uint8_t *)malloc(size > 0 ? size : 1);
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_TRUE(pino_unpack(pino, out));
+    TEST_ASSERT_EQUAL_MEMORY(data, out, size);
+
+    free(out);
+    pino_destroy(pino);
+}
+
+/* fed chunk bytes at a time, the decoder has to stop right at the end of the record */
+static inline void assert_decoded(const uint8_t *record, size_t size, size_t chunk, const uint8_t *data, size_t data_size)
+{
+    pino_decoder_t *decoder;
+    size_t offset, consumed;
+    pino_decoder_status_t status;
+
+    decoder = pino_decoder_create();
+    TEST_ASSERT_NOT_NULL(decoder);
+
+    status = PINO_DECODER_NEED_MORE;
+    for (offset = 0; offset < size && status == PINO_DECODER_NEED_MORE; offset += consumed) {
+        status = pino_decoder_feed(decoder, record + offset, size - offset < chunk ? size - offset : chunk, &consumed);
+    }
+    TEST_ASSERT_EQUAL_INT(PINO_DECODER_DONE, status);
+    TEST_ASSERT_EQUAL_size_t(size, offset);
+    assert_unpacked(pino_decoder_take(decoder), data, data_size);
+
+    pino_decoder_destroy(decoder);
+}
+#endif
+
 #endif  /* PINO_TESTS_UTIL_H */